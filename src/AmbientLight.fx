@@ -51,11 +51,7 @@ VertexOutput Main(VertexInput input)
 
 #ifdef PIXEL_SHADER
 
-Texture2D diffuseTexture : register(t0);
-Texture2D specularTexture : register(t1);
-Texture2D positionTexture : register(t2);
-Texture2D normalTexture : register(t3);
-SamplerState geometrySampler : register(s0);
+#include "GeometryBuffer.fxh"
 
 cbuffer DynamicLight : register(b0)
 {
@@ -80,7 +76,8 @@ struct PixelOutput
 
 PixelOutput Main(PixelInput input)
 {
-    float4 diffuseSample = diffuseTexture.Sample(geometrySampler, input.texcoord);
+    float4 diffuseSample, specularSample, positionSample, normalSample;
+    SampleGeometry(input.texcoord, diffuseSample, specularSample, positionSample, normalSample);
 
     float3 diffuseColor = diffuseSample.rgb;
     float ambientIntensity = diffuseSample.a;
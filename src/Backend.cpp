@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Backend.h"
+#include "Window.h"
+#include <windows.h>
+#include <DDSTextureLoader.h>
+#include <cassert>
+#include <stdexcept>
+
+const BackendStats& Backend::GetStats() const
+{
+    return m_Stats;
+}
+
+void Backend::ResetStats()
+{
+    m_Stats = { };
+}
+
+DX11Backend::DX11Backend(Window& window)
+{
+    {
+#ifndef NDEBUG
+        UINT uD3D11Flags = D3D11_CREATE_DEVICE_DEBUG;
+#else  // NDEBUG
+        UINT uD3D11Flags = 0;
+#endif // NDEBUG
+
+        D3D_FEATURE_LEVEL pD3D11FeatureLevels[] = { D3D_FEATURE_LEVEL_11_1 };
+
+        HRESULT hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, uD3D11Flags, pD3D11FeatureLevels, 1, D3D11_SDK_VERSION, &m_D3D11Device, nullptr, &m_D3D11DeviceContext);
+        if (FAILED(hr))
+            throw std::runtime_error("Failed to create DX11 device");
+
+        hr = m_D3D11DeviceContext.As(&m_D3D11DeviceContext1);
+        assert(SUCCEEDED(hr));
+    }
+
+    {
+        // https://docs.microsoft.com/en-us/windows/win32/api/dxgi1_2/nn-dxgi1_2-idxgifactory2
+
+        Microsoft::WRL::ComPtr<IDXGIDevice2> pDXGIDevice2;
+        Microsoft::WRL::ComPtr<IDXGIAdapter> pDXGIAdapter;
+        Microsoft::WRL::ComPtr<IDXGIFactory2> pIDXGIFactory2;
+
+        HRESULT hr = m_D3D11Device.As(&pDXGIDevice2);
+        assert(SUCCEEDED(hr));
+
+        hr = pDXGIDevice2->GetParent(IID_PPV_ARGS(&pDXGIAdapter));
+        assert(SUCCEEDED(hr));
+
+        hr = pDXGIAdapter->GetParent(IID_PPV_ARGS(&pIDXGIFactory2));
+        assert(SUCCEEDED(hr));
+
+        DXGI_SWAP_CHAIN_DESC1 swapChainDesc1{ };
+        swapChainDesc1.Width = window.GetWidth();
+        swapChainDesc1.Height = window.GetHeight();
+        swapChainDesc1.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        swapChainDesc1.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+        swapChainDesc1.BufferCount = 2; // For DXGI_SWAP_EFFECT_FLIP_DISCARD
+        swapChainDesc1.Scaling = DXGI_SCALING_NONE;
+        swapChainDesc1.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
+        swapChainDesc1.AlphaMode = DXGI_ALPHA_MODE_IGNORE;
+        swapChainDesc1.SampleDesc.Count = 1;
+        swapChainDesc1.SampleDesc.Quality = 0;
+
+        hr = pIDXGIFactory2->CreateSwapChainForHwnd(m_D3D11Device.Get(), window.GetHandle(), &swapChainDesc1, nullptr, nullptr, &m_D3D11SwapChain1);
+        if (FAILED(hr))
+            throw std::runtime_error("Failed to create swap chain");
+
+        hr = pIDXGIFactory2->MakeWindowAssociation(window.GetHandle(), DXGI_MWA_NO_WINDOW_CHANGES);
+        assert(SUCCEEDED(hr));
+    }
+}
+
+HRESULT DX11Backend::CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* data, ID3D11Buffer** buffer)
+{
+    return m_D3D11Device->CreateBuffer(desc, data, buffer);
+}
+
+HRESULT DX11Backend::CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* data, ID3D11Texture2D** texture)
+{
+    return m_D3D11Device->CreateTexture2D(desc, data, texture);
+}
+
+HRESULT DX11Backend::CreateTextureFromFile(const wchar_t* source, ID3D11ShaderResourceView** view)
+{
+    return DirectX::CreateDDSTextureFromFile(m_D3D11Device.Get(), source, nullptr, view);
+}
+
+HRESULT DX11Backend::CreateShaderResourceView(ID3D11Resource* resource, const D3D11_SHADER_RESOURCE_VIEW_DESC* desc, ID3D11ShaderResourceView** view)
+{
+    return m_D3D11Device->CreateShaderResourceView(resource, desc, view);
+}
+
+HRESULT DX11Backend::CreateRenderTargetView(ID3D11Resource* resource, const D3D11_RENDER_TARGET_VIEW_DESC* desc, ID3D11RenderTargetView** view)
+{
+    return m_D3D11Device->CreateRenderTargetView(resource, desc, view);
+}
+
+HRESULT DX11Backend::CreateDepthStencilView(ID3D11Resource* resource, const D3D11_DEPTH_STENCIL_VIEW_DESC* desc, ID3D11DepthStencilView** view)
+{
+    return m_D3D11Device->CreateDepthStencilView(resource, desc, view);
+}
+
+HRESULT DX11Backend::CreateVertexShader(const void* bytecode, SIZE_T length, ID3D11VertexShader** shader)
+{
+    return m_D3D11Device->CreateVertexShader(bytecode, length, nullptr, shader);
+}
+
+HRESULT DX11Backend::CreatePixelShader(const void* bytecode, SIZE_T length, ID3D11PixelShader** shader)
+{
+    return m_D3D11Device->CreatePixelShader(bytecode, length, nullptr, shader);
+}
+
+HRESULT DX11Backend::CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT count, const void* bytecode, SIZE_T length, ID3D11InputLayout** layout)
+{
+    return m_D3D11Device->CreateInputLayout(elements, count, bytecode, length, layout);
+}
+
+HRESULT DX11Backend::CreateSamplerState(const D3D11_SAMPLER_DESC* desc, ID3D11SamplerState** sampler)
+{
+    return m_D3D11Device->CreateSamplerState(desc, sampler);
+}
+
+HRESULT DX11Backend::CreateBlendState(const D3D11_BLEND_DESC* desc, ID3D11BlendState** state)
+{
+    return m_D3D11Device->CreateBlendState(desc, state);
+}
+
+HRESULT DX11Backend::CreateRasterizerState(const D3D11_RASTERIZER_DESC* desc, ID3D11RasterizerState** state)
+{
+    return m_D3D11Device->CreateRasterizerState(desc, state);
+}
+
+HRESULT DX11Backend::GetBackBuffer(ID3D11Texture2D** texture)
+{
+    return m_D3D11SwapChain1->GetBuffer(0, IID_PPV_ARGS(texture));
+}
+
+void DX11Backend::IASetInputLayout(ID3D11InputLayout* layout)
+{
+    m_D3D11DeviceContext->IASetInputLayout(layout);
+    m_Stats.m_StateCalls++;
+}
+
+void DX11Backend::IASetVertexBuffers(UINT slot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets)
+{
+    m_D3D11DeviceContext->IASetVertexBuffers(slot, count, buffers, strides, offsets);
+    m_Stats.m_StateCalls++;
+}
+
+void DX11Backend::IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+{
+    m_D3D11DeviceContext->IASetIndexBuffer(buffer, format, offset);
+    m_Stats.m_StateCalls++;
+}
+
+void DX11Backend::IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+    m_D3D11DeviceContext->IASetPrimitiveTopology(topology);
+    m_Stats.m_StateCalls++;
+}
+
+void DX11Backend::VSSetShader(ID3D11VertexShader* shader)
+{
+    m_D3D11DeviceContext->VSSetShader(shader, nullptr, 0);
+    m_Stats.m_StateCalls++;
+}
+
+void DX11Backend::VSSetConstantBuffers(UINT slot, UINT count, ID3D11Buffer* const* buffers)
+{
+    m_D3D11DeviceContext->VSSetConstantBuffers(slot, count, buffers);
+    m_Stats.m_StateCalls++;
+}
+
+void DX11Backend::VSSetConstantBuffers1(UINT slot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts)
+{
+    m_D3D11DeviceContext1->VSSetConstantBuffers1(slot, count, buffers, firstConstants, constantCounts);
+    m_Stats.m_StateCalls++;
+}
+
+void DX11Backend::PSSetShader(ID3D11PixelShader* shader)
+{
+    m_D3D11DeviceContext->PSSetShader(shader, nullptr, 0);
+    m_Stats.m_StateCalls++;
+}
+
+void DX11Backend::PSSetConstantBuffers(UINT slot, UINT count, ID3D11Buffer* const* buffers)
+{
+    m_D3D11DeviceContext->PSSetConstantBuffers(slot, count, buffers);
+    m_Stats.m_StateCalls++;
+}
+
+void DX11Backend::PSSetConstantBuffers1(UINT slot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts)
+{
+    m_D3D11DeviceContext1->PSSetConstantBuffers1(slot, count, buffers, firstConstants, constantCounts);
+    m_Stats.m_StateCalls++;
+}
+
+void DX11Backend::PSSetShaderResources(UINT slot, UINT count, ID3D11ShaderResourceView* const* views)
+{
+    m_D3D11DeviceContext->PSSetShaderResources(slot, count, views);
+    m_Stats.m_StateCalls++;
+}
+
+void DX11Backend::PSSetSamplers(UINT slot, UINT count, ID3D11SamplerState* const* samplers)
+{
+    m_D3D11DeviceContext->PSSetSamplers(slot, count, samplers);
+    m_Stats.m_StateCalls++;
+}
+
+void DX11Backend::RSSetState(ID3D11RasterizerState* state)
+{
+    m_D3D11DeviceContext->RSSetState(state);
+    m_Stats.m_StateCalls++;
+}
+
+void DX11Backend::RSSetViewports(UINT count, const D3D11_VIEWPORT* viewports)
+{
+    m_D3D11DeviceContext->RSSetViewports(count, viewports);
+    m_Stats.m_StateCalls++;
+}
+
+void DX11Backend::RSSetScissorRects(UINT count, const D3D11_RECT* rects)
+{
+    m_D3D11DeviceContext->RSSetScissorRects(count, rects);
+    m_Stats.m_StateCalls++;
+}
+
+void DX11Backend::OMSetRenderTargets(UINT count, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthStencilView)
+{
+    m_D3D11DeviceContext->OMSetRenderTargets(count, views, depthStencilView);
+    m_Stats.m_StateCalls++;
+}
+
+void DX11Backend::OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask)
+{
+    m_D3D11DeviceContext->OMSetBlendState(state, blendFactor, sampleMask);
+    m_Stats.m_StateCalls++;
+}
+
+void DX11Backend::ClearRenderTargetView(ID3D11RenderTargetView* view, const FLOAT color[4])
+{
+    m_D3D11DeviceContext->ClearRenderTargetView(view, color);
+    m_Stats.m_ClearCalls++;
+}
+
+void DX11Backend::ClearDepthStencilView(ID3D11DepthStencilView* view, UINT flags, FLOAT depth, UINT8 stencil)
+{
+    m_D3D11DeviceContext->ClearDepthStencilView(view, flags, depth, stencil);
+    m_Stats.m_ClearCalls++;
+}
+
+HRESULT DX11Backend::Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP type, UINT flags, D3D11_MAPPED_SUBRESOURCE* mappedResource)
+{
+    // Mapped size is unknown to the driver wrapper, only null backend accounts m_MappedBytes
+    m_Stats.m_MapCalls++;
+    return m_D3D11DeviceContext->Map(resource, subresource, type, flags, mappedResource);
+}
+
+void DX11Backend::Unmap(ID3D11Resource* resource, UINT subresource)
+{
+    m_D3D11DeviceContext->Unmap(resource, subresource);
+}
+
+void DX11Backend::DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex)
+{
+    m_D3D11DeviceContext->DrawIndexed(indexCount, startIndex, baseVertex);
+    m_Stats.m_DrawCalls++;
+    m_Stats.m_DrawIndices += indexCount;
+    m_Stats.m_DrawInstances++;
+}
+
+void DX11Backend::DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)
+{
+    m_D3D11DeviceContext->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+    m_Stats.m_DrawCalls++;
+    m_Stats.m_DrawIndices += indexCount * instanceCount;
+    m_Stats.m_DrawInstances += instanceCount;
+}
+
+void DX11Backend::Present()
+{
+    DXGI_PRESENT_PARAMETERS params{ };
+    m_D3D11SwapChain1->Present1(0, 0, &params);
+}
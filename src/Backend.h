@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <d3d11.h>
+#include <d3d11_1.h>
+#include <dxgi1_2.h>
+#include <wrl/client.h>
+
+class Window;
+
+// Counters collected between DX11Device::Begin() and DX11Device::End()
+struct BackendStats final
+{
+    UINT m_DrawCalls{ 0 };
+    UINT m_DrawIndices{ 0 };   // Of all instances
+    UINT m_DrawInstances{ 0 }; // One per plain indexed draw
+    UINT m_StateCalls{ 0 };
+    UINT m_ClearCalls{ 0 };
+    UINT m_MapCalls{ 0 };
+    UINT64 m_MappedBytes{ 0 };
+};
+
+// Subset of ID3D11Device, ID3D11DeviceContext and IDXGISwapChain1 used by resources.
+// Methods mirror D3D11 signatures so implementations can forward calls as is.
+class Backend
+{
+public:
+    virtual ~Backend() = default;
+
+    const BackendStats& GetStats() const;
+    void ResetStats();
+
+    virtual HRESULT CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* data, ID3D11Buffer** buffer) = 0;
+    virtual HRESULT CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* data, ID3D11Texture2D** texture) = 0;
+    virtual HRESULT CreateTextureFromFile(const wchar_t* source, ID3D11ShaderResourceView** view) = 0;
+    virtual HRESULT CreateShaderResourceView(ID3D11Resource* resource, const D3D11_SHADER_RESOURCE_VIEW_DESC* desc, ID3D11ShaderResourceView** view) = 0;
+    virtual HRESULT CreateRenderTargetView(ID3D11Resource* resource, const D3D11_RENDER_TARGET_VIEW_DESC* desc, ID3D11RenderTargetView** view) = 0;
+    virtual HRESULT CreateDepthStencilView(ID3D11Resource* resource, const D3D11_DEPTH_STENCIL_VIEW_DESC* desc, ID3D11DepthStencilView** view) = 0;
+    virtual HRESULT CreateVertexShader(const void* bytecode, SIZE_T length, ID3D11VertexShader** shader) = 0;
+    virtual HRESULT CreatePixelShader(const void* bytecode, SIZE_T length, ID3D11PixelShader** shader) = 0;
+    virtual HRESULT CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT count, const void* bytecode, SIZE_T length, ID3D11InputLayout** layout) = 0;
+    virtual HRESULT CreateSamplerState(const D3D11_SAMPLER_DESC* desc, ID3D11SamplerState** sampler) = 0;
+    virtual HRESULT CreateBlendState(const D3D11_BLEND_DESC* desc, ID3D11BlendState** state) = 0;
+    virtual HRESULT CreateRasterizerState(const D3D11_RASTERIZER_DESC* desc, ID3D11RasterizerState** state) = 0;
+    virtual HRESULT GetBackBuffer(ID3D11Texture2D** texture) = 0;
+
+    virtual void IASetInputLayout(ID3D11InputLayout* layout) = 0;
+    virtual void IASetVertexBuffers(UINT slot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets) = 0;
+    virtual void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset) = 0;
+    virtual void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) = 0;
+    virtual void VSSetShader(ID3D11VertexShader* shader) = 0;
+    virtual void VSSetConstantBuffers(UINT slot, UINT count, ID3D11Buffer* const* buffers) = 0;
+    // Binds windows of the buffers, offsets and sizes are counted in 16-byte constants, multiples of 16
+    virtual void VSSetConstantBuffers1(UINT slot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts) = 0;
+    virtual void PSSetShader(ID3D11PixelShader* shader) = 0;
+    virtual void PSSetConstantBuffers(UINT slot, UINT count, ID3D11Buffer* const* buffers) = 0;
+    virtual void PSSetConstantBuffers1(UINT slot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts) = 0;
+    virtual void PSSetShaderResources(UINT slot, UINT count, ID3D11ShaderResourceView* const* views) = 0;
+    virtual void PSSetSamplers(UINT slot, UINT count, ID3D11SamplerState* const* samplers) = 0;
+    virtual void RSSetState(ID3D11RasterizerState* state) = 0;
+    virtual void RSSetViewports(UINT count, const D3D11_VIEWPORT* viewports) = 0;
+    virtual void RSSetScissorRects(UINT count, const D3D11_RECT* rects) = 0;
+    virtual void OMSetRenderTargets(UINT count, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthStencilView) = 0;
+    virtual void OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask) = 0;
+    virtual void ClearRenderTargetView(ID3D11RenderTargetView* view, const FLOAT color[4]) = 0;
+    virtual void ClearDepthStencilView(ID3D11DepthStencilView* view, UINT flags, FLOAT depth, UINT8 stencil) = 0;
+    virtual HRESULT Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP type, UINT flags, D3D11_MAPPED_SUBRESOURCE* mappedResource) = 0;
+    virtual void Unmap(ID3D11Resource* resource, UINT subresource) = 0;
+    virtual void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex) = 0;
+    virtual void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance) = 0;
+
+    virtual void Present() = 0;
+
+protected:
+    BackendStats m_Stats{ };
+};
+
+class DX11Backend final : public Backend
+{
+public:
+    DX11Backend(Window& window);
+
+    HRESULT CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* data, ID3D11Buffer** buffer) override;
+    HRESULT CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* data, ID3D11Texture2D** texture) override;
+    HRESULT CreateTextureFromFile(const wchar_t* source, ID3D11ShaderResourceView** view) override;
+    HRESULT CreateShaderResourceView(ID3D11Resource* resource, const D3D11_SHADER_RESOURCE_VIEW_DESC* desc, ID3D11ShaderResourceView** view) override;
+    HRESULT CreateRenderTargetView(ID3D11Resource* resource, const D3D11_RENDER_TARGET_VIEW_DESC* desc, ID3D11RenderTargetView** view) override;
+    HRESULT CreateDepthStencilView(ID3D11Resource* resource, const D3D11_DEPTH_STENCIL_VIEW_DESC* desc, ID3D11DepthStencilView** view) override;
+    HRESULT CreateVertexShader(const void* bytecode, SIZE_T length, ID3D11VertexShader** shader) override;
+    HRESULT CreatePixelShader(const void* bytecode, SIZE_T length, ID3D11PixelShader** shader) override;
+    HRESULT CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT count, const void* bytecode, SIZE_T length, ID3D11InputLayout** layout) override;
+    HRESULT CreateSamplerState(const D3D11_SAMPLER_DESC* desc, ID3D11SamplerState** sampler) override;
+    HRESULT CreateBlendState(const D3D11_BLEND_DESC* desc, ID3D11BlendState** state) override;
+    HRESULT CreateRasterizerState(const D3D11_RASTERIZER_DESC* desc, ID3D11RasterizerState** state) override;
+    HRESULT GetBackBuffer(ID3D11Texture2D** texture) override;
+
+    void IASetInputLayout(ID3D11InputLayout* layout) override;
+    void IASetVertexBuffers(UINT slot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets) override;
+    void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset) override;
+    void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) override;
+    void VSSetShader(ID3D11VertexShader* shader) override;
+    void VSSetConstantBuffers(UINT slot, UINT count, ID3D11Buffer* const* buffers) override;
+    void VSSetConstantBuffers1(UINT slot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts) override;
+    void PSSetShader(ID3D11PixelShader* shader) override;
+    void PSSetConstantBuffers(UINT slot, UINT count, ID3D11Buffer* const* buffers) override;
+    void PSSetConstantBuffers1(UINT slot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts) override;
+    void PSSetShaderResources(UINT slot, UINT count, ID3D11ShaderResourceView* const* views) override;
+    void PSSetSamplers(UINT slot, UINT count, ID3D11SamplerState* const* samplers) override;
+    void RSSetState(ID3D11RasterizerState* state) override;
+    void RSSetViewports(UINT count, const D3D11_VIEWPORT* viewports) override;
+    void RSSetScissorRects(UINT count, const D3D11_RECT* rects) override;
+    void OMSetRenderTargets(UINT count, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthStencilView) override;
+    void OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask) override;
+    void ClearRenderTargetView(ID3D11RenderTargetView* view, const FLOAT color[4]) override;
+    void ClearDepthStencilView(ID3D11DepthStencilView* view, UINT flags, FLOAT depth, UINT8 stencil) override;
+    HRESULT Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP type, UINT flags, D3D11_MAPPED_SUBRESOURCE* mappedResource) override;
+    void Unmap(ID3D11Resource* resource, UINT subresource) override;
+    void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex) override;
+    void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance) override;
+
+    void Present() override;
+
+private:
+    Microsoft::WRL::ComPtr<ID3D11Device> m_D3D11Device;
+    Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_D3D11DeviceContext;
+    Microsoft::WRL::ComPtr<ID3D11DeviceContext1> m_D3D11DeviceContext1; // Constant buffer offsets
+    Microsoft::WRL::ComPtr<IDXGISwapChain1> m_D3D11SwapChain1;
+};
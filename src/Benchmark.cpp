@@ -0,0 +1,1552 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Benchmark.h"
+#include "Lighting.h"
+#include "ThreadPool.h"
+#include "Light.h"
+#include "LightTiles.h"
+#include "LightClusters.h"
+#include "Camera.h"
+#include "Context.h"
+#include "Application.h"
+#include "GeometryPacking.h"
+#include "DrawQueue.h"
+#include "TransformHierarchy.h"
+#include "FrustumCulling.h"
+#include "BoundingVolumeHierarchy.h"
+#include "OcclusionCulling.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "VertexFormat.h"
+#include "Meshlet.h"
+#include "MeshletCulling.h"
+#include "MeshFile.h"
+#include "MeshImporter.h"
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <algorithm>
+#include <random>
+#include <numeric>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+    // Lights own constant buffers, a headless context provides the device for them
+    class IdleApplication final : public Application
+    {
+    public:
+        void Update(Context& context) override
+        { }
+    };
+
+    // Rolling terrain of unit size in rows of quads, normals from the height function
+    void MakeTerrain(UINT gridSize, std::vector<Vertex>& vertices, std::vector<UINT>& indices)
+    {
+        for (UINT y = 0; y <= gridSize; y++)
+        {
+            for (UINT x = 0; x <= gridSize; x++)
+            {
+                float u = static_cast<float>(x) / gridSize;
+                float v = static_cast<float>(y) / gridSize;
+                float px = 2.0f * u - 1.0f;
+                float pz = 2.0f * v - 1.0f;
+
+                float h = 0.1f * std::sin(3.0f * px) * std::cos(2.0f * pz) + 0.02f * std::sin(17.0f * px + 11.0f * pz);
+                float dx = 0.3f * std::cos(3.0f * px) * std::cos(2.0f * pz) + 0.34f * std::cos(17.0f * px + 11.0f * pz);
+                float dz = -0.2f * std::sin(3.0f * px) * std::sin(2.0f * pz) + 0.22f * std::cos(17.0f * px + 11.0f * pz);
+
+                DirectX::XMFLOAT3 normal;
+                DirectX::XMStoreFloat3(&normal, DirectX::XMVector3Normalize(DirectX::XMVectorSet(-dx, 1.0f, -dz, 0.0f)));
+
+                vertices.push_back({ { px, h, pz }, normal, { u, v } });
+            }
+        }
+
+        for (UINT y = 0; y < gridSize; y++)
+        {
+            for (UINT x = 0; x < gridSize; x++)
+            {
+                UINT corner = y * (gridSize + 1) + x;
+                indices.insert(indices.end(), { corner, corner + gridSize + 1, corner + 1, corner + 1, corner + gridSize + 1, corner + gridSize + 2 });
+            }
+        }
+    }
+}
+
+bool Benchmark::Run(const std::string& name, bool& isPassed)
+{
+    isPassed = true;
+
+    if (name == "lighting")
+        RunLighting();
+    else if (name == "clusters")
+        RunClusters();
+    else if (name == "packing")
+        isPassed = RunPacking();
+    else if (name == "sorting")
+        isPassed = RunSorting();
+    else if (name == "transforms")
+        RunTransforms();
+    else if (name == "culling")
+        RunCulling();
+    else if (name == "hierarchy")
+        RunHierarchy();
+    else if (name == "occlusion")
+        RunOcclusion();
+    else if (name == "lod")
+        RunLod();
+    else if (name == "optimizer")
+        RunOptimizer();
+    else if (name == "vertices")
+        RunVertices();
+    else if (name == "indices")
+        RunIndices();
+    else if (name == "meshlets")
+        RunMeshlets();
+    else if (name == "meshfile")
+        RunMeshFile();
+    else if (name == "import")
+        RunImport();
+    else
+        return false;
+
+    return true;
+}
+
+void Benchmark::RunLighting()
+{
+    const UINT width = 1280;
+    const UINT height = 720;
+    const UINT lights = 32;
+    const UINT frames = 20;
+
+    ThreadPool threadPool;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    // Floor seen from above through an orthographic camera: positions on a grid, normals tilted around +Y
+    DirectX::XMMATRIX view = DirectX::XMMatrixLookToLH(DirectX::XMVectorSet(0.0f, 10.0f, 0.0f, 1.0f), DirectX::XMVectorSet(0.0f, -1.0f, 0.0f, 0.0f), DirectX::XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f));
+    DirectX::XMMATRIX viewProjection = DirectX::XMMatrixMultiply(view, DirectX::XMMatrixOrthographicLH(20.0f, 20.0f, 1.0f, 20.0f));
+
+    DirectX::XMFLOAT4X4 inverseViewProjection;
+    DirectX::XMStoreFloat4x4(&inverseViewProjection, DirectX::XMMatrixInverse(nullptr, viewProjection));
+
+    std::vector<DirectX::XMFLOAT4> diffuse(width * height);
+    std::vector<DirectX::XMFLOAT4> specular(width * height);
+    std::vector<DirectX::XMFLOAT4> normal(width * height);
+    std::vector<float> depth(width * height);
+
+    for (UINT y = 0; y < height; y++)
+    {
+        for (UINT x = 0; x < width; x++)
+        {
+            UINT pixel = y * width + x;
+
+            // Pixel center in world space, Y of the screen goes along -Z
+            DirectX::XMVECTOR position = DirectX::XMVectorSet(20.0f * (x + 0.5f) / width - 10.0f, -2.0f + 0.1f * unit(random), 10.0f - 20.0f * (y + 0.5f) / height, 1.0f);
+
+            diffuse[pixel] = { unit(random), unit(random), unit(random), 0.2f };
+            specular[pixel] = { diffuse[pixel].x * 0.5f, diffuse[pixel].y * 0.5f, diffuse[pixel].z * 0.5f, 0.8f };
+            normal[pixel] = { 0.3f * unit(random) - 0.15f, 1.0f, 0.3f * unit(random) - 0.15f, std::floor(1.0f + 63.0f * unit(random)) };
+            depth[pixel] = DirectX::XMVectorGetZ(DirectX::XMVector3TransformCoord(position, viewProjection));
+        }
+    }
+
+    std::vector<LightPass> passes(lights);
+
+    for (UINT light = 0; light < lights; light++)
+    {
+        LightPass& pass = passes[light];
+
+        pass.m_Light.m_Type = static_cast<int>(light == 0 ? LightType::Ambient : static_cast<LightType>(1 + light % 3));
+        pass.m_Light.m_Color = { unit(random), unit(random), unit(random) };
+        pass.m_Light.m_Intensity = light == 0 ? 0.2f : 1.0f;
+        pass.m_Light.m_Falloff = 20.0f;
+        pass.m_Light.m_SpotAngle = DirectX::XM_PIDIV2 / 3.0f;
+        pass.m_Light.m_SpotBorder = 0.25f;
+
+        pass.m_Vectors.m_CameraPosition = { 0.0f, 10.0f, -10.0f, 1.0f };
+        pass.m_Vectors.m_LightPosition = { 20.0f * unit(random) - 10.0f, 1.0f + 4.0f * unit(random), 20.0f * unit(random) - 10.0f, 1.0f };
+        pass.m_Vectors.m_LightDirection = { unit(random) - 0.5f, -1.0f, unit(random) - 0.5f, 0.0f };
+    }
+
+    const DirectX::XMFLOAT4* targets[] = { diffuse.data(), specular.data(), normal.data() };
+    const float black[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+    std::printf("Lighting: %ux%u, %u passes, %zu threads\n", width, height, lights, threadPool.GetThreadCount());
+
+    std::vector<float> results[2];
+    bool simdModes[] = { false, true };
+
+    for (bool simd : simdModes)
+    {
+        if (simd && !Lighting::IsSimdAvailable())
+        {
+            std::printf("AVX2: not compiled in\n");
+            continue;
+        }
+
+        Lighting lighting(threadPool);
+        lighting.SetSimd(simd);
+        lighting.LoadGeometry(width, height, targets, depth.data(), inverseViewProjection);
+
+        for (UINT frame = 0; frame < frames; frame++)
+        {
+            lighting.ClearFrame(black);
+            lighting.Shade(passes);
+        }
+
+        const LightingStats& stats = lighting.GetStats();
+        double nanoseconds = stats.m_Time * 1e9 / static_cast<double>(stats.m_LightPixels);
+
+        std::printf("%s: %.3f ms per frame, %.3f ns per pixel per light, %.1f M light pixels/s\n",
+            simd ? "AVX2" : "Scalar", stats.m_Time * 1000.0 / frames, nanoseconds, 1000.0 / nanoseconds);
+
+        std::vector<float>& result = results[simd ? 1 : 0];
+        for (UINT channel = 0; channel < 4; channel++)
+        {
+            for (UINT row = 0; row < height; row++)
+            {
+                const float* frameRow = lighting.GetFrameRow(channel, row);
+                result.insert(result.end(), frameRow, frameRow + width);
+            }
+        }
+    }
+
+    if (!results[1].empty())
+    {
+        // Scalar path follows DynamicLight.fx line by line and stands for the shader output
+        float difference = 0.0f;
+        for (size_t value = 0; value < results[0].size(); value++)
+            difference = (std::max)(difference, std::fabs(results[0][value] - results[1][value]));
+
+        std::printf("Max difference: %g (%s one 8-bit step)\n", difference, difference <= 1.0f / 255.0f ? "within" : "exceeds");
+    }
+}
+
+void Benchmark::RunClusters()
+{
+    const UINT width = 1920;
+    const UINT height = 1080;
+    const UINT frames = 20;
+    const UINT lightCounts[] = { 1000, 2500, 5000, 10000 };
+    const float wallDepth = 5.0f;
+
+    IdleApplication application;
+
+    ContextParams params{ };
+    params.m_WindowWidth = width;
+    params.m_WindowHeight = height;
+    params.m_DeviceType = DeviceType::Null;
+
+    Context context(application, params);
+    DX11Device& device = context.GetDevice();
+
+    ThreadPool threadPool;
+    LightTiles tiles;
+    LightClusters clusters(threadPool);
+
+    Camera camera;
+    camera.SetAspectRatio(static_cast<float>(width) / static_cast<float>(height));
+
+    std::printf("Clusters: %ux%u, %u pixel tiles, %u slices, %zu threads\n", width, height, LightClusters::s_TileSize, LightClusters::s_Slices, threadPool.GetThreadCount());
+
+    for (UINT lightCount : lightCounts)
+    {
+        std::mt19937 random(lightCount);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+        // Small point and spot lights spread through the view volume
+        TransformHierarchy transforms(threadPool);
+        std::vector<std::unique_ptr<Light>> lights;
+        std::vector<const Light*> lightPointers;
+
+        for (UINT index = 0; index < lightCount; index++)
+        {
+            auto& light = lights.emplace_back(new Light(device, transforms, index % 2 == 0 ? LightType::Point : LightType::Spot));
+            light->SetColor({ unit(random), unit(random), 1.0f });
+            light->SetFalloff(0.1f + 0.2f * unit(random));
+            light->Move(DirectX::XMVectorSet(100.0f * unit(random) - 50.0f, 40.0f * unit(random) - 20.0f, 2.0f + 96.0f * unit(random), 0.0f));
+            light->Rotate(DirectX::XMVectorSet(unit(random) - 0.5f, unit(random) - 0.5f, unit(random) - 0.5f, 0.0f), 360.0f * unit(random));
+
+            lightPointers.push_back(light.get());
+        }
+
+        transforms.Update();
+
+        double tilesTime = 0.0;
+        double clustersTime = 0.0;
+
+        for (UINT frame = 0; frame < frames; frame++)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            tiles.Build(camera, width, height, lightPointers);
+
+            std::chrono::steady_clock::time_point middle = std::chrono::steady_clock::now();
+            clusters.Build(camera, width, height, lightPointers);
+
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+            tilesTime += std::chrono::duration<double>(middle - start).count();
+            clustersTime += std::chrono::duration<double>(end - middle).count();
+        }
+
+        // Pixels of a wall close to the camera: 2D tiles keep every light behind it in their lists
+        const LightTilesStats& clusterStats = clusters.GetStats();
+        LightGrid grid = clusters.GetGrid();
+
+        UINT wallSlice = static_cast<UINT>(std::log(wallDepth) * grid.m_SliceScale + grid.m_SliceBias);
+        UINT64 wallLights = 0;
+
+        for (UINT tile = 0; tile < grid.m_TilesX * grid.m_TilesY; tile++)
+            wallLights += clusters.GetRanges()[wallSlice * grid.m_TilesX * grid.m_TilesY + tile].y;
+
+        double tileLength = static_cast<double>(tiles.GetStats().m_TileLights) / (tiles.GetTilesX() * tiles.GetTilesY());
+        double wallLength = static_cast<double>(wallLights) / (grid.m_TilesX * grid.m_TilesY);
+
+        std::printf("%5u lights, %5u visible: tiles %.3f ms, clusters %.3f ms, %u cluster entries, lights per pixel at depth %.0f: tiles %.2f, clusters %.2f\n",
+            lightCount, clusterStats.m_VisibleLights, tilesTime * 1000.0 / frames, clustersTime * 1000.0 / frames,
+            clusterStats.m_TileLights, wallDepth, tileLength, wallLength);
+    }
+}
+
+bool Benchmark::RunPacking()
+{
+    const UINT samples = 1 << 22;
+
+    std::mt19937 random(samples);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::normal_distribution<float> gaussian;
+
+    // Gaussian directions are uniform over the sphere
+    std::vector<DirectX::XMFLOAT3> normals(samples);
+    std::vector<DirectX::XMFLOAT3> colors(samples);
+    std::vector<DirectX::XMFLOAT4> materials(samples);
+
+    for (UINT sample = 0; sample < samples; sample++)
+    {
+        DirectX::XMStoreFloat3(&normals[sample], DirectX::XMVector3Normalize(DirectX::XMVectorSet(gaussian(random), gaussian(random), gaussian(random), 0.0f)));
+        colors[sample] = DirectX::XMFLOAT3(unit(random), unit(random), unit(random));
+        materials[sample] = DirectX::XMFLOAT4(unit(random), unit(random), unit(random), std::floor(256.0f * unit(random)));
+    }
+
+    std::vector<UINT> texels(samples * 3);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (UINT sample = 0; sample < samples; sample++)
+    {
+        const DirectX::XMFLOAT4& material = materials[sample];
+
+        texels[sample * 3 + 0] = GeometryPacking::EncodeAlbedo(colors[sample]);
+        texels[sample * 3 + 1] = GeometryPacking::EncodeNormal(normals[sample]);
+        texels[sample * 3 + 2] = GeometryPacking::EncodeMaterial(material.x, material.y, material.z, static_cast<int>(material.w));
+    }
+
+    std::chrono::steady_clock::time_point middle = std::chrono::steady_clock::now();
+
+    float normalError = 0.0f;
+    float albedoError = 0.0f;
+    float intensityError = 0.0f;
+    UINT hardnessErrors = 0;
+
+    for (UINT sample = 0; sample < samples; sample++)
+    {
+        DirectX::XMFLOAT3 albedo = GeometryPacking::DecodeAlbedo(texels[sample * 3 + 0]);
+        DirectX::XMFLOAT3 normal = GeometryPacking::DecodeNormal(texels[sample * 3 + 1]);
+        DirectX::XMFLOAT4 material = GeometryPacking::DecodeMaterial(texels[sample * 3 + 2]);
+
+        const DirectX::XMFLOAT3& color = colors[sample];
+        const DirectX::XMFLOAT4& expected = materials[sample];
+
+        float cosine = DirectX::XMVectorGetX(DirectX::XMVector3Dot(DirectX::XMLoadFloat3(&normal), DirectX::XMLoadFloat3(&normals[sample])));
+        normalError = (std::max)(normalError, std::acos((std::min)(cosine, 1.0f)));
+
+        albedoError = (std::max)({ albedoError, std::abs(albedo.x - color.x), std::abs(albedo.y - color.y), std::abs(albedo.z - color.z) });
+        intensityError = (std::max)({ intensityError, std::abs(material.x - expected.x), std::abs(material.y - expected.y), std::abs(material.z - expected.z) });
+
+        if (material.w != expected.w)
+            hardnessErrors++;
+    }
+
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+    double encodeTime = std::chrono::duration<double>(middle - start).count();
+    double decodeTime = std::chrono::duration<double>(end - middle).count();
+
+    // Bytes per pixel of the targets plus 32-bit depth
+    std::printf("Packing: %u pixels, full layout %u bytes, packed layout %u bytes per pixel\n", samples, 3 * 16 + 4, 3 * 4 + 4);
+    std::printf("Encode: %.2f ns, decode: %.2f ns per pixel\n", encodeTime * 1e9 / samples, decodeTime * 1e9 / samples);
+    std::printf("Max errors: normal %.4f degrees, linear albedo %.6f, intensity %.6f, hardness %u mismatches\n",
+        DirectX::XMConvertToDegrees(normalError), albedoError, intensityError, hardnessErrors);
+
+    bool isPassed = DirectX::XMConvertToDegrees(normalError) <= GeometryPacking::s_MaxNormalError && albedoError <= GeometryPacking::s_MaxAlbedoError &&
+        intensityError <= GeometryPacking::s_MaxIntensityError && hardnessErrors == 0;
+
+    std::printf("Round trip: %s\n", isPassed ? "within bounds" : "out of bounds");
+    return isPassed;
+}
+
+bool Benchmark::RunSorting()
+{
+    const UINT frames = 20;
+    const UINT drawCounts[] = { 1000, 10000, 100000, 1000000 };
+
+    std::printf("Sorting: 16 shaders, 64 materials, 128 textures, 4096 meshes\n");
+    bool isPassed = true;
+
+    for (UINT drawCount : drawCounts)
+    {
+        std::mt19937 random(drawCount);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+        // Scene order: every draw picks its state at random
+        std::vector<UINT64> keys(drawCount);
+        for (UINT64& key : keys)
+            key = DrawKey::Make(DrawPass::Opaque, static_cast<UINT>(random() % 16), static_cast<UINT>(random() % 64), static_cast<UINT>(random() % 128), static_cast<UINT>(random() % 4096), unit(random));
+
+        DrawQueue queue;
+        std::vector<DrawItem> reference;
+
+        double radixTime = 0.0;
+        double referenceTime = 0.0;
+
+        for (UINT frame = 0; frame < frames; frame++)
+        {
+            queue.Clear();
+            reference.clear();
+
+            for (UINT index = 0; index < drawCount; index++)
+            {
+                queue.Push(keys[index], index);
+                reference.push_back({ keys[index], index });
+            }
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            queue.Sort();
+
+            std::chrono::steady_clock::time_point middle = std::chrono::steady_clock::now();
+            std::stable_sort(reference.begin(), reference.end(), [](const DrawItem& left, const DrawItem& right) { return left.m_Key < right.m_Key; });
+
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+            radixTime += std::chrono::duration<double>(middle - start).count();
+            referenceTime += std::chrono::duration<double>(end - middle).count();
+        }
+
+        // Both sorts are stable, items must match one to one
+        UINT mismatches = 0;
+        for (UINT index = 0; index < drawCount; index++)
+        {
+            if (queue.GetItems()[index].m_Index != reference[index].m_Index)
+                mismatches++;
+        }
+
+        const DrawQueueStats& stats = queue.GetStats();
+
+        std::printf("%7u draws: radix %.3f ms, %u passes, std::stable_sort %.3f ms, %u mismatches, state changes %u unsorted, %u sorted\n",
+            drawCount, radixTime * 1000.0 / frames, stats.m_SortPasses, referenceTime * 1000.0 / frames, mismatches,
+            stats.m_UnsortedStateChanges, stats.m_StateChanges);
+
+        isPassed = isPassed && mismatches == 0;
+    }
+
+    std::printf("Order: %s\n", isPassed ? "identical" : "differs");
+    return isPassed;
+}
+
+void Benchmark::RunTransforms()
+{
+    const UINT frames = 20;
+    const UINT roots = 1000;
+    const UINT children = 10;      // Per root
+    const UINT grandchildren = 10; // Per child
+
+    ThreadPool serialPool(1);
+    ThreadPool threadPool;
+
+    std::printf("Transforms: %u roots, %u children, %u grandchildren, %zu threads\n", roots, roots * children, roots * children * grandchildren, threadPool.GetThreadCount());
+
+    for (ThreadPool* pool : { &serialPool, &threadPool })
+    {
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+        // Created depth first, the first Update() sorts the nodes by depth
+        TransformHierarchy transforms(*pool);
+        std::vector<TransformId> rootIds;
+
+        for (UINT root = 0; root < roots; root++)
+        {
+            TransformId rootId = rootIds.emplace_back(transforms.Create());
+            transforms.Move(rootId, DirectX::XMVectorSet(100.0f * unit(random), 0.0f, 100.0f * unit(random), 0.0f));
+
+            for (UINT child = 0; child < children; child++)
+            {
+                TransformId childId = transforms.Create(rootId);
+                transforms.Move(childId, DirectX::XMVectorSet(unit(random), unit(random), unit(random), 0.0f));
+                transforms.Scale(childId, DirectX::XMVectorReplicate(0.5f + unit(random)));
+
+                for (UINT grandchild = 0; grandchild < grandchildren; grandchild++)
+                {
+                    TransformId grandchildId = transforms.Create(childId);
+                    transforms.Move(grandchildId, DirectX::XMVectorSet(unit(random), unit(random), unit(random), 0.0f));
+                }
+            }
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        transforms.Update();
+        double firstTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // Every root turns, so every node is rebuilt. A tenth of the roots turns: a tenth of the subtrees.
+        double times[3]{ };
+        UINT updates[3]{ };
+
+        for (UINT frame = 0; frame < frames; frame++)
+        {
+            for (UINT scenario = 0; scenario < 3; scenario++)
+            {
+                UINT step = scenario == 0 ? 1 : 10;
+
+                if (scenario < 2)
+                {
+                    for (UINT root = 0; root < roots; root += step)
+                        transforms.Rotate(rootIds[root], DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), 1.0f);
+                }
+
+                start = std::chrono::steady_clock::now();
+                updates[scenario] = transforms.Update();
+                times[scenario] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+        }
+
+        std::printf("%zu threads: first update %.3f ms, all moving %.3f ms (%u nodes), tenth moving %.3f ms (%u nodes), static %.3f ms (%u nodes)\n",
+            pool->GetThreadCount(), firstTime * 1000.0, times[0] * 1000.0 / frames, updates[0], times[1] * 1000.0 / frames, updates[1],
+            times[2] * 1000.0 / frames, updates[2]);
+    }
+}
+
+void Benchmark::RunCulling()
+{
+    const UINT spheres = 100000;
+    const UINT frames = 100;
+
+    ThreadPool threadPool;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    // Camera in the middle of a scattered cloud, looking along +Z at roughly a quarter of it
+    Camera camera;
+    camera.SetAspectRatio(16.0f / 9.0f);
+    camera.SetFarPlane(100.0f);
+
+    FrustumCulling culling(threadPool);
+
+    for (UINT sphere = 0; sphere < spheres; sphere++)
+        culling.Add(DirectX::XMVectorSet(200.0f * unit(random) - 100.0f, 200.0f * unit(random) - 100.0f, 200.0f * unit(random) - 100.0f, 0.1f + 2.0f * unit(random)));
+
+    std::printf("Culling: %u spheres, %zu threads\n", spheres, threadPool.GetThreadCount());
+
+    std::vector<UINT> results[3];
+    const char* names[] = { "Scalar", "AVX2", "AVX2 parallel" };
+
+    for (UINT mode = 0; mode < 3; mode++)
+    {
+        if (mode > 0 && !FrustumCulling::IsSimdAvailable())
+        {
+            std::printf("AVX2: not compiled in\n");
+            break;
+        }
+
+        culling.SetSimd(mode > 0);
+        double time = 0.0;
+
+        for (UINT frame = 0; frame < frames; frame++)
+        {
+            if (mode < 2)
+                culling.Cull(camera.GetFrustum(), results[mode]);
+            else
+                culling.CullParallel(camera.GetFrustum(), results[mode]);
+
+            time += culling.GetStats().m_Time;
+        }
+
+        double nanoseconds = time * 1e9 / (static_cast<double>(spheres) * frames);
+
+        std::printf("%s: %.3f ms per frame, %.3f ns per sphere, %u visible\n", names[mode], time * 1000.0 / frames, nanoseconds, culling.GetStats().m_Visible);
+    }
+
+    if (!results[1].empty())
+    {
+        // Same expressions in the same order, lists have to match exactly
+        std::printf("Lists: %s\n", results[0] == results[1] && results[0] == results[2] ? "identical" : "differ");
+    }
+}
+
+void Benchmark::RunHierarchy()
+{
+    const UINT sceneSizes[] = { 10000, 100000, 1000000 };
+    const UINT frames = 10;
+    const UINT sphereQueries = 1000;
+    const UINT rays = 10000;
+
+    ThreadPool threadPool;
+
+    std::printf("Hierarchy: %zu threads, times per operation\n", threadPool.GetThreadCount());
+
+    for (UINT objects : sceneSizes)
+    {
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+        // Same density at every size, boxes of 0.5 to 2.5 units in a cube of 10 units per object
+        float side = 10.0f * std::cbrt(static_cast<float>(objects));
+
+        auto makeBounds = [&](float x, float y, float z)
+        {
+            float size = 0.25f + unit(random);
+            return BvhBounds{ { x - size, y - size, z - size }, { x + size, y + size, z + size } };
+        };
+
+        std::vector<BvhBounds> bounds(objects);
+        for (BvhBounds& box : bounds)
+            box = makeBounds(side * unit(random), side * unit(random), side * unit(random));
+
+        BoundingVolumeHierarchy hierarchy(threadPool);
+        hierarchy.Build(bounds);
+
+        const BvhStats& stats = hierarchy.GetStats();
+        std::printf("%u objects: build %.3f ms, %u nodes\n", objects, stats.m_BuildTime * 1000.0, stats.m_Nodes);
+
+        // Every hundredth object moves. Jitter around the same spot keeps the boxes tight, drifting away
+        // along a direction of its own stretches them until subtrees get rebuilt.
+        std::vector<DirectX::XMFLOAT3> velocities(objects);
+        for (DirectX::XMFLOAT3& velocity : velocities)
+            velocity = { 16.0f * unit(random) - 8.0f, 16.0f * unit(random) - 8.0f, 16.0f * unit(random) - 8.0f };
+
+        double refitTimes[2]{ };
+        UINT refitNodes[2]{ };
+        UINT rebuilds = 0;
+        float quality = 1.0f;
+
+        for (UINT scenario = 0; scenario < 2; scenario++)
+        {
+            for (UINT frame = 0; frame < frames; frame++)
+            {
+                for (UINT object = 0; object < objects; object += 100)
+                {
+                    const BvhBounds& box = hierarchy.GetBounds(object);
+
+                    DirectX::XMFLOAT3 offset = velocities[object];
+                    if (scenario == 0)
+                        offset = { unit(random) - 0.5f, unit(random) - 0.5f, unit(random) - 0.5f };
+
+                    float x = 0.5f * (box.m_Min.x + box.m_Max.x) + offset.x;
+                    float y = 0.5f * (box.m_Min.y + box.m_Max.y) + offset.y;
+                    float z = 0.5f * (box.m_Min.z + box.m_Max.z) + offset.z;
+
+                    hierarchy.Update(object, makeBounds(x, y, z));
+                }
+
+                hierarchy.Refit();
+
+                refitTimes[scenario] += stats.m_RefitTime;
+                refitNodes[scenario] += stats.m_RefitNodes;
+                rebuilds += scenario == 1 ? stats.m_Rebuilds : 0;
+                quality = (std::max)(quality, stats.m_Quality);
+            }
+        }
+
+        std::printf("  refit 1%% jittering %.3f ms (%u nodes), 1%% drifting %.3f ms (%u nodes, %u subtree rebuilds), worst quality %.2f\n",
+            refitTimes[0] * 1000.0 / frames, refitNodes[0] / frames, refitTimes[1] * 1000.0 / frames, refitNodes[1] / frames, rebuilds, quality);
+
+        // Camera in the middle looking along +Z, brute force box tests use the same expressions
+        Camera camera;
+        camera.SetAspectRatio(16.0f / 9.0f);
+        camera.SetFarPlane(side * 0.5f);
+        camera.Move(DirectX::XMVectorSet(side * 0.5f, side * 0.5f, side * 0.5f, 0.0f));
+
+        const Frustum& frustum = camera.GetFrustum();
+        std::vector<UINT> visible;
+
+        double cullTime = 0.0;
+        for (UINT frame = 0; frame < frames; frame++)
+        {
+            hierarchy.CullFrustum(frustum, visible);
+            cullTime += hierarchy.GetCullingStats().m_Time;
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::vector<UINT> bruteVisible;
+
+        for (UINT object = 0; object < objects; object++)
+        {
+            const BvhBounds& box = hierarchy.GetBounds(object);
+            bool isVisible = true;
+
+            for (const DirectX::XMFLOAT4& plane : frustum.m_Planes)
+            {
+                float distance = ((plane.x * (box.m_Min.x + box.m_Max.x) + plane.y * (box.m_Min.y + box.m_Max.y)) + plane.z * (box.m_Min.z + box.m_Max.z)) + 2.0f * plane.w;
+                float radius = (std::fabs(plane.x) * (box.m_Max.x - box.m_Min.x) + std::fabs(plane.y) * (box.m_Max.y - box.m_Min.y)) + std::fabs(plane.z) * (box.m_Max.z - box.m_Min.z);
+
+                isVisible = isVisible && distance + radius >= 0.0f;
+            }
+
+            if (isVisible)
+                bruteVisible.push_back(object);
+        }
+
+        double bruteTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::sort(visible.begin(), visible.end());
+
+        std::printf("  frustum %.3f ms (%u visible, %u boxes tested), brute force %.3f ms, lists %s\n",
+            cullTime * 1000.0 / frames, hierarchy.GetCullingStats().m_Visible, hierarchy.GetCullingStats().m_Tested, bruteTime * 1000.0,
+            visible == bruteVisible ? "identical" : "differ");
+
+        // Light sized spheres and rays through the scene from random points
+        std::vector<UINT> found;
+        UINT foundCount = 0;
+
+        start = std::chrono::steady_clock::now();
+        for (UINT query = 0; query < sphereQueries; query++)
+        {
+            hierarchy.QuerySphere(DirectX::XMVectorSet(side * unit(random), side * unit(random), side * unit(random), 10.0f), found);
+            foundCount += static_cast<UINT>(found.size());
+        }
+
+        double sphereTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        UINT hits = 0;
+        RayHit hit;
+
+        start = std::chrono::steady_clock::now();
+        for (UINT ray = 0; ray < rays; ray++)
+        {
+            DirectX::XMVECTOR origin = DirectX::XMVectorSet(side * unit(random), side * unit(random), side * unit(random), 1.0f);
+            DirectX::XMVECTOR direction = DirectX::XMVectorSet(unit(random) - 0.5f, unit(random) - 0.5f, unit(random) - 0.5f, 0.0f);
+
+            hits += hierarchy.CastRay(origin, direction, side, hit) ? 1 : 0;
+        }
+
+        double rayTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::printf("  sphere query %.3f us (%.1f objects), ray cast %.3f us (%u of %u hit)\n",
+            sphereTime * 1e6 / sphereQueries, static_cast<double>(foundCount) / sphereQueries, rayTime * 1e6 / rays, hits, rays);
+    }
+}
+
+void Benchmark::RunOcclusion()
+{
+    const UINT boxes = 4096;
+    const UINT frames = 100;
+    const UINT wallQuads = 16;       // Per side
+    const float wallHalfSize = 16.0f;
+    const float wallDistance = 20.0f;
+
+    // Camera at the origin looking along +Z at a wall, boxes scattered in front of it, behind it and around it
+    Camera camera;
+    camera.SetAspectRatio(4.0f / 3.0f);
+    camera.SetFarPlane(200.0f);
+
+    std::vector<DirectX::XMFLOAT3> wallPositions;
+    std::vector<UINT> wallIndices;
+
+    for (UINT y = 0; y <= wallQuads; y++)
+        for (UINT x = 0; x <= wallQuads; x++)
+            wallPositions.push_back({ wallHalfSize * (2.0f * x / wallQuads - 1.0f), wallHalfSize * (2.0f * y / wallQuads - 1.0f), wallDistance });
+
+    for (UINT y = 0; y < wallQuads; y++)
+    {
+        for (UINT x = 0; x < wallQuads; x++)
+        {
+            UINT corner = y * (wallQuads + 1) + x;
+            wallIndices.insert(wallIndices.end(), { corner, corner + wallQuads + 1, corner + 1, corner + 1, corner + wallQuads + 1, corner + wallQuads + 2 });
+        }
+    }
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    std::vector<OcclusionQuery> queries;
+    std::vector<bool> isHidden;
+
+    for (UINT box = 0; box < boxes; box++)
+    {
+        DirectX::XMFLOAT3 center(80.0f * unit(random) - 40.0f, 60.0f * unit(random) - 30.0f, 5.0f + 145.0f * unit(random));
+        float halfSize = 0.25f + 0.75f * unit(random);
+
+        OcclusionQuery& query = queries.emplace_back();
+        query.m_BoundsMin = { center.x - halfSize, center.y - halfSize, center.z - halfSize };
+        query.m_BoundsMax = { center.x + halfSize, center.y + halfSize, center.z + halfSize };
+        query.m_Triangles = 12;
+
+        // Behind the wall and inside its silhouette as seen from the origin
+        float slope = wallHalfSize / wallDistance;
+        bool isBehind = query.m_BoundsMin.z > wallDistance;
+
+        for (UINT corner = 0; corner < 8; corner++)
+        {
+            float x = corner & 1 ? query.m_BoundsMax.x : query.m_BoundsMin.x;
+            float y = corner & 2 ? query.m_BoundsMax.y : query.m_BoundsMin.y;
+            float z = corner & 4 ? query.m_BoundsMax.z : query.m_BoundsMin.z;
+
+            isBehind = isBehind && std::abs(x) < slope * z && std::abs(y) < slope * z;
+        }
+
+        isHidden.push_back(isBehind);
+    }
+
+    UINT hidden = static_cast<UINT>(std::count(isHidden.begin(), isHidden.end(), true));
+
+    ThreadPool serialPool(1);
+    ThreadPool threadPool;
+
+    std::printf("Occlusion: %u boxes, %u of them hidden by a wall of %zu triangles\n", boxes, hidden, wallIndices.size() / 3);
+
+    for (ThreadPool* pool : { &serialPool, &threadPool })
+    {
+        OcclusionCulling occlusion(*pool);
+        double time = 0.0;
+
+        for (UINT frame = 0; frame < frames; frame++)
+        {
+            occlusion.Begin(camera.GetViewProjection());
+            occlusion.AddOccluder(wallPositions, wallIndices, DirectX::XMMatrixIdentity());
+            occlusion.Rasterize();
+            occlusion.Test(queries);
+
+            time += occlusion.GetStats().m_Time;
+        }
+
+        const OcclusionStats& stats = occlusion.GetStats();
+
+        // Boxes reported occluded although some part of them is in view
+        UINT wrong = 0;
+        for (UINT box = 0; box < boxes; box++)
+            wrong += queries[box].m_IsOccluded && !isHidden[box] ? 1 : 0;
+
+        UINT covered = 0;
+        for (UINT y = 0; y < occlusion.GetHeight(); y++)
+            for (UINT x = 0; x < occlusion.GetWidth(); x++)
+                covered += occlusion.GetDepth(x, y) < 1.0f ? 1 : 0;
+
+        std::printf("%zu threads: %ux%u buffer, %.3f ms per frame, %u of %u pixels covered, %u boxes occluded (%u wrongly), %u triangles rejected\n",
+            pool->GetThreadCount(), occlusion.GetWidth(), occlusion.GetHeight(), time * 1000.0 / frames, covered,
+            occlusion.GetWidth() * occlusion.GetHeight(), stats.m_Occluded, wrong, stats.m_OccludedTriangles);
+    }
+}
+
+void Benchmark::RunLod()
+{
+    const UINT gridSize = 256; // Quads per side
+    const UINT frames = 2000;
+    const float height = 1080.0f;
+    const float threshold = 1.0f;
+
+    IdleApplication application;
+
+    ContextParams params{ };
+    params.m_DeviceType = DeviceType::Null;
+
+    Context context(application, params);
+    DX11Device& device = context.GetDevice();
+
+    std::vector<Vertex> vertices;
+    std::vector<UINT> indices;
+    MakeTerrain(gridSize, vertices, indices);
+
+    std::vector<UINT> lodIndices;
+    std::vector<MeshLod> lods;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    MeshSimplifier::BuildLods(vertices.data(), static_cast<UINT>(vertices.size()), indices.data(), static_cast<UINT>(indices.size()), lodIndices, lods);
+    double buildTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("Levels of detail: %zu vertices, %zu triangles, built in %.1f ms\n", vertices.size(), indices.size() / 3, buildTime * 1000.0);
+
+    for (size_t lod = 0; lod < lods.size(); lod++)
+        std::printf("  level %zu: %u triangles, error %.5f\n", lod, lods[lod].m_IndexCount / 3, lods[lod].m_Error);
+
+    // Built offline, the geometry takes the levels as they are
+    MeshData data{ vertices.data(), lodIndices.data(), static_cast<UINT>(vertices.size() * sizeof(Vertex)), static_cast<UINT>(lodIndices.size() * sizeof(UINT)) };
+    data.m_Lods = lods.data();
+    data.m_LodCount = static_cast<UINT>(lods.size());
+
+    ThreadPool threadPool;
+    TransformHierarchy transforms(threadPool);
+    std::vector<std::unique_ptr<Mesh>> meshes;
+    meshes.emplace_back(new Mesh(device, transforms, std::make_shared<MeshGeometry>(device, data)));
+
+    std::vector<UINT> updated;
+    transforms.Update();
+    Mesh::UpdateWorlds(meshes, updated);
+
+    Mesh& mesh = *meshes[0];
+    const MeshGeometry& geometry = mesh.GetGeometry();
+
+    // 1080 pixels high, 90 degrees vertical field of view
+    float pixelsPerUnit = 0.5f * height;
+
+    // Flying away to 500 units and back with a shaking camera, levels picked with and without hysteresis
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> shake(-0.01f, 0.01f);
+
+    UINT64 triangles[2]{ };
+    UINT switches[2]{ };
+    UINT plainLod = 0;
+
+    for (UINT frame = 0; frame < frames; frame++)
+    {
+        float phase = 1.0f - std::abs(2.0f * frame / frames - 1.0f);
+        float distance = 2.0f * std::pow(250.0f, phase) * (1.0f + shake(random));
+
+        UINT previousLod = mesh.GetLod();
+        UINT lod = mesh.SelectLod(DirectX::XMVectorSet(0.0f, 0.0f, -distance, 0.0f), pixelsPerUnit, threshold);
+
+        triangles[0] += geometry.GetLod(lod).m_IndexCount / 3;
+        switches[0] += lod != previousLod ? 1 : 0;
+
+        // Coarsest level within the threshold, from the same distance to the bounding sphere
+        float sphereDistance = distance - DirectX::XMVectorGetW(mesh.GetBoundingSphere());
+        UINT coarsest = 0;
+
+        for (UINT level = 1; level < geometry.GetLodCount(); level++)
+        {
+            if (sphereDistance > 0.0f && geometry.GetLod(level).m_Error * pixelsPerUnit / sphereDistance <= threshold)
+                coarsest = level;
+        }
+
+        triangles[1] += geometry.GetLod(coarsest).m_IndexCount / 3;
+        switches[1] += coarsest != plainLod ? 1 : 0;
+        plainLod = coarsest;
+    }
+
+    std::printf("Flight of %u frames: %.0f triangles per frame, %u switches with hysteresis, %.0f triangles, %u switches without, %u at full detail\n",
+        frames, static_cast<double>(triangles[0]) / frames, switches[0], static_cast<double>(triangles[1]) / frames, switches[1], geometry.GetIndexCount() / 3);
+
+    for (float distance : { 2.0f, 10.0f, 50.0f, 250.0f, 500.0f })
+    {
+        UINT lod = 0;
+        for (UINT settle = 0; settle < 2; settle++)
+            lod = mesh.SelectLod(DirectX::XMVectorSet(0.0f, 0.0f, -distance, 0.0f), pixelsPerUnit, threshold);
+
+        float pixels = 2.0f * DirectX::XMVectorGetW(mesh.GetBoundingSphere()) * pixelsPerUnit / distance;
+        std::printf("  %5.0f units away, %6.0f pixels across: level %u, %u triangles\n", distance, pixels, lod, geometry.GetLod(lod).m_IndexCount / 3);
+    }
+}
+
+void Benchmark::RunOptimizer()
+{
+    const UINT gridSize = 256;
+    const UINT sphereSegments = 256;
+    const UINT sphereRings = 128;
+
+    struct TestMesh
+    {
+        const char* m_Name;
+        std::vector<Vertex> m_Vertices;
+        std::vector<UINT> m_Indices;
+    };
+
+    std::vector<TestMesh> meshes(3);
+    std::mt19937 random(1);
+
+    {
+        // Rows of quads, already good for the cache
+        TestMesh& mesh = meshes[0];
+        mesh.m_Name = "terrain";
+        MakeTerrain(gridSize, mesh.m_Vertices, mesh.m_Indices);
+    }
+
+    {
+        // The same terrain with triangles in random order
+        TestMesh& mesh = meshes[1];
+        mesh.m_Name = "shuffled terrain";
+        MakeTerrain(gridSize, mesh.m_Vertices, mesh.m_Indices);
+
+        std::vector<UINT> triangles(mesh.m_Indices.size() / 3);
+        std::iota(triangles.begin(), triangles.end(), 0);
+        std::shuffle(triangles.begin(), triangles.end(), random);
+
+        std::vector<UINT> shuffled;
+        for (UINT triangle : triangles)
+            shuffled.insert(shuffled.end(), mesh.m_Indices.begin() + triangle * 3, mesh.m_Indices.begin() + triangle * 3 + 3);
+
+        mesh.m_Indices.swap(shuffled);
+    }
+
+    {
+        // Unindexed sphere, three vertices per triangle as exported by some tools
+        TestMesh& mesh = meshes[2];
+        mesh.m_Name = "sphere soup";
+
+        auto makeVertex = [](UINT segment, UINT ring)
+        {
+            float u = static_cast<float>(segment) / sphereSegments;
+            float v = static_cast<float>(ring) / sphereRings;
+            float theta = u * DirectX::XM_2PI;
+            float phi = v * DirectX::XM_PI;
+
+            DirectX::XMFLOAT3 normal(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta));
+            return Vertex{ normal, normal, { u, v } };
+        };
+
+        for (UINT ring = 0; ring < sphereRings; ring++)
+        {
+            for (UINT segment = 0; segment < sphereSegments; segment++)
+            {
+                Vertex corners[] = { makeVertex(segment, ring), makeVertex(segment + 1, ring), makeVertex(segment, ring + 1), makeVertex(segment + 1, ring + 1) };
+
+                for (UINT corner : { 0, 1, 2, 1, 3, 2 })
+                {
+                    mesh.m_Indices.push_back(static_cast<UINT>(mesh.m_Vertices.size()));
+                    mesh.m_Vertices.push_back(corners[corner]);
+                }
+            }
+        }
+    }
+
+    std::printf("Optimizer: ACMR and ATVR with a 16 entry FIFO cache, overdraw from six axis views\n");
+
+    for (TestMesh& mesh : meshes)
+    {
+        MeshOptimizerStats stats;
+        MeshOptimizer::Optimize(mesh.m_Vertices, mesh.m_Indices, &stats);
+
+        std::printf("%s: %zu triangles, %u vertices, %u after welding, %.1f ms\n", mesh.m_Name, mesh.m_Indices.size() / 3, stats.m_Vertices, stats.m_UniqueVertices, stats.m_Time * 1000.0);
+        std::printf("  ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, overdraw %.3f -> %.3f\n",
+            stats.m_Before.m_Acmr, stats.m_After.m_Acmr, stats.m_Before.m_Atvr, stats.m_After.m_Atvr, stats.m_Before.m_Overdraw, stats.m_After.m_Overdraw);
+    }
+}
+
+void Benchmark::RunVertices()
+{
+    const UINT vertexCount = 1 << 20;
+    const UINT repeats = 10;
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    // Scattered positions, normals over the whole sphere so the folded half is covered
+    std::vector<Vertex> vertices(vertexCount);
+    DirectX::XMFLOAT3 boundsMin(-10.0f, -2.0f, -10.0f);
+    DirectX::XMFLOAT3 boundsMax(10.0f, 2.0f, 10.0f);
+
+    for (Vertex& vertex : vertices)
+    {
+        vertex.Position = { boundsMin.x + 20.0f * unit(random), boundsMin.y + 4.0f * unit(random), boundsMin.z + 20.0f * unit(random) };
+        DirectX::XMStoreFloat3(&vertex.Normal, DirectX::XMVector3Normalize(DirectX::XMVectorSet(2.0f * unit(random) - 1.0f, 2.0f * unit(random) - 1.0f, 2.0f * unit(random) - 1.0f, 0.0f)));
+        vertex.TexCoord = { unit(random), unit(random) };
+    }
+
+    std::printf("Vertices: %u, %zu bytes each at full precision\n", vertexCount, sizeof(Vertex));
+
+    const VertexFormat formats[] = { VertexFormat::Quantized, VertexFormat::Half };
+    const char* names[] = { "Quantized", "Half" };
+
+    for (UINT format = 0; format < 2; format++)
+    {
+        UINT stride = VertexEncoding::GetStride(formats[format]);
+        std::vector<BYTE> encoded[2];
+        double times[2]{ };
+
+        for (UINT mode = 0; mode < 2; mode++)
+        {
+            if (mode > 0 && !VertexEncoding::IsSimdAvailable())
+                break;
+
+            encoded[mode].resize(static_cast<size_t>(vertexCount) * stride);
+
+            auto start = std::chrono::high_resolution_clock::now();
+
+            for (UINT repeat = 0; repeat < repeats; repeat++)
+                VertexEncoding::Encode(formats[format], vertices.data(), vertexCount, boundsMin, boundsMax, encoded[mode].data(), mode > 0);
+
+            times[mode] = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count() / repeats;
+        }
+
+        // Errors of what the shaders see: object space positions, unit normals and texture coordinates
+        DirectX::XMMATRIX positionTransform = VertexEncoding::GetPositionTransform(formats[format], boundsMin, boundsMax);
+        float positionError = 0.0f;
+        float normalError = 0.0f;
+        float texCoordError = 0.0f;
+
+        for (UINT index = 0; index < vertexCount; index++)
+        {
+            const Vertex& vertex = vertices[index];
+            Vertex decoded = VertexEncoding::Decode(formats[format], &encoded[0][static_cast<size_t>(index) * stride]);
+
+            DirectX::XMVECTOR position = DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat3(&decoded.Position), positionTransform);
+            float cosine = DirectX::XMVectorGetX(DirectX::XMVector3Dot(DirectX::XMLoadFloat3(&decoded.Normal), DirectX::XMLoadFloat3(&vertex.Normal)));
+
+            positionError = (std::max)(positionError, DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVectorSubtract(position, DirectX::XMLoadFloat3(&vertex.Position)))));
+            normalError = (std::max)(normalError, std::acos((std::min)(cosine, 1.0f)));
+            texCoordError = (std::max)({ texCoordError, std::fabs(decoded.TexCoord.x - vertex.TexCoord.x), std::fabs(decoded.TexCoord.y - vertex.TexCoord.y) });
+        }
+
+        std::printf("%s: %u bytes per vertex, max errors: position %.6f, normal %.4f degrees, texture coordinate %.6f\n",
+            names[format], stride, positionError, DirectX::XMConvertToDegrees(normalError), texCoordError);
+        std::printf("  Scalar: %.3f ms, %.0f Mvertices/s\n", times[0] * 1000.0, vertexCount / times[0] * 1e-6);
+
+        if (encoded[1].empty())
+            std::printf("  AVX2: not compiled in\n");
+        else
+        {
+            // Same expressions in the same order, buffers have to match exactly
+            std::printf("  AVX2: %.3f ms, %.0f Mvertices/s, %s\n", times[1] * 1000.0, vertexCount / times[1] * 1e-6, encoded[0] == encoded[1] ? "identical" : "differ");
+        }
+    }
+}
+
+void Benchmark::RunIndices()
+{
+    // The middle one has exactly 65536 vertices
+    const UINT gridSizes[] = { 64, 255, 256, 1024 };
+
+    std::printf("Indices: bytes per triangle list, meshlets of at most %u vertices and %u triangles\n", MeshletBuilder::s_MaxVertices, MeshletBuilder::s_MaxTriangles);
+
+    for (UINT gridSize : gridSizes)
+    {
+        std::vector<Vertex> vertices;
+        std::vector<UINT> indices;
+        MakeTerrain(gridSize, vertices, indices);
+        MeshOptimizer::OptimizeVertexCache(indices.data(), static_cast<UINT>(indices.size()), static_cast<UINT>(vertices.size()));
+
+        size_t wideBytes = indices.size() * sizeof(UINT);
+        size_t bytes = vertices.size() <= 65536 ? indices.size() * sizeof(USHORT) : wideBytes;
+
+        std::vector<DirectX::XMFLOAT3> positions(vertices.size());
+        for (size_t vertex = 0; vertex < vertices.size(); vertex++)
+            positions[vertex] = vertices[vertex].Position;
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        MeshletData meshlets;
+        MeshletBuilder::Build(positions.data(), static_cast<UINT>(positions.size()), indices.data(), static_cast<UINT>(indices.size()), meshlets);
+
+        double time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        // Meshlets have to draw the same triangles in the same order
+        std::vector<UINT> unpacked;
+        MeshletBuilder::Unpack(meshlets, unpacked);
+
+        double meshletCount = static_cast<double>(meshlets.m_Meshlets.size());
+
+        std::printf("%zu vertices, %zu triangles: 32-bit %zu bytes, automatic %zu bytes (%u-bit)\n",
+            vertices.size(), indices.size() / 3, wideBytes, bytes, bytes == wideBytes ? 32 : 16);
+        std::printf("  %zu meshlets, %.1f vertices and %.1f triangles each, %zu bytes (%.2f of 32-bit), built in %.2f ms, %s\n",
+            meshlets.m_Meshlets.size(), meshlets.m_Vertices.size() / meshletCount, indices.size() / 3 / meshletCount,
+            meshlets.GetSize(), static_cast<double>(meshlets.GetSize()) / wideBytes, time * 1000.0, unpacked == indices ? "identical" : "differ");
+    }
+}
+
+void Benchmark::RunMeshlets()
+{
+    const UINT sphereSegments = 256;
+    const UINT sphereRings = 128;
+    const UINT gridSize = 256;
+    const UINT frames = 100;
+
+    IdleApplication application;
+
+    ContextParams params{ };
+    params.m_DeviceType = DeviceType::Null;
+
+    Context context(application, params);
+    DX11Device& device = context.GetDevice();
+
+    // Closed sphere, about half of it faces away from any camera outside
+    std::vector<Vertex> sphereVertices;
+    std::vector<UINT> sphereIndices;
+
+    for (UINT ring = 0; ring <= sphereRings; ring++)
+    {
+        for (UINT segment = 0; segment <= sphereSegments; segment++)
+        {
+            float u = static_cast<float>(segment) / sphereSegments;
+            float v = static_cast<float>(ring) / sphereRings;
+            float theta = u * DirectX::XM_2PI;
+            float phi = v * DirectX::XM_PI;
+
+            DirectX::XMFLOAT3 normal(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta));
+            sphereVertices.push_back({ normal, normal, { u, v } });
+        }
+    }
+
+    for (UINT ring = 0; ring < sphereRings; ring++)
+    {
+        for (UINT segment = 0; segment < sphereSegments; segment++)
+        {
+            UINT corner = ring * (sphereSegments + 1) + segment;
+            sphereIndices.insert(sphereIndices.end(), { corner, corner + 1, corner + sphereSegments + 1, corner + 1, corner + sphereSegments + 2, corner + sphereSegments + 1 });
+        }
+    }
+
+    std::vector<Vertex> terrainVertices;
+    std::vector<UINT> terrainIndices;
+    MakeTerrain(gridSize, terrainVertices, terrainIndices);
+
+    auto makeGeometry = [&device](const std::vector<Vertex>& vertices, const std::vector<UINT>& indices)
+    {
+        MeshData data{ vertices.data(), indices.data(), static_cast<UINT>(vertices.size() * sizeof(Vertex)), static_cast<UINT>(indices.size() * sizeof(UINT)) };
+        data.m_BuildMeshlets = true;
+        data.m_KeepTriangles = true; // For the backface comparison below
+        return std::make_shared<MeshGeometry>(device, data);
+    };
+
+    ThreadPool threadPool;
+    TransformHierarchy transforms(threadPool);
+    std::vector<std::unique_ptr<Mesh>> meshes;
+
+    // Sphere in front of the camera, terrain below it reaching out of view on every side
+    auto& sphere = meshes.emplace_back(new Mesh(device, transforms, makeGeometry(sphereVertices, sphereIndices)));
+    sphere->Move(DirectX::XMVectorSet(0.0f, 0.0f, 4.0f, 0.0f));
+
+    auto& terrain = meshes.emplace_back(new Mesh(device, transforms, makeGeometry(terrainVertices, terrainIndices)));
+    terrain->Scale(DirectX::XMVectorSet(40.0f, 40.0f, 40.0f, 1.0f));
+    terrain->Move(DirectX::XMVectorSet(0.0f, -2.0f, 0.0f, 0.0f));
+
+    std::vector<UINT> updated;
+    transforms.Update();
+    Mesh::UpdateWorlds(meshes, updated);
+
+    Camera camera;
+    camera.SetAspectRatio(16.0f / 9.0f);
+    camera.SetFarPlane(100.0f);
+
+    const char* names[] = { "Sphere", "Terrain" };
+    std::printf("Meshlets: culled against the camera, %u frames\n", frames);
+
+    for (size_t index = 0; index < meshes.size(); index++)
+    {
+        const Mesh& mesh = *meshes[index];
+        const MeshGeometry& geometry = mesh.GetGeometry();
+
+        DirectX::XMMATRIX world = transforms.GetWorld(mesh.GetTransform());
+        float scale = transforms.GetWorldScale(mesh.GetTransform());
+
+        MeshletCulling culling;
+        double time = 0.0;
+
+        for (UINT frame = 0; frame < frames; frame++)
+        {
+            culling.Begin(camera.GetFrustum(), camera.GetPosition());
+
+            UINT indexCount = 0;
+            culling.Cull(geometry, world, scale, indexCount);
+            time += culling.GetStats().m_Time;
+        }
+
+        // Triangles a rasterizer would keep after backface culling, for comparison with the conservative cones
+        const std::vector<DirectX::XMFLOAT3>& positions = geometry.GetPositions();
+        const std::vector<UINT>& indices = geometry.GetIndices();
+        UINT frontTriangles = 0;
+
+        for (size_t triangle = 0; triangle < indices.size(); triangle += 3)
+        {
+            DirectX::XMVECTOR corners[3];
+            for (UINT corner = 0; corner < 3; corner++)
+                corners[corner] = DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat3(&positions[indices[triangle + corner]]), world);
+
+            DirectX::XMVECTOR normal = DirectX::XMVector3Cross(DirectX::XMVectorSubtract(corners[1], corners[0]), DirectX::XMVectorSubtract(corners[2], corners[0]));
+            frontTriangles += DirectX::XMVectorGetX(DirectX::XMVector3Dot(normal, DirectX::XMVectorSubtract(corners[0], camera.GetPosition()))) < 0.0f ? 1 : 0;
+        }
+
+        const MeshletCullingStats& stats = culling.GetStats();
+
+        std::printf("%s: %u meshlets, %u visible, %u backfacing, %u outside, %.3f ms per frame\n",
+            names[index], stats.m_Meshlets, stats.m_Visible, stats.m_Backfacing, stats.m_Outside, time * 1000.0 / frames);
+        std::printf("  triangles: %u of %u drawn, %u facing the camera\n", stats.m_Triangles, stats.m_FullTriangles, frontTriangles);
+    }
+}
+
+void Benchmark::RunMeshFile()
+{
+    const UINT gridSize = 1200;
+    const UINT pageSize = 4096;
+    const char* path = "benchmark.mesh";
+
+    IdleApplication application;
+
+    ContextParams params{ };
+    params.m_DeviceType = DeviceType::Null;
+
+    Context context(application, params);
+    DX11Device& device = context.GetDevice();
+
+    // One level and its meshlets, stored as built so that loading does no processing
+    std::vector<Vertex> vertices;
+    std::vector<UINT> indices;
+    MakeTerrain(gridSize, vertices, indices);
+
+    std::vector<DirectX::XMFLOAT3> positions(vertices.size());
+    for (size_t vertex = 0; vertex < vertices.size(); vertex++)
+        positions[vertex] = vertices[vertex].Position;
+
+    MeshletData meshlets;
+    MeshletBuilder::Build(positions.data(), static_cast<UINT>(positions.size()), indices.data(), static_cast<UINT>(indices.size()), meshlets);
+
+    MeshLod lod{ 0, static_cast<UINT>(indices.size()), 0.0f };
+
+    MeshData data{ vertices.data(), indices.data(), static_cast<UINT>(vertices.size() * sizeof(Vertex)), static_cast<UINT>(indices.size() * sizeof(UINT)) };
+    data.m_Lods = &lod;
+    data.m_LodCount = 1;
+    data.m_Meshlets = meshlets.m_Meshlets.data();
+    data.m_MeshletCount = static_cast<UINT>(meshlets.m_Meshlets.size());
+    data.m_MeshletVertices = meshlets.m_Vertices.data();
+    data.m_MeshletVertexCount = static_cast<UINT>(meshlets.m_Vertices.size());
+    data.m_MeshletIndices = meshlets.m_Indices.data();
+    data.m_MeshletIndexCount = static_cast<UINT>(meshlets.m_Indices.size());
+
+    auto start = std::chrono::high_resolution_clock::now();
+    MeshFile::Write(path, data);
+    double writeTime = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+    std::vector<char> copy;
+
+    {
+        // What a loader reading into memory pays before it could even start parsing
+        start = std::chrono::high_resolution_clock::now();
+
+        std::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
+        copy.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(copy.data(), static_cast<std::streamsize>(copy.size()));
+
+        double readTime = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        double megabytes = static_cast<double>(copy.size()) / (1024.0 * 1024.0);
+
+        std::printf("Mesh file: %u vertices, %zu triangles, %zu meshlets, %.1f MB\n", data.m_VertexSize / static_cast<UINT>(sizeof(Vertex)), indices.size() / 3, meshlets.m_Meshlets.size(), megabytes);
+        std::printf("Write: %.2f ms, %.0f MB/s\n", writeTime * 1000.0, megabytes / writeTime);
+        std::printf("Read into memory: %.2f ms, %.0f MB/s\n", readTime * 1000.0, megabytes / readTime);
+    }
+
+    {
+        start = std::chrono::high_resolution_clock::now();
+        MeshFile file(path);
+        double mapTime = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        // One read per page, the cost of the page faults a renderer pays on first use of the sections
+        const BYTE* bytes = reinterpret_cast<const BYTE*>(&file.GetHeader());
+        UINT checksum = 0;
+
+        start = std::chrono::high_resolution_clock::now();
+        for (UINT64 offset = 0; offset < file.GetSize(); offset += pageSize)
+            checksum += bytes[offset];
+        double touchTime = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        const MeshData& mapped = file.GetData();
+        bool isIdentical = mapped.m_VertexSize == data.m_VertexSize && mapped.m_IndexSize == data.m_IndexSize && mapped.m_MeshletCount == data.m_MeshletCount &&
+            std::equal(mapped.m_VertexData, mapped.m_VertexData + vertices.size(), vertices.begin(), [](const Vertex& a, const Vertex& b) { return std::memcmp(&a, &b, sizeof(Vertex)) == 0; }) &&
+            std::equal(static_cast<const UINT*>(mapped.m_IndexData), static_cast<const UINT*>(mapped.m_IndexData) + indices.size(), indices.begin());
+
+        start = std::chrono::high_resolution_clock::now();
+        MeshGeometry geometry(device, mapped);
+        double geometryTime = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        std::printf("Map: %.3f ms, first touch of %llu pages: %.2f ms (checksum %u), %s\n", mapTime * 1000.0, file.GetSize() / pageSize, touchTime * 1000.0, checksum, isIdentical ? "identical" : "differ");
+        std::printf("Geometry from the mapping: %.2f ms, %zu meshlets\n", geometryTime * 1000.0, geometry.GetMeshlets().m_Meshlets.size());
+    }
+
+    {
+        start = std::chrono::high_resolution_clock::now();
+        MeshFile file(path, true);
+        double verifyTime = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        std::printf("Map and verify hash: %.2f ms, %.0f MB/s\n", verifyTime * 1000.0, static_cast<double>(file.GetSize()) / (1024.0 * 1024.0) / verifyTime);
+    }
+
+    auto isRejected = [path, &copy](bool verify)
+    {
+        std::ofstream(path, std::ios::out | std::ios::binary | std::ios::trunc).write(copy.data(), static_cast<std::streamsize>(copy.size()));
+
+        try
+        {
+            MeshFile file(path, verify);
+        }
+        catch (const std::runtime_error&)
+        {
+            return true;
+        }
+
+        return false;
+    };
+
+    // A flipped byte anywhere past the header fails verification
+    copy[copy.size() / 2] ^= 1;
+    std::printf("Corrupted file: %s\n", isRejected(true) ? "rejected" : "accepted");
+    copy[copy.size() / 2] ^= 1;
+
+    {
+        // An index past the vertices fails on open, without the hash
+        MeshFileHeader header;
+        std::memcpy(&header, copy.data(), sizeof(header));
+
+        UINT outOfRange = static_cast<UINT>(vertices.size());
+        std::memcpy(&copy[static_cast<size_t>(header.m_Sections[static_cast<UINT>(MeshFileSection::Indices)].m_Offset)], &outOfRange, sizeof(outOfRange));
+
+        std::printf("Index out of range: %s\n", isRejected(false) ? "rejected" : "accepted");
+    }
+
+    std::remove(path);
+}
+
+void Benchmark::RunImport()
+{
+    const UINT gridSize = 1000;
+    const char* objPath = "benchmark.obj";
+    const char* glbPath = "benchmark.glb";
+
+    std::vector<Vertex> vertices;
+    std::vector<UINT> indices;
+    MakeTerrain(gridSize, vertices, indices);
+
+    // Sources are right-handed with counter-clockwise front faces and the texture origin of OBJ at the bottom,
+    // the importer turns all of it back
+    {
+        std::string text = "# Terrain\nmtllib benchmark.mtl\nusemtl terrain\n";
+        char line[128];
+
+        for (const Vertex& vertex : vertices)
+        {
+            text.append(line, std::snprintf(line, sizeof(line), "v %.9g %.9g %.9g\n", vertex.Position.x, vertex.Position.y, -vertex.Position.z));
+            text.append(line, std::snprintf(line, sizeof(line), "vt %.9g %.9g\n", vertex.TexCoord.x, 1.0f - vertex.TexCoord.y));
+            text.append(line, std::snprintf(line, sizeof(line), "vn %.9g %.9g %.9g\n", vertex.Normal.x, vertex.Normal.y, -vertex.Normal.z));
+        }
+
+        for (size_t index = 0; index < indices.size(); index += 3)
+        {
+            UINT a = indices[index] + 1;
+            UINT b = indices[index + 2] + 1;
+            UINT c = indices[index + 1] + 1;
+            text.append(line, std::snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c));
+        }
+
+        std::ofstream(objPath, std::ios::out | std::ios::binary | std::ios::trunc).write(text.data(), static_cast<std::streamsize>(text.size()));
+    }
+
+    {
+        std::vector<BYTE> binary(vertices.size() * sizeof(Vertex) + indices.size() * sizeof(UINT));
+        std::vector<Vertex> mirrored(vertices);
+
+        for (Vertex& vertex : mirrored)
+        {
+            vertex.Position.z = -vertex.Position.z;
+            vertex.Normal.z = -vertex.Normal.z;
+        }
+
+        std::memcpy(binary.data(), mirrored.data(), mirrored.size() * sizeof(Vertex));
+        std::vector<UINT> reversed(indices);
+        for (size_t index = 0; index < reversed.size(); index += 3)
+            std::swap(reversed[index + 1], reversed[index + 2]);
+
+        std::memcpy(binary.data() + mirrored.size() * sizeof(Vertex), reversed.data(), reversed.size() * sizeof(UINT));
+
+        size_t vertexBytes = vertices.size() * sizeof(Vertex);
+        char json[2048];
+        int jsonSize = std::snprintf(json, sizeof(json),
+            "{\"asset\":{\"version\":\"2.0\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],"
+            "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2},\"indices\":3,\"material\":0}]}],"
+            "\"materials\":[{\"name\":\"terrain\",\"pbrMetallicRoughness\":{\"baseColorFactor\":[0.5,0.6,0.4,1.0],\"roughnessFactor\":0.8}}],"
+            "\"buffers\":[{\"byteLength\":%zu}],"
+            "\"bufferViews\":[{\"buffer\":0,\"byteLength\":%zu,\"byteStride\":%zu},{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu}],"
+            "\"accessors\":[{\"bufferView\":0,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC3\"},"
+            "{\"bufferView\":0,\"byteOffset\":12,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC3\"},"
+            "{\"bufferView\":0,\"byteOffset\":24,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC2\"},"
+            "{\"bufferView\":1,\"componentType\":5125,\"count\":%zu,\"type\":\"SCALAR\"}]}",
+            binary.size(), vertexBytes, sizeof(Vertex), vertexBytes, indices.size() * sizeof(UINT), vertices.size(), vertices.size(), vertices.size(), indices.size());
+
+        // Chunks are padded to 4 bytes, JSON with spaces
+        UINT paddedJsonSize = (static_cast<UINT>(jsonSize) + 3) & ~3u;
+        UINT header[] = { 0x46546C67, 2, 12 + 8 + paddedJsonSize + 8 + static_cast<UINT>(binary.size()), paddedJsonSize, 0x4E4F534A };
+        UINT binaryHeader[] = { static_cast<UINT>(binary.size()), 0x004E4942 };
+
+        std::ofstream file(glbPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        file.write(json, jsonSize);
+        file.write("   ", paddedJsonSize - jsonSize);
+        file.write(reinterpret_cast<const char*>(binaryHeader), sizeof(binaryHeader));
+        file.write(reinterpret_cast<const char*>(binary.data()), static_cast<std::streamsize>(binary.size()));
+    }
+
+    // Every triangle corner has to come back as the source vertex, up to the rounding of the text and of 1 - v
+    auto matchesSource = [&vertices, &indices](const ImportedMesh& mesh)
+    {
+        if (mesh.m_Indices.size() != indices.size())
+            return false;
+
+        for (size_t index = 0; index < indices.size(); index++)
+        {
+            const float* imported = &mesh.m_Vertices[mesh.m_Indices[index]].Position.x;
+            const float* source = &vertices[indices[index]].Position.x;
+
+            for (UINT component = 0; component < sizeof(Vertex) / sizeof(float); component++)
+            {
+                if (std::abs(imported[component] - source[component]) > 1e-6f)
+                    return false;
+            }
+        }
+
+        return true;
+    };
+
+    const char* paths[] = { objPath, glbPath };
+    size_t threadCounts[] = { 1, std::thread::hardware_concurrency() };
+
+    std::printf("Import: terrain of %zu vertices and %zu triangles\n", vertices.size(), indices.size() / 3);
+
+    for (const char* path : paths)
+    {
+        ImportedMesh results[2];
+
+        for (size_t run = 0; run < 2; run++)
+        {
+            ThreadPool threadPool(threadCounts[run]);
+            MeshImporter importer(threadPool);
+            importer.Import(path, results[run]);
+
+            const ImportStats& stats = importer.GetStats();
+            double megabytes = static_cast<double>(stats.m_Bytes) / (1024.0 * 1024.0);
+
+            std::printf("%s, %zu threads: %.1f MB in %.2f ms, %.0f MB/s, %.2f M triangles/s, %u chunks, %u corners to %u vertices, %s\n",
+                path, threadPool.GetThreadCount(), megabytes, stats.m_Time * 1000.0, megabytes / stats.m_Time, stats.m_Triangles / stats.m_Time / 1e6,
+                stats.m_Chunks, stats.m_Corners, stats.m_Vertices, matchesSource(results[run]) ? "matches source" : "differs from source");
+        }
+
+        bool isIdentical = results[0].m_Indices == results[1].m_Indices && results[0].m_Vertices.size() == results[1].m_Vertices.size() &&
+            std::memcmp(results[0].m_Vertices.data(), results[1].m_Vertices.data(), results[0].m_Vertices.size() * sizeof(Vertex)) == 0;
+
+        const ImportedMaterial& material = results[1].m_Materials.front();
+        std::printf("  %s across thread counts, %zu subsets, material \"%s\" hardness %d\n", isIdentical ? "identical" : "different", results[1].m_Subsets.size(), material.m_Name.c_str(), material.m_SpecularHardness);
+    }
+
+    std::remove(objPath);
+    std::remove(glbPath);
+}
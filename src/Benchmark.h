@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <string>
+
+// Synthetic workloads timing CPU code paths without a window, selected with -benchmark <name>
+class Benchmark final
+{
+public:
+    // Returns false if there is no benchmark with this name. isPassed is cleared if a benchmark checking its
+    // results against a reference or documented bounds finds them off.
+    static bool Run(const std::string& name, bool& isPassed);
+
+private:
+    static void RunLighting();
+    static void RunClusters();
+    static bool RunPacking();
+    static bool RunSorting();
+    static void RunTransforms();
+    static void RunCulling();
+    static void RunHierarchy();
+    static void RunOcclusion();
+    static void RunLod();
+    static void RunOptimizer();
+    static void RunVertices();
+    static void RunIndices();
+    static void RunMeshlets();
+    static void RunMeshFile();
+    static void RunImport();
+};
@@ -0,0 +1,1028 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "BoundingVolumeHierarchy.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <cmath>
+#include <cassert>
+#include <xmmintrin.h>
+
+namespace
+{
+    const float s_Infinity = std::numeric_limits<float>::infinity();
+
+    BvhBounds GetEmptyBounds()
+    {
+        return { { s_Infinity, s_Infinity, s_Infinity }, { -s_Infinity, -s_Infinity, -s_Infinity } };
+    }
+
+    void Grow(BvhBounds& bounds, const BvhBounds& other)
+    {
+        bounds.m_Min.x = (std::min)(bounds.m_Min.x, other.m_Min.x);
+        bounds.m_Min.y = (std::min)(bounds.m_Min.y, other.m_Min.y);
+        bounds.m_Min.z = (std::min)(bounds.m_Min.z, other.m_Min.z);
+        bounds.m_Max.x = (std::max)(bounds.m_Max.x, other.m_Max.x);
+        bounds.m_Max.y = (std::max)(bounds.m_Max.y, other.m_Max.y);
+        bounds.m_Max.z = (std::max)(bounds.m_Max.z, other.m_Max.z);
+    }
+
+    float GetArea(const BvhBounds& bounds)
+    {
+        float x = bounds.m_Max.x - bounds.m_Min.x;
+        float y = bounds.m_Max.y - bounds.m_Min.y;
+        float z = bounds.m_Max.z - bounds.m_Min.z;
+
+        if (!(x >= 0.0f && y >= 0.0f && z >= 0.0f))
+            return 0.0f;
+
+        return 2.0f * (x * y + y * z + z * x);
+    }
+
+    // Doubled, min + max
+    float GetCentroid(const BvhBounds& bounds, UINT axis)
+    {
+        switch (axis)
+        {
+        case 0:
+            return bounds.m_Min.x + bounds.m_Max.x;
+        case 1:
+            return bounds.m_Min.y + bounds.m_Max.y;
+        default:
+            return bounds.m_Min.z + bounds.m_Max.z;
+        }
+    }
+
+    // Same expressions as the node test in CullFrustum(), on doubled centers and extents
+    bool IntersectsFrustum(const Frustum& frustum, const BvhBounds& bounds)
+    {
+        float centerX = bounds.m_Min.x + bounds.m_Max.x;
+        float centerY = bounds.m_Min.y + bounds.m_Max.y;
+        float centerZ = bounds.m_Min.z + bounds.m_Max.z;
+        float extentX = bounds.m_Max.x - bounds.m_Min.x;
+        float extentY = bounds.m_Max.y - bounds.m_Min.y;
+        float extentZ = bounds.m_Max.z - bounds.m_Min.z;
+
+        for (const DirectX::XMFLOAT4& plane : frustum.m_Planes)
+        {
+            float distance = ((plane.x * centerX + plane.y * centerY) + plane.z * centerZ) + 2.0f * plane.w;
+            float radius = (std::fabs(plane.x) * extentX + std::fabs(plane.y) * extentY) + std::fabs(plane.z) * extentZ;
+
+            if (distance + radius < 0.0f)
+                return false;
+        }
+
+        return true;
+    }
+
+    bool IntersectsSphere(const float sphere[4], const BvhBounds& bounds)
+    {
+        float x = (std::max)((std::max)(bounds.m_Min.x - sphere[0], sphere[0] - bounds.m_Max.x), 0.0f);
+        float y = (std::max)((std::max)(bounds.m_Min.y - sphere[1], sphere[1] - bounds.m_Max.y), 0.0f);
+        float z = (std::max)((std::max)(bounds.m_Min.z - sphere[2], sphere[2] - bounds.m_Max.z), 0.0f);
+
+        return (x * x + y * y) + z * z <= sphere[3] * sphere[3];
+    }
+
+    // Entry distance of the ray into the box, negative if it misses within maxDistance
+    float IntersectRay(const float origin[3], const float inverseDirection[3], float maxDistance, const BvhBounds& bounds)
+    {
+        float x1 = (bounds.m_Min.x - origin[0]) * inverseDirection[0];
+        float x2 = (bounds.m_Max.x - origin[0]) * inverseDirection[0];
+        float y1 = (bounds.m_Min.y - origin[1]) * inverseDirection[1];
+        float y2 = (bounds.m_Max.y - origin[1]) * inverseDirection[1];
+        float z1 = (bounds.m_Min.z - origin[2]) * inverseDirection[2];
+        float z2 = (bounds.m_Max.z - origin[2]) * inverseDirection[2];
+
+        float nearDistance = (std::max)((std::max)((std::min)(x1, x2), (std::min)(y1, y2)), (std::max)((std::min)(z1, z2), 0.0f));
+        float farDistance = (std::min)((std::min)((std::max)(x1, x2), (std::max)(y1, y2)), (std::min)((std::max)(z1, z2), maxDistance));
+
+        return nearDistance <= farDistance ? nearDistance : -1.0f;
+    }
+}
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy(ThreadPool& threadPool)
+    : m_ThreadPool(threadPool)
+{ }
+
+void BoundingVolumeHierarchy::Build(const std::vector<BvhBounds>& bounds)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    m_ObjectBounds = bounds;
+    Rebuild();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    m_Stats.m_BuildTime = elapsed.count();
+}
+
+UINT BoundingVolumeHierarchy::GetCount() const
+{
+    return static_cast<UINT>(m_ObjectBounds.size());
+}
+
+const BvhBounds& BoundingVolumeHierarchy::GetBounds(UINT object) const
+{
+    return m_ObjectBounds[object];
+}
+
+void BoundingVolumeHierarchy::Update(UINT object, const BvhBounds& bounds)
+{
+    m_ObjectBounds[object] = bounds;
+
+    if (!m_IsMoved[object])
+    {
+        m_IsMoved[object] = 1;
+        m_Moved.push_back(object);
+    }
+}
+
+void BoundingVolumeHierarchy::Refit()
+{
+    auto start = std::chrono::steady_clock::now();
+
+    m_Stats.m_RefitNodes = 0;
+    m_Stats.m_Rebuilds = 0;
+
+    // Leaves of moved objects and their ancestors, every node once
+    for (UINT object : m_Moved)
+    {
+        m_IsMoved[object] = 0;
+
+        for (UINT node = m_ObjectLocations[object] / 4; node != s_None && !m_IsNodeDirty[node];)
+        {
+            m_IsNodeDirty[node] = 1;
+            m_DirtyNodes.push_back(node);
+
+            UINT parent = m_NodeParents[node];
+            node = parent != s_None ? parent / 4 : s_None;
+        }
+    }
+
+    m_Moved.clear();
+
+    // Children are refitted before their parents, they always have larger indices
+    std::sort(m_DirtyNodes.begin(), m_DirtyNodes.end(), std::greater<UINT>());
+
+    for (UINT node : m_DirtyNodes)
+        RefitNode(node);
+
+    m_Stats.m_RefitNodes = static_cast<UINT>(m_DirtyNodes.size());
+    m_DirtyNodes.clear();
+
+    std::vector<UINT> degraded;
+    for (UINT subtree = 0; subtree < static_cast<UINT>(m_Subtrees.size()); subtree++)
+    {
+        if (m_Subtrees[subtree].m_Cost > s_RebuildRatio * m_Subtrees[subtree].m_BuildCost)
+            degraded.push_back(subtree);
+    }
+
+    // Splits between subtrees are only chosen by a full build, which also drops unused nodes
+    if (m_TopCost > s_RebuildRatio * m_TopBuildCost || m_UnusedNodes > m_Nodes.size() / 2)
+        Rebuild();
+    else if (!degraded.empty())
+        RebuildSubtrees(degraded);
+
+    double cost = m_TopCost;
+    double buildCost = m_TopBuildCost;
+
+    for (const Subtree& subtree : m_Subtrees)
+    {
+        cost += subtree.m_Cost;
+        buildCost += subtree.m_BuildCost;
+    }
+
+    m_Stats.m_Quality = buildCost > 0.0 ? static_cast<float>(cost / buildCost) : 1.0f;
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    m_Stats.m_RefitTime = elapsed.count();
+}
+
+void BoundingVolumeHierarchy::CullFrustum(const Frustum& frustum, std::vector<UINT>& visible)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    visible.clear();
+    UINT tested = 0;
+
+    if (m_Root != s_None)
+    {
+        // Distances are doubled along with centers and extents, so node boxes need no scaling
+        __m128 planes[6][4];
+        __m128 absolutePlanes[6][3];
+
+        for (UINT plane = 0; plane < 6; plane++)
+        {
+            const DirectX::XMFLOAT4& source = frustum.m_Planes[plane];
+
+            planes[plane][0] = _mm_set1_ps(source.x);
+            planes[plane][1] = _mm_set1_ps(source.y);
+            planes[plane][2] = _mm_set1_ps(source.z);
+            planes[plane][3] = _mm_set1_ps(2.0f * source.w);
+            absolutePlanes[plane][0] = _mm_set1_ps(std::fabs(source.x));
+            absolutePlanes[plane][1] = _mm_set1_ps(std::fabs(source.y));
+            absolutePlanes[plane][2] = _mm_set1_ps(std::fabs(source.z));
+        }
+
+        const __m128 zero = _mm_setzero_ps();
+
+        std::vector<UINT> stack;
+        stack.reserve(64);
+        stack.push_back(m_Root);
+
+        while (!stack.empty())
+        {
+            const Node& node = m_Nodes[stack.back()];
+            stack.pop_back();
+
+            __m128 minX = _mm_load_ps(node.m_MinX);
+            __m128 minY = _mm_load_ps(node.m_MinY);
+            __m128 minZ = _mm_load_ps(node.m_MinZ);
+            __m128 maxX = _mm_load_ps(node.m_MaxX);
+            __m128 maxY = _mm_load_ps(node.m_MaxY);
+            __m128 maxZ = _mm_load_ps(node.m_MaxZ);
+
+            __m128 centerX = _mm_add_ps(minX, maxX);
+            __m128 centerY = _mm_add_ps(minY, maxY);
+            __m128 centerZ = _mm_add_ps(minZ, maxZ);
+            __m128 extentX = _mm_sub_ps(maxX, minX);
+            __m128 extentY = _mm_sub_ps(maxY, minY);
+            __m128 extentZ = _mm_sub_ps(maxZ, minZ);
+
+            // Outside if behind any plane, inside if in front of all of them
+            __m128 outside = zero;
+            __m128 crossing = zero;
+
+            for (UINT plane = 0; plane < 6; plane++)
+            {
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+                    _mm_mul_ps(planes[plane][0], centerX),
+                    _mm_mul_ps(planes[plane][1], centerY)),
+                    _mm_mul_ps(planes[plane][2], centerZ)),
+                    planes[plane][3]);
+
+                __m128 radius = _mm_add_ps(_mm_add_ps(
+                    _mm_mul_ps(absolutePlanes[plane][0], extentX),
+                    _mm_mul_ps(absolutePlanes[plane][1], extentY)),
+                    _mm_mul_ps(absolutePlanes[plane][2], extentZ));
+
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+                crossing = _mm_or_ps(crossing, _mm_cmplt_ps(_mm_sub_ps(distance, radius), zero));
+            }
+
+            int outsideMask = _mm_movemask_ps(outside);
+            int crossingMask = _mm_movemask_ps(crossing);
+            tested += 4;
+
+            for (UINT slot = 0; slot < 4; slot++)
+            {
+                UINT child = node.m_Children[slot];
+
+                if (child == s_Empty || (outsideMask >> slot) & 1)
+                    continue;
+
+                bool isInside = ((crossingMask >> slot) & 1) == 0;
+
+                if (isInside)
+                {
+                    CollectObjects(child, visible);
+                }
+                else if (child & s_Leaf)
+                {
+                    UINT first = (child & ~s_Leaf) >> 3;
+                    UINT count = (child & 7) + 1;
+
+                    for (UINT reference = first; reference < first + count; reference++)
+                    {
+                        UINT object = m_References[reference];
+
+                        if (IntersectsFrustum(frustum, m_ObjectBounds[object]))
+                            visible.push_back(object);
+                    }
+
+                    tested += count;
+                }
+                else
+                {
+                    stack.push_back(child);
+                }
+            }
+        }
+    }
+
+    m_CullingStats.m_Tested = tested;
+    m_CullingStats.m_Visible = static_cast<UINT>(visible.size());
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    m_CullingStats.m_Time = elapsed.count();
+}
+
+void BoundingVolumeHierarchy::QuerySphere(const DirectX::XMVECTOR& sphere, std::vector<UINT>& objects) const
+{
+    objects.clear();
+
+    if (m_Root == s_None)
+        return;
+
+    float center[4];
+    DirectX::XMStoreFloat4(reinterpret_cast<DirectX::XMFLOAT4*>(center), sphere);
+
+    const __m128 centerX = _mm_set1_ps(center[0]);
+    const __m128 centerY = _mm_set1_ps(center[1]);
+    const __m128 centerZ = _mm_set1_ps(center[2]);
+    const __m128 radiusSquare = _mm_set1_ps(center[3] * center[3]);
+    const __m128 zero = _mm_setzero_ps();
+
+    std::vector<UINT> stack;
+    stack.reserve(64);
+    stack.push_back(m_Root);
+
+    while (!stack.empty())
+    {
+        const Node& node = m_Nodes[stack.back()];
+        stack.pop_back();
+
+        // Distance from the center to the closest point of every box
+        __m128 x = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(node.m_MinX), centerX), _mm_sub_ps(centerX, _mm_load_ps(node.m_MaxX))), zero);
+        __m128 y = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(node.m_MinY), centerY), _mm_sub_ps(centerY, _mm_load_ps(node.m_MaxY))), zero);
+        __m128 z = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(node.m_MinZ), centerZ), _mm_sub_ps(centerZ, _mm_load_ps(node.m_MaxZ))), zero);
+
+        __m128 distanceSquare = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+        int hitMask = _mm_movemask_ps(_mm_cmple_ps(distanceSquare, radiusSquare));
+
+        for (UINT slot = 0; slot < 4; slot++)
+        {
+            UINT child = node.m_Children[slot];
+
+            if (child == s_Empty || ((hitMask >> slot) & 1) == 0)
+                continue;
+
+            if (child & s_Leaf)
+            {
+                UINT first = (child & ~s_Leaf) >> 3;
+                UINT count = (child & 7) + 1;
+
+                for (UINT reference = first; reference < first + count; reference++)
+                {
+                    UINT object = m_References[reference];
+
+                    if (IntersectsSphere(center, m_ObjectBounds[object]))
+                        objects.push_back(object);
+                }
+            }
+            else
+            {
+                stack.push_back(child);
+            }
+        }
+    }
+}
+
+bool BoundingVolumeHierarchy::CastRay(const DirectX::XMVECTOR& origin, const DirectX::XMVECTOR& direction, float maxDistance, RayHit& hit) const
+{
+    if (m_Root == s_None)
+        return false;
+
+    DirectX::XMFLOAT3 rayOrigin;
+    DirectX::XMFLOAT3 rayDirection;
+    DirectX::XMStoreFloat3(&rayOrigin, origin);
+    DirectX::XMStoreFloat3(&rayDirection, DirectX::XMVector3Normalize(direction));
+
+    // Axis parallel rays get infinite slab distances
+    const float originValues[3] = { rayOrigin.x, rayOrigin.y, rayOrigin.z };
+    const float inverseDirection[3] = { 1.0f / rayDirection.x, 1.0f / rayDirection.y, 1.0f / rayDirection.z };
+
+    const __m128 originX = _mm_set1_ps(originValues[0]);
+    const __m128 originY = _mm_set1_ps(originValues[1]);
+    const __m128 originZ = _mm_set1_ps(originValues[2]);
+    const __m128 inverseX = _mm_set1_ps(inverseDirection[0]);
+    const __m128 inverseY = _mm_set1_ps(inverseDirection[1]);
+    const __m128 inverseZ = _mm_set1_ps(inverseDirection[2]);
+    const __m128 zero = _mm_setzero_ps();
+
+    float nearest = maxDistance;
+    bool isHit = false;
+
+    // Nodes with the distance the ray enters them, nearer children are popped first
+    std::vector<std::pair<UINT, float>> stack;
+    stack.reserve(64);
+    stack.push_back({ m_Root, 0.0f });
+
+    while (!stack.empty())
+    {
+        std::pair<UINT, float> entry = stack.back();
+        stack.pop_back();
+
+        if (entry.second > nearest)
+            continue;
+
+        const Node& node = m_Nodes[entry.first];
+
+        __m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.m_MinX), originX), inverseX);
+        __m128 x2 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.m_MaxX), originX), inverseX);
+        __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.m_MinY), originY), inverseY);
+        __m128 y2 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.m_MaxY), originY), inverseY);
+        __m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.m_MinZ), originZ), inverseZ);
+        __m128 z2 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.m_MaxZ), originZ), inverseZ);
+
+        __m128 nearDistance = _mm_max_ps(_mm_max_ps(_mm_min_ps(x1, x2), _mm_min_ps(y1, y2)), _mm_max_ps(_mm_min_ps(z1, z2), zero));
+        __m128 farDistance = _mm_min_ps(_mm_min_ps(_mm_max_ps(x1, x2), _mm_max_ps(y1, y2)), _mm_min_ps(_mm_max_ps(z1, z2), _mm_set1_ps(nearest)));
+
+        int hitMask = _mm_movemask_ps(_mm_cmple_ps(nearDistance, farDistance));
+
+        alignas(16) float nearDistances[4];
+        _mm_store_ps(nearDistances, nearDistance);
+
+        std::pair<UINT, float> children[4];
+        UINT childCount = 0;
+
+        for (UINT slot = 0; slot < 4; slot++)
+        {
+            UINT child = node.m_Children[slot];
+
+            if (child == s_Empty || ((hitMask >> slot) & 1) == 0)
+                continue;
+
+            if (child & s_Leaf)
+            {
+                UINT first = (child & ~s_Leaf) >> 3;
+                UINT count = (child & 7) + 1;
+
+                for (UINT reference = first; reference < first + count; reference++)
+                {
+                    UINT object = m_References[reference];
+                    float distance = IntersectRay(originValues, inverseDirection, nearest, m_ObjectBounds[object]);
+
+                    if (distance >= 0.0f)
+                    {
+                        nearest = distance;
+                        hit = { object, distance };
+                        isHit = true;
+                    }
+                }
+            }
+            else
+            {
+                children[childCount++] = { child, nearDistances[slot] };
+            }
+        }
+
+        std::sort(children, children + childCount, [](const std::pair<UINT, float>& a, const std::pair<UINT, float>& b)
+        {
+            return a.second > b.second;
+        });
+
+        stack.insert(stack.end(), children, children + childCount);
+    }
+
+    return isHit;
+}
+
+const BvhStats& BoundingVolumeHierarchy::GetStats() const
+{
+    return m_Stats;
+}
+
+const CullingStats& BoundingVolumeHierarchy::GetCullingStats() const
+{
+    return m_CullingStats;
+}
+
+BvhBounds BoundingVolumeHierarchy::GetSlotBounds(const Node& node, UINT slot)
+{
+    return { { node.m_MinX[slot], node.m_MinY[slot], node.m_MinZ[slot] }, { node.m_MaxX[slot], node.m_MaxY[slot], node.m_MaxZ[slot] } };
+}
+
+void BoundingVolumeHierarchy::SetSlotBounds(Node& node, UINT slot, const BvhBounds& bounds)
+{
+    node.m_MinX[slot] = bounds.m_Min.x;
+    node.m_MinY[slot] = bounds.m_Min.y;
+    node.m_MinZ[slot] = bounds.m_Min.z;
+    node.m_MaxX[slot] = bounds.m_Max.x;
+    node.m_MaxY[slot] = bounds.m_Max.y;
+    node.m_MaxZ[slot] = bounds.m_Max.z;
+}
+
+void BoundingVolumeHierarchy::Rebuild()
+{
+    UINT count = static_cast<UINT>(m_ObjectBounds.size());
+    assert(count < (1u << 28)); // Leaf children hold the first object in 28 bits
+
+    m_References.resize(count);
+    m_BuildItems.resize(count);
+
+    for (UINT object = 0; object < count; object++)
+        m_BuildItems[object] = { m_ObjectBounds[object], object };
+
+    m_ObjectLocations.assign(count, s_None);
+    m_IsMoved.assign(count, 0);
+    m_Moved.clear();
+
+    m_Subtrees.clear();
+    m_UnusedNodes = 0;
+    m_Root = count > 0 ? 0 : s_None;
+
+    // Top levels are split serially down to subtree size, small trees are a single subtree
+    NodeList top;
+
+    if (count > s_SubtreeSize)
+        BuildNode(0, count, GetItemBounds(0, count), s_None, top, &m_Subtrees);
+    else if (count > 0)
+        m_Subtrees.push_back({ 0, count, GetItemBounds(0, count), 0, 0, s_None });
+
+    std::vector<NodeList> lists(m_Subtrees.size());
+
+    m_ThreadPool.ParallelFor(m_Subtrees.size(), [&](size_t index)
+    {
+        const Subtree& subtree = m_Subtrees[index];
+        BuildNode(subtree.m_FirstObject, subtree.m_ObjectCount, subtree.m_Bounds, s_None, lists[index], nullptr);
+    });
+
+    for (UINT reference = 0; reference < count; reference++)
+        m_References[reference] = m_BuildItems[reference].m_Object;
+
+    // Subtrees follow the top level nodes in task order
+    UINT topCount = static_cast<UINT>(top.m_Nodes.size());
+    UINT nodeCount = topCount;
+
+    std::vector<UINT> firstNodes(m_Subtrees.size());
+    for (size_t subtree = 0; subtree < m_Subtrees.size(); subtree++)
+    {
+        firstNodes[subtree] = nodeCount;
+        nodeCount += static_cast<UINT>(lists[subtree].m_Nodes.size());
+    }
+
+    m_Nodes = std::move(top.m_Nodes);
+    m_Nodes.resize(nodeCount);
+    m_NodeParents = std::move(top.m_Parents);
+    m_NodeParents.resize(nodeCount);
+    m_NodeSubtrees.assign(nodeCount, s_None);
+    m_NodeCosts.assign(nodeCount, 0.0f);
+    m_IsNodeDirty.assign(nodeCount, 0);
+
+    m_ThreadPool.ParallelFor(m_Subtrees.size(), [&](size_t subtree)
+    {
+        PlaceSubtree(static_cast<UINT>(subtree), lists[subtree], firstNodes[subtree]);
+    });
+
+    m_TopCost = 0.0;
+
+    for (UINT node = 0; node < topCount; node++)
+    {
+        m_NodeCosts[node] = GetNodeCost(node);
+        m_TopCost += m_NodeCosts[node];
+        SetLeafLocations(node);
+    }
+
+    m_TopBuildCost = m_TopCost;
+
+    m_Stats.m_Nodes = nodeCount;
+    m_Stats.m_Rebuilds = static_cast<UINT>(m_Subtrees.size());
+    m_Stats.m_Quality = 1.0f;
+}
+
+UINT BoundingVolumeHierarchy::BuildNode(UINT first, UINT count, const BvhBounds& bounds, UINT parent, NodeList& nodes, std::vector<Subtree>* subtrees)
+{
+    UINT node = static_cast<UINT>(nodes.m_Nodes.size());
+    nodes.m_Nodes.emplace_back();
+    nodes.m_Parents.push_back(parent);
+
+    // The range with the largest box is split until there are four or all of them fit in leaves
+    struct Range
+    {
+        UINT m_First;
+        UINT m_Count;
+        BvhBounds m_Bounds;
+    };
+
+    Range ranges[4]{ { first, count, bounds } };
+    UINT rangeCount = 1;
+
+    while (rangeCount < 4)
+    {
+        UINT largest = s_None;
+        float largestArea = -1.0f;
+
+        for (UINT range = 0; range < rangeCount; range++)
+        {
+            float area = GetArea(ranges[range].m_Bounds);
+
+            if (ranges[range].m_Count > s_LeafSize && area > largestArea)
+            {
+                largest = range;
+                largestArea = area;
+            }
+        }
+
+        if (largest == s_None)
+            break;
+
+        Range& left = ranges[largest];
+        Range& right = ranges[rangeCount++];
+
+        UINT leftCount = Split(left.m_First, left.m_Count, left.m_Bounds, right.m_Bounds);
+
+        right.m_First = left.m_First + leftCount;
+        right.m_Count = left.m_Count - leftCount;
+        left.m_Count = leftCount;
+    }
+
+    for (UINT slot = 0; slot < 4; slot++)
+    {
+        UINT child = s_Empty;
+        BvhBounds slotBounds = GetEmptyBounds();
+
+        if (slot < rangeCount)
+        {
+            const Range& range = ranges[slot];
+            slotBounds = range.m_Bounds;
+
+            if (range.m_Count <= s_LeafSize)
+                child = s_Leaf | range.m_First << 3 | (range.m_Count - 1);
+            else if (subtrees != nullptr && range.m_Count <= s_SubtreeSize)
+                subtrees->push_back({ range.m_First, range.m_Count, range.m_Bounds, 0, 0, node * 4 + slot }); // Linked once placed
+            else
+                child = BuildNode(range.m_First, range.m_Count, range.m_Bounds, node * 4 + slot, nodes, subtrees);
+        }
+
+        // Not kept as a reference, recursion may have moved the nodes
+        SetSlotBounds(nodes.m_Nodes[node], slot, slotBounds);
+        nodes.m_Nodes[node].m_Children[slot] = child;
+    }
+
+    return node;
+}
+
+UINT BoundingVolumeHierarchy::Split(UINT first, UINT count, BvhBounds& leftBounds, BvhBounds& rightBounds)
+{
+    BuildItem* items = m_BuildItems.data() + first;
+
+    float centroidMin[3] = { s_Infinity, s_Infinity, s_Infinity };
+    float centroidMax[3] = { -s_Infinity, -s_Infinity, -s_Infinity };
+
+    for (UINT reference = 0; reference < count; reference++)
+    {
+        const BvhBounds& bounds = items[reference].m_Bounds;
+
+        for (UINT axis = 0; axis < 3; axis++)
+        {
+            float centroid = GetCentroid(bounds, axis);
+            centroidMin[axis] = (std::min)(centroidMin[axis], centroid);
+            centroidMax[axis] = (std::max)(centroidMax[axis], centroid);
+        }
+    }
+
+    // Binned SAH: boundaries between bins of centroids along every axis are the candidates,
+    // all three axes are binned in one pass over the objects
+    struct Bin
+    {
+        BvhBounds m_Bounds;
+        UINT m_Count;
+    };
+
+    Bin bins[3][s_Bins];
+    float scales[3];
+
+    for (UINT axis = 0; axis < 3; axis++)
+    {
+        float extent = centroidMax[axis] - centroidMin[axis];
+        scales[axis] = extent > 0.0f ? s_Bins / extent : 0.0f;
+
+        for (Bin& bin : bins[axis])
+            bin = { GetEmptyBounds(), 0 };
+    }
+
+    auto getBin = [&](const BvhBounds& bounds, UINT axis)
+    {
+        float offset = (GetCentroid(bounds, axis) - centroidMin[axis]) * scales[axis];
+        return (std::min)(static_cast<UINT>(offset), s_Bins - 1);
+    };
+
+    for (UINT reference = 0; reference < count; reference++)
+    {
+        const BvhBounds& bounds = items[reference].m_Bounds;
+
+        for (UINT axis = 0; axis < 3; axis++)
+        {
+            Bin& bin = bins[axis][getBin(bounds, axis)];
+            Grow(bin.m_Bounds, bounds);
+            bin.m_Count++;
+        }
+    }
+
+    float bestCost = s_Infinity;
+    UINT bestAxis = 0;
+    UINT bestBin = 0;
+
+    for (UINT axis = 0; axis < 3; axis++)
+    {
+        if (scales[axis] == 0.0f)
+            continue;
+
+        // Right side costs swept from the end, left side ones from the start
+        float rightCosts[s_Bins]{ };
+        BvhBounds right = GetEmptyBounds();
+        UINT rightCount = 0;
+
+        for (UINT bin = s_Bins - 1; bin > 0; bin--)
+        {
+            Grow(right, bins[axis][bin].m_Bounds);
+            rightCount += bins[axis][bin].m_Count;
+            rightCosts[bin] = GetArea(right) * rightCount;
+        }
+
+        BvhBounds left = GetEmptyBounds();
+        UINT leftCount = 0;
+
+        for (UINT bin = 1; bin < s_Bins; bin++)
+        {
+            Grow(left, bins[axis][bin - 1].m_Bounds);
+            leftCount += bins[axis][bin - 1].m_Count;
+
+            float cost = GetArea(left) * leftCount + rightCosts[bin];
+
+            if (leftCount > 0 && leftCount < count && cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = bin;
+            }
+        }
+    }
+
+    if (bestCost < s_Infinity)
+    {
+        leftBounds = GetEmptyBounds();
+        rightBounds = GetEmptyBounds();
+
+        for (UINT bin = 0; bin < s_Bins; bin++)
+            Grow(bin < bestBin ? leftBounds : rightBounds, bins[bestAxis][bin].m_Bounds);
+
+        BuildItem* middle = std::partition(items, items + count, [&](const BuildItem& item)
+        {
+            return getBin(item.m_Bounds, bestAxis) < bestBin;
+        });
+
+        return static_cast<UINT>(middle - items);
+    }
+
+    // Coincident centroids, any halving is as good as another
+    UINT axis = 0;
+    for (UINT candidate = 1; candidate < 3; candidate++)
+    {
+        if (centroidMax[candidate] - centroidMin[candidate] > centroidMax[axis] - centroidMin[axis])
+            axis = candidate;
+    }
+
+    std::nth_element(items, items + count / 2, items + count, [&](const BuildItem& a, const BuildItem& b)
+    {
+        return GetCentroid(a.m_Bounds, axis) < GetCentroid(b.m_Bounds, axis);
+    });
+
+    leftBounds = GetItemBounds(first, count / 2);
+    rightBounds = GetItemBounds(first + count / 2, count - count / 2);
+
+    return count / 2;
+}
+
+BvhBounds BoundingVolumeHierarchy::GetItemBounds(UINT first, UINT count) const
+{
+    BvhBounds bounds = GetEmptyBounds();
+
+    for (UINT item = first; item < first + count; item++)
+        Grow(bounds, m_BuildItems[item].m_Bounds);
+
+    return bounds;
+}
+
+BvhBounds BoundingVolumeHierarchy::GetRangeBounds(UINT first, UINT count) const
+{
+    BvhBounds bounds = GetEmptyBounds();
+
+    for (UINT reference = first; reference < first + count; reference++)
+        Grow(bounds, m_ObjectBounds[m_References[reference]]);
+
+    return bounds;
+}
+
+void BoundingVolumeHierarchy::PlaceSubtree(UINT subtree, const NodeList& nodes, UINT firstNode)
+{
+    Subtree& placed = m_Subtrees[subtree];
+    placed.m_FirstNode = firstNode;
+    placed.m_NodeCount = static_cast<UINT>(nodes.m_Nodes.size());
+    placed.m_Cost = 0.0;
+
+    for (UINT local = 0; local < placed.m_NodeCount; local++)
+    {
+        UINT node = firstNode + local;
+        m_Nodes[node] = nodes.m_Nodes[local];
+
+        for (UINT& child : m_Nodes[node].m_Children)
+        {
+            if (child != s_Empty && (child & s_Leaf) == 0)
+                child += firstNode;
+        }
+
+        UINT parent = nodes.m_Parents[local];
+        m_NodeParents[node] = parent != s_None ? parent + firstNode * 4 : placed.m_Parent;
+        m_NodeSubtrees[node] = subtree;
+        m_NodeCosts[node] = GetNodeCost(node);
+        m_IsNodeDirty[node] = 0;
+
+        placed.m_Cost += m_NodeCosts[node];
+        SetLeafLocations(node);
+    }
+
+    placed.m_BuildCost = placed.m_Cost;
+
+    if (placed.m_Parent != s_None)
+        m_Nodes[placed.m_Parent / 4].m_Children[placed.m_Parent % 4] = firstNode;
+    else
+        m_Root = firstNode;
+}
+
+void BoundingVolumeHierarchy::RebuildSubtrees(const std::vector<UINT>& subtrees)
+{
+    std::vector<NodeList> lists(subtrees.size());
+
+    m_BuildItems.resize(m_References.size());
+
+    m_ThreadPool.ParallelFor(subtrees.size(), [&](size_t index)
+    {
+        const Subtree& subtree = m_Subtrees[subtrees[index]];
+        UINT first = subtree.m_FirstObject;
+        UINT last = first + subtree.m_ObjectCount;
+
+        for (UINT reference = first; reference < last; reference++)
+            m_BuildItems[reference] = { m_ObjectBounds[m_References[reference]], m_References[reference] };
+
+        BuildNode(first, subtree.m_ObjectCount, GetItemBounds(first, subtree.m_ObjectCount), s_None, lists[index], nullptr);
+
+        for (UINT reference = first; reference < last; reference++)
+            m_References[reference] = m_BuildItems[reference].m_Object;
+    });
+
+    // In place if the new nodes fit, appended otherwise. What is left of the old range stays unused.
+    std::vector<UINT> firstNodes(subtrees.size());
+
+    for (size_t index = 0; index < subtrees.size(); index++)
+    {
+        const Subtree& subtree = m_Subtrees[subtrees[index]];
+        UINT nodeCount = static_cast<UINT>(lists[index].m_Nodes.size());
+
+        if (nodeCount <= subtree.m_NodeCount)
+        {
+            firstNodes[index] = subtree.m_FirstNode;
+            m_UnusedNodes += subtree.m_NodeCount - nodeCount;
+        }
+        else
+        {
+            firstNodes[index] = static_cast<UINT>(m_Nodes.size());
+            m_UnusedNodes += subtree.m_NodeCount;
+
+            size_t size = m_Nodes.size() + nodeCount;
+            m_Nodes.resize(size);
+            m_NodeParents.resize(size);
+            m_NodeSubtrees.resize(size);
+            m_NodeCosts.resize(size);
+            m_IsNodeDirty.resize(size);
+        }
+    }
+
+    m_ThreadPool.ParallelFor(subtrees.size(), [&](size_t index)
+    {
+        PlaceSubtree(subtrees[index], lists[index], firstNodes[index]);
+    });
+
+    m_Stats.m_Nodes = static_cast<UINT>(m_Nodes.size()) - m_UnusedNodes;
+    m_Stats.m_Rebuilds = static_cast<UINT>(subtrees.size());
+}
+
+void BoundingVolumeHierarchy::RefitNode(UINT node)
+{
+    Node& refitted = m_Nodes[node];
+
+    for (UINT slot = 0; slot < 4; slot++)
+    {
+        UINT child = refitted.m_Children[slot];
+
+        if (child == s_Empty)
+            continue;
+
+        BvhBounds bounds = GetEmptyBounds();
+
+        if (child & s_Leaf)
+        {
+            UINT first = (child & ~s_Leaf) >> 3;
+            UINT count = (child & 7) + 1;
+
+            bounds = GetRangeBounds(first, count);
+        }
+        else
+        {
+            for (UINT childSlot = 0; childSlot < 4; childSlot++)
+            {
+                if (m_Nodes[child].m_Children[childSlot] != s_Empty)
+                    Grow(bounds, GetSlotBounds(m_Nodes[child], childSlot));
+            }
+        }
+
+        SetSlotBounds(refitted, slot, bounds);
+    }
+
+    float cost = GetNodeCost(node);
+    double difference = static_cast<double>(cost) - m_NodeCosts[node];
+    m_NodeCosts[node] = cost;
+
+    if (m_NodeSubtrees[node] != s_None)
+        m_Subtrees[m_NodeSubtrees[node]].m_Cost += difference;
+    else
+        m_TopCost += difference;
+
+    m_IsNodeDirty[node] = 0;
+}
+
+float BoundingVolumeHierarchy::GetNodeCost(UINT node) const
+{
+    const Node& costed = m_Nodes[node];
+    float cost = 0.0f;
+
+    for (UINT slot = 0; slot < 4; slot++)
+    {
+        UINT child = costed.m_Children[slot];
+
+        if (child == s_Empty)
+            continue;
+
+        float weight = child & s_Leaf ? static_cast<float>((child & 7) + 1) : 1.0f;
+        cost += GetArea(GetSlotBounds(costed, slot)) * weight;
+    }
+
+    return cost;
+}
+
+void BoundingVolumeHierarchy::SetLeafLocations(UINT node)
+{
+    for (UINT slot = 0; slot < 4; slot++)
+    {
+        UINT child = m_Nodes[node].m_Children[slot];
+
+        if (child == s_Empty || (child & s_Leaf) == 0)
+            continue;
+
+        UINT first = (child & ~s_Leaf) >> 3;
+        UINT count = (child & 7) + 1;
+
+        for (UINT reference = first; reference < first + count; reference++)
+            m_ObjectLocations[m_References[reference]] = node * 4 + slot;
+    }
+}
+
+void BoundingVolumeHierarchy::CollectObjects(UINT child, std::vector<UINT>& objects) const
+{
+    std::vector<UINT> stack{ child };
+
+    while (!stack.empty())
+    {
+        UINT next = stack.back();
+        stack.pop_back();
+
+        if (next & s_Leaf)
+        {
+            UINT first = (next & ~s_Leaf) >> 3;
+            UINT count = (next & 7) + 1;
+
+            objects.insert(objects.end(), m_References.begin() + first, m_References.begin() + first + count);
+            continue;
+        }
+
+        for (UINT grandchild : m_Nodes[next].m_Children)
+        {
+            if (grandchild != s_Empty)
+                stack.push_back(grandchild);
+        }
+    }
+}
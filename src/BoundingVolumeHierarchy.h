@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "Camera.h"
+#include "FrustumCulling.h"
+#include <windows.h>
+#include <DirectXMath.h>
+#include <vector>
+
+class ThreadPool;
+
+struct BvhBounds final
+{
+    DirectX::XMFLOAT3 m_Min;
+    DirectX::XMFLOAT3 m_Max;
+};
+
+struct BvhStats final
+{
+    UINT m_Nodes{ 0 };         // Reachable from the root
+    UINT m_RefitNodes{ 0 };    // Of the last Refit()
+    UINT m_Rebuilds{ 0 };      // Subtrees rebuilt by the last Refit(), all of them on a full rebuild
+    float m_Quality{ 1.0f };   // SAH cost relative to the cost right after the nodes were built
+    double m_BuildTime{ 0.0 }; // Seconds, of the last Build()
+    double m_RefitTime{ 0.0 }; // Seconds, of the last Refit() including rebuilds
+};
+
+struct RayHit final
+{
+    UINT m_Object{ 0 };
+    float m_Distance{ 0.0f }; // To the object box, zero if the ray starts inside
+};
+
+// Spatial index over object boxes with four children per node. Child boxes of a node are kept as separate
+// coordinate arrays, one SSE instruction tests a query against all four. Nodes are built top down with
+// binned SAH splits, the top levels serially and subtrees of up to s_SubtreeSize objects as thread pool
+// tasks, every subtree owning contiguous ranges of nodes and objects. Moved objects refit boxes on their
+// path to the root only. Refits loosen the boxes over time: a subtree whose SAH cost grew by s_RebuildRatio
+// is rebuilt from its objects, the whole tree once the top levels did.
+class BoundingVolumeHierarchy final
+{
+public:
+    static constexpr UINT s_LeafSize = 4;         // Objects per leaf at most
+    static constexpr UINT s_Bins = 16;            // Split candidates per axis
+    static constexpr UINT s_SubtreeSize = 4096;   // Objects per build task at most
+    static constexpr float s_RebuildRatio = 1.5f;
+
+    BoundingVolumeHierarchy(ThreadPool& threadPool);
+
+    // Object ids are indices into bounds
+    void Build(const std::vector<BvhBounds>& bounds);
+    UINT GetCount() const;
+
+    // Moves take effect on Refit()
+    const BvhBounds& GetBounds(UINT object) const;
+    void Update(UINT object, const BvhBounds& bounds);
+    void Refit();
+
+    // Objects whose boxes intersect the query, in no particular order
+    void CullFrustum(const Frustum& frustum, std::vector<UINT>& visible);
+    void QuerySphere(const DirectX::XMVECTOR& sphere, std::vector<UINT>& objects) const; // Center in xyz, radius in w
+
+    // Nearest object box hit within maxDistance along the ray, distances are in world units
+    bool CastRay(const DirectX::XMVECTOR& origin, const DirectX::XMVECTOR& direction, float maxDistance, RayHit& hit) const;
+
+    const BvhStats& GetStats() const;
+    const CullingStats& GetCullingStats() const; // Of the last CullFrustum(), boxes of nodes and objects tested
+
+private:
+    // Child is a node index, a leaf (s_Leaf | first object << 3 | object count - 1) or s_Empty
+    struct alignas(16) Node
+    {
+        float m_MinX[4];
+        float m_MinY[4];
+        float m_MinZ[4];
+        float m_MaxX[4];
+        float m_MaxY[4];
+        float m_MaxZ[4];
+        UINT m_Children[4];
+    };
+
+    // Nodes built by one task, indices are relative to the first one until placed
+    struct NodeList
+    {
+        std::vector<Node> m_Nodes;
+        std::vector<UINT> m_Parents; // Node * 4 + slot, s_None for the first node
+    };
+
+    // Objects are partitioned with their boxes while building, for sequential access
+    struct BuildItem
+    {
+        BvhBounds m_Bounds;
+        UINT m_Object;
+    };
+
+    struct Subtree
+    {
+        UINT m_FirstObject;
+        UINT m_ObjectCount;
+        BvhBounds m_Bounds;
+        UINT m_FirstNode;
+        UINT m_NodeCount;
+        UINT m_Parent;           // Top level node * 4 + slot pointing to the subtree, s_None if it is the whole tree
+        double m_Cost{ 0.0 };
+        double m_BuildCost{ 0.0 };
+    };
+
+    static constexpr UINT s_None = ~0u;
+    static constexpr UINT s_Empty = ~0u;
+    static constexpr UINT s_Leaf = 0x80000000;
+
+    static BvhBounds GetSlotBounds(const Node& node, UINT slot);
+    static void SetSlotBounds(Node& node, UINT slot, const BvhBounds& bounds);
+
+    void Rebuild();
+    UINT BuildNode(UINT first, UINT count, const BvhBounds& bounds, UINT parent, NodeList& nodes, std::vector<Subtree>* subtrees);
+    UINT Split(UINT first, UINT count, BvhBounds& leftBounds, BvhBounds& rightBounds); // Returns the left count
+    BvhBounds GetItemBounds(UINT first, UINT count) const;
+    BvhBounds GetRangeBounds(UINT first, UINT count) const;
+    void PlaceSubtree(UINT subtree, const NodeList& nodes, UINT firstNode);
+    void RebuildSubtrees(const std::vector<UINT>& subtrees);
+
+    void RefitNode(UINT node);
+    float GetNodeCost(UINT node) const;
+    void SetLeafLocations(UINT node);
+    void CollectObjects(UINT child, std::vector<UINT>& objects) const; // Every object below a node child
+
+    ThreadPool& m_ThreadPool;
+    BvhStats m_Stats;
+    CullingStats m_CullingStats;
+
+    std::vector<BvhBounds> m_ObjectBounds;
+    std::vector<UINT> m_References;      // Object ids in leaf order
+    std::vector<UINT> m_ObjectLocations; // Leaf of every object as node * 4 + slot
+    std::vector<BuildItem> m_BuildItems; // In the order of m_References
+
+    std::vector<Node> m_Nodes; // Top level nodes first, parents always precede their children
+    UINT m_Root{ s_None };
+    std::vector<UINT> m_NodeParents;
+    std::vector<UINT> m_NodeSubtrees; // s_None for top level nodes
+    std::vector<float> m_NodeCosts;   // Child box areas, leaves weighted by their object count
+    std::vector<BYTE> m_IsNodeDirty;
+    UINT m_UnusedNodes{ 0 };          // Left behind by rebuilt subtrees
+
+    std::vector<Subtree> m_Subtrees;
+    double m_TopCost{ 0.0 };
+    double m_TopBuildCost{ 0.0 };
+
+    std::vector<UINT> m_Moved;
+    std::vector<BYTE> m_IsMoved;
+    std::vector<UINT> m_DirtyNodes;
+};
@@ -23,10 +23,14 @@
 #pragma once
 
 #include "Resource.h"
+#include "Backend.h"
+#include "CommandBuffer.h"
 #include <d3d11.h>
 #include <wrl/client.h>
 #include <windows.h>
+#include <algorithm>
 #include <memory>
+#include <vector>
 #include <cassert>
 
 class DX11Device;
@@ -37,16 +41,23 @@ enum ResourceInput
     INPUT_PIXEL_SHADER  = (1 << 1)
 };
 
+enum class ConstantUsage
+{
+    Static, // Updated now and then, contents persist across frames
+    Frame   // Updated every frame it is bound in, suballocated from the device's constant ring
+};
+
 template <typename T>
 class ConstantBuffer final : public DX11Resource
 {
 public:
-    ConstantBuffer(DX11Device& device, UINT slot, ResourceInput input)
+    ConstantBuffer(DX11Device& device, UINT slot, ResourceInput input, ConstantUsage usage = ConstantUsage::Static)
         : DX11Resource(device)
         , m_ResourceSlot(slot)
         , m_ResourceInput(input)
+        , m_Usage(usage)
     {
-        ID3D11Device& deviceHandle = m_Device.GetHandle();
+        Backend& backend = m_Device.GetBackend();
 
         {
             D3D11_BUFFER_DESC desc{ };
@@ -55,57 +66,239 @@ public:
             desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
             desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 
-            HRESULT hr = deviceHandle.CreateBuffer(&desc, nullptr, &m_ConstantBuffer);
+            HRESULT hr = backend.CreateBuffer(&desc, nullptr, &m_ConstantBuffer);
             assert(SUCCEEDED(hr));
         }
     }
 
     void Enable() override
     {
-        ID3D11DeviceContext& deviceContext = m_Device.GetContext();
+        CommandBuffer& commandBuffer = m_Device.GetCommandBuffer();
 
         {
-            ID3D11Buffer* buffers[] = { m_ConstantBuffer.Get() };
-
             if (m_ResourceInput & INPUT_VERTEX_SHADER)
-                deviceContext.VSSetConstantBuffers(m_ResourceSlot, 1, buffers);
+                commandBuffer.SetVertexConstantBuffer(m_ResourceSlot, m_ConstantBuffer.Get());
 
             if (m_ResourceInput & INPUT_PIXEL_SHADER)
-                deviceContext.PSSetConstantBuffers(m_ResourceSlot, 1, buffers);
+                commandBuffer.SetPixelConstantBuffer(m_ResourceSlot, m_ConstantBuffer.Get());
         }
     }
 
     void Disable() override
     {
-        ID3D11DeviceContext& deviceContext = m_Device.GetContext();
+        CommandBuffer& commandBuffer = m_Device.GetCommandBuffer();
 
         {
-            ID3D11Buffer* buffers[] = { nullptr };
-
             if (m_ResourceInput & INPUT_VERTEX_SHADER)
-                deviceContext.VSSetConstantBuffers(m_ResourceSlot, 1, buffers);
+                commandBuffer.SetVertexConstantBuffer(m_ResourceSlot, nullptr);
 
             if (m_ResourceInput & INPUT_PIXEL_SHADER)
-                deviceContext.PSSetConstantBuffers(m_ResourceSlot, 1, buffers);
+                commandBuffer.SetPixelConstantBuffer(m_ResourceSlot, nullptr);
         }
     }
 
+    // Contents are copied into the command buffer, the data can change right after
     void Update(const T& data)
     {
-        ID3D11DeviceContext& deviceContext = m_Device.GetContext();
+        CommandBuffer& commandBuffer = m_Device.GetCommandBuffer();
 
         {
-            D3D11_MAPPED_SUBRESOURCE mappedSubresource{ };
-
-            deviceContext.Map(m_ConstantBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedSubresource);
-            std::memcpy(mappedSubresource.pData, &data, sizeof(data));
-            deviceContext.Unmap(m_ConstantBuffer.Get(), 0);
+            if (m_Usage == ConstantUsage::Frame)
+                commandBuffer.UpdateConstants(m_ConstantBuffer.Get(), &data, sizeof(data));
+            else
+                commandBuffer.UpdateBuffer(m_ConstantBuffer.Get(), &data, sizeof(data));
         }
     }
 
 private:
     UINT m_ResourceSlot{ 0 };
     ResourceInput m_ResourceInput{ 0 };
+    ConstantUsage m_Usage{ ConstantUsage::Static };
 
     Microsoft::WRL::ComPtr<ID3D11Buffer> m_ConstantBuffer;
 };
+
+// Buffer of T rewritten by the CPU every frame, derived classes only bind it. Storage grows in powers of two and
+// is never shrunk, shader resources are structured buffers viewed as a whole.
+template <typename T>
+class DynamicBuffer : public DX11Resource
+{
+public:
+    // Storage is replaced when it grows, so the buffer must not be used earlier in the same frame
+    void Update(const std::vector<T>& data)
+    {
+        if (data.empty())
+            return;
+
+        Reserve(static_cast<UINT>(data.size()));
+
+        CommandBuffer& commandBuffer = m_Device.GetCommandBuffer();
+
+        {
+            commandBuffer.UpdateBuffer(m_Buffer.Get(), data.data(), static_cast<UINT>(data.size() * sizeof(T)));
+        }
+    }
+
+protected:
+    DynamicBuffer(DX11Device& device, UINT bindFlags)
+        : DX11Resource(device)
+        , m_BindFlags(bindFlags)
+    {
+        Reserve(1);
+    }
+
+    ID3D11Buffer* GetBuffer() const
+    {
+        return m_Buffer.Get();
+    }
+
+    ID3D11ShaderResourceView* GetShaderView() const
+    {
+        return m_ShaderView.Get();
+    }
+
+private:
+    void Reserve(UINT count)
+    {
+        if (count <= m_Capacity)
+            return;
+
+        UINT capacity = (std::max)(m_Capacity, 1u);
+        while (capacity < count)
+            capacity *= 2;
+
+        Backend& backend = m_Device.GetBackend();
+        bool isShaderResource = (m_BindFlags & D3D11_BIND_SHADER_RESOURCE) != 0;
+
+        {
+            D3D11_BUFFER_DESC desc{ };
+            desc.ByteWidth = capacity * static_cast<UINT>(sizeof(T));
+            desc.Usage = D3D11_USAGE_DYNAMIC;
+            desc.BindFlags = m_BindFlags;
+            desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+            desc.MiscFlags = isShaderResource ? D3D11_RESOURCE_MISC_BUFFER_STRUCTURED : 0;
+            desc.StructureByteStride = static_cast<UINT>(sizeof(T));
+
+            HRESULT hr = backend.CreateBuffer(&desc, nullptr, &m_Buffer);
+            assert(SUCCEEDED(hr));
+        }
+
+        if (isShaderResource)
+        {
+            D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc{ };
+            viewDesc.Format = DXGI_FORMAT_UNKNOWN;
+            viewDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+            viewDesc.Buffer.FirstElement = 0;
+            viewDesc.Buffer.NumElements = capacity;
+
+            HRESULT hr = backend.CreateShaderResourceView(m_Buffer.Get(), &viewDesc, &m_ShaderView);
+            assert(SUCCEEDED(hr));
+        }
+
+        m_Capacity = capacity;
+    }
+
+    UINT m_BindFlags{ 0 };
+    UINT m_Capacity{ 0 };
+
+    Microsoft::WRL::ComPtr<ID3D11Buffer> m_Buffer;
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_ShaderView;
+};
+
+// Pixel shader StructuredBuffer<T>
+template <typename T>
+class StructuredBuffer final : public DynamicBuffer<T>
+{
+public:
+    StructuredBuffer(DX11Device& device, UINT slot)
+        : DynamicBuffer<T>(device, D3D11_BIND_SHADER_RESOURCE)
+        , m_ResourceSlot(slot)
+    {
+    }
+
+    void Enable() override
+    {
+        CommandBuffer& commandBuffer = this->m_Device.GetCommandBuffer();
+
+        {
+            commandBuffer.SetPixelShaderResource(m_ResourceSlot, this->GetShaderView());
+        }
+    }
+
+    void Disable() override
+    {
+        CommandBuffer& commandBuffer = this->m_Device.GetCommandBuffer();
+
+        {
+            commandBuffer.SetPixelShaderResource(m_ResourceSlot, nullptr);
+        }
+    }
+
+private:
+    UINT m_ResourceSlot{ 0 };
+};
+
+// Vertex buffer read once per instance from an input assembler slot
+template <typename T>
+class InstanceBuffer final : public DynamicBuffer<T>
+{
+public:
+    InstanceBuffer(DX11Device& device, UINT slot)
+        : DynamicBuffer<T>(device, D3D11_BIND_VERTEX_BUFFER)
+        , m_ResourceSlot(slot)
+    {
+    }
+
+    void Enable() override
+    {
+        CommandBuffer& commandBuffer = this->m_Device.GetCommandBuffer();
+
+        {
+            commandBuffer.SetVertexBuffer(m_ResourceSlot, this->GetBuffer(), static_cast<UINT>(sizeof(T)), 0); // Input Assembly
+        }
+    }
+
+    void Disable() override
+    {
+        CommandBuffer& commandBuffer = this->m_Device.GetCommandBuffer();
+
+        {
+            commandBuffer.SetVertexBuffer(m_ResourceSlot, nullptr, static_cast<UINT>(sizeof(T)), 0); // Input Assembly
+        }
+    }
+
+private:
+    UINT m_ResourceSlot{ 0 };
+};
+
+// Index buffer rebuilt on the CPU every frame, bound in place of the index buffer of a geometry
+template <typename T>
+class IndexBuffer final : public DynamicBuffer<T>
+{
+public:
+    static_assert(sizeof(T) == sizeof(USHORT) || sizeof(T) == sizeof(UINT), "Indices are 16 or 32-bit");
+    static constexpr DXGI_FORMAT s_Format = sizeof(T) == sizeof(USHORT) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+
+    IndexBuffer(DX11Device& device)
+        : DynamicBuffer<T>(device, D3D11_BIND_INDEX_BUFFER)
+    {
+    }
+
+    void Enable() override
+    {
+        CommandBuffer& commandBuffer = this->m_Device.GetCommandBuffer();
+
+        {
+            commandBuffer.SetIndexBuffer(this->GetBuffer(), s_Format, 0); // Input Assembly
+        }
+    }
+
+    void Disable() override
+    {
+        CommandBuffer& commandBuffer = this->m_Device.GetCommandBuffer();
+
+        {
+            commandBuffer.SetIndexBuffer(nullptr, s_Format, 0); // Input Assembly
+        }
+    }
+};
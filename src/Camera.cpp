@@ -21,6 +21,8 @@
  */
 
 #include "Camera.h"
+#include <algorithm>
+#include <cmath>
 
 Camera::Camera()
 {
@@ -120,12 +122,111 @@ const DirectX::XMMATRIX& Camera::GetProjection() const
     return m_Projection;
 }
 
+const DirectX::XMMATRIX& Camera::GetViewProjection() const
+{
+    return m_ViewProjection;
+}
+
+const DirectX::XMMATRIX& Camera::GetInverseViewProjection() const
+{
+    return m_InverseViewProjection;
+}
+
+const Frustum& Camera::GetFrustum() const
+{
+    return m_Frustum;
+}
+
+bool Camera::ProjectSphere(const DirectX::XMVECTOR& sphere, DirectX::XMFLOAT4& rect) const
+{
+    // Corners of the sphere bounding box are projected, the sphere is outside if all of them are outside of one frustum plane
+    const DirectX::XMMATRIX& viewProjection = m_ViewProjection;
+
+    float radius = DirectX::XMVectorGetW(sphere);
+    rect = { -1.0f, -1.0f, 1.0f, 1.0f };
+
+    if (std::isinf(radius))
+        return true;
+
+    if (radius <= 0.0f)
+        return false;
+
+    int outside[6]{ };
+    DirectX::XMFLOAT4 bounds{ 1.0f, 1.0f, -1.0f, -1.0f };
+
+    for (int corner = 0; corner < 8; corner++)
+    {
+        DirectX::XMVECTOR offset = DirectX::XMVectorSet(
+            corner & 1 ? radius : -radius,
+            corner & 2 ? radius : -radius,
+            corner & 4 ? radius : -radius,
+            0.0f);
+
+        DirectX::XMVECTOR position = DirectX::XMVectorSetW(DirectX::XMVectorAdd(sphere, offset), 1.0f);
+
+        DirectX::XMFLOAT4 clip;
+        DirectX::XMStoreFloat4(&clip, DirectX::XMVector4Transform(position, viewProjection));
+
+        outside[0] += clip.x < -clip.w ? 1 : 0;
+        outside[1] += clip.x > clip.w ? 1 : 0;
+        outside[2] += clip.y < -clip.w ? 1 : 0;
+        outside[3] += clip.y > clip.w ? 1 : 0;
+        outside[4] += clip.z < 0.0f ? 1 : 0;
+        outside[5] += clip.z > clip.w ? 1 : 0;
+
+        // Corners in front of the near plane have positive w
+        if (clip.z >= 0.0f)
+        {
+            bounds.x = (std::min)(bounds.x, clip.x / clip.w);
+            bounds.y = (std::min)(bounds.y, clip.y / clip.w);
+            bounds.z = (std::max)(bounds.z, clip.x / clip.w);
+            bounds.w = (std::max)(bounds.w, clip.y / clip.w);
+        }
+    }
+
+    for (int plane = 0; plane < 6; plane++)
+    {
+        if (outside[plane] == 8)
+            return false;
+    }
+
+    // Projection of a box crossing the near plane is unbounded
+    if (outside[4] == 0)
+        rect = bounds;
+
+    return true;
+}
+
 void Camera::UpdateView()
 {
     m_View = DirectX::XMMatrixLookToLH(m_Position, m_Forward, m_Up);
+    UpdateViewProjection();
 }
 
 void Camera::UpdateProjection()
 {
     m_Projection = DirectX::XMMatrixPerspectiveFovLH(DirectX::XMConvertToRadians(m_Fov), m_AspectRatio, m_NearPlane, m_FarPlane);
+    UpdateViewProjection();
+}
+
+void Camera::UpdateViewProjection()
+{
+    m_ViewProjection = DirectX::XMMatrixMultiply(m_View, m_Projection);
+    m_InverseViewProjection = DirectX::XMMatrixInverse(nullptr, m_ViewProjection);
+
+    // Clip space x, y and z are dot products of a position with matrix columns: -w <= x, y <= w, 0 <= z <= w
+    DirectX::XMMATRIX columns(DirectX::XMMatrixTranspose(m_ViewProjection));
+
+    DirectX::XMVECTOR planes[] =
+    {
+        DirectX::XMVectorAdd(columns.r[3], columns.r[0]),
+        DirectX::XMVectorSubtract(columns.r[3], columns.r[0]),
+        DirectX::XMVectorAdd(columns.r[3], columns.r[1]),
+        DirectX::XMVectorSubtract(columns.r[3], columns.r[1]),
+        columns.r[2],
+        DirectX::XMVectorSubtract(columns.r[3], columns.r[2])
+    };
+
+    for (int plane = 0; plane < 6; plane++)
+        DirectX::XMStoreFloat4(&m_Frustum.m_Planes[plane], DirectX::XMPlaneNormalize(planes[plane]));
 }
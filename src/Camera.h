@@ -24,6 +24,12 @@
 
 #include <DirectXMath.h>
 
+// World space planes as (normal, distance) with normals pointing inside: left, right, bottom, top, near, far
+struct Frustum final
+{
+    DirectX::XMFLOAT4 m_Planes[6];
+};
+
 class Camera final
 {
 public:
@@ -53,9 +59,18 @@ public:
 
     const DirectX::XMMATRIX& GetProjection() const;
 
+    const DirectX::XMMATRIX& GetViewProjection() const;
+    const DirectX::XMMATRIX& GetInverseViewProjection() const; // Normalized device coordinates and depth to world
+    const Frustum& GetFrustum() const;                         // Extracted from the view projection
+
+    // Conservative normalized device rectangle (left, bottom, right, top) of a world space sphere
+    // with center in xyz and radius in w, false if the sphere is outside of the view frustum
+    bool ProjectSphere(const DirectX::XMVECTOR& sphere, DirectX::XMFLOAT4& rect) const;
+
 private:
     void UpdateView();
     void UpdateProjection();
+    void UpdateViewProjection();
 
     DirectX::XMVECTOR m_Position{ DirectX::XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f) }; // Zero
     DirectX::XMVECTOR m_Right{ DirectX::XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f) };    // X
@@ -69,4 +84,7 @@ private:
 
     DirectX::XMMATRIX m_View{ DirectX::XMMatrixIdentity() };
     DirectX::XMMATRIX m_Projection{ DirectX::XMMatrixIdentity() };
+    DirectX::XMMATRIX m_ViewProjection{ DirectX::XMMatrixIdentity() };
+    DirectX::XMMATRIX m_InverseViewProjection{ DirectX::XMMatrixIdentity() };
+    Frustum m_Frustum{ };
 };
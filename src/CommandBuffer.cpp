@@ -0,0 +1,376 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "CommandBuffer.h"
+#include "Backend.h"
+#include "StateCache.h"
+#include "ConstantRing.h"
+#include <algorithm>
+#include <iterator>
+#include <cstring>
+#include <cassert>
+
+namespace
+{
+    // Where the current contents of a buffer updated by UpdateConstants() live
+    struct ConstantWindow final
+    {
+        ID3D11Buffer* m_Buffer;
+        UINT m_FirstConstant;
+        UINT m_ConstantCount; // Zero if the ring was full and the buffer itself was written
+    };
+
+    void WriteBuffer(Backend& backend, ID3D11Buffer* buffer, const BYTE* data, UINT size)
+    {
+        D3D11_MAPPED_SUBRESOURCE mappedSubresource{ };
+
+        HRESULT hr = backend.Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedSubresource);
+        assert(SUCCEEDED(hr));
+
+        std::memcpy(mappedSubresource.pData, data, size);
+        backend.Unmap(buffer, 0);
+    }
+}
+
+void CommandBuffer::SetPipeline(ID3D11VertexShader* vertexShader, ID3D11PixelShader* pixelShader, ID3D11InputLayout* inputLayout)
+{
+    Record(CommandType::SetPipeline).m_Pipeline = { vertexShader, pixelShader, inputLayout };
+}
+
+void CommandBuffer::SetVertexBuffer(UINT slot, ID3D11Buffer* buffer, UINT stride, UINT offset)
+{
+    Record(CommandType::SetVertexBuffer).m_VertexBuffer = { slot, stride, offset, buffer };
+}
+
+void CommandBuffer::SetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+{
+    Record(CommandType::SetIndexBuffer).m_IndexBuffer = { buffer, format, offset };
+}
+
+void CommandBuffer::SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+    Record(CommandType::SetPrimitiveTopology).m_Topology = topology;
+}
+
+void CommandBuffer::SetVertexConstantBuffer(UINT slot, ID3D11Buffer* buffer)
+{
+    Record(CommandType::SetVertexConstantBuffer).m_ConstantBuffer = { slot, buffer };
+}
+
+void CommandBuffer::SetPixelConstantBuffer(UINT slot, ID3D11Buffer* buffer)
+{
+    Record(CommandType::SetPixelConstantBuffer).m_ConstantBuffer = { slot, buffer };
+}
+
+void CommandBuffer::SetPixelShaderResource(UINT slot, ID3D11ShaderResourceView* view)
+{
+    Record(CommandType::SetPixelShaderResource).m_ShaderResource = { slot, view };
+}
+
+void CommandBuffer::SetPixelSampler(UINT slot, ID3D11SamplerState* sampler)
+{
+    Record(CommandType::SetPixelSampler).m_Sampler = { slot, sampler };
+}
+
+void CommandBuffer::SetRasterizerState(ID3D11RasterizerState* state)
+{
+    Record(CommandType::SetRasterizerState).m_RasterizerState = state;
+}
+
+void CommandBuffer::SetViewport(const D3D11_VIEWPORT& viewport)
+{
+    Record(CommandType::SetViewport).m_Viewport = viewport;
+}
+
+void CommandBuffer::SetScissorRect(const D3D11_RECT& rect)
+{
+    Record(CommandType::SetScissorRect).m_ScissorRect = rect;
+}
+
+void CommandBuffer::SetRenderTargets(UINT count, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthStencilView)
+{
+    RenderTargetsCommand& command = Record(CommandType::SetRenderTargets).m_RenderTargets;
+
+    assert(count <= std::size(command.m_Views));
+    command.m_Count = count;
+    std::copy(views, views + count, command.m_Views);
+    command.m_DepthStencilView = depthStencilView;
+}
+
+void CommandBuffer::SetBlendState(ID3D11BlendState* state)
+{
+    Record(CommandType::SetBlendState).m_BlendState = state;
+}
+
+void CommandBuffer::ClearRenderTarget(ID3D11RenderTargetView* view, const FLOAT color[4])
+{
+    ClearRenderTargetCommand& command = Record(CommandType::ClearRenderTarget).m_ClearRenderTarget;
+
+    command.m_View = view;
+    std::copy(color, color + 4, command.m_Color);
+}
+
+void CommandBuffer::ClearDepthStencil(ID3D11DepthStencilView* view, UINT flags, FLOAT depth, UINT8 stencil)
+{
+    Record(CommandType::ClearDepthStencil).m_ClearDepthStencil = { view, flags, depth, stencil };
+}
+
+void CommandBuffer::UpdateBuffer(ID3D11Buffer* buffer, const void* data, UINT size)
+{
+    UINT dataOffset = static_cast<UINT>(m_Data.size());
+
+    m_Data.resize(m_Data.size() + size);
+    std::memcpy(m_Data.data() + dataOffset, data, size);
+
+    Record(CommandType::UpdateBuffer).m_UpdateBuffer = { buffer, dataOffset, size };
+}
+
+void CommandBuffer::UpdateConstants(ID3D11Buffer* buffer, const void* data, UINT size)
+{
+    UINT dataOffset = static_cast<UINT>(m_Data.size());
+
+    m_Data.resize(m_Data.size() + size);
+    std::memcpy(m_Data.data() + dataOffset, data, size);
+
+    Record(CommandType::UpdateConstants).m_UpdateBuffer = { buffer, dataOffset, size };
+    m_ConstantUpdates++;
+}
+
+void CommandBuffer::DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex)
+{
+    Record(CommandType::DrawIndexed).m_DrawIndexed = { indexCount, startIndex, baseVertex };
+    m_DrawCommands++;
+}
+
+void CommandBuffer::DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)
+{
+    Record(CommandType::DrawIndexedInstanced).m_DrawIndexedInstanced = { indexCount, instanceCount, startIndex, baseVertex, startInstance };
+    m_DrawCommands++;
+}
+
+const std::vector<Command>& CommandBuffer::GetCommands() const
+{
+    return m_Commands;
+}
+
+const BYTE* CommandBuffer::GetData(const UpdateBufferCommand& command) const
+{
+    return m_Data.data() + command.m_DataOffset;
+}
+
+CommandBufferStats CommandBuffer::GetStats() const
+{
+    CommandBufferStats stats;
+    stats.m_Commands = static_cast<UINT>(m_Commands.size());
+    stats.m_DrawCommands = m_DrawCommands;
+    stats.m_ConstantUpdates = m_ConstantUpdates;
+    stats.m_DataBytes = m_Data.size();
+    return stats;
+}
+
+void CommandBuffer::Submit(Backend& backend, StateCache& stateCache, ConstantRing& constantRing) const
+{
+    // Constants of the whole frame are written up front, the ring may not stay mapped while draws read it
+    std::vector<ConstantWindow> updates;
+    updates.reserve(m_ConstantUpdates);
+
+    constantRing.Begin();
+
+    for (const Command& command : m_Commands)
+    {
+        if (command.m_Type != CommandType::UpdateConstants)
+            continue;
+
+        const UpdateBufferCommand& update = command.m_UpdateBuffer;
+        ConstantWindow& window = updates.emplace_back();
+        window.m_Buffer = update.m_Buffer;
+
+        constantRing.Allocate(GetData(update), update.m_DataSize, window.m_FirstConstant, window.m_ConstantCount);
+    }
+
+    constantRing.End();
+
+    // Buffers as recorded per slot, a buffer bound while its contents are in the ring is replaced by its window
+    std::vector<ConstantWindow> windows;
+    ID3D11Buffer* vertexConstants[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT]{ };
+    ID3D11Buffer* pixelConstants[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT]{ };
+    size_t nextUpdate = 0;
+
+    auto findWindow = [&windows](ID3D11Buffer* buffer) -> ConstantWindow*
+    {
+        auto window = std::find_if(windows.begin(), windows.end(), [buffer](const ConstantWindow& window) { return window.m_Buffer == buffer; });
+        return window != windows.end() ? &*window : nullptr;
+    };
+
+    auto setVertexConstants = [&](UINT slot, ID3D11Buffer* buffer)
+    {
+        assert(slot < std::size(vertexConstants));
+        vertexConstants[slot] = buffer;
+
+        const ConstantWindow* window = findWindow(buffer);
+        if (window != nullptr && window->m_ConstantCount > 0)
+            stateCache.SetVertexConstantBuffer(slot, constantRing.GetBuffer(), window->m_FirstConstant, window->m_ConstantCount);
+        else
+            stateCache.SetVertexConstantBuffer(slot, buffer);
+    };
+
+    auto setPixelConstants = [&](UINT slot, ID3D11Buffer* buffer)
+    {
+        assert(slot < std::size(pixelConstants));
+        pixelConstants[slot] = buffer;
+
+        const ConstantWindow* window = findWindow(buffer);
+        if (window != nullptr && window->m_ConstantCount > 0)
+            stateCache.SetPixelConstantBuffer(slot, constantRing.GetBuffer(), window->m_FirstConstant, window->m_ConstantCount);
+        else
+            stateCache.SetPixelConstantBuffer(slot, buffer);
+    };
+
+    for (const Command& command : m_Commands)
+    {
+        switch (command.m_Type)
+        {
+        case CommandType::SetPipeline:
+        {
+            const PipelineCommand& pipeline = command.m_Pipeline;
+            stateCache.SetPipeline(pipeline.m_VertexShader, pipeline.m_PixelShader, pipeline.m_InputLayout);
+            break;
+        }
+
+        case CommandType::SetVertexBuffer:
+        {
+            const VertexBufferCommand& vertexBuffer = command.m_VertexBuffer;
+            stateCache.SetVertexBuffer(vertexBuffer.m_Slot, vertexBuffer.m_Buffer, vertexBuffer.m_Stride, vertexBuffer.m_Offset);
+            break;
+        }
+
+        case CommandType::SetIndexBuffer:
+            stateCache.SetIndexBuffer(command.m_IndexBuffer.m_Buffer, command.m_IndexBuffer.m_Format, command.m_IndexBuffer.m_Offset);
+            break;
+
+        case CommandType::SetPrimitiveTopology:
+            stateCache.SetPrimitiveTopology(command.m_Topology);
+            break;
+
+        case CommandType::SetVertexConstantBuffer:
+            setVertexConstants(command.m_ConstantBuffer.m_Slot, command.m_ConstantBuffer.m_Object);
+            break;
+
+        case CommandType::SetPixelConstantBuffer:
+            setPixelConstants(command.m_ConstantBuffer.m_Slot, command.m_ConstantBuffer.m_Object);
+            break;
+
+        case CommandType::SetPixelShaderResource:
+            stateCache.SetPixelShaderResource(command.m_ShaderResource.m_Slot, command.m_ShaderResource.m_Object);
+            break;
+
+        case CommandType::SetPixelSampler:
+            stateCache.SetPixelSampler(command.m_Sampler.m_Slot, command.m_Sampler.m_Object);
+            break;
+
+        case CommandType::SetRasterizerState:
+            stateCache.SetRasterizerState(command.m_RasterizerState);
+            break;
+
+        case CommandType::SetViewport:
+            stateCache.SetViewport(command.m_Viewport);
+            break;
+
+        case CommandType::SetScissorRect:
+            stateCache.SetScissorRect(command.m_ScissorRect);
+            break;
+
+        case CommandType::SetRenderTargets:
+            stateCache.SetRenderTargets(command.m_RenderTargets.m_Count, command.m_RenderTargets.m_Views, command.m_RenderTargets.m_DepthStencilView);
+            break;
+
+        case CommandType::SetBlendState:
+            stateCache.SetBlendState(command.m_BlendState);
+            break;
+
+        case CommandType::ClearRenderTarget:
+            backend.ClearRenderTargetView(command.m_ClearRenderTarget.m_View, command.m_ClearRenderTarget.m_Color);
+            break;
+
+        case CommandType::ClearDepthStencil:
+        {
+            const ClearDepthStencilCommand& clear = command.m_ClearDepthStencil;
+            backend.ClearDepthStencilView(clear.m_View, clear.m_Flags, clear.m_Depth, clear.m_Stencil);
+            break;
+        }
+
+        case CommandType::UpdateBuffer:
+            WriteBuffer(backend, command.m_UpdateBuffer.m_Buffer, GetData(command.m_UpdateBuffer), command.m_UpdateBuffer.m_DataSize);
+            break;
+
+        case CommandType::UpdateConstants:
+        {
+            const ConstantWindow& update = updates[nextUpdate++];
+
+            // Did not fit, written in place like UpdateBuffer()
+            if (update.m_ConstantCount == 0)
+                WriteBuffer(backend, update.m_Buffer, GetData(command.m_UpdateBuffer), command.m_UpdateBuffer.m_DataSize);
+
+            if (ConstantWindow* window = findWindow(update.m_Buffer))
+                *window = update;
+            else
+                windows.push_back(update);
+
+            // Slots still holding the buffer see the new contents
+            for (UINT slot = 0; slot < std::size(vertexConstants); slot++)
+                if (vertexConstants[slot] == update.m_Buffer)
+                    setVertexConstants(slot, update.m_Buffer);
+
+            for (UINT slot = 0; slot < std::size(pixelConstants); slot++)
+                if (pixelConstants[slot] == update.m_Buffer)
+                    setPixelConstants(slot, update.m_Buffer);
+
+            break;
+        }
+
+        case CommandType::DrawIndexed:
+            backend.DrawIndexed(command.m_DrawIndexed.m_IndexCount, command.m_DrawIndexed.m_StartIndex, command.m_DrawIndexed.m_BaseVertex);
+            break;
+
+        case CommandType::DrawIndexedInstanced:
+        {
+            const DrawIndexedInstancedCommand& draw = command.m_DrawIndexedInstanced;
+            backend.DrawIndexedInstanced(draw.m_IndexCount, draw.m_InstanceCount, draw.m_StartIndex, draw.m_BaseVertex, draw.m_StartInstance);
+            break;
+        }
+        }
+    }
+}
+
+void CommandBuffer::Clear()
+{
+    m_Commands.clear();
+    m_Data.clear();
+    m_DrawCommands = 0;
+    m_ConstantUpdates = 0;
+}
+
+Command& CommandBuffer::Record(CommandType type)
+{
+    Command& command = m_Commands.emplace_back();
+    command.m_Type = type;
+    return command;
+}
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <d3d11.h>
+#include <type_traits>
+#include <vector>
+
+class Backend;
+class StateCache;
+class ConstantRing;
+
+enum class CommandType : UINT
+{
+    SetPipeline,
+    SetVertexBuffer,
+    SetIndexBuffer,
+    SetPrimitiveTopology,
+    SetVertexConstantBuffer,
+    SetPixelConstantBuffer,
+    SetPixelShaderResource,
+    SetPixelSampler,
+    SetRasterizerState,
+    SetViewport,
+    SetScissorRect,
+    SetRenderTargets,
+    SetBlendState,
+    ClearRenderTarget,
+    ClearDepthStencil,
+    UpdateBuffer,
+    UpdateConstants,
+    DrawIndexed,
+    DrawIndexedInstanced
+};
+
+struct PipelineCommand final
+{
+    ID3D11VertexShader* m_VertexShader;
+    ID3D11PixelShader* m_PixelShader;
+    ID3D11InputLayout* m_InputLayout;
+};
+
+struct VertexBufferCommand final
+{
+    UINT m_Slot;
+    UINT m_Stride;
+    UINT m_Offset;
+    ID3D11Buffer* m_Buffer;
+};
+
+struct IndexBufferCommand final
+{
+    ID3D11Buffer* m_Buffer;
+    DXGI_FORMAT m_Format;
+    UINT m_Offset;
+};
+
+// Constant buffer, shader resource and sampler bindings of a single slot
+template <typename T>
+struct SlotCommand final
+{
+    UINT m_Slot;
+    T* m_Object;
+};
+
+struct RenderTargetsCommand final
+{
+    UINT m_Count;
+    ID3D11RenderTargetView* m_Views[4];
+    ID3D11DepthStencilView* m_DepthStencilView;
+};
+
+struct ClearRenderTargetCommand final
+{
+    ID3D11RenderTargetView* m_View;
+    FLOAT m_Color[4];
+};
+
+struct ClearDepthStencilCommand final
+{
+    ID3D11DepthStencilView* m_View;
+    UINT m_Flags;
+    FLOAT m_Depth;
+    UINT8 m_Stencil;
+};
+
+// Contents are kept in the data block of the command buffer
+struct UpdateBufferCommand final
+{
+    ID3D11Buffer* m_Buffer;
+    UINT m_DataOffset;
+    UINT m_DataSize;
+};
+
+struct DrawIndexedCommand final
+{
+    UINT m_IndexCount;
+    UINT m_StartIndex;
+    INT m_BaseVertex;
+};
+
+struct DrawIndexedInstancedCommand final
+{
+    UINT m_IndexCount;
+    UINT m_InstanceCount;
+    UINT m_StartIndex;
+    INT m_BaseVertex;
+    UINT m_StartInstance;
+};
+
+struct Command final
+{
+    CommandType m_Type;
+
+    union
+    {
+        PipelineCommand m_Pipeline;
+        VertexBufferCommand m_VertexBuffer;
+        IndexBufferCommand m_IndexBuffer;
+        D3D11_PRIMITIVE_TOPOLOGY m_Topology;
+        SlotCommand<ID3D11Buffer> m_ConstantBuffer;
+        SlotCommand<ID3D11ShaderResourceView> m_ShaderResource;
+        SlotCommand<ID3D11SamplerState> m_Sampler;
+        ID3D11RasterizerState* m_RasterizerState;
+        D3D11_VIEWPORT m_Viewport;
+        D3D11_RECT m_ScissorRect;
+        RenderTargetsCommand m_RenderTargets;
+        ID3D11BlendState* m_BlendState;
+        ClearRenderTargetCommand m_ClearRenderTarget;
+        ClearDepthStencilCommand m_ClearDepthStencil;
+        UpdateBufferCommand m_UpdateBuffer;
+        DrawIndexedCommand m_DrawIndexed;
+        DrawIndexedInstancedCommand m_DrawIndexedInstanced;
+    };
+};
+
+static_assert(std::is_trivially_copyable_v<Command>, "Commands are copied as plain memory");
+
+struct CommandBufferStats final
+{
+    UINT m_Commands{ 0 };
+    UINT m_DrawCommands{ 0 };
+    UINT m_ConstantUpdates{ 0 };
+    UINT64 m_DataBytes{ 0 }; // Buffer contents copied by UpdateBuffer() and UpdateConstants()
+};
+
+// Frame recorded as a flat array of plain commands, replayed into a Backend by Submit(). Objects are
+// referenced by raw pointers and have to stay alive until the commands are submitted or cleared.
+// Recording does not touch the backend, so commands can be inspected, reordered or replayed first.
+class CommandBuffer final
+{
+public:
+    void SetPipeline(ID3D11VertexShader* vertexShader, ID3D11PixelShader* pixelShader, ID3D11InputLayout* inputLayout);
+    void SetVertexBuffer(UINT slot, ID3D11Buffer* buffer, UINT stride, UINT offset);
+    void SetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset);
+    void SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology);
+    void SetVertexConstantBuffer(UINT slot, ID3D11Buffer* buffer);
+    void SetPixelConstantBuffer(UINT slot, ID3D11Buffer* buffer);
+    void SetPixelShaderResource(UINT slot, ID3D11ShaderResourceView* view);
+    void SetPixelSampler(UINT slot, ID3D11SamplerState* sampler);
+    void SetRasterizerState(ID3D11RasterizerState* state);
+    void SetViewport(const D3D11_VIEWPORT& viewport);
+    void SetScissorRect(const D3D11_RECT& rect);
+    void SetRenderTargets(UINT count, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthStencilView);
+    void SetBlendState(ID3D11BlendState* state);
+    void ClearRenderTarget(ID3D11RenderTargetView* view, const FLOAT color[4]);
+    void ClearDepthStencil(ID3D11DepthStencilView* view, UINT flags, FLOAT depth, UINT8 stencil);
+
+    // Contents are copied now and written with D3D11_MAP_WRITE_DISCARD on submission
+    void UpdateBuffer(ID3D11Buffer* buffer, const void* data, UINT size);
+    // Contents go to the frame's constant ring, the buffer is rebound to their window until the next update.
+    // Binding the buffer without an update in the same frame leaves its contents undefined.
+    void UpdateConstants(ID3D11Buffer* buffer, const void* data, UINT size);
+
+    void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex);
+    void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance);
+
+    const std::vector<Command>& GetCommands() const;
+    const BYTE* GetData(const UpdateBufferCommand& command) const;
+    CommandBufferStats GetStats() const;
+
+    // Commands are kept, the same frame can be submitted again. State changes go through the cache.
+    void Submit(Backend& backend, StateCache& stateCache, ConstantRing& constantRing) const;
+    void Clear();
+
+private:
+    Command& Record(CommandType type);
+
+    std::vector<Command> m_Commands;
+    std::vector<BYTE> m_Data;
+    UINT m_DrawCommands{ 0 };
+    UINT m_ConstantUpdates{ 0 };
+};
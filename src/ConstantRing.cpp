@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ConstantRing.h"
+#include "Backend.h"
+#include <cstring>
+#include <cassert>
+
+ConstantRing::ConstantRing(Backend& backend, UINT size)
+    : m_Backend(backend)
+    , m_Size(size)
+{
+    assert(size % s_Alignment == 0);
+
+    {
+        D3D11_BUFFER_DESC desc{ };
+        desc.ByteWidth = size;
+        desc.Usage = D3D11_USAGE_DYNAMIC;
+        desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+        HRESULT hr = m_Backend.CreateBuffer(&desc, nullptr, &m_Buffer);
+        assert(SUCCEEDED(hr));
+    }
+}
+
+ID3D11Buffer* ConstantRing::GetBuffer() const
+{
+    return m_Buffer.Get();
+}
+
+void ConstantRing::Begin()
+{
+    assert(m_MappedData == nullptr);
+
+    m_Offset = 0;
+    m_Stats = { };
+}
+
+bool ConstantRing::Allocate(const void* data, UINT size, UINT& firstConstant, UINT& constantCount)
+{
+    UINT alignedSize = (size + s_Alignment - 1) & ~(s_Alignment - 1);
+
+    // A bound window is limited to 4096 constants as any constant buffer
+    assert(alignedSize / s_ConstantSize <= D3D11_REQ_CONSTANT_BUFFER_ELEMENT_COUNT);
+
+    if (alignedSize > m_Size - m_Offset)
+    {
+        m_Stats.m_Fallbacks++;
+        return false;
+    }
+
+    if (m_MappedData == nullptr)
+    {
+        D3D11_MAPPED_SUBRESOURCE mappedSubresource{ };
+
+        HRESULT hr = m_Backend.Map(m_Buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedSubresource);
+        assert(SUCCEEDED(hr));
+
+        m_MappedData = static_cast<BYTE*>(mappedSubresource.pData);
+    }
+
+    std::memcpy(m_MappedData + m_Offset, data, size);
+
+    firstConstant = m_Offset / s_ConstantSize;
+    constantCount = alignedSize / s_ConstantSize;
+
+    m_Offset += alignedSize;
+    m_Stats.m_Allocations++;
+    m_Stats.m_UploadedBytes += alignedSize;
+    return true;
+}
+
+void ConstantRing::End()
+{
+    if (m_MappedData == nullptr)
+        return;
+
+    m_Backend.Unmap(m_Buffer.Get(), 0);
+    m_MappedData = nullptr;
+}
+
+const ConstantRingStats& ConstantRing::GetStats() const
+{
+    return m_Stats;
+}
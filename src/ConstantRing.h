@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+
+class Backend;
+
+struct ConstantRingStats final
+{
+    UINT m_Allocations{ 0 };
+    UINT m_Fallbacks{ 0 };       // Updates that did not fit and mapped their own buffer
+    UINT64 m_UploadedBytes{ 0 }; // Including alignment padding
+};
+
+// Upload buffer shared by the constants rewritten every frame. Updates are suballocated linearly at
+// 256-byte offsets, the granularity of *SetConstantBuffers1(), and the whole frame is written with a
+// single D3D11_MAP_WRITE_DISCARD. Nothing wraps around within a frame: once the buffer is full,
+// Allocate() fails and the caller writes the update to its own buffer instead.
+class ConstantRing final
+{
+public:
+    static constexpr UINT s_Alignment = 256;
+    static constexpr UINT s_ConstantSize = 16; // Offsets and sizes are bound in float4 constants
+
+    ConstantRing(Backend& backend, UINT size);
+
+    ID3D11Buffer* GetBuffer() const;
+
+    // Starts a new frame, the buffer is mapped by the first allocation
+    void Begin();
+    // Copies the data to the next free range, false if the rest of the buffer is too small
+    bool Allocate(const void* data, UINT size, UINT& firstConstant, UINT& constantCount);
+    void End();
+
+    const ConstantRingStats& GetStats() const; // Of the current or last frame
+
+private:
+    Backend& m_Backend;
+
+    Microsoft::WRL::ComPtr<ID3D11Buffer> m_Buffer;
+    UINT m_Size{ 0 };
+    UINT m_Offset{ 0 };
+    BYTE* m_MappedData{ nullptr };
+
+    ConstantRingStats m_Stats{ };
+};
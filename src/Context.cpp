@@ -52,6 +52,16 @@ float Context::GetFrameTime() const
     return m_FrameTime;
 }
 
+float Context::GetTotalTime() const
+{
+    return m_TotalTime;
+}
+
+size_t Context::GetFrameCount() const
+{
+    return m_FrameCount;
+}
+
 void Context::Run()
 {
     m_Application.Start(*this);
@@ -71,6 +81,11 @@ void Context::Run()
 
         std::chrono::duration<float> frameDuration = frameEnd - frameBegin;
         m_FrameTime = frameDuration.count();
+
+        m_TotalTime += m_FrameTime;
+        m_FrameCount++;
+        if (m_Params.m_FrameLimit != 0 && m_FrameCount >= m_Params.m_FrameLimit)
+            Terminate();
     }
 
     m_Application.Shutdown(*this);
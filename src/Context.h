@@ -35,6 +35,9 @@ struct ContextParams final
     std::string m_WindowCaption;
     size_t m_WindowWidth;
     size_t m_WindowHeight;
+
+    DeviceType m_DeviceType{ DeviceType::Hardware };
+    size_t m_FrameLimit{ 0 }; // Run until terminated if zero
 };
 
 class Context final
@@ -48,6 +51,8 @@ public:
     DX11Device& GetDevice() const;
 
     float GetFrameTime() const;
+    float GetTotalTime() const;
+    size_t GetFrameCount() const;
 
     void Run();
     void Terminate();
@@ -66,5 +71,7 @@ private:
     std::unique_ptr<DX11Device> m_Device;
 
     float m_FrameTime{ 0.0f };
+    float m_TotalTime{ 0.0f };
+    size_t m_FrameCount{ 0 };
     bool m_Terminate{ false };
 };
@@ -23,84 +23,64 @@
 #include "Device.h"
 #include "Context.h"
 #include "Window.h"
-#include <windows.h>
-#include <cassert>
-#include <stdexcept>
+#include "NullBackend.h"
+#include "SoftwareBackend.h"
 
 DX11Device::DX11Device(Context& context)
 {
+    const ContextParams& params = context.GetParams();
     Window& window = context.GetWindow();
 
+    switch (params.m_DeviceType)
     {
-#ifndef NDEBUG
-        UINT uD3D11Flags = D3D11_CREATE_DEVICE_DEBUG;
-#else  // NDEBUG
-        UINT uD3D11Flags = 0;
-#endif // NDEBUG
+    case DeviceType::Hardware:
+        m_Backend.reset(new DX11Backend(window));
+        break;
 
-        D3D_FEATURE_LEVEL pD3D11FeatureLevels[] = { D3D_FEATURE_LEVEL_11_1 };
+    case DeviceType::Null:
+        m_Backend.reset(new NullBackend(window.GetWidth(), window.GetHeight()));
+        break;
 
-        HRESULT hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, uD3D11Flags, pD3D11FeatureLevels, 1, D3D11_SDK_VERSION, &m_D3D11Device, nullptr, &m_D3D11DeviceContext);
-        if (FAILED(hr))
-            throw std::runtime_error("Failed to create DX11 device");
+    case DeviceType::Software:
+        m_Backend.reset(new SoftwareBackend(window.GetWidth(), window.GetHeight()));
+        break;
     }
 
-    {
-        // https://docs.microsoft.com/en-us/windows/win32/api/dxgi1_2/nn-dxgi1_2-idxgifactory2
-
-        Microsoft::WRL::ComPtr<IDXGIDevice2> pDXGIDevice2;
-        Microsoft::WRL::ComPtr<IDXGIAdapter> pDXGIAdapter;
-        Microsoft::WRL::ComPtr<IDXGIFactory2> pIDXGIFactory2;
-
-        HRESULT hr = m_D3D11Device.As(&pDXGIDevice2);
-        assert(SUCCEEDED(hr));
-
-        hr = pDXGIDevice2->GetParent(IID_PPV_ARGS(&pDXGIAdapter));
-        assert(SUCCEEDED(hr));
-
-        hr = pDXGIAdapter->GetParent(IID_PPV_ARGS(&pIDXGIFactory2));
-        assert(SUCCEEDED(hr));
-
-        DXGI_SWAP_CHAIN_DESC1 swapChainDesc1{ };
-        swapChainDesc1.Width = window.GetWidth();
-        swapChainDesc1.Height = window.GetHeight();
-        swapChainDesc1.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-        swapChainDesc1.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-        swapChainDesc1.BufferCount = 2; // For DXGI_SWAP_EFFECT_FLIP_DISCARD
-        swapChainDesc1.Scaling = DXGI_SCALING_NONE;
-        swapChainDesc1.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
-        swapChainDesc1.AlphaMode = DXGI_ALPHA_MODE_IGNORE;
-        swapChainDesc1.SampleDesc.Count = 1;
-        swapChainDesc1.SampleDesc.Quality = 0;
-
-        hr = pIDXGIFactory2->CreateSwapChainForHwnd(m_D3D11Device.Get(), window.GetHandle(), &swapChainDesc1, nullptr, nullptr, &m_D3D11SwapChain1);
-        if (FAILED(hr))
-            throw std::runtime_error("Failed to create swap chain");
-
-        hr = pIDXGIFactory2->MakeWindowAssociation(window.GetHandle(), DXGI_MWA_NO_WINDOW_CHANGES);
-        assert(SUCCEEDED(hr));
-    }
+    m_StateCache.reset(new StateCache(*m_Backend));
+    m_ConstantRing.reset(new ConstantRing(*m_Backend, 256 * 1024)); // 1024 updates of up to 256 bytes
+}
+
+Backend& DX11Device::GetBackend() const
+{
+    return *m_Backend;
 }
 
-ID3D11Device& DX11Device::GetHandle() const
+CommandBuffer& DX11Device::GetCommandBuffer()
 {
-    return *m_D3D11Device.Get();
+    return m_CommandBuffer;
 }
 
-ID3D11DeviceContext& DX11Device::GetContext() const
+const CommandBufferStats& DX11Device::GetCommandStats() const
 {
-    return *m_D3D11DeviceContext.Get();
+    return m_CommandStats;
 }
 
-IDXGISwapChain1& DX11Device::GetSwapChain() const
+const StateCacheStats& DX11Device::GetStateStats() const
 {
-    return *m_D3D11SwapChain1.Get();
+    return m_StateCache->GetStats();
+}
+
+const ConstantRingStats& DX11Device::GetConstantStats() const
+{
+    return m_ConstantRing->GetStats();
 }
 
 void DX11Device::Begin(Context& context)
 {
     Window& window = context.GetWindow();
 
+    m_Backend->ResetStats();
+
     {
         D3D11_VIEWPORT viewport{ };
         viewport.Width = static_cast<FLOAT>(window.GetWidth());
@@ -108,12 +88,19 @@ void DX11Device::Begin(Context& context)
         viewport.MinDepth = 0.0f;
         viewport.MaxDepth = 1.0f;
 
-        m_D3D11DeviceContext->RSSetViewports(1, &viewport); // Rasterizer Stage
+        m_CommandBuffer.SetViewport(viewport); // Rasterizer Stage
     }
 }
 
 void DX11Device::End(Context & context)
 {
-    DXGI_PRESENT_PARAMETERS params{ };
-    m_D3D11SwapChain1->Present1(0, 0, &params);
+    // Also carries commands recorded while resources were set up before the first frame
+    m_CommandStats = m_CommandBuffer.GetStats();
+    m_StateCache->ResetStats();
+
+    m_CommandBuffer.Submit(*m_Backend, *m_StateCache, *m_ConstantRing);
+    m_CommandBuffer.Clear();
+
+    m_Backend->Present();
+    m_StateCache->InvalidateRenderTargets();
 }
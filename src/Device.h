@@ -22,26 +22,42 @@
 
 #pragma once
 
-#include <d3d11.h>
-#include <dxgi1_2.h>
-#include <wrl/client.h>
+#include "Backend.h"
+#include "CommandBuffer.h"
+#include "StateCache.h"
+#include "ConstantRing.h"
+#include <memory>
 
 class Context;
 
+enum class DeviceType
+{
+    Hardware,
+    Null,
+    Software // Headless, Geometry.fx pass rasterized on CPU
+};
+
 class DX11Device final
 {
 public:
     DX11Device(Context& context);
 
-    ID3D11Device& GetHandle() const;
-    ID3D11DeviceContext& GetContext() const;
-    IDXGISwapChain1& GetSwapChain() const;
+    Backend& GetBackend() const;
+
+    // Resources record their frame work here, End() submits it to the backend
+    CommandBuffer& GetCommandBuffer();
+    const CommandBufferStats& GetCommandStats() const; // Of the last submitted frame
+    const StateCacheStats& GetStateStats() const;      // Of the last submitted frame
+    const ConstantRingStats& GetConstantStats() const; // Of the last submitted frame
 
     void Begin(Context& context);
     void End(Context& context);
 
 private:
-    Microsoft::WRL::ComPtr<ID3D11Device> m_D3D11Device;
-    Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_D3D11DeviceContext;
-    Microsoft::WRL::ComPtr<IDXGISwapChain1> m_D3D11SwapChain1;
+    std::unique_ptr<Backend> m_Backend;
+    std::unique_ptr<StateCache> m_StateCache;
+    std::unique_ptr<ConstantRing> m_ConstantRing;
+
+    CommandBuffer m_CommandBuffer;
+    CommandBufferStats m_CommandStats{ };
 };
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "DrawQueue.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    UINT GetField(UINT64 key, UINT shift, UINT bits)
+    {
+        return static_cast<UINT>((key >> shift) & ((1ull << bits) - 1));
+    }
+
+    UINT64 SetField(UINT value, UINT shift, UINT bits)
+    {
+        return (static_cast<UINT64>(value) & ((1ull << bits) - 1)) << shift;
+    }
+}
+
+UINT64 DrawKey::Make(DrawPass pass, UINT shader, UINT material, UINT texture, UINT mesh, float depth)
+{
+    const float depthScale = static_cast<float>((1 << s_DepthBits) - 1);
+
+    depth = (std::min)((std::max)(depth, 0.0f), 1.0f);
+    if (pass == DrawPass::Transparent)
+        depth = 1.0f - depth;
+
+    UINT quantizedDepth = static_cast<UINT>(std::lround(depth * depthScale));
+
+    return SetField(static_cast<UINT>(pass), s_PassShift, s_PassBits)
+        | SetField(shader, s_ShaderShift, s_ShaderBits)
+        | SetField(material, s_MaterialShift, s_MaterialBits)
+        | SetField(texture, s_TextureShift, s_TextureBits)
+        | SetField(mesh, s_MeshShift, s_MeshBits)
+        | SetField(quantizedDepth, s_DepthShift, s_DepthBits);
+}
+
+DrawPass DrawKey::GetPass(UINT64 key)
+{
+    return static_cast<DrawPass>(GetField(key, s_PassShift, s_PassBits));
+}
+
+UINT DrawKey::GetShader(UINT64 key)
+{
+    return GetField(key, s_ShaderShift, s_ShaderBits);
+}
+
+UINT DrawKey::GetMaterial(UINT64 key)
+{
+    return GetField(key, s_MaterialShift, s_MaterialBits);
+}
+
+UINT DrawKey::GetTexture(UINT64 key)
+{
+    return GetField(key, s_TextureShift, s_TextureBits);
+}
+
+UINT DrawKey::GetMesh(UINT64 key)
+{
+    return GetField(key, s_MeshShift, s_MeshBits);
+}
+
+void DrawQueue::Clear()
+{
+    m_Items.clear();
+}
+
+void DrawQueue::Push(UINT64 key, UINT index)
+{
+    m_Items.push_back({ key, index });
+}
+
+void DrawQueue::Sort()
+{
+    m_Stats = { };
+    m_Stats.m_Draws = static_cast<UINT>(m_Items.size());
+    m_Stats.m_UnsortedStateChanges = CountStateChanges(m_Items);
+
+    size_t count = m_Items.size();
+    m_SortItems.resize(count);
+
+    // Histograms of all digits in one read of the keys
+    UINT histograms[s_Digits][s_Buckets]{ };
+
+    for (const DrawItem& item : m_Items)
+    {
+        for (UINT digit = 0; digit < s_Digits; digit++)
+            histograms[digit][(item.m_Key >> (digit * s_DigitBits)) & (s_Buckets - 1)]++;
+    }
+
+    DrawItem* source = m_Items.data();
+    DrawItem* target = m_SortItems.data();
+
+    for (UINT digit = 0; digit < s_Digits; digit++)
+    {
+        UINT* histogram = histograms[digit];
+        UINT shift = digit * s_DigitBits;
+
+        // Every key has the same digit, the pass would not move anything
+        if (count == 0 || histogram[(source[0].m_Key >> shift) & (s_Buckets - 1)] == count)
+            continue;
+
+        // Exclusive prefix sum turns counts into bucket offsets
+        UINT offset = 0;
+        for (UINT bucket = 0; bucket < s_Buckets; bucket++)
+        {
+            UINT bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+
+        for (size_t item = 0; item < count; item++)
+            target[histogram[(source[item].m_Key >> shift) & (s_Buckets - 1)]++] = source[item];
+
+        std::swap(source, target);
+        m_Stats.m_SortPasses++;
+    }
+
+    if (source != m_Items.data())
+        m_Items.swap(m_SortItems);
+
+    m_Stats.m_StateChanges = CountStateChanges(m_Items);
+}
+
+const std::vector<DrawItem>& DrawQueue::GetItems() const
+{
+    return m_Items;
+}
+
+const DrawQueueStats& DrawQueue::GetStats() const
+{
+    return m_Stats;
+}
+
+UINT DrawQueue::CountStateChanges(const std::vector<DrawItem>& items)
+{
+    UINT changes = 0;
+
+    for (size_t item = 0; item < items.size(); item++)
+    {
+        UINT64 key = items[item].m_Key;
+
+        if (item == 0)
+        {
+            changes += 4;
+            continue;
+        }
+
+        UINT64 previousKey = items[item - 1].m_Key;
+
+        changes += DrawKey::GetShader(key) != DrawKey::GetShader(previousKey) ? 1 : 0;
+        changes += DrawKey::GetMaterial(key) != DrawKey::GetMaterial(previousKey) ? 1 : 0;
+        changes += DrawKey::GetTexture(key) != DrawKey::GetTexture(previousKey) ? 1 : 0;
+        changes += DrawKey::GetMesh(key) != DrawKey::GetMesh(previousKey) ? 1 : 0;
+    }
+
+    return changes;
+}
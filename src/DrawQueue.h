@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <d3d11.h>
+#include <vector>
+
+enum class DrawPass : UINT
+{
+    Opaque,     // Front to back, occluded pixels fail the early depth test
+    Transparent // Back to front, blended over what is behind
+};
+
+// 64-bit draw sort key, most significant field first:
+// pass (4) | shader (8) | material (8) | texture (8) | mesh geometry (12) | view depth (24)
+// Draws sharing a shader, material, texture and geometry end up next to each other, ready to be
+// drawn as instances of one call, and run in depth order within that group.
+struct DrawKey final
+{
+    static constexpr UINT s_PassBits = 4;
+    static constexpr UINT s_ShaderBits = 8;
+    static constexpr UINT s_MaterialBits = 8;
+    static constexpr UINT s_TextureBits = 8;
+    static constexpr UINT s_MeshBits = 12;
+    static constexpr UINT s_DepthBits = 24;
+
+    static constexpr UINT s_DepthShift = 0;
+    static constexpr UINT s_MeshShift = s_DepthShift + s_DepthBits;
+    static constexpr UINT s_TextureShift = s_MeshShift + s_MeshBits;
+    static constexpr UINT s_MaterialShift = s_TextureShift + s_TextureBits;
+    static constexpr UINT s_ShaderShift = s_MaterialShift + s_MaterialBits;
+    static constexpr UINT s_PassShift = s_ShaderShift + s_ShaderBits;
+
+    static_assert(s_PassShift + s_PassBits == 64, "Draw key fields must fill 64 bits");
+
+    // Depth is normalized view depth, clamped to [0, 1]. Ids are truncated to their field width.
+    static UINT64 Make(DrawPass pass, UINT shader, UINT material, UINT texture, UINT mesh, float depth);
+
+    static DrawPass GetPass(UINT64 key);
+    static UINT GetShader(UINT64 key);
+    static UINT GetMaterial(UINT64 key);
+    static UINT GetTexture(UINT64 key);
+    static UINT GetMesh(UINT64 key);
+};
+
+struct DrawItem final
+{
+    UINT64 m_Key;
+    UINT m_Index; // Caller defined, usually the position of the draw in the scene
+};
+
+struct DrawQueueStats final
+{
+    UINT m_Draws{ 0 };
+    UINT m_StateChanges{ 0 };         // Shader, material, texture and geometry switches in sorted order
+    UINT m_UnsortedStateChanges{ 0 }; // The same switches in Push() order
+    UINT m_SortPasses{ 0 };           // Radix passes left after skipping digits all keys share
+};
+
+// Draws of one frame, filled with Push() and ordered by key with Sort()
+class DrawQueue final
+{
+public:
+    void Clear();
+    void Push(UINT64 key, UINT index);
+
+    // Stable least significant digit radix sort on 8-bit digits
+    void Sort();
+
+    const std::vector<DrawItem>& GetItems() const;
+    const DrawQueueStats& GetStats() const;
+
+    // Bindings needed to issue items in their order, the first item binds every field
+    static UINT CountStateChanges(const std::vector<DrawItem>& items);
+
+private:
+    static constexpr UINT s_DigitBits = 8;
+    static constexpr UINT s_Digits = 64 / s_DigitBits;
+    static constexpr UINT s_Buckets = 1 << s_DigitBits;
+
+    std::vector<DrawItem> m_Items;
+    std::vector<DrawItem> m_SortItems; // Scatter target of odd passes
+
+    DrawQueueStats m_Stats{ };
+};
@@ -55,11 +55,7 @@ VertexOutput Main(VertexInput input)
 #define LIGHT_POINT     2
 #define LIGHT_SPOT      3
 
-Texture2D diffuseTexture : register(t0);
-Texture2D specularTexture : register(t1);
-Texture2D positionTexture : register(t2);
-Texture2D normalTexture : register(t3);
-SamplerState geometrySampler : register(s0);
+#include "GeometryBuffer.fxh"
 
 cbuffer DynamicLight : register(b0)
 {
@@ -71,13 +67,6 @@ cbuffer DynamicLight : register(b0)
     float dynamicLightSpotBorder;
 };
 
-cbuffer WorldVectors : register(b1)
-{
-    float4 cameraPosition;
-    float4 lightPosition;
-    float4 lightDirection;
-};
-
 struct PixelInput
 {
     float4 position : SV_POSITION; // System Value
@@ -91,10 +80,13 @@ struct PixelOutput
 
 PixelOutput Main(PixelInput input)
 {
-    float4 diffuseSample = diffuseTexture.Sample(geometrySampler, input.texcoord);
-    float4 specularSample = specularTexture.Sample(geometrySampler, input.texcoord);
-    float4 positionSample = positionTexture.Sample(geometrySampler, input.texcoord);
-    float4 normalSample = normalTexture.Sample(geometrySampler, input.texcoord);
+    float4 diffuseSample, specularSample, positionSample, normalSample;
+    SampleGeometry(input.texcoord, diffuseSample, specularSample, positionSample, normalSample);
+
+    // --- Skip pixels outside of the light volume, the scissor rectangle only bounds it on screen
+
+    if (distance(positionSample.xyz, lightBounds.xyz) > lightBounds.w)
+        discard;
 
     // --- Calculate diffuse color
 
@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "FrustumCulling.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <cassert>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif // __AVX2__
+
+FrustumCulling::FrustumCulling(ThreadPool& threadPool)
+    : m_ThreadPool(threadPool)
+{
+    m_Simd = IsSimdAvailable();
+}
+
+bool FrustumCulling::IsInside(const Frustum& frustum, float x, float y, float z, float radius)
+{
+    for (const DirectX::XMFLOAT4& plane : frustum.m_Planes)
+    {
+        float distance = ((plane.x * x + plane.y * y) + plane.z * z) + plane.w;
+
+        if (!(distance >= -radius))
+            return false;
+    }
+
+    return true;
+}
+
+bool FrustumCulling::IsSimdAvailable()
+{
+#if defined(__AVX2__)
+    return true;
+#else  // __AVX2__
+    return false;
+#endif // __AVX2__
+}
+
+void FrustumCulling::SetSimd(bool simd)
+{
+    m_Simd = simd && IsSimdAvailable();
+}
+
+void FrustumCulling::Clear()
+{
+    m_Count = 0;
+
+    m_CenterX.clear();
+    m_CenterY.clear();
+    m_CenterZ.clear();
+    m_Radii.clear();
+}
+
+UINT FrustumCulling::Add(const DirectX::XMVECTOR& sphere)
+{
+    // Grow by a whole vector of padding spheres at a time
+    if (m_Count % 8 == 0)
+    {
+        size_t size = static_cast<size_t>(m_Count) + 8;
+
+        m_CenterX.resize(size, 0.0f);
+        m_CenterY.resize(size, 0.0f);
+        m_CenterZ.resize(size, 0.0f);
+        m_Radii.resize(size, -std::numeric_limits<float>::infinity());
+    }
+
+    DirectX::XMFLOAT4 value;
+    DirectX::XMStoreFloat4(&value, sphere);
+
+    m_CenterX[m_Count] = value.x;
+    m_CenterY[m_Count] = value.y;
+    m_CenterZ[m_Count] = value.z;
+    m_Radii[m_Count] = value.w;
+
+    return m_Count++;
+}
+
+UINT FrustumCulling::GetCount() const
+{
+    return m_Count;
+}
+
+void FrustumCulling::Cull(const Frustum& frustum, std::vector<UINT>& visible)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    // Room for the padding lanes written past the last survivor
+    visible.resize(m_CenterX.size());
+    UINT count = CullRange(frustum, 0, m_Count, visible.data());
+    visible.resize(count);
+
+    m_Stats.m_Tested = m_Count;
+    m_Stats.m_Visible = count;
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    m_Stats.m_Time = elapsed.count();
+}
+
+void FrustumCulling::CullParallel(const Frustum& frustum, std::vector<UINT>& visible)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    // Every batch writes its survivors at its own offset, the gaps are squeezed out afterwards
+    UINT batches = (m_Count + s_BatchSize - 1) / s_BatchSize;
+    m_BatchCounts.resize(batches);
+    visible.resize(m_CenterX.size());
+
+    m_ThreadPool.ParallelFor(batches, [&](size_t batch)
+    {
+        UINT first = static_cast<UINT>(batch) * s_BatchSize;
+        UINT last = (std::min)(first + s_BatchSize, m_Count);
+
+        m_BatchCounts[batch] = CullRange(frustum, first, last, visible.data() + first);
+    });
+
+    UINT count = 0;
+
+    for (UINT batch = 0; batch < batches; batch++)
+    {
+        const UINT* source = visible.data() + static_cast<size_t>(batch) * s_BatchSize;
+        std::copy(source, source + m_BatchCounts[batch], visible.data() + count);
+        count += m_BatchCounts[batch];
+    }
+
+    visible.resize(count);
+
+    m_Stats.m_Tested = m_Count;
+    m_Stats.m_Visible = count;
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    m_Stats.m_Time = elapsed.count();
+}
+
+const CullingStats& FrustumCulling::GetStats() const
+{
+    return m_Stats;
+}
+
+UINT FrustumCulling::CullRange(const Frustum& frustum, UINT first, UINT last, UINT* visible) const
+{
+    UINT count = 0;
+
+#if defined(__AVX2__)
+    if (m_Simd)
+    {
+        __m256 planes[6][4];
+
+        for (UINT plane = 0; plane < 6; plane++)
+        {
+            planes[plane][0] = _mm256_set1_ps(frustum.m_Planes[plane].x);
+            planes[plane][1] = _mm256_set1_ps(frustum.m_Planes[plane].y);
+            planes[plane][2] = _mm256_set1_ps(frustum.m_Planes[plane].z);
+            planes[plane][3] = _mm256_set1_ps(frustum.m_Planes[plane].w);
+        }
+
+        const __m256 negativeZero = _mm256_set1_ps(-0.0f);
+
+        // Ranges end at a batch boundary or at the padded end of the arrays
+        assert(first % 8 == 0 && (last % 8 == 0 || last == m_Count));
+
+        for (UINT index = first; index < last; index += 8)
+        {
+            __m256 x = _mm256_loadu_ps(m_CenterX.data() + index);
+            __m256 y = _mm256_loadu_ps(m_CenterY.data() + index);
+            __m256 z = _mm256_loadu_ps(m_CenterZ.data() + index);
+            __m256 negativeRadius = _mm256_xor_ps(_mm256_loadu_ps(m_Radii.data() + index), negativeZero);
+
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+            for (UINT plane = 0; plane < 6; plane++)
+            {
+                __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+                    _mm256_mul_ps(planes[plane][0], x),
+                    _mm256_mul_ps(planes[plane][1], y)),
+                    _mm256_mul_ps(planes[plane][2], z)),
+                    planes[plane][3]);
+
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+            }
+
+            // Every lane is stored, only survivors advance the output
+            UINT mask = static_cast<UINT>(_mm256_movemask_ps(inside));
+
+            for (UINT lane = 0; lane < 8; lane++)
+            {
+                visible[count] = index + lane;
+                count += (mask >> lane) & 1;
+            }
+        }
+
+        return count;
+    }
+#endif // __AVX2__
+
+    for (UINT index = first; index < last; index++)
+    {
+        if (IsInside(frustum, m_CenterX[index], m_CenterY[index], m_CenterZ[index], m_Radii[index]))
+            visible[count++] = index;
+    }
+
+    return count;
+}
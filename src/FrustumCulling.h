@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "Camera.h"
+#include <windows.h>
+#include <DirectXMath.h>
+#include <vector>
+
+class ThreadPool;
+
+struct CullingStats final
+{
+    UINT m_Tested{ 0 };
+    UINT m_Visible{ 0 };
+    double m_Time{ 0.0 }; // Seconds
+};
+
+// Bounding spheres tested against the six planes of a frustum. Centers and radii are kept as separate
+// arrays padded to a multiple of 8, so the AVX2 path tests eight spheres per plane with one instruction
+// and compacts the survivors without branches. Padding spheres have a radius of minus infinity and never
+// pass. The scalar path evaluates the same expressions in the same order and produces the same lists.
+class FrustumCulling final
+{
+public:
+    static constexpr UINT s_BatchSize = 4096; // Spheres per thread pool task, multiple of 8
+
+    FrustumCulling(ThreadPool& threadPool);
+
+    // Sphere is outside if its center lies further than the radius behind any plane, the scalar path of Cull()
+    static bool IsInside(const Frustum& frustum, float x, float y, float z, float radius);
+
+    // True when built with AVX2, see DX11_AVX2 in CMakeLists.txt
+    static bool IsSimdAvailable();
+    void SetSimd(bool simd);
+
+    // Center in xyz and radius in w, returns the index reported by Cull()
+    void Clear();
+    UINT Add(const DirectX::XMVECTOR& sphere);
+    UINT GetCount() const;
+
+    // Replaces visible with indices of spheres intersecting the frustum, in ascending order
+    void Cull(const Frustum& frustum, std::vector<UINT>& visible);
+    void CullParallel(const Frustum& frustum, std::vector<UINT>& visible);
+
+    const CullingStats& GetStats() const; // Of the last Cull()
+
+private:
+    UINT CullRange(const Frustum& frustum, UINT first, UINT last, UINT* visible) const;
+
+    ThreadPool& m_ThreadPool;
+    CullingStats m_Stats;
+    bool m_Simd{ true };
+
+    UINT m_Count{ 0 };
+    std::vector<float> m_CenterX;
+    std::vector<float> m_CenterY;
+    std::vector<float> m_CenterZ;
+    std::vector<float> m_Radii;
+
+    std::vector<UINT> m_BatchCounts; // CullParallel() survivors of every batch
+};
@@ -22,24 +22,31 @@
 
 #include "Game.h"
 #include "Context.h"
+#include <algorithm>
+#include <cmath>
 
 void Game::Start(Context& context)
 {
     Window& window = context.GetWindow();
     DX11Device& device = context.GetDevice();
 
-    m_GeometryBuffer.reset(new GeometryBuffer(device));
+    m_GeometryBuffer.reset(new GeometryBuffer(device, m_GeometryLayout));
     m_FrameBuffer.reset(new FrameBuffer(device));
 
-    m_GeometryShader.reset(new Shader(device, "Geometry.fx"));
-    m_GeometryShader->SetSampler(0, D3D11_FILTER_ANISOTROPIC);
+    // Shaders writing or reading the G-buffer are compiled for its layout
+    std::vector<std::string> geometryDefines;
+    if (m_GeometryLayout == GeometryLayout::Packed)
+        geometryDefines.push_back("GEOMETRY_PACKED");
 
-    m_AmbientLightShader.reset(new Shader(device, "AmbientLight.fx"));
+    m_AmbientLightShader.reset(new Shader(device, "AmbientLight.fx", geometryDefines));
     m_AmbientLightShader->SetSampler(0, D3D11_FILTER_MIN_MAG_MIP_POINT);
 
-    m_DynamicLightShader.reset(new Shader(device, "DynamicLight.fx"));
+    m_DynamicLightShader.reset(new Shader(device, "DynamicLight.fx", geometryDefines));
     m_DynamicLightShader->SetSampler(0, D3D11_FILTER_MIN_MAG_MIP_POINT);
 
+    m_TiledLightShader.reset(new Shader(device, "TiledLight.fx", geometryDefines));
+    m_TiledLightShader->SetSampler(0, D3D11_FILTER_MIN_MAG_MIP_POINT);
+
     m_Camera.reset(new Camera());
     m_Camera->SetAspectRatio(window.GetAspectRatio());
 
@@ -58,7 +65,7 @@ void Game::Start(Context& context)
         sizeof(StaticData::s_QuadIndices)
     };
 
-    m_Frame.reset(new Mesh(device, quad));
+    m_Frame.reset(new MeshGeometry(device, quad));
 
     MeshData cube
     {
@@ -68,40 +75,78 @@ void Game::Start(Context& context)
         sizeof(StaticData::s_CubeIndices)
     };
 
-    auto& mesh1 = m_Meshes.emplace_back(new Mesh(device, cube));
+    m_ThreadPool.reset(new ThreadPool());
+    m_Transforms.reset(new TransformHierarchy(*m_ThreadPool));
+
+    // Meshes are instances of shared geometry, the quad is an occluder
+    quad.m_KeepTriangles = true;
+
+    std::shared_ptr<MeshGeometry> quadGeometry(new MeshGeometry(device, quad));
+    std::shared_ptr<MeshGeometry> cubeGeometry(new MeshGeometry(device, cube));
+
+    auto& mesh1 = m_Meshes.emplace_back(new Mesh(device, *m_Transforms, cubeGeometry));
     mesh1->Rotate(DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), 35.0f);
 
-    auto& mesh2 = m_Meshes.emplace_back(new Mesh(device, cube));
+    auto& mesh2 = m_Meshes.emplace_back(new Mesh(device, *m_Transforms, cubeGeometry));
     mesh2->Scale(DirectX::XMVectorSet(0.75f, 0.75f, 0.75f, 1.0f));
     mesh2->Move(DirectX::XMVectorSet(0.0f, 0.0f, 5.0f, 0.0f));
 
-    auto& mesh3 = m_Meshes.emplace_back(new Mesh(device, cube));
+    auto& mesh3 = m_Meshes.emplace_back(new Mesh(device, *m_Transforms, cubeGeometry));
     mesh3->Rotate(DirectX::XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), 45.0f);
     mesh3->Rotate(DirectX::XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f), 15.0f);
     mesh3->Move(DirectX::XMVectorSet(3.0f, 0.0f, 3.0f, 0.0f));
 
-    auto& mesh4 = m_Meshes.emplace_back(new Mesh(device, quad));
+    auto& mesh4 = m_Meshes.emplace_back(new Mesh(device, *m_Transforms, quadGeometry));
     mesh4->Rotate(DirectX::XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f), 90.0f);
     mesh4->Scale(DirectX::XMVectorSet(20.0f, 20.0f, 20.0f, 1.0f));
     mesh4->Move(DirectX::XMVectorSet(0.0f, -2.0f, 0.0f, 0.0f));
+    mesh4->SetOccluder(true);
+
+    // Geometry pass shaders only for the vertex formats in use, each with its input layout
+    for (const std::unique_ptr<Mesh>& mesh : m_Meshes)
+    {
+        VertexFormat format = mesh->GetGeometry().GetVertexFormat();
+        std::unique_ptr<Shader>& geometryShader = m_GeometryShaders[static_cast<UINT>(format)];
+
+        if (!geometryShader)
+        {
+            geometryShader.reset(new Shader(device, "Geometry.fx", geometryDefines, ShaderInput::Instances, format));
+            geometryShader->SetSampler(0, D3D11_FILTER_ANISOTROPIC);
+        }
+    }
 
-    m_AmbientLight.reset(new Light(device, LightType::Ambient));
+    m_InstanceBuffer.reset(new InstanceBuffer<InstanceData>(device, 1));
+    m_MeshletShortIndices.reset(new IndexBuffer<USHORT>(device));
+    m_MeshletIndices.reset(new IndexBuffer<UINT>(device));
+
+    m_AmbientLight.reset(new Light(device, *m_Transforms, LightType::Ambient));
     m_AmbientLight->SetIntensity(0.2f);
 
     //auto& light1 = m_DynamicLights.emplace_back(new DynamicLight(device, LightType::Direction));
     //auto& light1 = m_DynamicLights.emplace_back(new DynamicLight(device, LightType::Point));
-    auto& light1 = m_Lights.emplace_back(new Light(device, LightType::Spot));
+    auto& light1 = m_Lights.emplace_back(new Light(device, *m_Transforms, LightType::Spot));
     light1->SetColor({ 1.0f, 0.0f, 0.0f });
     light1->Move(DirectX::XMVectorSet(0.0f, 5.0f, 5.0f, 0.0f));
     light1->Rotate(DirectX::XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f), 135.0f);
 
     //auto& light2 = m_DynamicLights.emplace_back(new DynamicLight(device, LightType::Direction));
     //auto& light2 = m_DynamicLights.emplace_back(new DynamicLight(device, LightType::Point));
-    auto& light2 = m_Lights.emplace_back(new Light(device, LightType::Spot));
+    auto& light2 = m_Lights.emplace_back(new Light(device, *m_Transforms, LightType::Spot));
     light2->SetColor({ 0.0f, 1.0f, 0.0f });
     light2->Move(DirectX::XMVectorSet(0.0f, 5.0f, -5.0f, 0.0f));
     light2->Rotate(DirectX::XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f), 45.0f);
 
+    m_SceneHierarchy.reset(new BoundingVolumeHierarchy(*m_ThreadPool));
+    m_LightCulling.reset(new FrustumCulling(*m_ThreadPool));
+    m_OcclusionCulling.reset(new OcclusionCulling(*m_ThreadPool, 256, static_cast<UINT>(256.0f / window.GetAspectRatio())));
+
+    m_LightTiles.reset(new LightTiles());
+    m_LightClusters.reset(new LightClusters(*m_ThreadPool));
+    m_LightGrid.reset(new ConstantBuffer<LightGrid>(device, 2, ResourceInput::INPUT_PIXEL_SHADER, ConstantUsage::Frame));
+    m_TiledLights.reset(new StructuredBuffer<TiledLightData>(device, 5));
+    m_TileLightIndices.reset(new StructuredBuffer<UINT>(device, 6));
+    m_TileLightRanges.reset(new StructuredBuffer<DirectX::XMUINT2>(device, 7));
+
     context.OnKeyDown.Connect(std::bind(&Game::OnKeyDown, this, std::placeholders::_1, std::placeholders::_2));
     context.OnKeyUp.Connect(std::bind(&Game::OnKeyUp, this, std::placeholders::_1, std::placeholders::_2));
     context.OnMouseDown.Connect(std::bind(&Game::OnMouseDown, this, std::placeholders::_1, std::placeholders::_2));
@@ -151,23 +196,203 @@ void Game::Update(Context& context)
 
 void Game::Render(Context& context)
 {
-    m_GeometryBuffer->Enable();
+    m_DrawQueue.Clear();
+
+    // Only nodes moved since the last frame and their descendants pay for their matrices
+    m_Transforms->Update();
+    Mesh::UpdateWorlds(m_Meshes, m_MovedMeshes);
 
     {
-        m_GeometryShader->Enable();
-        m_GeometryShader->SetViewProjection(DirectX::XMMatrixMultiply(m_Camera->GetView(), m_Camera->GetProjection()));
+        // Built once all meshes have their worlds, moved ones are refitted from then on
+        if (m_SceneHierarchy->GetCount() != m_Meshes.size())
+        {
+            std::vector<BvhBounds> bounds;
+            for (auto& mesh : m_Meshes)
+                bounds.push_back({ mesh->GetBoundsMin(), mesh->GetBoundsMax() });
 
-        m_Material->Enable();
-        m_Texture->Enable();
+            m_SceneHierarchy->Build(bounds);
+        }
+        else if (!m_MovedMeshes.empty())
+        {
+            for (UINT index : m_MovedMeshes)
+                m_SceneHierarchy->Update(index, { m_Meshes[index]->GetBoundsMin(), m_Meshes[index]->GetBoundsMax() });
+
+            m_SceneHierarchy->Refit();
+        }
 
-        for (auto& mesh : m_Meshes)
+        // Ambient light lights everything and is never culled
+        m_LightCulling->Clear();
+        for (auto& light : m_Lights)
+            m_LightCulling->Add(light->GetBoundingSphere());
+
+        const Frustum& frustum = m_Camera->GetFrustum();
+        m_LightCulling->CullParallel(frustum, m_VisibleLights);
+
+        // Draw order does not depend on the tree layout
+        m_SceneHierarchy->CullFrustum(frustum, m_VisibleMeshes);
+        std::sort(m_VisibleMeshes.begin(), m_VisibleMeshes.end());
+    }
+
+    {
+        // Occluders are always drawn, the rest only if some part of their box is in front of them
+        m_OcclusionCulling->Begin(m_Camera->GetViewProjection());
+        m_OcclusionQueries.clear();
+
+        for (UINT index : m_VisibleMeshes)
         {
-            m_GeometryShader->SetWorld(mesh->GetWorld());
-            m_GeometryShader->UpdateTransform();
+            const Mesh& mesh = *m_Meshes[index];
+            const MeshGeometry& geometry = mesh.GetGeometry();
+
+            if (mesh.IsOccluder())
+                m_OcclusionCulling->AddOccluder(geometry.GetPositions(), geometry.GetIndices(), m_Transforms->GetWorld(mesh.GetTransform()));
+            else
+                m_OcclusionQueries.push_back({ mesh.GetBoundsMin(), mesh.GetBoundsMax(), geometry.GetIndexCount() / 3 });
+        }
+
+        m_OcclusionCulling->Rasterize();
+        m_OcclusionCulling->Test(m_OcclusionQueries);
+
+        // Queries follow the visible meshes, skipping occluders
+        size_t query = 0;
+        size_t visible = 0;
+
+        for (UINT index : m_VisibleMeshes)
+        {
+            if (m_Meshes[index]->IsOccluder() || !m_OcclusionQueries[query++].m_IsOccluded)
+                m_VisibleMeshes[visible++] = index;
+        }
+
+        m_VisibleMeshes.resize(visible);
+    }
+
+    {
+        // Normalized view depth of mesh origins, the scene has one shader, material and texture
+        const DirectX::XMVECTOR& cameraPosition = m_Camera->GetPosition();
+        const DirectX::XMVECTOR& cameraForward = m_Camera->GetForward();
+
+        float nearPlane = m_Camera->GetNearPlane();
+        float depthScale = 1.0f / (m_Camera->GetFarPlane() - nearPlane);
+
+        // Screen pixels covered by one unit at distance one
+        float pixelsPerUnit = 0.5f * static_cast<float>(context.GetWindow().GetHeight()) / std::tan(0.5f * DirectX::XMConvertToRadians(m_Camera->GetFov()));
+
+        m_LodStats = { };
+
+        for (UINT index : m_VisibleMeshes)
+        {
+            Mesh& mesh = *m_Meshes[index];
+            const MeshGeometry& geometry = mesh.GetGeometry();
+
+            UINT previousLod = mesh.GetLod();
+            UINT lod = mesh.SelectLod(cameraPosition, pixelsPerUnit, m_LodThreshold);
+
+            m_LodStats.m_Triangles += geometry.GetLod(lod).m_IndexCount / 3;
+            m_LodStats.m_FullTriangles += geometry.GetIndexCount() / 3;
+            m_LodStats.m_Switches += lod != previousLod ? 1 : 0;
+
+            DirectX::XMVECTOR offset = DirectX::XMVectorSubtract(mesh.GetWorldPosition(), cameraPosition);
+            float depth = (DirectX::XMVectorGetX(DirectX::XMVector3Dot(offset, cameraForward)) - nearPlane) * depthScale;
+
+            // Levels of a geometry draw apart, vertex formats select the shader
+            UINT shader = static_cast<UINT>(geometry.GetVertexFormat());
+            m_DrawQueue.Push(DrawKey::Make(DrawPass::Opaque, shader, 0, 0, geometry.GetId() * MeshGeometry::s_MaxLods + lod, depth), index);
+        }
+
+        m_DrawQueue.Sort();
+    }
+
+    m_DrawBatches.clear();
+    m_Instances.clear();
+
+    {
+        m_MeshletCulling.Begin(m_Camera->GetFrustum(), m_Camera->GetPosition());
+
+        // Instances of a batch keep the sorted order, geometry ids may collide once truncated to the key
+        for (const DrawItem& item : m_DrawQueue.GetItems())
+        {
+            const Mesh& mesh = *m_Meshes[item.m_Index];
+            MeshGeometry* geometry = &mesh.GetGeometry();
+
+            if (mesh.GetLod() == 0 && !geometry->GetMeshlets().m_Meshlets.empty())
+            {
+                UINT indexCount = 0;
+                UINT firstIndex = m_MeshletCulling.Cull(*geometry, m_Transforms->GetWorld(mesh.GetTransform()), m_Transforms->GetWorldScale(mesh.GetTransform()), indexCount);
+
+                if (indexCount > 0)
+                {
+                    m_DrawBatches.push_back({ item.m_Key, geometry, 0, static_cast<UINT>(m_Instances.size()), 1, true, firstIndex, indexCount });
+                    m_Instances.push_back(mesh.GetInstance());
+                }
+
+                continue;
+            }
+
+            bool isBatched = !m_DrawBatches.empty() && !m_DrawBatches.back().m_IsMeshlets && m_DrawBatches.back().m_Geometry == geometry && m_DrawBatches.back().m_Lod == mesh.GetLod() &&
+                (m_DrawBatches.back().m_Key >> DrawKey::s_MeshShift) == (item.m_Key >> DrawKey::s_MeshShift);
+
+            if (!isBatched)
+                m_DrawBatches.push_back({ item.m_Key, geometry, mesh.GetLod(), static_cast<UINT>(m_Instances.size()), 0, false, 0, 0 });
+
+            m_DrawBatches.back().m_InstanceCount++;
+            m_Instances.push_back(mesh.GetInstance());
+        }
+
+        m_InstanceBuffer->Update(m_Instances);
+        m_MeshletShortIndices->Update(m_MeshletCulling.GetShortIndices());
+        m_MeshletIndices->Update(m_MeshletCulling.GetIndices());
+    }
+
+    m_GeometryBuffer->Enable();
+
+    {
+        m_InstanceBuffer->Enable();
 
-            mesh->Enable();
-            mesh->Draw();
+        for (size_t batch = 0; batch < m_DrawBatches.size(); batch++)
+        {
+            // State is bound only when its key field differs from the previous batch
+            const DrawBatch& drawBatch = m_DrawBatches[batch];
+
+            UINT64 key = drawBatch.m_Key;
+            UINT64 previousKey = batch > 0 ? m_DrawBatches[batch - 1].m_Key : ~key;
+
+            if (DrawKey::GetShader(key) != DrawKey::GetShader(previousKey))
+            {
+                // Updated first, so the buffers are bound straight to their ring windows
+                Shader& geometryShader = *m_GeometryShaders[DrawKey::GetShader(key)];
+                geometryShader.SetViewProjection(m_Camera->GetViewProjection());
+                geometryShader.UpdateTransform();
+                geometryShader.Enable();
+            }
+
+            if (DrawKey::GetMaterial(key) != DrawKey::GetMaterial(previousKey))
+                m_Material->Enable();
+
+            if (DrawKey::GetTexture(key) != DrawKey::GetTexture(previousKey))
+                m_Texture->Enable();
+
+            // Meshlet batches replace the index buffer of their geometry
+            const DrawBatch* previousBatch = batch > 0 ? &m_DrawBatches[batch - 1] : nullptr;
+
+            if (previousBatch == nullptr || previousBatch->m_Geometry != drawBatch.m_Geometry || (previousBatch->m_IsMeshlets && !drawBatch.m_IsMeshlets))
+                drawBatch.m_Geometry->Enable();
+
+            if (drawBatch.m_IsMeshlets)
+            {
+                if (previousBatch == nullptr || !previousBatch->m_IsMeshlets || previousBatch->m_Geometry != drawBatch.m_Geometry)
+                {
+                    if (drawBatch.m_Geometry->GetIndexFormat() == DXGI_FORMAT_R16_UINT)
+                        m_MeshletShortIndices->Enable();
+                    else
+                        m_MeshletIndices->Enable();
+                }
+
+                drawBatch.m_Geometry->DrawRange(drawBatch.m_FirstIndex, drawBatch.m_IndexCount, drawBatch.m_FirstInstance);
+            }
+            else
+                drawBatch.m_Geometry->DrawInstanced(drawBatch.m_InstanceCount, drawBatch.m_FirstInstance, drawBatch.m_Lod);
         }
+
+        m_InstanceBuffer->Disable();
     }
 
     m_GeometryBuffer->Disable();
@@ -175,11 +400,60 @@ void Game::Render(Context& context)
     m_FrameBuffer->Enable();
     m_Frame->Enable();
 
-    m_GeometryBuffer->GetDiffuseTexture().Enable();
-    m_GeometryBuffer->GetSpecularTexture().Enable();
-    m_GeometryBuffer->GetPositionTexture().Enable();
-    m_GeometryBuffer->GetNormalTexture().Enable();
+    m_GeometryBuffer->EnableTextures();
+
+    Window& window = context.GetWindow();
+
+    UINT width = static_cast<UINT>(window.GetWidth());
+    UINT height = static_cast<UINT>(window.GetHeight());
 
+    if (m_LightingMode != LightingMode::Passes)
+    {
+        // Ambient light goes first, it overwrites the frame like a separate pass would
+        std::vector<const Light*> lights;
+        if (m_AmbientLight != nullptr)
+            lights.push_back(m_AmbientLight.get());
+
+        for (UINT index : m_VisibleLights)
+            lights.push_back(m_Lights[index].get());
+
+        if (m_LightingMode == LightingMode::Tiles)
+        {
+            m_LightTiles->Build(*m_Camera, width, height, lights);
+
+            m_LightGrid->Update(m_LightTiles->GetGrid());
+            m_TiledLights->Update(m_LightTiles->GetLights());
+            m_TileLightIndices->Update(m_LightTiles->GetIndices());
+            m_TileLightRanges->Update(m_LightTiles->GetRanges());
+        }
+        else
+        {
+            m_LightClusters->Build(*m_Camera, width, height, lights);
+
+            m_LightGrid->Update(m_LightClusters->GetGrid());
+            m_TiledLights->Update(m_LightClusters->GetLights());
+            m_TileLightIndices->Update(m_LightClusters->GetIndices());
+            m_TileLightRanges->Update(m_LightClusters->GetRanges());
+        }
+
+        m_TiledLightShader->SetCameraPosition(m_Camera->GetPosition());
+        m_TiledLightShader->SetInverseViewProjection(m_Camera->GetInverseViewProjection());
+        m_TiledLightShader->UpdateVectors();
+        m_TiledLightShader->Enable();
+
+        m_LightGrid->Enable();
+        m_TiledLights->Enable();
+        m_TileLightIndices->Enable();
+        m_TileLightRanges->Enable();
+
+        m_Frame->Draw();
+
+        m_LightGrid->Disable();
+        m_TiledLights->Disable();
+        m_TileLightIndices->Disable();
+        m_TileLightRanges->Disable();
+    }
+    else
     {
         m_AmbientLightShader->Enable();
 
@@ -188,32 +462,86 @@ void Game::Render(Context& context)
             m_AmbientLight->Enable();
             m_Frame->Draw();
         }
-    }
 
-    {
         m_DynamicLightShader->Enable();
         m_DynamicLightShader->SetCameraPosition(m_Camera->GetPosition());
+        m_DynamicLightShader->SetInverseViewProjection(m_Camera->GetInverseViewProjection());
 
-        for (auto& light : m_Lights)
+        for (UINT index : m_VisibleLights)
         {
+            // Light volume: lights out of view are skipped, the rest only shade pixels their volume covers
+            const std::unique_ptr<Light>& light = m_Lights[index];
+            DirectX::XMVECTOR bounds = light->GetBoundingSphere();
+            DirectX::XMFLOAT4 rect;
+
+            if (!m_Camera->ProjectSphere(bounds, rect))
+                continue;
+
+            DirectX::XMUINT4 pixels = LightTiles::GetTileRect(rect, width, height, 1);
+            D3D11_RECT scissorRect{ static_cast<LONG>(pixels.x), static_cast<LONG>(pixels.y), static_cast<LONG>(pixels.z + 1), static_cast<LONG>(pixels.w + 1) };
+            m_FrameBuffer->SetScissorRect(&scissorRect);
+
             m_DynamicLightShader->SetLightPosition(light->GetPosition());
             m_DynamicLightShader->SetLightDirection(light->GetDirection());
+            m_DynamicLightShader->SetLightBounds(bounds);
             m_DynamicLightShader->UpdateVectors();
 
             light->Enable();
             m_Frame->Draw();
         }
+
+        m_FrameBuffer->SetScissorRect(nullptr);
     }
 
-    m_GeometryBuffer->GetDiffuseTexture().Disable();
-    m_GeometryBuffer->GetSpecularTexture().Disable();
-    m_GeometryBuffer->GetPositionTexture().Disable();
-    m_GeometryBuffer->GetNormalTexture().Disable();
+    m_GeometryBuffer->DisableTextures();
+}
+
+void Game::SetGeometryLayout(GeometryLayout layout)
+{
+    m_GeometryLayout = layout;
+}
+
+const DrawQueueStats& Game::GetDrawStats() const
+{
+    return m_DrawQueue.GetStats();
+}
+
+const CullingStats& Game::GetMeshCullingStats() const
+{
+    return m_SceneHierarchy->GetCullingStats();
+}
+
+const CullingStats& Game::GetLightCullingStats() const
+{
+    return m_LightCulling->GetStats();
+}
+
+const BvhStats& Game::GetSceneStats() const
+{
+    return m_SceneHierarchy->GetStats();
+}
+
+const OcclusionStats& Game::GetOcclusionStats() const
+{
+    return m_OcclusionCulling->GetStats();
+}
+
+const LodStats& Game::GetLodStats() const
+{
+    return m_LodStats;
+}
+
+const MeshletCullingStats& Game::GetMeshletStats() const
+{
+    return m_MeshletCulling.GetStats();
 }
 
 
 void Game::OnKeyDown(Context& context, unsigned int key)
-{ }
+{
+    if (key == 'L')
+        m_LightingMode = static_cast<LightingMode>((static_cast<int>(m_LightingMode) + 1) % 3);
+}
 
 void Game::OnKeyUp(Context& context, unsigned int key)
 { }
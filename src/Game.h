@@ -30,11 +30,28 @@
 #include "Material.h"
 #include "Texture.h"
 #include "Light.h"
+#include "LightTiles.h"
+#include "LightClusters.h"
+#include "ThreadPool.h"
+#include "TransformHierarchy.h"
+#include "FrustumCulling.h"
+#include "OcclusionCulling.h"
+#include "MeshletCulling.h"
+#include "BoundingVolumeHierarchy.h"
+#include "Buffer.h"
+#include "DrawQueue.h"
 #include <memory>
 #include <vector>
 
 class Context;
 
+enum class LightingMode
+{
+    Passes,  // AmbientLight.fx and one DynamicLight.fx pass per light
+    Tiles,   // TiledLight.fx over LightTiles lists
+    Clusters // TiledLight.fx over LightClusters lists
+};
+
 class Game final : public Application
 {
 public:
@@ -44,6 +61,22 @@ public:
     void Update(Context& context) override;
     void Render(Context& context);
 
+    // Takes effect on Start()
+    void SetGeometryLayout(GeometryLayout layout);
+
+    // Geometry pass draws of the last frame
+    const DrawQueueStats& GetDrawStats() const;
+
+    // Frustum culling of the last frame
+    const CullingStats& GetMeshCullingStats() const;
+    const CullingStats& GetLightCullingStats() const;
+    const BvhStats& GetSceneStats() const;
+    const OcclusionStats& GetOcclusionStats() const;
+
+    // Levels of detail drawn in the last frame
+    const LodStats& GetLodStats() const;
+    const MeshletCullingStats& GetMeshletStats() const;
+
     void OnKeyDown(Context& context, unsigned int key);
     void OnKeyUp(Context& context, unsigned int key);
     void OnMouseDown(Context& context, unsigned int key);
@@ -51,22 +84,80 @@ public:
     void OnMouseMove(Context& context, int x, int y);
 
 private:
+    GeometryLayout m_GeometryLayout{ GeometryLayout::Packed };
+
+    // Run of sorted draws sharing state and geometry, drawn as instances of one call
+    struct DrawBatch
+    {
+        UINT64 m_Key; // Of the first draw
+        MeshGeometry* m_Geometry;
+        UINT m_Lod;
+        UINT m_FirstInstance;
+        UINT m_InstanceCount;
+
+        // Meshes culled by meshlets are drawn alone from a range of the meshlet indices of their index format
+        bool m_IsMeshlets;
+        UINT m_FirstIndex;
+        UINT m_IndexCount;
+    };
+
     std::unique_ptr<GeometryBuffer> m_GeometryBuffer;
     std::unique_ptr<FrameBuffer> m_FrameBuffer;
 
-    std::unique_ptr<Shader> m_GeometryShader;
+    std::unique_ptr<Shader> m_GeometryShaders[VertexEncoding::s_FormatCount]; // By VertexFormat, created for formats in use
     std::unique_ptr<Shader> m_AmbientLightShader;
     std::unique_ptr<Shader> m_DynamicLightShader;
+    std::unique_ptr<Shader> m_TiledLightShader;
+
+    // Places meshes and lights, declared first to outlive them
+    std::unique_ptr<TransformHierarchy> m_Transforms;
 
     std::unique_ptr<Camera> m_Camera;
     std::unique_ptr<Material> m_Material;
     std::unique_ptr<ImageTexture> m_Texture;
 
-    std::unique_ptr<Mesh> m_Frame;
+    std::unique_ptr<MeshGeometry> m_Frame;
     std::vector<std::unique_ptr<Mesh>> m_Meshes;
 
+    // Geometry pass order and instances, rebuilt every frame
+    DrawQueue m_DrawQueue;
+    std::vector<DrawBatch> m_DrawBatches;
+    std::vector<InstanceData> m_Instances;
+    std::unique_ptr<InstanceBuffer<InstanceData>> m_InstanceBuffer;
+
+    // Meshes with meshlets drawn at level 0 only draw meshlets facing the camera and in view
+    MeshletCulling m_MeshletCulling;
+    std::unique_ptr<IndexBuffer<USHORT>> m_MeshletShortIndices;
+    std::unique_ptr<IndexBuffer<UINT>> m_MeshletIndices;
+
     std::unique_ptr<Light> m_AmbientLight;
     std::vector<std::unique_ptr<Light>> m_Lights;
 
+    // Only meshes and lights in view are drawn. Mesh boxes are indexed by the scene hierarchy, refitted as
+    // meshes move, light spheres are gathered every frame.
+    std::unique_ptr<BoundingVolumeHierarchy> m_SceneHierarchy;
+    std::unique_ptr<FrustumCulling> m_LightCulling;
+    std::vector<UINT> m_MovedMeshes;
+    std::vector<UINT> m_VisibleMeshes;
+    std::vector<UINT> m_VisibleLights;
+
+    // Meshes in view are tested against the occluders in view before they are drawn
+    std::unique_ptr<OcclusionCulling> m_OcclusionCulling;
+    std::vector<OcclusionQuery> m_OcclusionQueries;
+
+    // Meshes are drawn at the coarsest level of detail whose error stays below a pixel
+    float m_LodThreshold{ 1.0f };
+    LodStats m_LodStats;
+
+    // Single pass lighting over per tile or per cluster light lists, L cycles lighting modes
+    std::unique_ptr<ThreadPool> m_ThreadPool;
+    std::unique_ptr<LightTiles> m_LightTiles;
+    std::unique_ptr<LightClusters> m_LightClusters;
+    std::unique_ptr<ConstantBuffer<LightGrid>> m_LightGrid;
+    std::unique_ptr<StructuredBuffer<TiledLightData>> m_TiledLights;
+    std::unique_ptr<StructuredBuffer<UINT>> m_TileLightIndices;
+    std::unique_ptr<StructuredBuffer<DirectX::XMUINT2>> m_TileLightRanges;
+    LightingMode m_LightingMode{ LightingMode::Clusters };
+
     bool m_IsLeftMouseButtonPressed{ false };
 };
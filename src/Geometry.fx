@@ -26,36 +26,63 @@
 
 cbuffer VertexTransform : register(b0)
 {
-    float4x4 worldVertices;
-    float4x4 worldNormals;
     float4x4 viewProjection;
 };
 
 struct VertexInput
 {
     float3 position : POSITION;
+#ifdef VERTEX_OCTAHEDRAL_NORMALS
+    float2 normal : NORMAL; // Octahedral projection, see VertexEncoding
+#else  // VERTEX_OCTAHEDRAL_NORMALS
     float3 normal : NORMAL;
+#endif // VERTEX_OCTAHEDRAL_NORMALS
     float2 texcoord : TEXCOORD;
+
+    // Matrix rows of the instance, see InstanceData
+    float4 world0 : INSTANCE_WORLD0;
+    float4 world1 : INSTANCE_WORLD1;
+    float4 world2 : INSTANCE_WORLD2;
+    float4 world3 : INSTANCE_WORLD3;
+    float4 normals0 : INSTANCE_NORMALS0;
+    float4 normals1 : INSTANCE_NORMALS1;
+    float4 normals2 : INSTANCE_NORMALS2;
+    float4 normals3 : INSTANCE_NORMALS3;
 };
 
 struct VertexOutput
 {
     float4 projectionPosition : SV_POSITION; // System Value
-    float3 pixelPosition : PIXEL_POSITION;
     float3 pixelNormal : PIXEL_NORMAL;
     float2 texcoord : TEXCOORD;
 };
 
+#ifdef VERTEX_OCTAHEDRAL_NORMALS
+#include "GeometryPacking.fxh"
+
+float3 DecodeVertexNormal(float2 octahedron)
+{
+    return UnfoldOctahedral(octahedron);
+}
+#else  // VERTEX_OCTAHEDRAL_NORMALS
+float3 DecodeVertexNormal(float3 normal)
+{
+    return normal;
+}
+#endif // VERTEX_OCTAHEDRAL_NORMALS
+
 VertexOutput Main(VertexInput input)
 {
+    float4x4 worldVertices = float4x4(input.world0, input.world1, input.world2, input.world3);
+    float4x4 worldNormals = float4x4(input.normals0, input.normals1, input.normals2, input.normals3);
+
     float4 vertexPosition = float4(input.position, 1.0f);
-    float4 vertexNormal = float4(input.normal, 1.0f);
+    float4 vertexNormal = float4(DecodeVertexNormal(input.normal), 1.0f);
     float4x4 worldViewProjection = mul(worldVertices, viewProjection);
 
     VertexOutput output;
 
     output.projectionPosition = mul(vertexPosition, worldViewProjection);
-    output.pixelPosition = mul(vertexPosition, worldVertices).xyz;
     output.pixelNormal = mul(vertexNormal, worldNormals).xyz;
     output.texcoord = input.texcoord;
 
@@ -66,6 +93,8 @@ VertexOutput Main(VertexInput input)
 
 #ifdef PIXEL_SHADER
 
+#include "GeometryPacking.fxh"
+
 Texture2D diffuseTexture : register(t0);
 SamplerState diffuseSampler : register(s0);
 
@@ -80,18 +109,25 @@ cbuffer Material : register(b0)
 struct PixelInput
 {
     float4 projectionPosition : SV_POSITION; // System Value
-    float3 pixelPosition: PIXEL_POSITION;
     float3 pixelNormal: PIXEL_NORMAL;
     float2 texcoord : TEXCOORD;
 };
 
+#ifdef GEOMETRY_PACKED
+struct PixelOutput
+{
+    float4 albedo : SV_Target0;   // System Value
+    float4 normal : SV_Target1;   // System Value
+    float4 material : SV_Target2; // System Value
+};
+#else  // GEOMETRY_PACKED
 struct PixelOutput
 {
     float4 diffuse : SV_Target0;  // System Value
     float4 specular : SV_Target1; // System Value
-    float4 position : SV_Target2; // System Value
-    float4 normal : SV_Target3;   // System Value
+    float4 normal : SV_Target2;   // System Value
 };
+#endif // GEOMETRY_PACKED
 
 PixelOutput Main(PixelInput input)
 {
@@ -100,10 +136,17 @@ PixelOutput Main(PixelInput input)
 
     PixelOutput output;
 
+#ifdef GEOMETRY_PACKED
+    // Specular color is not stored
+    output.albedo = float4(diffuseColor, 1.0f);
+    output.normal = float4(EncodeNormal(input.pixelNormal), 0.0f, 0.0f);
+    output.material = EncodeMaterial(ambientIntensity, diffuseIntensity, specularIntensity, specularHardness);
+#else  // GEOMETRY_PACKED
+    // Position is rebuilt from depth, its target used to hold specular intensity
     output.diffuse = float4(diffuseColor, ambientIntensity);
-    output.specular = float4(specularColor, diffuseIntensity);
-    output.position = float4(input.pixelPosition, specularIntensity);
+    output.specular = float4(mul(specularColor, specularIntensity), diffuseIntensity);
     output.normal = float4(input.pixelNormal, specularHardness);
+#endif // GEOMETRY_PACKED
 
     return output;
 }
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "GeometryPacking.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    float Saturate(float value)
+    {
+        return value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f;
+    }
+
+    UINT ToUnorm(float value, float scale)
+    {
+        return static_cast<UINT>(Saturate(value) * scale + 0.5f);
+    }
+
+    float ToSrgb(float value)
+    {
+        value = Saturate(value);
+        return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+    }
+
+    float FromSrgb(float value)
+    {
+        return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+    }
+
+    // Every 8-bit sRGB value decoded once
+    struct SrgbTable
+    {
+        SrgbTable()
+        {
+            for (UINT value = 0; value < 256; value++)
+                m_Linear[value] = FromSrgb(static_cast<float>(value) / 255.0f);
+        }
+
+        float m_Linear[256];
+    };
+
+    const SrgbTable s_SrgbTable;
+}
+
+UINT GeometryPacking::EncodeAlbedo(const DirectX::XMFLOAT3& color)
+{
+    return ToUnorm(ToSrgb(color.x), 255.0f) | (ToUnorm(ToSrgb(color.y), 255.0f) << 8) | (ToUnorm(ToSrgb(color.z), 255.0f) << 16) | 0xff000000;
+}
+
+DirectX::XMFLOAT3 GeometryPacking::DecodeAlbedo(UINT texel)
+{
+    return DirectX::XMFLOAT3(s_SrgbTable.m_Linear[texel & 0xff], s_SrgbTable.m_Linear[(texel >> 8) & 0xff], s_SrgbTable.m_Linear[(texel >> 16) & 0xff]);
+}
+
+DirectX::XMFLOAT2 GeometryPacking::FoldOctahedral(const DirectX::XMFLOAT3& normal)
+{
+    // Interpolated normals can cancel out, a zero normal lands in the center of the square
+    float length = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+    float inverseLength = 1.0f / (std::max)(length, 1e-20f);
+
+    float x = normal.x * inverseLength;
+    float y = normal.y * inverseLength;
+    float z = normal.z * inverseLength;
+
+    if (z < 0.0f)
+    {
+        float foldedX = (1.0f - std::fabs(y)) * std::copysign(1.0f, x);
+        float foldedY = (1.0f - std::fabs(x)) * std::copysign(1.0f, y);
+
+        x = foldedX;
+        y = foldedY;
+    }
+
+    return DirectX::XMFLOAT2(x, y);
+}
+
+DirectX::XMFLOAT3 GeometryPacking::UnfoldOctahedral(const DirectX::XMFLOAT2& octahedron)
+{
+    float x = octahedron.x;
+    float y = octahedron.y;
+    float z = 1.0f - std::fabs(x) - std::fabs(y);
+
+    float fold = (std::max)(-z, 0.0f);
+    x += x >= 0.0f ? -fold : fold;
+    y += y >= 0.0f ? -fold : fold;
+
+    float length = std::sqrt(x * x + y * y + z * z);
+    return DirectX::XMFLOAT3(x / length, y / length, z / length);
+}
+
+UINT GeometryPacking::EncodeNormal(const DirectX::XMFLOAT3& normal)
+{
+    DirectX::XMFLOAT2 octahedron = FoldOctahedral(normal);
+    return ToUnorm(octahedron.x * 0.5f + 0.5f, 65535.0f) | (ToUnorm(octahedron.y * 0.5f + 0.5f, 65535.0f) << 16);
+}
+
+DirectX::XMFLOAT3 GeometryPacking::DecodeNormal(UINT texel)
+{
+    float x = static_cast<float>(texel & 0xffff) / 65535.0f * 2.0f - 1.0f;
+    float y = static_cast<float>(texel >> 16) / 65535.0f * 2.0f - 1.0f;
+    return UnfoldOctahedral(DirectX::XMFLOAT2(x, y));
+}
+
+UINT GeometryPacking::EncodeMaterial(float ambientIntensity, float diffuseIntensity, float specularIntensity, int specularHardness)
+{
+    UINT hardness = static_cast<UINT>(std::clamp(specularHardness, 0, 255));
+    return ToUnorm(ambientIntensity, 255.0f) | (ToUnorm(diffuseIntensity, 255.0f) << 8) | (ToUnorm(specularIntensity, 255.0f) << 16) | (hardness << 24);
+}
+
+DirectX::XMFLOAT4 GeometryPacking::DecodeMaterial(UINT texel)
+{
+    return DirectX::XMFLOAT4(
+        static_cast<float>(texel & 0xff) / 255.0f,
+        static_cast<float>((texel >> 8) & 0xff) / 255.0f,
+        static_cast<float>((texel >> 16) & 0xff) / 255.0f,
+        static_cast<float>(texel >> 24));
+}
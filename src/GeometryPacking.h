@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <d3d11.h>
+#include <DirectXMath.h>
+
+enum class GeometryLayout
+{
+    Full,  // Three DXGI_FORMAT_R32G32B32A32_FLOAT targets: diffuse, specular and normal
+    Packed // Albedo, normal and material targets
+};
+
+// Texels of the packed GeometryBuffer layout, CPU mirror of GeometryPacking.fxh.
+// Every target is 32 bits per pixel, channels are stored in DXGI order starting from the low bits.
+class GeometryPacking final
+{
+public:
+    static constexpr DXGI_FORMAT s_AlbedoFormat = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+    static constexpr DXGI_FORMAT s_NormalFormat = DXGI_FORMAT_R16G16_UNORM;
+    static constexpr DXGI_FORMAT s_MaterialFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+    // Largest round trip errors, checked by -benchmark packing. Hardness survives exactly.
+    static constexpr float s_MaxNormalError = 0.05f;     // Degrees
+    static constexpr float s_MaxAlbedoError = 0.005f;    // Per linear channel
+    static constexpr float s_MaxIntensityError = 0.002f; // Half of an 8-bit step
+
+    // Linear color, the sRGB curve is applied by the target on GPU
+    static UINT EncodeAlbedo(const DirectX::XMFLOAT3& color);
+    static DirectX::XMFLOAT3 DecodeAlbedo(UINT texel);
+
+    // Normal projected on the octahedron |x| + |y| + |z| = 1 in [-1, 1], the lower half folded over the
+    // diagonals. The normal does not have to be normalized, VertexEncoding stores vertex normals this way too.
+    static DirectX::XMFLOAT2 FoldOctahedral(const DirectX::XMFLOAT3& normal);
+    static DirectX::XMFLOAT3 UnfoldOctahedral(const DirectX::XMFLOAT2& octahedron);
+
+    // Octahedral projection remapped to [0, 1]
+    static UINT EncodeNormal(const DirectX::XMFLOAT3& normal);
+    static DirectX::XMFLOAT3 DecodeNormal(UINT texel);
+
+    // Intensities are clamped to [0, 1] and hardness to [0, 255], decoded hardness is in w
+    static UINT EncodeMaterial(float ambientIntensity, float diffuseIntensity, float specularIntensity, int specularHardness);
+    static DirectX::XMFLOAT4 DecodeMaterial(UINT texel);
+};
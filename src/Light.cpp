@@ -22,13 +22,23 @@
 
 #include "Light.h"
 #include "Device.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
-Light::Light(DX11Device& device, LightType type)
+Light::Light(DX11Device& device, TransformHierarchy& transforms, LightType type, TransformId parent)
+    : m_Transforms(transforms)
+    , m_Transform(transforms.Create(parent))
 {
     m_LightData.m_Type = type;
     m_LightBuffer.reset(new ConstantBuffer<LightData>(device, 0, ResourceInput::INPUT_PIXEL_SHADER));
 }
 
+LightType Light::GetType() const
+{
+    return m_LightData.m_Type;
+}
+
 const DirectX::XMFLOAT3& Light::GetColor() const
 {
     return m_LightData.m_Color;
@@ -84,25 +94,69 @@ void Light::SetSpotBorder(float border)
     m_IsDataDirty = true;
 }
 
-const DirectX::XMVECTOR& Light::GetPosition() const
+float Light::GetRange() const
 {
-    return m_Position;
+    if (m_LightData.m_Type == LightType::Ambient || m_LightData.m_Type == LightType::Direction)
+        return std::numeric_limits<float>::infinity();
+
+    // Solve color * intensity * falloff^2 / (falloff^2 + distance^2) = 1 / 255 for distance
+    const DirectX::XMFLOAT3& color = m_LightData.m_Color;
+    float energy = (std::max)({ color.x, color.y, color.z }) * m_LightData.m_Intensity * 255.0f;
+
+    if (energy <= 1.0f)
+        return 0.0f;
+
+    return m_LightData.m_Falloff * std::sqrt(energy - 1.0f);
 }
 
-void Light::Move(const DirectX::XMVECTOR& position)
+DirectX::XMVECTOR Light::GetBoundingSphere() const
 {
-    m_Position = DirectX::XMVectorAdd(m_Position, position);
+    float range = GetRange();
+    float angle = m_LightData.m_SpotAngle;
+
+    if (m_LightData.m_Type != LightType::Spot || std::isinf(range) || angle >= DirectX::XM_PIDIV2)
+        return DirectX::XMVectorSetW(GetPosition(), range);
+
+    // Spot cone capped at the range, wide cones are bounded by their base circle
+    DirectX::XMVECTOR direction = GetDirection();
+    float centerDistance = range * std::cos(angle);
+    float radius = range * std::sin(angle);
+
+    if (angle < DirectX::XM_PIDIV4)
+    {
+        centerDistance = range / (2.0f * std::cos(angle));
+        radius = centerDistance;
+    }
+
+    DirectX::XMVECTOR center = DirectX::XMVectorMultiplyAdd(direction, DirectX::XMVectorReplicate(centerDistance), GetPosition());
+    return DirectX::XMVectorSetW(center, radius);
+}
+
+TransformId Light::GetTransform() const
+{
+    return m_Transform;
 }
 
-const DirectX::XMVECTOR& Light::GetDirection() const
+DirectX::XMVECTOR Light::GetPosition() const
+{
+    return m_Transforms.GetWorldPosition(m_Transform);
+}
+
+DirectX::XMVECTOR Light::GetDirection() const
+{
+    // Parents may scale, only the axis is kept
+    DirectX::XMMATRIX world(m_Transforms.GetWorld(m_Transform));
+    return DirectX::XMVector3Normalize(world.r[2]);
+}
+
+void Light::Move(const DirectX::XMVECTOR& position)
 {
-    return m_Direction;
+    m_Transforms.Move(m_Transform, position);
 }
 
 void Light::Rotate(const DirectX::XMVECTOR& axis, float angle)
 {
-    DirectX::XMMATRIX rotation(DirectX::XMMatrixRotationAxis(axis, DirectX::XMConvertToRadians(angle)));
-    m_Direction = DirectX::XMVector4Transform(m_Direction, rotation);
+    m_Transforms.Rotate(m_Transform, axis, angle);
 }
 
 void Light::Enable()
@@ -23,6 +23,7 @@
 #pragma once
 
 #include "Buffer.h"
+#include "TransformHierarchy.h"
 #include <DirectXMath.h>
 #include <memory>
 
@@ -39,7 +40,9 @@ enum class LightType
 class Light final
 {
 public:
-    Light(DX11Device& device, LightType type);
+    Light(DX11Device& device, TransformHierarchy& transforms, LightType type, TransformId parent = TransformHierarchy::s_None);
+
+    LightType GetType() const;
 
     const DirectX::XMFLOAT3& GetColor() const;
     void SetColor(const DirectX::XMFLOAT3& color);
@@ -56,10 +59,20 @@ public:
     float GetSpotBorder() const;
     void SetSpotBorder(float border);
 
-    const DirectX::XMVECTOR& GetPosition() const;
-    void Move(const DirectX::XMVECTOR& position);
+    // Distance where the light color drops below one 8-bit step, infinite for ambient and directional lights
+    float GetRange() const;
+
+    // Sphere around everything the light reaches: center in xyz, radius in w
+    DirectX::XMVECTOR GetBoundingSphere() const;
 
-    const DirectX::XMVECTOR& GetDirection() const;
+    TransformId GetTransform() const;
+
+    // In world space as of the last TransformHierarchy::Update(), the light shines along its local z axis
+    DirectX::XMVECTOR GetPosition() const;
+    DirectX::XMVECTOR GetDirection() const;
+
+    // Relative to the parent
+    void Move(const DirectX::XMVECTOR& position);
     void Rotate(const DirectX::XMVECTOR& axis, float angle);
 
     void Enable();
@@ -77,8 +90,8 @@ private:
         float m_SpotBorder{ 0.25f };
     };
 
-    DirectX::XMVECTOR m_Position{ DirectX::XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f) };
-    DirectX::XMVECTOR m_Direction{ DirectX::XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f) };
+    TransformHierarchy& m_Transforms;
+    TransformId m_Transform{ TransformHierarchy::s_None };
 
     LightData m_LightData{ };
     bool m_IsDataDirty{ true };
@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "LightClusters.h"
+#include "ThreadPool.h"
+#include "Camera.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    bool Intersects(const DirectX::XMFLOAT4& sphere, const DirectX::XMFLOAT3& minimum, const DirectX::XMFLOAT3& maximum)
+    {
+        auto axisDistance = [](float center, float low, float high)
+        {
+            return center < low ? low - center : (center > high ? center - high : 0.0f);
+        };
+
+        float x = axisDistance(sphere.x, minimum.x, maximum.x);
+        float y = axisDistance(sphere.y, minimum.y, maximum.y);
+        float z = axisDistance(sphere.z, minimum.z, maximum.z);
+
+        return x * x + y * y + z * z <= sphere.w * sphere.w;
+    }
+}
+
+LightClusters::LightClusters(ThreadPool& threadPool)
+    : m_ThreadPool(threadPool)
+{ }
+
+void LightClusters::Build(const Camera& camera, UINT width, UINT height, const std::vector<const Light*>& lights)
+{
+    UpdateBoxes(camera, width, height);
+    DirectX::XMStoreFloat4(&m_ViewForward, camera.GetForward());
+
+    float nearPlane = camera.GetNearPlane();
+
+    auto getSlice = [this, nearPlane](float depth)
+    {
+        float slice = std::log((std::max)(depth, nearPlane)) * m_SliceScale + m_SliceBias;
+        return (std::min)(static_cast<UINT>((std::max)(slice, 0.0f)), s_Slices - 1);
+    };
+
+    m_Bounds.resize(lights.size());
+    m_Lights.resize(lights.size());
+
+    // Light bounds: screen tiles from the projected sphere, slices from its view depth range
+    m_ThreadPool.ParallelFor(lights.size(), [&](size_t index)
+    {
+        const Light& light = *lights[index];
+        LightBounds& bounds = m_Bounds[index];
+
+        DirectX::XMVECTOR sphere = light.GetBoundingSphere();
+        DirectX::XMFLOAT4 rect;
+
+        bounds.m_IsVisible = camera.ProjectSphere(sphere, rect);
+        if (!bounds.m_IsVisible)
+            return;
+
+        float radius = DirectX::XMVectorGetW(sphere);
+        DirectX::XMVECTOR center = DirectX::XMVector4Transform(DirectX::XMVectorSetW(sphere, 1.0f), camera.GetView());
+        DirectX::XMStoreFloat4(&bounds.m_Sphere, DirectX::XMVectorSetW(center, radius));
+
+        bounds.m_Rect = LightTiles::GetTileRect(rect, width, height, s_TileSize);
+        bounds.m_FirstSlice = 0;
+        bounds.m_LastSlice = s_Slices - 1;
+
+        if (!std::isinf(radius))
+        {
+            bounds.m_FirstSlice = getSlice(bounds.m_Sphere.z - radius);
+            bounds.m_LastSlice = getSlice(bounds.m_Sphere.z + radius);
+        }
+
+        m_Lights[index] = LightTiles::GetLightData(light);
+    });
+
+    // Visible lights are compacted in order, slices get their overlapping lights
+    UINT visibleLights = 0;
+
+    for (std::vector<UINT>& sliceLights : m_SliceLights)
+        sliceLights.clear();
+
+    for (size_t index = 0; index < lights.size(); index++)
+    {
+        if (!m_Bounds[index].m_IsVisible)
+            continue;
+
+        m_Bounds[visibleLights] = m_Bounds[index];
+        m_Lights[visibleLights] = m_Lights[index];
+
+        for (UINT slice = m_Bounds[visibleLights].m_FirstSlice; slice <= m_Bounds[visibleLights].m_LastSlice; slice++)
+            m_SliceLights[slice].push_back(visibleLights);
+
+        visibleLights++;
+    }
+
+    m_Bounds.resize(visibleLights);
+    m_Lights.resize(visibleLights);
+
+    // Every row of clusters in every slice is assigned on its own, cluster index is row * m_TilesX + column
+    size_t rowCount = static_cast<size_t>(s_Slices) * m_TilesY;
+    m_Ranges.assign(rowCount * m_TilesX, DirectX::XMUINT2(0, 0));
+
+    m_ThreadPool.ParallelFor(rowCount, [&](size_t rowIndex)
+    {
+        UINT slice = static_cast<UINT>(rowIndex / m_TilesY);
+        UINT y = static_cast<UINT>(rowIndex % m_TilesY);
+
+        ClusterRow& row = m_Rows[rowIndex];
+        row.m_Pairs.clear();
+
+        DirectX::XMUINT2* ranges = m_Ranges.data() + rowIndex * m_TilesX;
+        const ClusterBox* boxes = m_Boxes.data() + rowIndex * m_TilesX;
+
+        for (UINT light : m_SliceLights[slice])
+        {
+            const LightBounds& bounds = m_Bounds[light];
+            if (y < bounds.m_Rect.y || y > bounds.m_Rect.w)
+                continue;
+
+            bool isUnbounded = std::isinf(bounds.m_Sphere.w);
+
+            for (UINT x = bounds.m_Rect.x; x <= bounds.m_Rect.z; x++)
+            {
+                if (!isUnbounded && !Intersects(bounds.m_Sphere, boxes[x].m_Minimum, boxes[x].m_Maximum))
+                    continue;
+
+                row.m_Pairs.emplace_back(x, light);
+                ranges[x].y++;
+            }
+        }
+
+        // Counting sort by column, pairs are already in light order
+        UINT offset = 0;
+        for (UINT x = 0; x < m_TilesX; x++)
+        {
+            ranges[x].x = offset;
+            offset += ranges[x].y;
+            ranges[x].y = 0;
+        }
+
+        row.m_Indices.resize(row.m_Pairs.size());
+
+        for (const DirectX::XMUINT2& pair : row.m_Pairs)
+        {
+            DirectX::XMUINT2& range = ranges[pair.x];
+            row.m_Indices[range.x + range.y++] = pair.y;
+        }
+    });
+
+    UINT indexCount = 0;
+    for (ClusterRow& row : m_Rows)
+    {
+        row.m_Offset = indexCount;
+        indexCount += static_cast<UINT>(row.m_Indices.size());
+    }
+
+    m_Indices.resize(indexCount);
+
+    m_ThreadPool.ParallelFor(rowCount, [&](size_t rowIndex)
+    {
+        const ClusterRow& row = m_Rows[rowIndex];
+        std::copy(row.m_Indices.begin(), row.m_Indices.end(), m_Indices.begin() + row.m_Offset);
+
+        DirectX::XMUINT2* ranges = m_Ranges.data() + rowIndex * m_TilesX;
+        for (UINT x = 0; x < m_TilesX; x++)
+            ranges[x].x += row.m_Offset;
+    });
+
+    m_Stats.m_Lights = static_cast<UINT>(lights.size());
+    m_Stats.m_VisibleLights = visibleLights;
+    m_Stats.m_TileLights = indexCount;
+}
+
+LightGrid LightClusters::GetGrid() const
+{
+    LightGrid grid{ };
+    grid.m_TileSize = s_TileSize;
+    grid.m_TilesX = m_TilesX;
+    grid.m_TilesY = m_TilesY;
+    grid.m_Slices = s_Slices;
+    grid.m_ViewForward = m_ViewForward;
+    grid.m_SliceScale = m_SliceScale;
+    grid.m_SliceBias = m_SliceBias;
+
+    return grid;
+}
+
+const std::vector<TiledLightData>& LightClusters::GetLights() const
+{
+    return m_Lights;
+}
+
+const std::vector<UINT>& LightClusters::GetIndices() const
+{
+    return m_Indices;
+}
+
+const std::vector<DirectX::XMUINT2>& LightClusters::GetRanges() const
+{
+    return m_Ranges;
+}
+
+const LightTilesStats& LightClusters::GetStats() const
+{
+    return m_Stats;
+}
+
+void LightClusters::UpdateBoxes(const Camera& camera, UINT width, UINT height)
+{
+    DirectX::XMFLOAT4 projection(camera.GetFov(), camera.GetAspectRatio(), camera.GetNearPlane(), camera.GetFarPlane());
+
+    if (width == m_Width && height == m_Height && std::memcmp(&projection, &m_Projection, sizeof(projection)) == 0)
+        return;
+
+    m_Width = width;
+    m_Height = height;
+    m_Projection = projection;
+
+    m_TilesX = (width + s_TileSize - 1) / s_TileSize;
+    m_TilesY = (height + s_TileSize - 1) / s_TileSize;
+
+    float nearPlane = camera.GetNearPlane();
+    float farPlane = camera.GetFarPlane();
+
+    // Slice k spans near * (far / near)^(k / slices) to near * (far / near)^((k + 1) / slices)
+    m_SliceScale = static_cast<float>(s_Slices) / std::log(farPlane / nearPlane);
+    m_SliceBias = -std::log(nearPlane) * m_SliceScale;
+
+    DirectX::XMFLOAT4X4 matrix;
+    DirectX::XMStoreFloat4x4(&matrix, camera.GetProjection());
+
+    float scaleX = matrix.m[0][0];
+    float scaleY = matrix.m[1][1];
+
+    float fullWidth = static_cast<float>(width);
+    float fullHeight = static_cast<float>(height);
+
+    m_Boxes.resize(static_cast<size_t>(s_Slices) * m_TilesY * m_TilesX);
+    m_Rows.resize(static_cast<size_t>(s_Slices) * m_TilesY);
+    m_SliceLights.resize(s_Slices);
+
+    for (UINT slice = 0; slice < s_Slices; slice++)
+    {
+        // Boxes overlap slightly, pixels right at a slice border may pick either slice
+        float depths[] =
+        {
+            nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(slice) / static_cast<float>(s_Slices)) * 0.999f,
+            nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(slice + 1) / static_cast<float>(s_Slices)) * 1.001f
+        };
+
+        for (UINT y = 0; y < m_TilesY; y++)
+        {
+            // Tile edges in normalized device coordinates, Y goes up
+            float edgesY[] =
+            {
+                1.0f - 2.0f * static_cast<float>((std::min)((y + 1) * s_TileSize, height)) / fullHeight,
+                1.0f - 2.0f * static_cast<float>(y * s_TileSize) / fullHeight
+            };
+
+            for (UINT x = 0; x < m_TilesX; x++)
+            {
+                float edgesX[] =
+                {
+                    2.0f * static_cast<float>(x * s_TileSize) / fullWidth - 1.0f,
+                    2.0f * static_cast<float>((std::min)((x + 1) * s_TileSize, width)) / fullWidth - 1.0f
+                };
+
+                ClusterBox& box = m_Boxes[(static_cast<size_t>(slice) * m_TilesY + y) * m_TilesX + x];
+                box.m_Minimum = DirectX::XMFLOAT3(FLT_MAX, FLT_MAX, depths[0]);
+                box.m_Maximum = DirectX::XMFLOAT3(-FLT_MAX, -FLT_MAX, depths[1]);
+
+                // View space position is the device coordinate scaled by depth
+                for (float depth : depths)
+                {
+                    for (UINT edge = 0; edge < 2; edge++)
+                    {
+                        float viewX = edgesX[edge] * depth / scaleX;
+                        float viewY = edgesY[edge] * depth / scaleY;
+
+                        box.m_Minimum.x = (std::min)(box.m_Minimum.x, viewX);
+                        box.m_Minimum.y = (std::min)(box.m_Minimum.y, viewY);
+                        box.m_Maximum.x = (std::max)(box.m_Maximum.x, viewX);
+                        box.m_Maximum.y = (std::max)(box.m_Maximum.y, viewY);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "LightTiles.h"
+#include <d3d11.h>
+#include <DirectXMath.h>
+#include <vector>
+
+class Camera;
+class ThreadPool;
+
+// Clustered variant of LightTiles: screen tiles are split into exponential view depth slices between the
+// camera near and far planes. A light lands only in froxels its bounding sphere intersects, so lights behind
+// a near occluder no longer add to the lists of pixels in front of it. Lists keep light order.
+class LightClusters final
+{
+public:
+    static constexpr UINT s_TileSize = 32;
+    static constexpr UINT s_Slices = 24;
+
+    LightClusters(ThreadPool& threadPool);
+
+    void Build(const Camera& camera, UINT width, UINT height, const std::vector<const Light*>& lights);
+
+    LightGrid GetGrid() const;
+
+    // Visible lights in Build() order, cluster lists index into them
+    const std::vector<TiledLightData>& GetLights() const;
+    const std::vector<UINT>& GetIndices() const;
+    const std::vector<DirectX::XMUINT2>& GetRanges() const;
+
+    const LightTilesStats& GetStats() const;
+
+private:
+    struct LightBounds
+    {
+        DirectX::XMUINT4 m_Rect; // Inclusive tile rectangle
+        UINT m_FirstSlice;
+        UINT m_LastSlice;
+        DirectX::XMFLOAT4 m_Sphere; // View space, infinite radius for ambient and directional lights
+        bool m_IsVisible;
+    };
+
+    // View space froxel boxes, rebuilt when the projection or the screen size changes
+    struct ClusterBox
+    {
+        DirectX::XMFLOAT3 m_Minimum;
+        DirectX::XMFLOAT3 m_Maximum;
+    };
+
+    // Lists of one row of clusters in one slice, built independently and merged afterwards
+    struct ClusterRow
+    {
+        std::vector<DirectX::XMUINT2> m_Pairs; // Cluster column and light
+        std::vector<UINT> m_Indices;
+        UINT m_Offset;
+    };
+
+    void UpdateBoxes(const Camera& camera, UINT width, UINT height);
+
+    ThreadPool& m_ThreadPool;
+
+    UINT m_Width{ 0 };
+    UINT m_Height{ 0 };
+    UINT m_TilesX{ 0 };
+    UINT m_TilesY{ 0 };
+    DirectX::XMFLOAT4 m_Projection{ }; // Fov, aspect ratio, near and far planes the boxes were built for
+    DirectX::XMFLOAT4 m_ViewForward{ };
+    float m_SliceScale{ 0.0f };
+    float m_SliceBias{ 0.0f };
+
+    std::vector<ClusterBox> m_Boxes;
+    std::vector<LightBounds> m_Bounds;
+    std::vector<std::vector<UINT>> m_SliceLights; // Visible lights overlapping every slice
+    std::vector<ClusterRow> m_Rows;
+
+    std::vector<TiledLightData> m_Lights;
+    std::vector<UINT> m_Indices;
+    std::vector<DirectX::XMUINT2> m_Ranges;
+
+    LightTilesStats m_Stats;
+};
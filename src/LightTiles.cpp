@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "LightTiles.h"
+#include "Camera.h"
+#include <algorithm>
+
+void LightTiles::Build(const Camera& camera, UINT width, UINT height, const std::vector<const Light*>& lights)
+{
+    m_TilesX = (width + s_TileSize - 1) / s_TileSize;
+    m_TilesY = (height + s_TileSize - 1) / s_TileSize;
+
+    m_Lights.clear();
+    m_Rects.clear();
+
+    for (const Light* light : lights)
+    {
+        DirectX::XMFLOAT4 rect;
+        if (!camera.ProjectSphere(light->GetBoundingSphere(), rect))
+            continue;
+
+        m_Rects.push_back(GetTileRect(rect, width, height, s_TileSize));
+        m_Lights.push_back(GetLightData(*light));
+    }
+
+    // Counting sort of tile and light pairs, lights stay in order within every tile
+    m_Ranges.assign(static_cast<size_t>(m_TilesX) * m_TilesY, DirectX::XMUINT2(0, 0));
+
+    for (const DirectX::XMUINT4& rect : m_Rects)
+    {
+        for (UINT y = rect.y; y <= rect.w; y++)
+        {
+            for (UINT x = rect.x; x <= rect.z; x++)
+                m_Ranges[y * m_TilesX + x].y++;
+        }
+    }
+
+    UINT offset = 0;
+    for (DirectX::XMUINT2& range : m_Ranges)
+    {
+        range.x = offset;
+        offset += range.y;
+        range.y = 0;
+    }
+
+    m_Indices.resize(offset);
+
+    for (UINT light = 0; light < m_Rects.size(); light++)
+    {
+        const DirectX::XMUINT4& rect = m_Rects[light];
+
+        for (UINT y = rect.y; y <= rect.w; y++)
+        {
+            for (UINT x = rect.x; x <= rect.z; x++)
+            {
+                DirectX::XMUINT2& range = m_Ranges[y * m_TilesX + x];
+                m_Indices[range.x + range.y++] = light;
+            }
+        }
+    }
+
+    m_Stats.m_Lights = static_cast<UINT>(lights.size());
+    m_Stats.m_VisibleLights = static_cast<UINT>(m_Lights.size());
+    m_Stats.m_TileLights = offset;
+}
+
+TiledLightData LightTiles::GetLightData(const Light& light)
+{
+    TiledLightData data;
+    data.m_Type = light.GetType();
+    data.m_Color = light.GetColor();
+    data.m_Intensity = light.GetIntensity();
+    data.m_Falloff = light.GetFalloff();
+    data.m_SpotAngle = DirectX::XMConvertToRadians(light.GetSpotAngle());
+    data.m_SpotBorder = light.GetSpotBorder();
+
+    DirectX::XMStoreFloat4(&data.m_Position, light.GetPosition());
+    DirectX::XMStoreFloat4(&data.m_Direction, light.GetDirection());
+
+    return data;
+}
+
+DirectX::XMUINT4 LightTiles::GetTileRect(const DirectX::XMFLOAT4& rect, UINT width, UINT height, UINT tileSize)
+{
+    UINT tilesX = (width + tileSize - 1) / tileSize;
+    UINT tilesY = (height + tileSize - 1) / tileSize;
+
+    // Normalized device coordinates to pixels, Y goes down
+    float left = (rect.x * 0.5f + 0.5f) * static_cast<float>(width);
+    float right = (rect.z * 0.5f + 0.5f) * static_cast<float>(width);
+    float top = (0.5f - rect.w * 0.5f) * static_cast<float>(height);
+    float bottom = (0.5f - rect.y * 0.5f) * static_cast<float>(height);
+
+    auto toTile = [tileSize](float pixel, UINT tiles)
+    {
+        UINT tile = static_cast<UINT>((std::max)(pixel, 0.0f)) / tileSize;
+        return (std::min)(tile, tiles - 1);
+    };
+
+    return DirectX::XMUINT4(toTile(left, tilesX), toTile(top, tilesY), toTile(right, tilesX), toTile(bottom, tilesY));
+}
+
+LightGrid LightTiles::GetGrid() const
+{
+    LightGrid grid{ };
+    grid.m_TileSize = s_TileSize;
+    grid.m_TilesX = m_TilesX;
+    grid.m_TilesY = m_TilesY;
+    grid.m_Slices = 1;
+    grid.m_ViewForward = { 0.0f, 0.0f, 1.0f, 0.0f };
+
+    return grid;
+}
+
+UINT LightTiles::GetTilesX() const
+{
+    return m_TilesX;
+}
+
+UINT LightTiles::GetTilesY() const
+{
+    return m_TilesY;
+}
+
+const std::vector<TiledLightData>& LightTiles::GetLights() const
+{
+    return m_Lights;
+}
+
+const std::vector<UINT>& LightTiles::GetIndices() const
+{
+    return m_Indices;
+}
+
+const std::vector<DirectX::XMUINT2>& LightTiles::GetRanges() const
+{
+    return m_Ranges;
+}
+
+const LightTilesStats& LightTiles::GetStats() const
+{
+    return m_Stats;
+}
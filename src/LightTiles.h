@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "Light.h"
+#include <d3d11.h>
+#include <DirectXMath.h>
+#include <vector>
+
+class Camera;
+
+// Element of TiledLight.fx tiledLights buffer, LightData followed by world vectors
+struct TiledLightData final
+{
+    LightType m_Type;
+    DirectX::XMFLOAT3 m_Color;
+    float m_Intensity;
+    float m_Falloff;
+    float m_SpotAngle; // Radians
+    float m_SpotBorder;
+    DirectX::XMFLOAT4 m_Position;
+    DirectX::XMFLOAT4 m_Direction;
+};
+
+// TiledLight.fx LightGrid buffer (b2). Lists belong to clusters: screen tiles split into view depth
+// slices, cluster of a pixel is (slice * m_TilesY + y) * m_TilesX + x
+struct LightGrid final
+{
+    UINT m_TileSize;
+    UINT m_TilesX;
+    UINT m_TilesY;
+    UINT m_Slices;
+    DirectX::XMFLOAT4 m_ViewForward; // View depth is dot(position - camera position, forward)
+    float m_SliceScale;              // Slice is log(depth) * scale + bias
+    float m_SliceBias;
+    float m_Padding[2];
+};
+
+struct LightTilesStats final
+{
+    UINT m_Lights{ 0 };        // Lights passed to Build()
+    UINT m_VisibleLights{ 0 }; // Lights overlapping at least one tile
+    UINT m_TileLights{ 0 };    // Entries in all tile lists
+};
+
+// Screen tile light lists for a single pass deferred lighting. Every light is bounded by a sphere,
+// the sphere is projected into a conservative screen rectangle and the light is added to all tiles
+// under it. Lists keep light order, so blending in TiledLight.fx matches one pass per light.
+class LightTiles final
+{
+public:
+    static constexpr UINT s_TileSize = 16;
+
+    static TiledLightData GetLightData(const Light& light);
+
+    // Inclusive tile rectangle (left, top, right, bottom) under a Camera::ProjectSphere rectangle
+    static DirectX::XMUINT4 GetTileRect(const DirectX::XMFLOAT4& rect, UINT width, UINT height, UINT tileSize);
+
+    void Build(const Camera& camera, UINT width, UINT height, const std::vector<const Light*>& lights);
+
+    // Single depth slice
+    LightGrid GetGrid() const;
+
+    UINT GetTilesX() const;
+    UINT GetTilesY() const;
+
+    // Visible lights in Build() order, tile lists index into them
+    const std::vector<TiledLightData>& GetLights() const;
+    const std::vector<UINT>& GetIndices() const;
+    const std::vector<DirectX::XMUINT2>& GetRanges() const;
+
+    const LightTilesStats& GetStats() const;
+
+private:
+    UINT m_TilesX{ 0 };
+    UINT m_TilesY{ 0 };
+
+    std::vector<TiledLightData> m_Lights;
+    std::vector<DirectX::XMUINT4> m_Rects; // Inclusive tile rectangle of every visible light
+    std::vector<UINT> m_Indices;
+    std::vector<DirectX::XMUINT2> m_Ranges;
+
+    LightTilesStats m_Stats;
+};
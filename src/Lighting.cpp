@@ -0,0 +1,706 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Lighting.h"
+#include "ThreadPool.h"
+#include "Light.h"
+#include "GeometryPacking.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cassert>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif // __AVX2__
+
+namespace
+{
+    // Planes in Geometry.fx target order, channel c of target t is plane t * 4 + c
+    enum GeometryPlane : UINT
+    {
+        DIFFUSE_R, DIFFUSE_G, DIFFUSE_B, AMBIENT_INTENSITY,
+        SPECULAR_R, SPECULAR_G, SPECULAR_B, DIFFUSE_INTENSITY,
+        POSITION_X, POSITION_Y, POSITION_Z, SPECULAR_INTENSITY,
+        NORMAL_X, NORMAL_Y, NORMAL_Z, SPECULAR_HARDNESS
+    };
+
+    // Values uniform over a pass, derived once instead of per pixel
+    struct PassUniforms
+    {
+        LightType m_Type;
+        bool m_Blend;
+
+        float m_Color[3];      // dynamicLightColor * dynamicLightIntensity
+        float m_FalloffSquare;
+        float m_HardAngleCos;
+        float m_SoftAngleCos;
+
+        float m_Camera[3];
+        float m_Position[3];
+        float m_Direction[3];  // Normalized
+
+        bool m_Bounded;        // DynamicLight.fx light volume test, skipped when it never fails
+        float m_Bounds[4];     // Volume center and squared radius
+        D3D11_RECT m_Scissor;
+    };
+
+    PassUniforms GetUniforms(const LightPass& pass)
+    {
+        const LightConstants& light = pass.m_Light;
+        const LightVectors& vectors = pass.m_Vectors;
+
+        PassUniforms uniforms;
+        uniforms.m_Type = static_cast<LightType>(light.m_Type);
+        uniforms.m_Blend = pass.m_Blend;
+
+        uniforms.m_Color[0] = light.m_Color.x * light.m_Intensity;
+        uniforms.m_Color[1] = light.m_Color.y * light.m_Intensity;
+        uniforms.m_Color[2] = light.m_Color.z * light.m_Intensity;
+        uniforms.m_FalloffSquare = light.m_Falloff * light.m_Falloff;
+        uniforms.m_HardAngleCos = std::cos(light.m_SpotAngle * (1.0f - light.m_SpotBorder));
+        uniforms.m_SoftAngleCos = std::cos(light.m_SpotAngle);
+
+        uniforms.m_Camera[0] = vectors.m_CameraPosition.x;
+        uniforms.m_Camera[1] = vectors.m_CameraPosition.y;
+        uniforms.m_Camera[2] = vectors.m_CameraPosition.z;
+        uniforms.m_Position[0] = vectors.m_LightPosition.x;
+        uniforms.m_Position[1] = vectors.m_LightPosition.y;
+        uniforms.m_Position[2] = vectors.m_LightPosition.z;
+
+        const DirectX::XMFLOAT4& direction = vectors.m_LightDirection;
+        float directionLength = std::sqrt(direction.x * direction.x + direction.y * direction.y + direction.z * direction.z);
+
+        uniforms.m_Direction[0] = direction.x / directionLength;
+        uniforms.m_Direction[1] = direction.y / directionLength;
+        uniforms.m_Direction[2] = direction.z / directionLength;
+
+        const DirectX::XMFLOAT4& bounds = vectors.m_LightBounds;
+        uniforms.m_Bounded = uniforms.m_Type != LightType::Ambient && !std::isinf(bounds.w);
+
+        uniforms.m_Bounds[0] = bounds.x;
+        uniforms.m_Bounds[1] = bounds.y;
+        uniforms.m_Bounds[2] = bounds.z;
+        uniforms.m_Bounds[3] = bounds.w * bounds.w;
+
+        uniforms.m_Scissor = pass.m_Scissor;
+
+        return uniforms;
+    }
+
+    // Unorm render targets clamp shader output, NaN turns into zero
+    float Saturate(float value)
+    {
+        return value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f;
+    }
+
+    void ShadeScalar(const PassUniforms& pass, const float* const geometry[16], float* const frame[4], UINT count)
+    {
+        for (UINT pixel = 0; pixel < count; pixel++)
+        {
+            if (pass.m_Bounded)
+            {
+                float boundsX = geometry[POSITION_X][pixel] - pass.m_Bounds[0];
+                float boundsY = geometry[POSITION_Y][pixel] - pass.m_Bounds[1];
+                float boundsZ = geometry[POSITION_Z][pixel] - pass.m_Bounds[2];
+
+                // Discarded
+                if (boundsX * boundsX + boundsY * boundsY + boundsZ * boundsZ > pass.m_Bounds[3])
+                    continue;
+            }
+
+            float color[4];
+
+            if (pass.m_Type == LightType::Ambient)
+            {
+                // AmbientLight.fx
+                float ambientIntensity = geometry[AMBIENT_INTENSITY][pixel];
+
+                color[0] = geometry[DIFFUSE_R][pixel] * ambientIntensity * pass.m_Color[0];
+                color[1] = geometry[DIFFUSE_G][pixel] * ambientIntensity * pass.m_Color[1];
+                color[2] = geometry[DIFFUSE_B][pixel] * ambientIntensity * pass.m_Color[2];
+                color[3] = 1.0f;
+            }
+            else
+            {
+                // DynamicLight.fx
+                float positionX = geometry[POSITION_X][pixel];
+                float positionY = geometry[POSITION_Y][pixel];
+                float positionZ = geometry[POSITION_Z][pixel];
+
+                float normalX = geometry[NORMAL_X][pixel];
+                float normalY = geometry[NORMAL_Y][pixel];
+                float normalZ = geometry[NORMAL_Z][pixel];
+                float normalLength = std::sqrt(normalX * normalX + normalY * normalY + normalZ * normalZ);
+
+                normalX /= normalLength;
+                normalY /= normalLength;
+                normalZ /= normalLength;
+
+                float fromLightX = pass.m_Direction[0];
+                float fromLightY = pass.m_Direction[1];
+                float fromLightZ = pass.m_Direction[2];
+
+                if (pass.m_Type == LightType::Point)
+                {
+                    fromLightX = positionX - pass.m_Position[0];
+                    fromLightY = positionY - pass.m_Position[1];
+                    fromLightZ = positionZ - pass.m_Position[2];
+
+                    float fromLightLength = std::sqrt(fromLightX * fromLightX + fromLightY * fromLightY + fromLightZ * fromLightZ);
+                    fromLightX /= fromLightLength;
+                    fromLightY /= fromLightLength;
+                    fromLightZ /= fromLightLength;
+                }
+
+                float normalDotLight = fromLightX * normalX + fromLightY * normalY + fromLightZ * normalZ;
+                float diffuseLightIntensity = (std::max)(-normalDotLight, 0.0f);
+
+                float reflectionX = fromLightX - 2.0f * normalDotLight * normalX;
+                float reflectionY = fromLightY - 2.0f * normalDotLight * normalY;
+                float reflectionZ = fromLightZ - 2.0f * normalDotLight * normalZ;
+
+                float toCameraX = pass.m_Camera[0] - positionX;
+                float toCameraY = pass.m_Camera[1] - positionY;
+                float toCameraZ = pass.m_Camera[2] - positionZ;
+                float toCameraLength = std::sqrt(toCameraX * toCameraX + toCameraY * toCameraY + toCameraZ * toCameraZ);
+
+                float specularLightIntensity = (toCameraX * reflectionX + toCameraY * reflectionY + toCameraZ * reflectionZ) / toCameraLength;
+                specularLightIntensity = (std::max)(specularLightIntensity, 0.0f);
+                specularLightIntensity = std::pow(specularLightIntensity, static_cast<float>(static_cast<int>(geometry[SPECULAR_HARDNESS][pixel])));
+
+                if (pass.m_Type == LightType::Spot)
+                {
+                    float toPixelX = positionX - pass.m_Position[0];
+                    float toPixelY = positionY - pass.m_Position[1];
+                    float toPixelZ = positionZ - pass.m_Position[2];
+                    float toPixelLength = std::sqrt(toPixelX * toPixelX + toPixelY * toPixelY + toPixelZ * toPixelZ);
+
+                    float angleCos = (fromLightX * toPixelX + fromLightY * toPixelY + fromLightZ * toPixelZ) / toPixelLength;
+                    angleCos = (std::max)(angleCos, 0.0f);
+
+                    float spotIntensity = Saturate((pass.m_SoftAngleCos - angleCos) / (pass.m_SoftAngleCos - pass.m_HardAngleCos));
+
+                    diffuseLightIntensity *= spotIntensity;
+                    specularLightIntensity *= spotIntensity;
+                }
+
+                if (pass.m_Type != LightType::Direction)
+                {
+                    float distanceX = positionX - pass.m_Position[0];
+                    float distanceY = positionY - pass.m_Position[1];
+                    float distanceZ = positionZ - pass.m_Position[2];
+                    float distanceSquare = distanceX * distanceX + distanceY * distanceY + distanceZ * distanceZ;
+
+                    float lightFalloff = pass.m_FalloffSquare / (pass.m_FalloffSquare + distanceSquare);
+
+                    diffuseLightIntensity *= lightFalloff;
+                    specularLightIntensity *= lightFalloff;
+                }
+
+                float diffuseIntensity = geometry[DIFFUSE_INTENSITY][pixel] * diffuseLightIntensity;
+                float specularIntensity = geometry[SPECULAR_INTENSITY][pixel] * specularLightIntensity;
+
+                color[0] = (geometry[DIFFUSE_R][pixel] * diffuseIntensity + geometry[SPECULAR_R][pixel] * specularIntensity) * pass.m_Color[0];
+                color[1] = (geometry[DIFFUSE_G][pixel] * diffuseIntensity + geometry[SPECULAR_G][pixel] * specularIntensity) * pass.m_Color[1];
+                color[2] = (geometry[DIFFUSE_B][pixel] * diffuseIntensity + geometry[SPECULAR_B][pixel] * specularIntensity) * pass.m_Color[2];
+                color[3] = diffuseLightIntensity + specularLightIntensity;
+            }
+
+            float alpha = Saturate(color[3]);
+
+            for (UINT channel = 0; channel < 4; channel++)
+            {
+                float source = Saturate(color[channel]);
+                frame[channel][pixel] = pass.m_Blend ? source * alpha + frame[channel][pixel] * (1.0f - alpha) : source;
+            }
+        }
+    }
+
+#if defined(__AVX2__)
+    __m256 Saturate(__m256 value)
+    {
+        // MAXPS returns the second operand for NaN
+        return _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+    }
+
+    __m256 Dot(__m256 ax, __m256 ay, __m256 az, __m256 bx, __m256 by, __m256 bz)
+    {
+        return _mm256_fmadd_ps(ax, bx, _mm256_fmadd_ps(ay, by, _mm256_mul_ps(az, bz)));
+    }
+
+    // pow(base, int(exponent)) by squaring, lanes carry different exponents
+    __m256 PowInteger(__m256 base, __m256 exponent)
+    {
+        __m256i bits = _mm256_cvttps_epi32(exponent);
+        __m256 result = _mm256_set1_ps(1.0f);
+
+        const __m256i one = _mm256_set1_epi32(1);
+
+        while (!_mm256_testz_si256(bits, bits))
+        {
+            __m256 odd = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(bits, one), one));
+            result = _mm256_blendv_ps(result, _mm256_mul_ps(result, base), odd);
+
+            base = _mm256_mul_ps(base, base);
+            bits = _mm256_srli_epi32(bits, 1);
+        }
+
+        return result;
+    }
+
+    void ShadeSimd(const PassUniforms& pass, const float* const geometry[16], float* const frame[4], UINT count)
+    {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 two = _mm256_set1_ps(2.0f);
+
+        const __m256 lightColor[] = { _mm256_set1_ps(pass.m_Color[0]), _mm256_set1_ps(pass.m_Color[1]), _mm256_set1_ps(pass.m_Color[2]) };
+
+        for (UINT pixel = 0; pixel < count; pixel += 8)
+        {
+            auto load = [&geometry, pixel](UINT plane) { return _mm256_loadu_ps(geometry[plane] + pixel); };
+
+            // Lanes outside of the light volume keep the frame, NaN distances pass like in the shader
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+            if (pass.m_Bounded)
+            {
+                __m256 boundsX = _mm256_sub_ps(load(POSITION_X), _mm256_set1_ps(pass.m_Bounds[0]));
+                __m256 boundsY = _mm256_sub_ps(load(POSITION_Y), _mm256_set1_ps(pass.m_Bounds[1]));
+                __m256 boundsZ = _mm256_sub_ps(load(POSITION_Z), _mm256_set1_ps(pass.m_Bounds[2]));
+
+                inside = _mm256_cmp_ps(Dot(boundsX, boundsY, boundsZ, boundsX, boundsY, boundsZ), _mm256_set1_ps(pass.m_Bounds[3]), _CMP_NGT_UQ);
+
+                if (_mm256_movemask_ps(inside) == 0)
+                    continue;
+            }
+
+            __m256 color[4];
+
+            if (pass.m_Type == LightType::Ambient)
+            {
+                // AmbientLight.fx
+                __m256 ambientIntensity = load(AMBIENT_INTENSITY);
+
+                color[0] = _mm256_mul_ps(_mm256_mul_ps(load(DIFFUSE_R), ambientIntensity), lightColor[0]);
+                color[1] = _mm256_mul_ps(_mm256_mul_ps(load(DIFFUSE_G), ambientIntensity), lightColor[1]);
+                color[2] = _mm256_mul_ps(_mm256_mul_ps(load(DIFFUSE_B), ambientIntensity), lightColor[2]);
+                color[3] = one;
+            }
+            else
+            {
+                // DynamicLight.fx
+                __m256 positionX = load(POSITION_X);
+                __m256 positionY = load(POSITION_Y);
+                __m256 positionZ = load(POSITION_Z);
+
+                __m256 normalX = load(NORMAL_X);
+                __m256 normalY = load(NORMAL_Y);
+                __m256 normalZ = load(NORMAL_Z);
+                __m256 normalLength = _mm256_sqrt_ps(Dot(normalX, normalY, normalZ, normalX, normalY, normalZ));
+
+                normalX = _mm256_div_ps(normalX, normalLength);
+                normalY = _mm256_div_ps(normalY, normalLength);
+                normalZ = _mm256_div_ps(normalZ, normalLength);
+
+                __m256 toPixelX = _mm256_sub_ps(positionX, _mm256_set1_ps(pass.m_Position[0]));
+                __m256 toPixelY = _mm256_sub_ps(positionY, _mm256_set1_ps(pass.m_Position[1]));
+                __m256 toPixelZ = _mm256_sub_ps(positionZ, _mm256_set1_ps(pass.m_Position[2]));
+                __m256 distanceSquare = Dot(toPixelX, toPixelY, toPixelZ, toPixelX, toPixelY, toPixelZ);
+                __m256 toPixelLength = _mm256_sqrt_ps(distanceSquare);
+
+                __m256 fromLightX = _mm256_set1_ps(pass.m_Direction[0]);
+                __m256 fromLightY = _mm256_set1_ps(pass.m_Direction[1]);
+                __m256 fromLightZ = _mm256_set1_ps(pass.m_Direction[2]);
+
+                if (pass.m_Type == LightType::Point)
+                {
+                    fromLightX = _mm256_div_ps(toPixelX, toPixelLength);
+                    fromLightY = _mm256_div_ps(toPixelY, toPixelLength);
+                    fromLightZ = _mm256_div_ps(toPixelZ, toPixelLength);
+                }
+
+                __m256 normalDotLight = Dot(fromLightX, fromLightY, fromLightZ, normalX, normalY, normalZ);
+                __m256 diffuseLightIntensity = _mm256_max_ps(_mm256_sub_ps(zero, normalDotLight), zero);
+
+                __m256 reflectionScale = _mm256_mul_ps(two, normalDotLight);
+                __m256 reflectionX = _mm256_fnmadd_ps(reflectionScale, normalX, fromLightX);
+                __m256 reflectionY = _mm256_fnmadd_ps(reflectionScale, normalY, fromLightY);
+                __m256 reflectionZ = _mm256_fnmadd_ps(reflectionScale, normalZ, fromLightZ);
+
+                __m256 toCameraX = _mm256_sub_ps(_mm256_set1_ps(pass.m_Camera[0]), positionX);
+                __m256 toCameraY = _mm256_sub_ps(_mm256_set1_ps(pass.m_Camera[1]), positionY);
+                __m256 toCameraZ = _mm256_sub_ps(_mm256_set1_ps(pass.m_Camera[2]), positionZ);
+                __m256 toCameraLength = _mm256_sqrt_ps(Dot(toCameraX, toCameraY, toCameraZ, toCameraX, toCameraY, toCameraZ));
+
+                __m256 specularLightIntensity = _mm256_div_ps(Dot(toCameraX, toCameraY, toCameraZ, reflectionX, reflectionY, reflectionZ), toCameraLength);
+                specularLightIntensity = _mm256_max_ps(specularLightIntensity, zero);
+                specularLightIntensity = PowInteger(specularLightIntensity, load(SPECULAR_HARDNESS));
+
+                if (pass.m_Type == LightType::Spot)
+                {
+                    __m256 angleCos = _mm256_div_ps(Dot(fromLightX, fromLightY, fromLightZ, toPixelX, toPixelY, toPixelZ), toPixelLength);
+                    angleCos = _mm256_max_ps(angleCos, zero);
+
+                    __m256 softAngleCos = _mm256_set1_ps(pass.m_SoftAngleCos);
+                    __m256 angleRange = _mm256_set1_ps(1.0f / (pass.m_SoftAngleCos - pass.m_HardAngleCos));
+                    __m256 spotIntensity = Saturate(_mm256_mul_ps(_mm256_sub_ps(softAngleCos, angleCos), angleRange));
+
+                    diffuseLightIntensity = _mm256_mul_ps(diffuseLightIntensity, spotIntensity);
+                    specularLightIntensity = _mm256_mul_ps(specularLightIntensity, spotIntensity);
+                }
+
+                if (pass.m_Type != LightType::Direction)
+                {
+                    __m256 falloffSquare = _mm256_set1_ps(pass.m_FalloffSquare);
+                    __m256 lightFalloff = _mm256_div_ps(falloffSquare, _mm256_add_ps(falloffSquare, distanceSquare));
+
+                    diffuseLightIntensity = _mm256_mul_ps(diffuseLightIntensity, lightFalloff);
+                    specularLightIntensity = _mm256_mul_ps(specularLightIntensity, lightFalloff);
+                }
+
+                __m256 diffuseIntensity = _mm256_mul_ps(load(DIFFUSE_INTENSITY), diffuseLightIntensity);
+                __m256 specularIntensity = _mm256_mul_ps(load(SPECULAR_INTENSITY), specularLightIntensity);
+
+                for (UINT channel = 0; channel < 3; channel++)
+                {
+                    __m256 diffuse = _mm256_mul_ps(load(DIFFUSE_R + channel), diffuseIntensity);
+                    color[channel] = _mm256_mul_ps(_mm256_fmadd_ps(load(SPECULAR_R + channel), specularIntensity, diffuse), lightColor[channel]);
+                }
+
+                color[3] = _mm256_add_ps(diffuseLightIntensity, specularLightIntensity);
+            }
+
+            __m256 alpha = Saturate(color[3]);
+            __m256 inverseAlpha = _mm256_sub_ps(one, alpha);
+
+            for (UINT channel = 0; channel < 4; channel++)
+            {
+                __m256 source = Saturate(color[channel]);
+                __m256 destination = _mm256_loadu_ps(frame[channel] + pixel);
+
+                if (pass.m_Blend)
+                    source = _mm256_fmadd_ps(source, alpha, _mm256_mul_ps(destination, inverseAlpha));
+
+                _mm256_storeu_ps(frame[channel] + pixel, _mm256_blendv_ps(destination, source, inside));
+            }
+        }
+    }
+#endif // __AVX2__
+}
+
+Lighting::Lighting(ThreadPool& threadPool)
+    : m_ThreadPool(threadPool)
+{
+    m_Simd = IsSimdAvailable();
+}
+
+const LightingStats& Lighting::GetStats() const
+{
+    return m_Stats;
+}
+
+bool Lighting::IsSimdAvailable()
+{
+#if defined(__AVX2__)
+    return true;
+#else  // __AVX2__
+    return false;
+#endif // __AVX2__
+}
+
+void Lighting::SetSimd(bool simd)
+{
+    m_Simd = simd && IsSimdAvailable();
+}
+
+void Lighting::LoadGeometry(UINT width, UINT height, const DirectX::XMFLOAT4* const targets[3], const float* depth, const DirectX::XMFLOAT4X4& inverseViewProjection)
+{
+    Resize(width, height);
+
+    size_t planeSize = static_cast<size_t>(m_Stride) * m_Height;
+
+    m_ThreadPool.ParallelFor(m_Height, [this, targets, depth, &inverseViewProjection, planeSize](size_t row)
+    {
+        // Diffuse, specular and normal go to planes 0 - 7 and 12 - 15
+        const UINT firstPlanes[] = { 0, 4, 12 };
+
+        for (UINT target = 0; target < 3; target++)
+        {
+            const DirectX::XMFLOAT4* source = targets[target] + row * m_Width;
+
+            float* x = m_Geometry.data() + (firstPlanes[target] + 0) * planeSize + row * m_Stride;
+            float* y = m_Geometry.data() + (firstPlanes[target] + 1) * planeSize + row * m_Stride;
+            float* z = m_Geometry.data() + (firstPlanes[target] + 2) * planeSize + row * m_Stride;
+            float* w = m_Geometry.data() + (firstPlanes[target] + 3) * planeSize + row * m_Stride;
+
+            for (UINT pixel = 0; pixel < m_Width; pixel++)
+            {
+                x[pixel] = source[pixel].x;
+                y[pixel] = source[pixel].y;
+                z[pixel] = source[pixel].z;
+                w[pixel] = source[pixel].w;
+            }
+        }
+
+        // Specular intensity is already applied to specular color
+        std::fill_n(m_Geometry.data() + 11 * planeSize + row * m_Stride, m_Width, 1.0f);
+
+        LoadPositions(row, depth, inverseViewProjection);
+    });
+}
+
+void Lighting::LoadGeometry(UINT width, UINT height, const UINT* const targets[3], const float* depth, const DirectX::XMFLOAT4X4& inverseViewProjection)
+{
+    Resize(width, height);
+
+    size_t planeSize = static_cast<size_t>(m_Stride) * m_Height;
+
+    m_ThreadPool.ParallelFor(m_Height, [this, targets, depth, &inverseViewProjection, planeSize](size_t row)
+    {
+        float* planes[s_GeometryPlanes];
+        for (UINT plane = 0; plane < s_GeometryPlanes; plane++)
+            planes[plane] = m_Geometry.data() + plane * planeSize + row * m_Stride;
+
+        for (UINT pixel = 0; pixel < m_Width; pixel++)
+        {
+            size_t texel = row * m_Width + pixel;
+
+            DirectX::XMFLOAT3 albedo = GeometryPacking::DecodeAlbedo(targets[0][texel]);
+            DirectX::XMFLOAT3 normal = GeometryPacking::DecodeNormal(targets[1][texel]);
+            DirectX::XMFLOAT4 material = GeometryPacking::DecodeMaterial(targets[2][texel]);
+
+            // Same planes as the full layout except positions, Geometry.fx uses diffuse color for specular
+            planes[0][pixel] = albedo.x;
+            planes[1][pixel] = albedo.y;
+            planes[2][pixel] = albedo.z;
+            planes[3][pixel] = material.x;
+            planes[4][pixel] = albedo.x;
+            planes[5][pixel] = albedo.y;
+            planes[6][pixel] = albedo.z;
+            planes[7][pixel] = material.y;
+            planes[11][pixel] = material.z;
+            planes[12][pixel] = normal.x;
+            planes[13][pixel] = normal.y;
+            planes[14][pixel] = normal.z;
+            planes[15][pixel] = material.w;
+        }
+
+        LoadPositions(row, depth, inverseViewProjection);
+    });
+}
+
+void Lighting::ClearFrame(const float color[4])
+{
+    size_t planeSize = static_cast<size_t>(m_Stride) * m_Height;
+
+    for (UINT channel = 0; channel < s_FramePlanes; channel++)
+        std::fill_n(m_Frame.data() + channel * planeSize, planeSize, color[channel]);
+}
+
+void Lighting::LoadFrame(const BYTE* texels)
+{
+    size_t planeSize = static_cast<size_t>(m_Stride) * m_Height;
+
+    m_ThreadPool.ParallelFor(m_Height, [this, texels, planeSize](size_t row)
+    {
+        const BYTE* source = texels + row * m_Width * 4;
+
+        for (UINT channel = 0; channel < s_FramePlanes; channel++)
+        {
+            float* plane = m_Frame.data() + channel * planeSize + row * m_Stride;
+
+            for (UINT pixel = 0; pixel < m_Width; pixel++)
+                plane[pixel] = source[pixel * 4 + channel] / 255.0f;
+        }
+    });
+}
+
+void Lighting::StoreFrame(BYTE* texels) const
+{
+    size_t planeSize = static_cast<size_t>(m_Stride) * m_Height;
+
+    m_ThreadPool.ParallelFor(m_Height, [this, texels, planeSize](size_t row)
+    {
+        BYTE* destination = texels + row * m_Width * 4;
+
+        for (UINT channel = 0; channel < s_FramePlanes; channel++)
+        {
+            const float* plane = m_Frame.data() + channel * planeSize + row * m_Stride;
+
+            for (UINT pixel = 0; pixel < m_Width; pixel++)
+                destination[pixel * 4 + channel] = static_cast<BYTE>(Saturate(plane[pixel]) * 255.0f + 0.5f);
+        }
+    });
+}
+
+const float* Lighting::GetFrameRow(UINT channel, UINT row) const
+{
+    return m_Frame.data() + (static_cast<size_t>(channel) * m_Height + row) * m_Stride;
+}
+
+void Lighting::Shade(const std::vector<LightPass>& passes)
+{
+    ShadeTiles(passes, s_TileSize, nullptr);
+}
+
+void Lighting::Shade(const std::vector<LightPass>& passes, const LightTileLists& tiles)
+{
+    assert(tiles.m_TileSize > 0 && tiles.m_TileSize % 8 == 0);
+    ShadeTiles(passes, tiles.m_TileSize, &tiles);
+}
+
+void Lighting::Resize(UINT width, UINT height)
+{
+    if (width == m_Width && height == m_Height)
+        return;
+
+    m_Width = width;
+    m_Height = height;
+    m_Stride = (width + 7) & ~7u;
+
+    // Padding is never written, zero keeps it free of denormals
+    m_Geometry.assign(static_cast<size_t>(m_Stride) * height * s_GeometryPlanes, 0.0f);
+    m_Frame.assign(static_cast<size_t>(m_Stride) * height * s_FramePlanes, 0.0f);
+}
+
+void Lighting::LoadPositions(size_t row, const float* depth, const DirectX::XMFLOAT4X4& inverseViewProjection)
+{
+    size_t planeSize = static_cast<size_t>(m_Stride) * m_Height;
+
+    float* x = m_Geometry.data() + 8 * planeSize + row * m_Stride;
+    float* y = m_Geometry.data() + 9 * planeSize + row * m_Stride;
+    float* z = m_Geometry.data() + 10 * planeSize + row * m_Stride;
+
+    // Pixel centers to normalized device coordinates like GeometryBuffer.fxh, Y goes up
+    DirectX::XMMATRIX unprojection = DirectX::XMLoadFloat4x4(&inverseViewProjection);
+    float ndcY = 1.0f - (static_cast<float>(row) + 0.5f) / static_cast<float>(m_Height) * 2.0f;
+
+    for (UINT pixel = 0; pixel < m_Width; pixel++)
+    {
+        float ndcX = (static_cast<float>(pixel) + 0.5f) / static_cast<float>(m_Width) * 2.0f - 1.0f;
+
+        DirectX::XMFLOAT3 position;
+        DirectX::XMStoreFloat3(&position, DirectX::XMVector3TransformCoord(DirectX::XMVectorSet(ndcX, ndcY, depth[row * m_Width + pixel], 1.0f), unprojection));
+
+        x[pixel] = position.x;
+        y[pixel] = position.y;
+        z[pixel] = position.z;
+    }
+}
+
+void Lighting::ShadeTiles(const std::vector<LightPass>& passes, UINT tileSize, const LightTileLists* tiles)
+{
+    if (passes.empty() || m_Width == 0 || m_Height == 0)
+        return;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::vector<PassUniforms> uniforms;
+    for (const LightPass& pass : passes)
+        uniforms.push_back(GetUniforms(pass));
+
+    UINT tilesX = (m_Width + tileSize - 1) / tileSize;
+    UINT tilesY = (m_Height + tileSize - 1) / tileSize;
+    size_t planeSize = static_cast<size_t>(m_Stride) * m_Height;
+
+    std::atomic<UINT64> lightPixels{ 0 };
+
+    // Scissor edge clamped to a tile edge range
+    auto clip = [](LONG edge, UINT low, UINT high)
+    {
+        return static_cast<UINT>((std::min)((std::max)(edge, static_cast<LONG>(low)), static_cast<LONG>(high)));
+    };
+
+    m_ThreadPool.ParallelFor(static_cast<size_t>(tilesX) * tilesY, [&](size_t tile)
+    {
+        UINT left = static_cast<UINT>(tile % tilesX) * tileSize;
+        UINT top = static_cast<UINT>(tile / tilesX) * tileSize;
+
+        // Tiles start at multiples of 8, padded rows make every span a whole number of vectors
+        UINT right = (std::min)(left + tileSize, m_Stride);
+        UINT bottom = (std::min)(top + tileSize, m_Height);
+
+        // Without lists every tile runs all passes
+        const UINT* order = nullptr;
+        UINT count = static_cast<UINT>(uniforms.size());
+
+        if (tiles != nullptr)
+        {
+            order = tiles->m_Indices + tiles->m_Ranges[tile].x;
+            count = tiles->m_Ranges[tile].y;
+        }
+
+        UINT64 tilePixels = 0;
+
+        for (UINT index = 0; index < count; index++)
+        {
+            const PassUniforms& pass = uniforms[order != nullptr ? order[index] : index];
+
+            // Part of the tile inside the scissor rectangle, columns rounded out to whole vectors
+            UINT passLeft = clip(pass.m_Scissor.left, left, right) & ~7u;
+            UINT passRight = (clip(pass.m_Scissor.right, left, right) + 7) & ~7u;
+            UINT passTop = clip(pass.m_Scissor.top, top, bottom);
+            UINT passBottom = clip(pass.m_Scissor.bottom, top, bottom);
+
+            if (passLeft >= passRight || passTop >= passBottom)
+                continue;
+
+            UINT span = passRight - passLeft;
+            tilePixels += static_cast<UINT64>((std::min)(passRight, m_Width) - passLeft) * (passBottom - passTop);
+
+            for (UINT row = passTop; row < passBottom; row++)
+            {
+                size_t offset = static_cast<size_t>(row) * m_Stride + passLeft;
+
+                const float* geometry[s_GeometryPlanes];
+                float* frame[s_FramePlanes];
+
+                for (UINT plane = 0; plane < s_GeometryPlanes; plane++)
+                    geometry[plane] = m_Geometry.data() + plane * planeSize + offset;
+
+                for (UINT plane = 0; plane < s_FramePlanes; plane++)
+                    frame[plane] = m_Frame.data() + plane * planeSize + offset;
+
+#if defined(__AVX2__)
+                if (m_Simd)
+                {
+                    ShadeSimd(pass, geometry, frame, span);
+                    continue;
+                }
+#endif // __AVX2__
+
+                ShadeScalar(pass, geometry, frame, span);
+            }
+        }
+
+        lightPixels += tilePixels;
+    });
+
+    m_Stats.m_Passes += passes.size();
+    m_Stats.m_LightPixels += lightPixels;
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    m_Stats.m_Time += elapsed.count();
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <d3d11.h>
+#include <DirectXMath.h>
+#include <vector>
+#include <climits>
+#include <limits>
+
+class ThreadPool;
+
+// CPU mirror of AmbientLight.fx / DynamicLight.fx DynamicLight buffer (b0)
+struct LightConstants final
+{
+    int m_Type;
+    DirectX::XMFLOAT3 m_Color;
+    float m_Intensity;
+    float m_Falloff;
+    float m_SpotAngle;
+    float m_SpotBorder;
+};
+
+// CPU mirror of GeometryBuffer.fxh WorldVectors buffer (b1)
+struct LightVectors final
+{
+    DirectX::XMFLOAT4 m_CameraPosition;
+    DirectX::XMFLOAT4 m_LightPosition;
+    DirectX::XMFLOAT4 m_LightDirection;
+    DirectX::XMFLOAT4 m_LightBounds{ 0.0f, 0.0f, 0.0f, std::numeric_limits<float>::infinity() }; // Unbounded unless set
+    DirectX::XMFLOAT4X4 m_InverseViewProjection{ 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+};
+
+struct LightPass final
+{
+    LightConstants m_Light{ };
+    LightVectors m_Vectors{ };
+    bool m_Blend{ true }; // SRC_ALPHA / INV_SRC_ALPHA like FrameBuffer, output overwrites the frame otherwise
+    D3D11_RECT m_Scissor{ 0, 0, LONG_MAX, LONG_MAX }; // Pixels outside are left untouched
+};
+
+// Per tile pass lists, see LightTiles. Tile size has to be a multiple of 8
+struct LightTileLists final
+{
+    UINT m_TileSize{ 0 };
+    const UINT* m_Indices{ nullptr };            // Pass indices grouped by tile
+    const DirectX::XMUINT2* m_Ranges{ nullptr }; // Offset into m_Indices and count, one per tile in row-major order
+};
+
+struct LightingStats final
+{
+    UINT64 m_Passes{ 0 };
+    UINT64 m_LightPixels{ 0 }; // Pixels shaded by all passes
+    double m_Time{ 0.0 };      // Seconds spent in Shade()
+};
+
+// CPU versions of AmbientLight.fx and DynamicLight.fx over a structure-of-arrays G-buffer.
+// Every G-buffer and frame channel is a separate plane with rows padded to 8 pixels, so the AVX2
+// path always processes full vectors. The scalar path follows the shaders line by line and is used
+// when AVX2 is not compiled in or disabled. Scissor columns are rounded out to whole vectors, the
+// light volume test of DynamicLight.fx keeps pixels outside of it untouched.
+class Lighting final
+{
+public:
+    Lighting(ThreadPool& threadPool);
+
+    const LightingStats& GetStats() const;
+
+    // True when built with AVX2, see DX11_AVX2 in CMakeLists.txt
+    static bool IsSimdAvailable();
+    void SetSimd(bool simd);
+
+    // Geometry.fx targets in order: diffuse, specular, normal. Positions are rebuilt from depth at
+    // pixel centers the same way GeometryBuffer.fxh does
+    void LoadGeometry(UINT width, UINT height, const DirectX::XMFLOAT4* const targets[3], const float* depth, const DirectX::XMFLOAT4X4& inverseViewProjection);
+
+    // Packed Geometry.fx targets in order: albedo, normal, material, see GeometryPacking
+    void LoadGeometry(UINT width, UINT height, const UINT* const targets[3], const float* depth, const DirectX::XMFLOAT4X4& inverseViewProjection);
+
+    // Frame is kept in floats between passes, texels are 8-bit RGBA and tightly packed
+    void ClearFrame(const float color[4]);
+    void LoadFrame(const BYTE* texels);
+    void StoreFrame(BYTE* texels) const;
+    const float* GetFrameRow(UINT channel, UINT row) const;
+
+    // Passes run in order, every tile is shaded by all of them before moving on
+    void Shade(const std::vector<LightPass>& passes);
+
+    // Every tile is shaded only by passes in its list, in list order
+    void Shade(const std::vector<LightPass>& passes, const LightTileLists& tiles);
+
+private:
+    void Resize(UINT width, UINT height);
+    void LoadPositions(size_t row, const float* depth, const DirectX::XMFLOAT4X4& inverseViewProjection);
+    void ShadeTiles(const std::vector<LightPass>& passes, UINT tileSize, const LightTileLists* tiles);
+
+    static constexpr UINT s_GeometryPlanes = 16;
+    static constexpr UINT s_FramePlanes = 4;
+    static constexpr UINT s_TileSize = 64;
+
+    ThreadPool& m_ThreadPool;
+    LightingStats m_Stats;
+    bool m_Simd{ true };
+
+    UINT m_Width{ 0 };
+    UINT m_Height{ 0 };
+    UINT m_Stride{ 0 }; // Row length in floats, multiple of 8
+
+    std::vector<float> m_Geometry;
+    std::vector<float> m_Frame;
+};
@@ -22,7 +22,12 @@
 
 #include "Game.h"
 #include "Context.h"
+#include "Benchmark.h"
+#include "SoftwareBackend.h"
 #include <windows.h>
+#include <sstream>
+#include <string>
+#include <cstdio>
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nShowCmd)
 {
@@ -33,8 +38,115 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     params.m_WindowWidth = 800;
     params.m_WindowHeight = 600;
 
+    // -null: run headless without GPU or window
+    // -software: run headless, rasterize geometry pass on CPU
+    // -frames <N>: terminate after N frames, headless runs stop after 100 unless N > 0
+    // -benchmark <name>: run a CPU benchmark and exit, with code 1 if its checks fail
+    // -gbuffer <full|packed>: G-buffer layout, packed by default
+    std::istringstream arguments(lpCmdLine);
+    std::string argument;
+    std::string benchmark;
+
+    while (arguments >> argument)
+    {
+        if (argument == "-null")
+            params.m_DeviceType = DeviceType::Null;
+        else if (argument == "-software")
+            params.m_DeviceType = DeviceType::Software;
+        else if (argument == "-frames")
+            arguments >> params.m_FrameLimit;
+        else if (argument == "-benchmark")
+            arguments >> benchmark;
+        else if (argument == "-gbuffer")
+        {
+            std::string layout;
+            arguments >> layout;
+            game.SetGeometryLayout(layout == "full" ? GeometryLayout::Full : GeometryLayout::Packed);
+        }
+    }
+
+    // WIN32 executables start without a console, statistics go to the one of the parent process if there is one
+    if (params.m_DeviceType != DeviceType::Hardware || !benchmark.empty())
+    {
+        FILE* console = nullptr;
+        if (AttachConsole(ATTACH_PARENT_PROCESS))
+            freopen_s(&console, "CONOUT$", "w", stdout);
+    }
+
+    // Without a window nothing else terminates a headless run, so it cannot run unlimited
+    if (params.m_DeviceType != DeviceType::Hardware && params.m_FrameLimit == 0)
+        params.m_FrameLimit = 100;
+
+    if (!benchmark.empty())
+    {
+        bool isPassed = true;
+        if (!Benchmark::Run(benchmark, isPassed))
+        {
+            std::printf("Unknown benchmark: %s\n", benchmark.c_str());
+            return 1;
+        }
+
+        return isPassed ? 0 : 1;
+    }
+
     Context context(game, params);
     context.Run();
 
+    if (params.m_DeviceType != DeviceType::Hardware)
+    {
+        // Counters of the last frame, earlier frames are identical for a static scene
+        const BackendStats& stats = context.GetDevice().GetBackend().GetStats();
+
+        float averageFrameTime = context.GetTotalTime() / static_cast<float>(context.GetFrameCount());
+
+        std::printf("Frames: %zu, average frame: %.3f ms\n", context.GetFrameCount(), averageFrameTime * 1000.0f);
+        std::printf("Draw calls: %u, instances: %u, indices: %u, state calls: %u, clears: %u\n", stats.m_DrawCalls, stats.m_DrawInstances, stats.m_DrawIndices, stats.m_StateCalls, stats.m_ClearCalls);
+        std::printf("Map calls: %u, mapped bytes: %llu\n", stats.m_MapCalls, stats.m_MappedBytes);
+
+        const DrawQueueStats& drawStats = game.GetDrawStats();
+        std::printf("Sorted draws: %u, state changes: %u, unsorted: %u, radix passes: %u\n", drawStats.m_Draws, drawStats.m_StateChanges, drawStats.m_UnsortedStateChanges, drawStats.m_SortPasses);
+
+        const CullingStats& meshCullingStats = game.GetMeshCullingStats();
+        const CullingStats& lightCullingStats = game.GetLightCullingStats();
+        std::printf("Visible meshes: %u (%u boxes tested), visible lights: %u of %u\n", meshCullingStats.m_Visible, meshCullingStats.m_Tested, lightCullingStats.m_Visible, lightCullingStats.m_Tested);
+
+        const OcclusionStats& occlusionStats = game.GetOcclusionStats();
+        std::printf("Occluded meshes: %u of %u, rejected triangles: %u, occluder triangles: %u, occlusion: %.3f ms\n", occlusionStats.m_Occluded, occlusionStats.m_Tested, occlusionStats.m_OccludedTriangles, occlusionStats.m_OccluderTriangles, occlusionStats.m_Time * 1000.0);
+
+        const LodStats& lodStats = game.GetLodStats();
+        std::printf("Drawn triangles: %u of %u at full detail, level of detail switches: %u\n", lodStats.m_Triangles, lodStats.m_FullTriangles, lodStats.m_Switches);
+
+        const MeshletCullingStats& meshletStats = game.GetMeshletStats();
+        std::printf("Meshlets: %u of %u visible, backfacing: %u, outside: %u, triangles: %u of %u\n", meshletStats.m_Visible, meshletStats.m_Meshlets, meshletStats.m_Backfacing, meshletStats.m_Outside, meshletStats.m_Triangles, meshletStats.m_FullTriangles);
+
+        const BvhStats& sceneStats = game.GetSceneStats();
+        std::printf("Scene nodes: %u, refitted: %u, rebuilt subtrees: %u, quality: %.2f\n", sceneStats.m_Nodes, sceneStats.m_RefitNodes, sceneStats.m_Rebuilds, sceneStats.m_Quality);
+
+        const CommandBufferStats& commandStats = context.GetDevice().GetCommandStats();
+        std::printf("Commands: %u, draw commands: %u, command data: %llu bytes\n", commandStats.m_Commands, commandStats.m_DrawCommands, commandStats.m_DataBytes);
+
+        const StateCacheStats& stateStats = context.GetDevice().GetStateStats();
+        std::printf("State calls issued: %u, elided: %u\n", stateStats.m_IssuedCalls, stateStats.m_ElidedCalls);
+
+        const ConstantRingStats& constantStats = context.GetDevice().GetConstantStats();
+        std::printf("Constant updates: %u, ring allocations: %u, fallbacks: %u, uploaded bytes: %llu\n", commandStats.m_ConstantUpdates, constantStats.m_Allocations, constantStats.m_Fallbacks, constantStats.m_UploadedBytes);
+    }
+
+    if (params.m_DeviceType == DeviceType::Software)
+    {
+        // Totals over all frames
+        const SoftwareBackend& backend = static_cast<const SoftwareBackend&>(context.GetDevice().GetBackend());
+        const RasterizerStats& stats = backend.GetRasterizerStats();
+        const LightingStats& lightingStats = backend.GetLightingStats();
+
+        double frames = static_cast<double>(context.GetFrameCount());
+        double trianglesPerSecond = stats.m_Time > 0.0 ? static_cast<double>(stats.m_Triangles) / stats.m_Time : 0.0;
+
+        std::printf("Triangles: %llu, culled: %llu, binned: %llu\n", stats.m_Triangles, stats.m_CulledTriangles, stats.m_BinnedTriangles);
+        std::printf("Rejected blocks: %llu, shaded pixels: %llu\n", stats.m_RejectedBlocks, stats.m_ShadedPixels);
+        std::printf("Rasterizer: %.3f ms per frame, %.0f triangles/s\n", stats.m_Time * 1000.0 / frames, trianglesPerSecond);
+        std::printf("Lighting: %.3f ms per frame, %llu passes, %llu light pixels\n", lightingStats.m_Time * 1000.0 / frames, lightingStats.m_Passes, lightingStats.m_LightPixels);
+    }
+
     return 0;
 }
@@ -22,124 +22,525 @@
 
 #include "Mesh.h"
 #include "Device.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
 #include <windows.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <cassert>
 
-Mesh::Mesh(DX11Device& device, const MeshData& data)
+namespace
+{
+    // Geometry may be created on loader threads
+    std::atomic<UINT> s_NextGeometryId{ 0 };
+}
+
+void MeshData::ComputeBounds()
+{
+    UINT vertexCount = m_VertexSize / sizeof(Vertex);
+    if (vertexCount == 0)
+    {
+        m_BoundingSphere = { 0.0f, 0.0f, 0.0f, 0.0f };
+        return;
+    }
+
+    DirectX::XMVECTOR boundsMin = DirectX::XMLoadFloat3(&m_VertexData[0].Position);
+    DirectX::XMVECTOR boundsMax = boundsMin;
+
+    for (UINT vertex = 1; vertex < vertexCount; vertex++)
+    {
+        DirectX::XMVECTOR position = DirectX::XMLoadFloat3(&m_VertexData[vertex].Position);
+        boundsMin = DirectX::XMVectorMin(boundsMin, position);
+        boundsMax = DirectX::XMVectorMax(boundsMax, position);
+    }
+
+    // Centered on the box, the farthest vertex is usually closer than its corners
+    DirectX::XMVECTOR center = DirectX::XMVectorScale(DirectX::XMVectorAdd(boundsMin, boundsMax), 0.5f);
+    float radiusSquared = 0.0f;
+
+    for (UINT vertex = 0; vertex < vertexCount; vertex++)
+    {
+        DirectX::XMVECTOR offset = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&m_VertexData[vertex].Position), center);
+        radiusSquared = (std::max)(radiusSquared, DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(offset)));
+    }
+
+    DirectX::XMStoreFloat3(&m_BoundsMin, boundsMin);
+    DirectX::XMStoreFloat3(&m_BoundsMax, boundsMax);
+    DirectX::XMStoreFloat4(&m_BoundingSphere, DirectX::XMVectorSetW(center, std::sqrt(radiusSquared)));
+}
+
+MeshGeometry::MeshGeometry(DX11Device& device, const MeshData& data)
     : DX11Resource(device)
-    , m_Indices(data.m_IndexSize / sizeof(data.m_IndexData[0]))
+    , m_Id(s_NextGeometryId++)
 {
-    ID3D11Device& deviceHandle = m_Device.GetHandle();
+    Backend& backend = m_Device.GetBackend();
+
+    UINT vertexCount = data.m_VertexSize / sizeof(data.m_VertexData[0]);
+    UINT indexCount = data.m_IndexSize / (data.m_IndexFormat == DXGI_FORMAT_R16_UINT ? sizeof(USHORT) : sizeof(UINT));
+
+    std::vector<Vertex> processedVertices;
+    std::vector<UINT> lodIndices;
+    const Vertex* vertices = data.m_VertexData;
+    const UINT* indices = static_cast<const UINT*>(data.m_IndexData);
+
+    // Processing works on 32-bit indices, the buffer gets its own width below
+    std::vector<UINT> wideIndices;
+    if (data.m_IndexFormat == DXGI_FORMAT_R16_UINT)
+    {
+        const USHORT* shortIndices = static_cast<const USHORT*>(data.m_IndexData);
+        wideIndices.assign(shortIndices, shortIndices + indexCount);
+        indices = wideIndices.data();
+    }
 
+    if (data.m_LodCount > 0)
+        m_Lods.assign(data.m_Lods, data.m_Lods + (std::min)(data.m_LodCount, s_MaxLods));
+    else
     {
+        // Meshes without offline levels of detail are processed at load: welded and ordered for the vertex cache
+        // and overdraw, simplified into levels sharing one index buffer, and renumbered for fetch locality last
+        processedVertices.assign(data.m_VertexData, data.m_VertexData + vertexCount);
+        std::vector<UINT> fullIndices(indices, indices + indexCount);
+
+        vertexCount = MeshOptimizer::WeldVertices(processedVertices, fullIndices);
+        MeshOptimizer::OptimizeVertexCache(fullIndices.data(), indexCount, vertexCount);
+        MeshOptimizer::OptimizeOverdraw(processedVertices, fullIndices.data(), indexCount);
+
+        MeshSimplifier::BuildLods(processedVertices.data(), vertexCount, fullIndices.data(), indexCount, lodIndices, m_Lods);
+
+        for (size_t lod = 1; lod < m_Lods.size(); lod++)
+            MeshOptimizer::OptimizeVertexCache(&lodIndices[m_Lods[lod].m_FirstIndex], m_Lods[lod].m_IndexCount, vertexCount);
+
+        MeshOptimizer::OptimizeVertexFetch(processedVertices, lodIndices);
+
+        vertices = processedVertices.data();
+        vertexCount = static_cast<UINT>(processedVertices.size());
+        indices = lodIndices.data();
+        indexCount = static_cast<UINT>(lodIndices.size());
+    }
+
+    m_Indices = m_Lods[0].m_IndexCount;
+    m_VertexFormat = data.m_VertexFormat;
+
+    {
+        MeshData boundedData = data;
+        if (boundedData.m_BoundingSphere.w < 0.0f)
+            boundedData.ComputeBounds();
+
+        m_BoundsMin = boundedData.m_BoundsMin;
+        m_BoundsMax = boundedData.m_BoundsMax;
+        m_BoundingSphere = boundedData.m_BoundingSphere;
+
+        DirectX::XMStoreFloat4x4(&m_PositionTransform, VertexEncoding::GetPositionTransform(m_VertexFormat, m_BoundsMin, m_BoundsMax));
+    }
+
+    {
+        // Meshlets without offline levels would point at vertices renumbered above
+        assert(data.m_MeshletCount == 0 || data.m_LodCount > 0);
+
+        if (data.m_MeshletCount > 0)
+        {
+            m_Meshlets.m_Meshlets.assign(data.m_Meshlets, data.m_Meshlets + data.m_MeshletCount);
+            m_Meshlets.m_Vertices.assign(data.m_MeshletVertices, data.m_MeshletVertices + data.m_MeshletVertexCount);
+            m_Meshlets.m_Indices.assign(data.m_MeshletIndices, data.m_MeshletIndices + data.m_MeshletIndexCount);
+        }
+
+        // Level 0 is copied out of the vertices only to build meshlets from it or to keep it for occluders
+        bool buildMeshlets = data.m_MeshletCount == 0 && data.m_BuildMeshlets;
+
+        if (buildMeshlets || data.m_KeepTriangles)
+        {
+            std::vector<DirectX::XMFLOAT3> positions(vertexCount);
+            for (UINT vertex = 0; vertex < vertexCount; vertex++)
+                positions[vertex] = vertices[vertex].Position;
+
+            std::vector<UINT> levelIndices(indices + m_Lods[0].m_FirstIndex, indices + m_Lods[0].m_FirstIndex + m_Indices);
+
+            if (buildMeshlets)
+                MeshletBuilder::Build(positions.data(), vertexCount, levelIndices.data(), m_Indices, m_Meshlets);
+
+            if (data.m_KeepTriangles)
+            {
+                m_Positions.swap(positions);
+                m_IndexData.swap(levelIndices);
+            }
+        }
+    }
+
+    {
+        UINT stride = VertexEncoding::GetStride(m_VertexFormat);
+
+        // Quantized positions span the bounds of the source vertices, welding and simplification keep them inside
+        std::vector<BYTE> encodedVertices;
+        if (m_VertexFormat != VertexFormat::Full)
+        {
+            encodedVertices.resize(static_cast<size_t>(vertexCount) * stride);
+            VertexEncoding::Encode(m_VertexFormat, vertices, vertexCount, m_BoundsMin, m_BoundsMax, encodedVertices.data());
+        }
+
         D3D11_BUFFER_DESC vertexBufferDesc{ };
-        vertexBufferDesc.ByteWidth = data.m_VertexSize;
-        vertexBufferDesc.StructureByteStride = sizeof(data.m_VertexData[0]);
+        vertexBufferDesc.ByteWidth = vertexCount * stride;
+        vertexBufferDesc.StructureByteStride = stride;
         vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
         vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 
         D3D11_SUBRESOURCE_DATA vertexBufferData{ };
-        vertexBufferData.pSysMem = data.m_VertexData;
+        vertexBufferData.pSysMem = encodedVertices.empty() ? static_cast<const void*>(vertices) : encodedVertices.data();
 
-        HRESULT hr = deviceHandle.CreateBuffer(&vertexBufferDesc, &vertexBufferData, &m_VertexBuffer);
+        HRESULT hr = backend.CreateBuffer(&vertexBufferDesc, &vertexBufferData, &m_VertexBuffer);
         assert(SUCCEEDED(hr));
     }
 
     {
+        // Every vertex of a triangle list is addressable with 16 bits up to 65536 vertices
+        std::vector<USHORT> shortIndices;
+        if (vertexCount <= 65536)
+        {
+            m_IndexFormat = DXGI_FORMAT_R16_UINT;
+            shortIndices.assign(indices, indices + indexCount);
+        }
+
+        UINT stride = m_IndexFormat == DXGI_FORMAT_R16_UINT ? sizeof(USHORT) : sizeof(UINT);
+
         D3D11_BUFFER_DESC indexBufferDesc{ };
-        indexBufferDesc.ByteWidth = data.m_IndexSize;
-        indexBufferDesc.StructureByteStride = sizeof(data.m_IndexData[0]);
+        indexBufferDesc.ByteWidth = indexCount * stride;
+        indexBufferDesc.StructureByteStride = stride;
         indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
         indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
 
         D3D11_SUBRESOURCE_DATA indexBufferData{ };
-        indexBufferData.pSysMem = data.m_IndexData;
+        indexBufferData.pSysMem = shortIndices.empty() ? static_cast<const void*>(indices) : shortIndices.data();
 
-        HRESULT hr = deviceHandle.CreateBuffer(&indexBufferDesc, &indexBufferData, &m_IndexBuffer);
+        HRESULT hr = backend.CreateBuffer(&indexBufferDesc, &indexBufferData, &m_IndexBuffer);
         assert(SUCCEEDED(hr));
     }
+}
+
+UINT MeshGeometry::GetId() const
+{
+    return m_Id;
+}
+
+const DirectX::XMFLOAT3& MeshGeometry::GetBoundsMin() const
+{
+    return m_BoundsMin;
+}
+
+const DirectX::XMFLOAT3& MeshGeometry::GetBoundsMax() const
+{
+    return m_BoundsMax;
+}
 
-    UpdateWorld();
+const DirectX::XMFLOAT4& MeshGeometry::GetBoundingSphere() const
+{
+    return m_BoundingSphere;
+}
+
+VertexFormat MeshGeometry::GetVertexFormat() const
+{
+    return m_VertexFormat;
+}
+
+const DirectX::XMFLOAT4X4& MeshGeometry::GetPositionTransform() const
+{
+    return m_PositionTransform;
 }
 
-const DirectX::XMMATRIX& Mesh::GetRotation() const
+DXGI_FORMAT MeshGeometry::GetIndexFormat() const
 {
-    return m_Rotataion;
+    return m_IndexFormat;
+}
+
+const MeshletData& MeshGeometry::GetMeshlets() const
+{
+    return m_Meshlets;
+}
+
+const std::vector<DirectX::XMFLOAT3>& MeshGeometry::GetPositions() const
+{
+    return m_Positions;
+}
+
+const std::vector<UINT>& MeshGeometry::GetIndices() const
+{
+    return m_IndexData;
+}
+
+UINT MeshGeometry::GetIndexCount() const
+{
+    return m_Indices;
+}
+
+UINT MeshGeometry::GetLodCount() const
+{
+    return static_cast<UINT>(m_Lods.size());
+}
+
+const MeshLod& MeshGeometry::GetLod(UINT lod) const
+{
+    return m_Lods[lod];
+}
+
+void MeshGeometry::Enable()
+{
+    CommandBuffer& commandBuffer = m_Device.GetCommandBuffer();
+
+    {
+        commandBuffer.SetVertexBuffer(0, m_VertexBuffer.Get(), VertexEncoding::GetStride(m_VertexFormat), 0); // Input Assembly
+        commandBuffer.SetIndexBuffer(m_IndexBuffer.Get(), m_IndexFormat, 0); // Input Assembly
+        commandBuffer.SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST); // Input Assembly
+    }
+}
+
+void MeshGeometry::Disable()
+{
+    CommandBuffer& commandBuffer = m_Device.GetCommandBuffer();
+
+    {
+        commandBuffer.SetVertexBuffer(0, nullptr, VertexEncoding::GetStride(m_VertexFormat), 0); // Input Assembly
+        commandBuffer.SetIndexBuffer(nullptr, m_IndexFormat, 0); // Input Assembly
+    }
+}
+
+void MeshGeometry::Draw() const
+{
+    CommandBuffer& commandBuffer = m_Device.GetCommandBuffer();
+    commandBuffer.DrawIndexed(m_Indices, m_Lods[0].m_FirstIndex, 0);
+}
+
+void MeshGeometry::DrawInstanced(UINT instanceCount, UINT startInstance, UINT lod) const
+{
+    CommandBuffer& commandBuffer = m_Device.GetCommandBuffer();
+    commandBuffer.DrawIndexedInstanced(m_Lods[lod].m_IndexCount, instanceCount, m_Lods[lod].m_FirstIndex, 0, startInstance);
+}
+
+void MeshGeometry::DrawRange(UINT startIndex, UINT indexCount, UINT startInstance) const
+{
+    CommandBuffer& commandBuffer = m_Device.GetCommandBuffer();
+    commandBuffer.DrawIndexedInstanced(indexCount, 1, startIndex, 0, startInstance);
+}
+
+Mesh::Mesh(DX11Device& device, TransformHierarchy& transforms, const MeshData& data, TransformId parent)
+    : Mesh(device, transforms, std::make_shared<MeshGeometry>(device, data), parent)
+{ }
+
+Mesh::Mesh(DX11Device& device, TransformHierarchy& transforms, const std::shared_ptr<MeshGeometry>& geometry, TransformId parent)
+    : DX11Resource(device)
+    , m_Transforms(transforms)
+    , m_Transform(transforms.Create(parent))
+    , m_Geometry(geometry)
+{ }
+
+MeshGeometry& Mesh::GetGeometry() const
+{
+    return *m_Geometry;
+}
+
+TransformId Mesh::GetTransform() const
+{
+    return m_Transform;
+}
+
+DirectX::XMVECTOR Mesh::GetRotation() const
+{
+    return m_Transforms.GetRotation(m_Transform);
 }
 
 void Mesh::Rotate(const DirectX::XMVECTOR& axis, float angle)
 {
-    DirectX::XMMATRIX rotation(DirectX::XMMatrixRotationAxis(axis, DirectX::XMConvertToRadians(angle)));
-    m_Rotataion = DirectX::XMMatrixMultiply(m_Rotataion, rotation);
-    UpdateWorld();
+    m_Transforms.Rotate(m_Transform, axis, angle);
 }
 
-const DirectX::XMVECTOR& Mesh::GetScaling() const
+DirectX::XMVECTOR Mesh::GetScaling() const
 {
-    return m_Scaling;
+    return m_Transforms.GetScaling(m_Transform);
 }
 
 void Mesh::Scale(const DirectX::XMVECTOR& scaling)
 {
-    m_Scaling = DirectX::XMVectorMultiply(m_Scaling, scaling);
-    UpdateWorld();
+    m_Transforms.Scale(m_Transform, scaling);
 }
 
-const DirectX::XMVECTOR& Mesh::GetPosition() const
+DirectX::XMVECTOR Mesh::GetPosition() const
 {
-    return m_Position;
+    return m_Transforms.GetPosition(m_Transform);
 }
 
 void Mesh::Move(const DirectX::XMVECTOR& position)
 {
-    m_Position = DirectX::XMVectorAdd(m_Position, position);
-    UpdateWorld();
+    m_Transforms.Move(m_Transform, position);
 }
 
-const DirectX::XMMATRIX& Mesh::GetWorld() const
+DirectX::XMVECTOR Mesh::GetWorldPosition() const
 {
-    return m_World;
+    return m_Transforms.GetWorldPosition(m_Transform);
 }
 
-void Mesh::Enable()
+DirectX::XMVECTOR Mesh::GetBoundingSphere() const
 {
-    ID3D11DeviceContext& deviceContext = m_Device.GetContext();
+    return DirectX::XMLoadFloat4(&m_BoundingSphere);
+}
+
+UINT Mesh::GetLod() const
+{
+    return m_Lod;
+}
+
+UINT Mesh::SelectLod(const DirectX::XMVECTOR& cameraPosition, float pixelsPerUnit, float threshold)
+{
+    const MeshGeometry& geometry = *m_Geometry;
+
+    // World units per object unit from the bounding spheres, distance to the nearest point of the sphere
+    DirectX::XMVECTOR sphere = GetBoundingSphere();
+    float radius = DirectX::XMVectorGetW(sphere);
+    float objectRadius = geometry.GetBoundingSphere().w;
+    float scale = objectRadius > 0.0f ? radius / objectRadius : 1.0f;
+
+    float distance = DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVectorSubtract(sphere, cameraPosition))) - radius;
+    if (!(distance > 0.0f))
+    {
+        m_Lod = 0;
+        return m_Lod;
+    }
+
+    float pixelsPerError = scale * pixelsPerUnit / distance;
+
+    // Errors grow with levels
+    UINT finest = 0;
+    UINT coarsest = 0;
 
+    for (UINT lod = 1; lod < geometry.GetLodCount(); lod++)
     {
-        ID3D11Buffer* buffers[] = { m_VertexBuffer.Get() };
-        UINT strides[] = { sizeof(Vertex) };
-        UINT offsets[] = { 0 };
+        float pixels = geometry.GetLod(lod).m_Error * pixelsPerError;
 
-        deviceContext.IASetVertexBuffers(0, 1, buffers, strides, offsets); // Input Assembly
-        deviceContext.IASetIndexBuffer(m_IndexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0); // Input Assembly
-        deviceContext.IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST); // Input Assembly
+        if (pixels <= threshold)
+            finest = lod;
+
+        if (pixels <= threshold * (1.0f - s_LodHysteresis))
+            coarsest = lod;
     }
+
+    if (m_Lod < coarsest)
+        m_Lod = coarsest;
+    else if (m_Lod > finest)
+        m_Lod = finest;
+
+    return m_Lod;
 }
 
-void Mesh::Disable()
+bool Mesh::IsOccluder() const
+{
+    return m_IsOccluder;
+}
+
+void Mesh::SetOccluder(bool isOccluder)
+{
+    assert(!isOccluder || !m_Geometry->GetPositions().empty());
+    m_IsOccluder = isOccluder;
+}
+
+const DirectX::XMFLOAT3& Mesh::GetBoundsMin() const
+{
+    return m_BoundsMin;
+}
+
+const DirectX::XMFLOAT3& Mesh::GetBoundsMax() const
+{
+    return m_BoundsMax;
+}
+
+const InstanceData& Mesh::GetInstance() const
 {
-    ID3D11DeviceContext& deviceContext = m_Device.GetContext();
+    assert(m_WorldVersion != 0);
+    return m_Instance;
+}
 
+UINT Mesh::UpdateWorlds(const std::vector<std::unique_ptr<Mesh>>& meshes, std::vector<UINT>& updated)
+{
+    updated.clear();
+
+    for (UINT index = 0; index < static_cast<UINT>(meshes.size()); index++)
     {
-        ID3D11Buffer* buffers[] = { nullptr };
-        UINT strides[] = { sizeof(Vertex) };
-        UINT offsets[] = { 0 };
+        Mesh& mesh = *meshes[index];
+
+        if (mesh.m_WorldVersion == mesh.m_Transforms.GetVersion(mesh.m_Transform))
+            continue;
 
-        deviceContext.IASetVertexBuffers(0, 1, buffers, strides, offsets); // Input Assembly
-        deviceContext.IASetIndexBuffer(nullptr, DXGI_FORMAT_R32_UINT, 0); // Input Assembly
+        mesh.UpdateWorld();
+        updated.push_back(index);
     }
+
+    return static_cast<UINT>(updated.size());
+}
+
+void Mesh::Enable()
+{
+    m_Geometry->Enable();
+}
+
+void Mesh::Disable()
+{
+    m_Geometry->Disable();
 }
 
 void Mesh::Draw() const
 {
-    ID3D11DeviceContext& deviceContext = m_Device.GetContext();
-    deviceContext.DrawIndexed(m_Indices, 0, 0);
+    m_Geometry->Draw();
 }
 
 void Mesh::UpdateWorld()
 {
-    DirectX::XMMATRIX scaling(DirectX::XMMatrixScalingFromVector(m_Scaling));
-    DirectX::XMMATRIX translation(DirectX::XMMatrixTranslationFromVector(m_Position));
+    DirectX::XMMATRIX world(m_Transforms.GetWorld(m_Transform));
+    DirectX::XMMATRIX worldNormals;
+
+    // Uniform scale s: the 3x3 part is s times a rotation, whose inverse transpose is the rotation itself,
+    // so the normal matrix is the world divided by s twice. Translation would only reach w of transformed
+    // normals, which Geometry.fx drops.
+    float scale = m_Transforms.GetWorldScale(m_Transform);
+
+    if (scale != 0.0f)
+    {
+        DirectX::XMVECTOR inverseScale = DirectX::XMVectorReplicate(1.0f / (scale * scale));
+
+        worldNormals.r[0] = DirectX::XMVectorMultiply(world.r[0], inverseScale);
+        worldNormals.r[1] = DirectX::XMVectorMultiply(world.r[1], inverseScale);
+        worldNormals.r[2] = DirectX::XMVectorMultiply(world.r[2], inverseScale);
+        worldNormals.r[3] = DirectX::XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+    else
+    {
+        DirectX::XMVECTOR determinant(DirectX::XMMatrixDeterminant(world));
+        worldNormals = DirectX::XMMatrixTranspose(DirectX::XMMatrixInverse(&determinant, world));
+    }
+
+    // Dequantization only moves positions, normals are decoded in object space already
+    DirectX::XMStoreFloat4x4(&m_Instance.m_World, DirectX::XMMatrixMultiply(DirectX::XMLoadFloat4x4(&m_Geometry->GetPositionTransform()), world));
+    DirectX::XMStoreFloat4x4(&m_Instance.m_WorldNormals, worldNormals);
+
+    // Radius grows with the longest scaled axis
+    const DirectX::XMFLOAT4& sphere = m_Geometry->GetBoundingSphere();
+    DirectX::XMVECTOR center = DirectX::XMVector3TransformCoord(DirectX::XMVectorSet(sphere.x, sphere.y, sphere.z, 1.0f), world);
+
+    float axisScale = std::sqrt((std::max)({
+        DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(world.r[0])),
+        DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(world.r[1])),
+        DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(world.r[2])) }));
+
+    DirectX::XMStoreFloat4(&m_BoundingSphere, DirectX::XMVectorSetW(center, sphere.w * axisScale));
+
+    // Box center is transformed, every world axis extent sums the absolute contributions of the local ones
+    DirectX::XMVECTOR boundsMin = DirectX::XMLoadFloat3(&m_Geometry->GetBoundsMin());
+    DirectX::XMVECTOR boundsMax = DirectX::XMLoadFloat3(&m_Geometry->GetBoundsMax());
+
+    DirectX::XMVECTOR boxCenter = DirectX::XMVector3TransformCoord(DirectX::XMVectorScale(DirectX::XMVectorAdd(boundsMin, boundsMax), 0.5f), world);
+    DirectX::XMVECTOR halfExtent = DirectX::XMVectorScale(DirectX::XMVectorSubtract(boundsMax, boundsMin), 0.5f);
+
+    DirectX::XMVECTOR worldExtent = DirectX::XMVectorAdd(DirectX::XMVectorAdd(
+        DirectX::XMVectorAbs(DirectX::XMVectorScale(world.r[0], DirectX::XMVectorGetX(halfExtent))),
+        DirectX::XMVectorAbs(DirectX::XMVectorScale(world.r[1], DirectX::XMVectorGetY(halfExtent)))),
+        DirectX::XMVectorAbs(DirectX::XMVectorScale(world.r[2], DirectX::XMVectorGetZ(halfExtent))));
 
-    m_World = scaling * m_Rotataion * translation;
+    DirectX::XMStoreFloat3(&m_BoundsMin, DirectX::XMVectorSubtract(boxCenter, worldExtent));
+    DirectX::XMStoreFloat3(&m_BoundsMax, DirectX::XMVectorAdd(boxCenter, worldExtent));
+    m_WorldVersion = m_Transforms.GetVersion(m_Transform);
 }
@@ -23,19 +23,17 @@
 #pragma once
 
 #include "Resource.h"
+#include "TransformHierarchy.h"
+#include "VertexFormat.h"
+#include "Meshlet.h"
 #include <d3d11.h>
 #include <wrl/client.h>
 #include <DirectXMath.h>
+#include <memory>
+#include <vector>
 
 class DX11Device;
 
-struct Vertex final
-{
-    DirectX::XMFLOAT3 Position{ 0.0f, 0.0f, 0.0f };
-    DirectX::XMFLOAT3 Normal{ 0.0f, 0.0f, 0.0f };
-    DirectX::XMFLOAT2 TexCoord{ 0.0f, 0.0f };
-};
-
 struct StaticData final
 {
     static constexpr Vertex s_QuadVertices[] =
@@ -90,29 +88,175 @@ struct StaticData final
     };
 };
 
+// Index range of a level of detail, levels share the vertices of the full mesh
+struct MeshLod final
+{
+    UINT m_FirstIndex{ 0 };
+    UINT m_IndexCount{ 0 };
+    float m_Error{ 0.0f }; // Largest deviation from the full mesh in object units
+};
+
 struct MeshData final
 {
     const Vertex* m_VertexData{ nullptr };
-    const UINT* m_IndexData{ nullptr };
+    const void* m_IndexData{ nullptr }; // Of m_IndexFormat
     UINT m_VertexSize{ 0 };
     UINT m_IndexSize{ 0 };
+    DXGI_FORMAT m_IndexFormat{ DXGI_FORMAT_R32_UINT }; // Or DXGI_FORMAT_R16_UINT
+
+    // Levels of detail built offline, m_IndexData holds all of them. Built from level 0 at load if empty.
+    const MeshLod* m_Lods{ nullptr };
+    UINT m_LodCount{ 0 };
+
+    // Layout of the vertex buffer, m_VertexData is encoded into it at load
+    VertexFormat m_VertexFormat{ VertexFormat::Full };
+
+    // Split level 0 into meshlets at load, see MeshGeometry::GetMeshlets()
+    bool m_BuildMeshlets{ false };
+
+    // Keep a CPU copy of level 0 for meshes drawn as occluders, see MeshGeometry::GetPositions()
+    bool m_KeepTriangles{ false };
+
+    // Meshlets of level 0 built offline, used instead of building them. Only valid with offline levels, whose
+    // vertex numbering they share.
+    const Meshlet* m_Meshlets{ nullptr };
+    UINT m_MeshletCount{ 0 };
+    const UINT* m_MeshletVertices{ nullptr };
+    UINT m_MeshletVertexCount{ 0 };
+    const BYTE* m_MeshletIndices{ nullptr };
+    UINT m_MeshletIndexCount{ 0 };
+
+    // Object space bounds of the vertices, filled by ComputeBounds() unless known in advance
+    DirectX::XMFLOAT3 m_BoundsMin{ 0.0f, 0.0f, 0.0f };
+    DirectX::XMFLOAT3 m_BoundsMax{ 0.0f, 0.0f, 0.0f };
+    DirectX::XMFLOAT4 m_BoundingSphere{ 0.0f, 0.0f, 0.0f, -1.0f }; // Center in xyz, radius in w, negative if not computed
+
+    void ComputeBounds();
+};
+
+// Per-instance stream of Geometry.fx at input slot 1, rows as in DirectXMath
+struct InstanceData final
+{
+    DirectX::XMFLOAT4X4 m_World;        // Preceded by the position transform of the geometry
+    DirectX::XMFLOAT4X4 m_WorldNormals; // Inverse transpose of the world alone
 };
 
+struct LodStats final
+{
+    UINT m_Triangles{ 0 };     // Drawn
+    UINT m_FullTriangles{ 0 }; // Had every mesh been drawn at level 0
+    UINT m_Switches{ 0 };      // Meshes changing level since the previous frame
+};
+
+// Vertex and index buffers, shared by every mesh placing them in the world
+class MeshGeometry final : public DX11Resource
+{
+public:
+    static constexpr UINT s_MaxLods = 8;
+
+    MeshGeometry(DX11Device& device, const MeshData& data);
+
+    // Unique per geometry, draw keys group instances by it
+    UINT GetId() const;
+    UINT GetIndexCount() const; // Of the full mesh
+
+    // Level 0 is the full mesh, coarser levels follow with growing errors
+    UINT GetLodCount() const;
+    const MeshLod& GetLod(UINT lod) const;
+
+    // Object space bounds, see MeshData
+    const DirectX::XMFLOAT3& GetBoundsMin() const;
+    const DirectX::XMFLOAT3& GetBoundsMax() const;
+    const DirectX::XMFLOAT4& GetBoundingSphere() const;
+
+    // Vertex buffer layout, shaders drawing the geometry need the matching input layout. Quantized positions
+    // are brought back into object space by the position transform, instances put it in front of their world.
+    VertexFormat GetVertexFormat() const;
+    const DirectX::XMFLOAT4X4& GetPositionTransform() const;
+
+    // 16-bit whenever the vertices allow it
+    DXGI_FORMAT GetIndexFormat() const;
+
+    // Level 0 as meshlets with byte indices into small vertex tables, empty unless requested by MeshData
+    const MeshletData& GetMeshlets() const;
+
+    // CPU copy of the full mesh triangles, occluders are rasterized from it. Empty unless requested by MeshData.
+    const std::vector<DirectX::XMFLOAT3>& GetPositions() const;
+    const std::vector<UINT>& GetIndices() const;
+
+    void Enable() override;
+    void Disable() override;
+
+    void Draw() const;
+    void DrawInstanced(UINT instanceCount, UINT startInstance, UINT lod = 0) const;
+
+    // One instance with indices of a buffer bound in place of the own one, see MeshletCulling
+    void DrawRange(UINT startIndex, UINT indexCount, UINT startInstance) const;
+
+private:
+    Microsoft::WRL::ComPtr<ID3D11Buffer> m_VertexBuffer;
+    Microsoft::WRL::ComPtr<ID3D11Buffer> m_IndexBuffer;
+
+    UINT m_Indices{ 0 };
+    DXGI_FORMAT m_IndexFormat{ DXGI_FORMAT_R32_UINT };
+    UINT m_Id{ 0 };
+    std::vector<MeshLod> m_Lods;
+
+    VertexFormat m_VertexFormat{ VertexFormat::Full };
+    DirectX::XMFLOAT4X4 m_PositionTransform{ };
+
+    DirectX::XMFLOAT3 m_BoundsMin{ };
+    DirectX::XMFLOAT3 m_BoundsMax{ };
+    DirectX::XMFLOAT4 m_BoundingSphere{ };
+
+    MeshletData m_Meshlets;
+
+    std::vector<DirectX::XMFLOAT3> m_Positions;
+    std::vector<UINT> m_IndexData;
+};
+
+// Geometry placed in the world by a node of the transform hierarchy
 class Mesh final : public DX11Resource
 {
 public:
-    Mesh(DX11Device& device, const MeshData& data);
+    static constexpr float s_LodHysteresis = 0.25f; // Part of the threshold a coarser level has to stay below
+    Mesh(DX11Device& device, TransformHierarchy& transforms, const MeshData& data, TransformId parent = TransformHierarchy::s_None); // With geometry of its own
+    Mesh(DX11Device& device, TransformHierarchy& transforms, const std::shared_ptr<MeshGeometry>& geometry, TransformId parent = TransformHierarchy::s_None);
+
+    MeshGeometry& GetGeometry() const;
+    TransformId GetTransform() const; // Lights and meshes can be attached to it
 
-    const DirectX::XMMATRIX& GetRotation() const;
+    // Local transform, relative to the parent
+    DirectX::XMVECTOR GetRotation() const;
     void Rotate(const DirectX::XMVECTOR& axis, float angle);
 
-    const DirectX::XMVECTOR& GetScaling() const;
+    DirectX::XMVECTOR GetScaling() const;
     void Scale(const DirectX::XMVECTOR& scaling);
 
-    const DirectX::XMVECTOR& GetPosition() const;
+    DirectX::XMVECTOR GetPosition() const;
     void Move(const DirectX::XMVECTOR& position);
 
-    const DirectX::XMMATRIX& GetWorld() const;
+    // As of the last UpdateWorlds()
+    DirectX::XMVECTOR GetWorldPosition() const;
+    DirectX::XMVECTOR GetBoundingSphere() const; // Of the geometry in world space, center in xyz and radius in w
+    const DirectX::XMFLOAT3& GetBoundsMin() const; // World space box around the geometry box
+    const DirectX::XMFLOAT3& GetBoundsMax() const;
+    const InstanceData& GetInstance() const;
+
+    // Occluders are drawn whenever in view and hide other meshes from the occlusion culling, their geometry
+    // has to keep its triangles, see MeshData
+    bool IsOccluder() const;
+    void SetOccluder(bool isOccluder);
+
+    // Level of detail drawn, the coarsest one whose error projects to at most threshold pixels. Coarser levels
+    // are only taken once their error is clearly below the threshold, so meshes at the switching distance do
+    // not flip between levels every frame. pixelsPerUnit is the size of one unit at distance one on screen.
+    UINT GetLod() const;
+    UINT SelectLod(const DirectX::XMVECTOR& cameraPosition, float pixelsPerUnit, float threshold);
+
+    // Rebuilds instance matrices of meshes whose world changed in the last TransformHierarchy::Update(),
+    // replaces updated with their indices
+    static UINT UpdateWorlds(const std::vector<std::unique_ptr<Mesh>>& meshes, std::vector<UINT>& updated);
 
     void Enable() override;
     void Disable() override;
@@ -122,14 +266,16 @@ public:
 private:
     void UpdateWorld();
 
-    DirectX::XMMATRIX m_Rotataion{ DirectX::XMMatrixIdentity() };
-    DirectX::XMVECTOR m_Scaling{ DirectX::XMVectorSet(1.0f, 1.0f, 1.0f, 1.0f) };
-    DirectX::XMVECTOR m_Position{ DirectX::XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f) };
-
-    DirectX::XMMATRIX m_World{ DirectX::XMMatrixIdentity() };
+    TransformHierarchy& m_Transforms;
+    TransformId m_Transform{ TransformHierarchy::s_None };
 
-    Microsoft::WRL::ComPtr<ID3D11Buffer> m_VertexBuffer;
-    Microsoft::WRL::ComPtr<ID3D11Buffer> m_IndexBuffer;
+    InstanceData m_Instance{ };
+    DirectX::XMFLOAT4 m_BoundingSphere{ };
+    DirectX::XMFLOAT3 m_BoundsMin{ };
+    DirectX::XMFLOAT3 m_BoundsMax{ };
+    UINT m_WorldVersion{ 0 }; // Of the transform when m_Instance was built, versions start at 1
+    UINT m_Lod{ 0 };
+    bool m_IsOccluder{ false };
 
-    UINT m_Indices{ 0 };
+    std::shared_ptr<MeshGeometry> m_Geometry;
 };
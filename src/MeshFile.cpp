@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "MeshFile.h"
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+    UINT64 AlignUp(UINT64 value)
+    {
+        return (value + MeshFile::s_Alignment - 1) / MeshFile::s_Alignment * MeshFile::s_Alignment;
+    }
+
+    UINT GetIndexStride(UINT indexFormat)
+    {
+        return indexFormat == DXGI_FORMAT_R16_UINT ? sizeof(USHORT) : sizeof(UINT);
+    }
+
+    // Element sizes of the sections, the file stores them as laid out in memory
+    constexpr UINT64 s_ElementSizes[] =
+    {
+        sizeof(Vertex), 0, sizeof(MeshLod), sizeof(Meshlet), sizeof(UINT), sizeof(BYTE), sizeof(MeshFileBounds)
+    };
+
+    template<typename T>
+    UINT GetMaxIndex(const void* indices, UINT indexCount)
+    {
+        UINT maxIndex = 0;
+        for (UINT index = 0; index < indexCount; index++)
+            maxIndex = (std::max)(maxIndex, static_cast<UINT>(static_cast<const T*>(indices)[index]));
+
+        return maxIndex;
+    }
+
+    // Every range MeshGeometry reads through, a file that passes cannot make it index past a section
+    bool IsConsistent(const MeshData& data)
+    {
+        UINT vertexCount = data.m_VertexSize / static_cast<UINT>(sizeof(Vertex));
+        UINT indexCount = data.m_IndexSize / GetIndexStride(data.m_IndexFormat);
+
+        // Offline meshlets number vertices as the offline levels do, levels built at load renumber them
+        if (data.m_MeshletCount > 0 && data.m_LodCount == 0)
+            return false;
+
+        if (data.m_LodCount > MeshGeometry::s_MaxLods || (data.m_LodCount == 0 && indexCount % 3 != 0))
+            return false;
+
+        for (UINT lod = 0; lod < data.m_LodCount; lod++)
+        {
+            const MeshLod& level = data.m_Lods[lod];
+            if (level.m_IndexCount == 0 || level.m_IndexCount % 3 != 0 || static_cast<UINT64>(level.m_FirstIndex) + level.m_IndexCount > indexCount)
+                return false;
+        }
+
+        UINT maxIndex = data.m_IndexFormat == DXGI_FORMAT_R16_UINT ? GetMaxIndex<USHORT>(data.m_IndexData, indexCount) : GetMaxIndex<UINT>(data.m_IndexData, indexCount);
+        if (indexCount > 0 && maxIndex >= vertexCount)
+            return false;
+
+        for (UINT meshlet = 0; meshlet < data.m_MeshletCount; meshlet++)
+        {
+            const Meshlet& current = data.m_Meshlets[meshlet];
+            if (current.m_VertexCount > MeshletBuilder::s_MaxVertices || current.m_TriangleCount > MeshletBuilder::s_MaxTriangles)
+                return false;
+
+            UINT64 indexEnd = (static_cast<UINT64>(current.m_FirstTriangle) + current.m_TriangleCount) * 3;
+            if (static_cast<UINT64>(current.m_FirstVertex) + current.m_VertexCount > data.m_MeshletVertexCount || indexEnd > data.m_MeshletIndexCount)
+                return false;
+
+            // Local indices address the vertex table of their own meshlet
+            for (UINT64 index = static_cast<UINT64>(current.m_FirstTriangle) * 3; index < indexEnd; index++)
+            {
+                if (data.m_MeshletIndices[index] >= current.m_VertexCount)
+                    return false;
+            }
+        }
+
+        UINT maxMeshletVertex = GetMaxIndex<UINT>(data.m_MeshletVertices, data.m_MeshletVertexCount);
+        return data.m_MeshletVertexCount == 0 || maxMeshletVertex < vertexCount;
+    }
+
+    static_assert(sizeof(s_ElementSizes) / sizeof(s_ElementSizes[0]) == static_cast<size_t>(MeshFileSection::Count), "Element size of every section");
+    static_assert(sizeof(MeshFileHeader) % sizeof(UINT64) == 0, "Hashed bytes start at a word");
+    static_assert(sizeof(Vertex) == 32 && sizeof(MeshLod) == 12 && sizeof(Meshlet) == 48, "Section layouts are part of the format");
+}
+
+MeshFile::MeshFile(const std::string& path, bool verify)
+{
+    auto fail = [this, &path](const char* reason)
+    {
+        if (m_View != nullptr)
+            UnmapViewOfFile(m_View);
+        if (m_Mapping != nullptr)
+            CloseHandle(m_Mapping);
+        if (m_File != INVALID_HANDLE_VALUE)
+            CloseHandle(m_File);
+
+        throw std::runtime_error(std::string("Failed to load mesh: ") + path + ", " + reason);
+    };
+
+    m_File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_File == INVALID_HANDLE_VALUE)
+        fail("cannot open");
+
+    LARGE_INTEGER fileSize{ };
+    if (!GetFileSizeEx(m_File, &fileSize) || static_cast<UINT64>(fileSize.QuadPart) < sizeof(MeshFileHeader))
+        fail("too small");
+
+    m_Size = static_cast<UINT64>(fileSize.QuadPart);
+
+    m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_Mapping == nullptr)
+        fail("cannot map");
+
+    m_View = static_cast<const BYTE*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+    if (m_View == nullptr)
+        fail("cannot map");
+
+    // The header and the sections holding indices are read here, vertices are touched when used
+    const MeshFileHeader& header = GetHeader();
+
+    if (header.m_Magic != s_Magic)
+        fail("not a mesh file");
+    if (header.m_Version != s_Version)
+        fail("unsupported version");
+    if (header.m_FileSize != m_Size || m_Size % s_Alignment != 0)
+        fail("truncated");
+    if (header.m_VertexFormat >= VertexEncoding::s_FormatCount || (header.m_IndexFormat != DXGI_FORMAT_R16_UINT && header.m_IndexFormat != DXGI_FORMAT_R32_UINT))
+        fail("unknown format");
+
+    for (UINT section = 0; section < static_cast<UINT>(MeshFileSection::Count); section++)
+    {
+        const MeshFileRange& range = header.m_Sections[section];
+        UINT64 elementSize = section == static_cast<UINT>(MeshFileSection::Indices) ? GetIndexStride(header.m_IndexFormat) : s_ElementSizes[section];
+
+        // Sizes end up in UINT fields of MeshData
+        bool isInside = range.m_Offset >= sizeof(MeshFileHeader) && range.m_Size <= m_Size && range.m_Offset <= m_Size - range.m_Size;
+        if (!isInside || range.m_Offset % s_Alignment != 0 || range.m_Size % elementSize != 0 || range.m_Size > 0xFFFFFFFF)
+            fail("bad section");
+    }
+
+    if (header.m_Sections[static_cast<UINT>(MeshFileSection::Bounds)].m_Size != sizeof(MeshFileBounds))
+        fail("bad section");
+
+    if (verify && Hash(m_View + sizeof(MeshFileHeader), m_Size - sizeof(MeshFileHeader)) != header.m_Hash)
+        fail("hash mismatch");
+
+    auto getSection = [this, &header](MeshFileSection section)
+    {
+        return m_View + header.m_Sections[static_cast<UINT>(section)].m_Offset;
+    };
+
+    auto getCount = [&header](MeshFileSection section, UINT64 elementSize)
+    {
+        return static_cast<UINT>(header.m_Sections[static_cast<UINT>(section)].m_Size / elementSize);
+    };
+
+    m_Data.m_VertexData = reinterpret_cast<const Vertex*>(getSection(MeshFileSection::Vertices));
+    m_Data.m_VertexSize = getCount(MeshFileSection::Vertices, 1);
+    m_Data.m_IndexData = getSection(MeshFileSection::Indices);
+    m_Data.m_IndexSize = getCount(MeshFileSection::Indices, 1);
+    m_Data.m_IndexFormat = static_cast<DXGI_FORMAT>(header.m_IndexFormat);
+    m_Data.m_VertexFormat = static_cast<VertexFormat>(header.m_VertexFormat);
+
+    m_Data.m_Lods = reinterpret_cast<const MeshLod*>(getSection(MeshFileSection::Lods));
+    m_Data.m_LodCount = getCount(MeshFileSection::Lods, sizeof(MeshLod));
+
+    m_Data.m_Meshlets = reinterpret_cast<const Meshlet*>(getSection(MeshFileSection::Meshlets));
+    m_Data.m_MeshletCount = getCount(MeshFileSection::Meshlets, sizeof(Meshlet));
+    m_Data.m_MeshletVertices = reinterpret_cast<const UINT*>(getSection(MeshFileSection::MeshletVertices));
+    m_Data.m_MeshletVertexCount = getCount(MeshFileSection::MeshletVertices, sizeof(UINT));
+    m_Data.m_MeshletIndices = getSection(MeshFileSection::MeshletIndices);
+    m_Data.m_MeshletIndexCount = getCount(MeshFileSection::MeshletIndices, sizeof(BYTE));
+
+    const MeshFileBounds& bounds = *reinterpret_cast<const MeshFileBounds*>(getSection(MeshFileSection::Bounds));
+    m_Data.m_BoundsMin = bounds.m_BoundsMin;
+    m_Data.m_BoundsMax = bounds.m_BoundsMax;
+    m_Data.m_BoundingSphere = bounds.m_BoundingSphere;
+
+    if (!IsConsistent(m_Data))
+        fail("bad section");
+}
+
+MeshFile::~MeshFile()
+{
+    UnmapViewOfFile(m_View);
+    CloseHandle(m_Mapping);
+    CloseHandle(m_File);
+}
+
+const MeshData& MeshFile::GetData() const
+{
+    return m_Data;
+}
+
+const MeshFileHeader& MeshFile::GetHeader() const
+{
+    return *reinterpret_cast<const MeshFileHeader*>(m_View);
+}
+
+UINT64 MeshFile::GetSize() const
+{
+    return m_Size;
+}
+
+void MeshFile::Write(const std::string& path, const MeshData& data)
+{
+    if (!IsConsistent(data))
+    {
+        throw std::runtime_error("Failed to write mesh: " + path + ", inconsistent ranges");
+    }
+
+    MeshData boundedData = data;
+    if (boundedData.m_BoundingSphere.w < 0.0f)
+        boundedData.ComputeBounds();
+
+    MeshFileBounds bounds{ boundedData.m_BoundsMin, boundedData.m_BoundsMax, boundedData.m_BoundingSphere };
+
+    const void* sources[] =
+    {
+        data.m_VertexData, data.m_IndexData, data.m_Lods, data.m_Meshlets, data.m_MeshletVertices, data.m_MeshletIndices, &bounds
+    };
+
+    const UINT64 sizes[] =
+    {
+        data.m_VertexSize,
+        data.m_IndexSize,
+        static_cast<UINT64>(data.m_LodCount) * sizeof(MeshLod),
+        static_cast<UINT64>(data.m_MeshletCount) * sizeof(Meshlet),
+        static_cast<UINT64>(data.m_MeshletVertexCount) * sizeof(UINT),
+        static_cast<UINT64>(data.m_MeshletIndexCount) * sizeof(BYTE),
+        sizeof(MeshFileBounds)
+    };
+
+    MeshFileHeader header;
+    header.m_Magic = s_Magic;
+    header.m_Version = s_Version;
+    header.m_VertexFormat = static_cast<UINT>(data.m_VertexFormat);
+    header.m_IndexFormat = static_cast<UINT>(data.m_IndexFormat);
+
+    UINT64 offset = AlignUp(sizeof(MeshFileHeader));
+
+    for (UINT section = 0; section < static_cast<UINT>(MeshFileSection::Count); section++)
+    {
+        header.m_Sections[section] = { offset, sizes[section] };
+        offset = AlignUp(offset + sizes[section]);
+    }
+
+    header.m_FileSize = offset;
+
+    // Padding stays zero, the hash covers it
+    std::vector<BYTE> file(static_cast<size_t>(header.m_FileSize));
+
+    for (UINT section = 0; section < static_cast<UINT>(MeshFileSection::Count); section++)
+    {
+        if (sizes[section] > 0)
+            std::memcpy(&file[static_cast<size_t>(header.m_Sections[section].m_Offset)], sources[section], static_cast<size_t>(sizes[section]));
+    }
+
+    header.m_Hash = Hash(file.data() + sizeof(MeshFileHeader), file.size() - sizeof(MeshFileHeader));
+    std::memcpy(file.data(), &header, sizeof(header));
+
+    std::ofstream meshFile(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    meshFile.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+
+    if (!meshFile)
+    {
+        throw std::runtime_error("Failed to write mesh: " + path);
+    }
+}
+
+UINT64 MeshFile::Hash(const BYTE* data, UINT64 size)
+{
+    UINT64 hash = 14695981039346656037ull;
+
+    for (UINT64 offset = 0; offset + sizeof(UINT64) <= size; offset += sizeof(UINT64))
+    {
+        UINT64 word;
+        std::memcpy(&word, data + offset, sizeof(word));
+
+        hash ^= word;
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
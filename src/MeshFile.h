@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "Mesh.h"
+#include <windows.h>
+#include <string>
+
+// Sections of a mesh file, in file order
+enum class MeshFileSection
+{
+    Vertices,        // Vertex
+    Indices,         // USHORT or UINT, see MeshFileHeader::m_IndexFormat
+    Lods,            // MeshLod, empty if the levels are built at load
+    Meshlets,        // Meshlet of level 0, empty if built at load or not at all
+    MeshletVertices, // UINT
+    MeshletIndices,  // BYTE
+    Bounds,          // One MeshFileBounds
+    Count
+};
+
+struct MeshFileRange final
+{
+    UINT64 m_Offset{ 0 }; // From the start of the file, multiple of MeshFile::s_Alignment
+    UINT64 m_Size{ 0 };   // Bytes
+};
+
+struct MeshFileBounds final
+{
+    DirectX::XMFLOAT3 m_BoundsMin;
+    DirectX::XMFLOAT3 m_BoundsMax;
+    DirectX::XMFLOAT4 m_BoundingSphere;
+};
+
+// Fixed size header at the start of the file, little endian like every section
+struct MeshFileHeader final
+{
+    UINT m_Magic{ 0 };
+    UINT m_Version{ 0 };
+    UINT m_VertexFormat{ 0 }; // VertexFormat the geometry encodes the vertices into
+    UINT m_IndexFormat{ 0 };  // DXGI_FORMAT_R16_UINT or DXGI_FORMAT_R32_UINT
+    UINT64 m_FileSize{ 0 };
+    UINT64 m_Hash{ 0 };       // Of every byte after the header, see MeshFile::Hash()
+    MeshFileRange m_Sections[static_cast<size_t>(MeshFileSection::Count)];
+};
+
+// Binary mesh container laid out as MeshData expects it in memory. The file is mapped read only and MeshData
+// points straight into the sections, so opening reads only the header and the sections holding indices, whose
+// ranges are checked, and reading vertices costs page faults; nothing is parsed or copied. Sections start at
+// aligned offsets and the file is padded to the alignment, which the hash walks in 64-bit words. The mapping
+// lives as long as the MeshFile, and so does its MeshData.
+class MeshFile final
+{
+public:
+    static constexpr UINT s_Magic = 0x4853454D; // "MESH"
+    static constexpr UINT s_Version = 1;
+    static constexpr UINT s_Alignment = 64;
+
+    // Throws if the file cannot be mapped, its header does not describe it or a level, index or meshlet
+    // points outside its section. Verifying the hash reads the whole file.
+    MeshFile(const std::string& path, bool verify = false);
+    ~MeshFile();
+
+    MeshFile(const MeshFile&) = delete;
+    MeshFile& operator=(const MeshFile&) = delete;
+
+    const MeshData& GetData() const;
+    const MeshFileHeader& GetHeader() const;
+    UINT64 GetSize() const;
+
+    // Computes the bounds unless data has them, throws if the file cannot be written or would not
+    // load, as with meshlets but no levels
+    static void Write(const std::string& path, const MeshData& data);
+
+    // 64-bit FNV-1a over 64-bit words, size is a multiple of 8
+    static UINT64 Hash(const BYTE* data, UINT64 size);
+
+private:
+    HANDLE m_File{ INVALID_HANDLE_VALUE };
+    HANDLE m_Mapping{ nullptr };
+    const BYTE* m_View{ nullptr };
+    UINT64 m_Size{ 0 };
+
+    MeshData m_Data;
+};
@@ -0,0 +1,1823 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "MeshImporter.h"
+#include "ThreadPool.h"
+#include <windows.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace
+{
+    // Chunks of OBJ text per thread, more than one evens out lines of different cost
+    constexpr size_t s_ChunksPerThread = 4;
+    constexpr size_t s_MinChunkSize = 1 << 16;
+
+    // Corners are deduplicated in shards picked by the top bits of their hash, one hash map each
+    constexpr UINT s_ShardBits = 6;
+    constexpr UINT s_ShardCount = 1 << s_ShardBits;
+
+    constexpr int s_Missing = INT_MIN; // OBJ corner without texture coordinate or normal
+
+    constexpr UINT s_MaxJsonDepth = 64;
+    constexpr UINT s_MaxNodeDepth = 256;
+
+    std::vector<char> ReadFile(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
+        if (!file)
+            throw std::runtime_error("Failed to open mesh: " + path);
+
+        std::vector<char> contents(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(contents.data(), static_cast<std::streamsize>(contents.size()));
+
+        if (!file)
+            throw std::runtime_error("Failed to read mesh: " + path);
+
+        return contents;
+    }
+
+    // Read only view of a whole file, its pages are read in as the parser threads reach them
+    class MappedFile final
+    {
+    public:
+        explicit MappedFile(const std::string& path)
+        {
+            LARGE_INTEGER size{ };
+
+            m_File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (m_File == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_File, &size))
+            {
+                Close();
+                throw std::runtime_error("Failed to open mesh: " + path);
+            }
+
+            // Empty files cannot be mapped
+            m_Size = static_cast<size_t>(size.QuadPart);
+            if (m_Size == 0)
+                return;
+
+            m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            m_View = m_Mapping != nullptr ? static_cast<const char*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+
+            if (m_View == nullptr)
+            {
+                Close();
+                throw std::runtime_error("Failed to map mesh: " + path);
+            }
+        }
+
+        ~MappedFile()
+        {
+            Close();
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const char* GetData() const
+        {
+            return m_View;
+        }
+
+        size_t GetSize() const
+        {
+            return m_Size;
+        }
+
+    private:
+        void Close()
+        {
+            if (m_View != nullptr)
+                UnmapViewOfFile(m_View);
+            if (m_Mapping != nullptr)
+                CloseHandle(m_Mapping);
+            if (m_File != INVALID_HANDLE_VALUE)
+                CloseHandle(m_File);
+        }
+
+        HANDLE m_File{ INVALID_HANDLE_VALUE };
+        HANDLE m_Mapping{ nullptr };
+        const char* m_View{ nullptr };
+        size_t m_Size{ 0 };
+    };
+
+    std::string GetDirectory(const std::string& path)
+    {
+        size_t separator = path.find_last_of("/\\");
+        return separator == std::string::npos ? std::string() : path.substr(0, separator + 1);
+    }
+
+    std::string GetExtension(const std::string& path)
+    {
+        size_t dot = path.find_last_of('.');
+        if (dot == std::string::npos || path.find_first_of("/\\", dot) != std::string::npos)
+            return std::string();
+
+        std::string extension = path.substr(dot + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+        return extension;
+    }
+
+    UINT64 Mix(UINT64 value)
+    {
+        value ^= value >> 30;
+        value *= 0xBF58476D1CE4E5B9ull;
+        value ^= value >> 27;
+        value *= 0x94D049BB133111EBull;
+        return value ^ (value >> 31);
+    }
+
+    // Right-handed source space to the left-handed one of the renderer
+    DirectX::XMFLOAT3 Mirror(const DirectX::XMFLOAT3& vector)
+    {
+        return { vector.x, vector.y, -vector.z };
+    }
+
+    // Area weighted normal of a clockwise triangle, added to its corners
+    void AddTriangleNormal(const DirectX::XMFLOAT3* positions, const UINT corners[3], DirectX::XMFLOAT3* normals)
+    {
+        DirectX::XMVECTOR a = DirectX::XMLoadFloat3(&positions[corners[0]]);
+        DirectX::XMVECTOR b = DirectX::XMLoadFloat3(&positions[corners[1]]);
+        DirectX::XMVECTOR c = DirectX::XMLoadFloat3(&positions[corners[2]]);
+        DirectX::XMVECTOR normal = DirectX::XMVector3Cross(DirectX::XMVectorSubtract(b, a), DirectX::XMVectorSubtract(c, a));
+
+        for (UINT corner = 0; corner < 3; corner++)
+            DirectX::XMStoreFloat3(&normals[corners[corner]], DirectX::XMVectorAdd(DirectX::XMLoadFloat3(&normals[corners[corner]]), normal));
+    }
+
+    DirectX::XMFLOAT3 NormalizeOrUp(const DirectX::XMFLOAT3& vector)
+    {
+        DirectX::XMVECTOR value = DirectX::XMLoadFloat3(&vector);
+        if (DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(value)) == 0.0f)
+            return { 0.0f, 1.0f, 0.0f };
+
+        DirectX::XMFLOAT3 normal;
+        DirectX::XMStoreFloat3(&normal, DirectX::XMVector3Normalize(value));
+        return normal;
+    }
+
+    // Open addressing map of keys to vertex numbers in order of first insertion
+    template<typename Key, UINT64 (*Hash)(const Key&), bool (*IsEqual)(const Key&, const Key&)>
+    class VertexTable final
+    {
+    public:
+        explicit VertexTable(size_t expectedKeys)
+        {
+            m_Keys.reserve(expectedKeys);
+            Rehash(expectedKeys * 2);
+        }
+
+        UINT Insert(const Key& key)
+        {
+            if (2 * (m_Keys.size() + 1) > m_Slots.size())
+                Rehash(m_Slots.size() * 2);
+
+            for (size_t slot = Hash(key) & m_Mask; ; slot = (slot + 1) & m_Mask)
+            {
+                UINT number = m_Slots[slot];
+                if (number == s_Empty)
+                {
+                    number = static_cast<UINT>(m_Keys.size());
+                    m_Slots[slot] = number;
+                    m_Keys.push_back(key);
+                    return number;
+                }
+
+                if (IsEqual(m_Keys[number], key))
+                    return number;
+            }
+        }
+
+        std::vector<Key>& GetKeys()
+        {
+            return m_Keys;
+        }
+
+    private:
+        static constexpr UINT s_Empty = UINT_MAX;
+
+        void Rehash(size_t slotCount)
+        {
+            size_t size = 16;
+            while (size < slotCount)
+                size *= 2;
+
+            m_Slots.assign(size, s_Empty);
+            m_Mask = size - 1;
+
+            for (size_t number = 0; number < m_Keys.size(); number++)
+            {
+                size_t slot = Hash(m_Keys[number]) & m_Mask;
+                while (m_Slots[slot] != s_Empty)
+                    slot = (slot + 1) & m_Mask;
+
+                m_Slots[slot] = static_cast<UINT>(number);
+            }
+        }
+
+        std::vector<UINT> m_Slots;
+        std::vector<Key> m_Keys;
+        size_t m_Mask{ 0 };
+    };
+
+    bool IsSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    const char* SkipSpaces(const char* text, const char* end)
+    {
+        while (text < end && IsSpace(*text))
+            text++;
+
+        return text;
+    }
+
+    // Keyword followed by a space or the line end
+    bool StartsWith(const char* text, const char* end, const char* keyword)
+    {
+        size_t length = std::strlen(keyword);
+        return static_cast<size_t>(end - text) >= length && std::memcmp(text, keyword, length) == 0 && (text + length == end || IsSpace(text[length]));
+    }
+
+    // Rest of the line without surrounding spaces
+    std::string ParseName(const char* text, const char* end)
+    {
+        text = SkipSpaces(text, end);
+        while (end > text && IsSpace(end[-1]))
+            end--;
+
+        return std::string(text, end);
+    }
+
+    bool ParseInt(const char*& text, const char* end, int& value)
+    {
+        const char* cursor = text;
+        bool isNegative = cursor < end && *cursor == '-';
+        if (cursor < end && (*cursor == '-' || *cursor == '+'))
+            cursor++;
+
+        if (cursor == end || *cursor < '0' || *cursor > '9')
+            return false;
+
+        INT64 result = 0;
+        for (; cursor < end && *cursor >= '0' && *cursor <= '9'; cursor++)
+        {
+            result = result * 10 + (*cursor - '0');
+            if (result > INT_MAX)
+                return false;
+        }
+
+        value = static_cast<int>(isNegative ? -result : result);
+        text = cursor;
+        return true;
+    }
+
+    bool ParseFloats(const char*& text, const char* end, float* values, UINT count)
+    {
+        for (UINT index = 0; index < count; index++)
+        {
+            text = SkipSpaces(text, end);
+            if (!MeshImporter::ParseFloat(text, end, values[index]))
+                return false;
+        }
+
+        return true;
+    }
+
+    struct ObjCorner final
+    {
+        int m_Position{ 0 };
+        int m_TexCoord{ s_Missing };
+        int m_Normal{ s_Missing };
+        UINT m_Relative{ 0 }; // Bit per attribute counted back from the chunk end, resolved once chunk offsets are known
+    };
+
+    UINT64 HashCorner(const ObjCorner& corner)
+    {
+        UINT64 attributes = static_cast<UINT64>(static_cast<UINT>(corner.m_Position)) << 32 | static_cast<UINT>(corner.m_TexCoord);
+        return Mix(attributes ^ Mix(static_cast<UINT>(corner.m_Normal)));
+    }
+
+    bool IsEqualCorner(const ObjCorner& a, const ObjCorner& b)
+    {
+        return a.m_Position == b.m_Position && a.m_TexCoord == b.m_TexCoord && a.m_Normal == b.m_Normal;
+    }
+
+    UINT64 HashVertex(const Vertex& vertex)
+    {
+        UINT64 words[4];
+        static_assert(sizeof(words) == sizeof(Vertex), "Vertex hashed as words");
+        std::memcpy(words, &vertex, sizeof(words));
+
+        return Mix(words[0] ^ Mix(words[1] ^ Mix(words[2] ^ Mix(words[3]))));
+    }
+
+    bool IsEqualVertex(const Vertex& a, const Vertex& b)
+    {
+        return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+    }
+
+    // Lines of an OBJ file between two line ends, parsed on its own
+    struct ObjChunk final
+    {
+        const char* m_Begin{ nullptr };
+        const char* m_End{ nullptr };
+
+        std::vector<DirectX::XMFLOAT3> m_Positions;
+        std::vector<DirectX::XMFLOAT2> m_TexCoords;
+        std::vector<DirectX::XMFLOAT3> m_Normals;
+        std::vector<ObjCorner> m_Corners; // Three per triangle in the winding of the renderer, polygons are fanned
+
+        std::vector<std::pair<size_t, std::string>> m_MaterialSwitches; // usemtl and the first corner after it
+        std::vector<std::string> m_Libraries;
+        bool m_HasMissingNormals{ false };
+
+        // Of the chunk in the whole file
+        size_t m_FirstPosition{ 0 };
+        size_t m_FirstTexCoord{ 0 };
+        size_t m_FirstNormal{ 0 };
+        size_t m_FirstCorner{ 0 };
+
+        // Corners by the shard of their hash in file order, then the shard vertex of each once deduplicated
+        std::vector<BYTE> m_CornerShards;
+        std::vector<ObjCorner> m_ShardCorners[s_ShardCount];
+        std::vector<UINT> m_ShardVertices[s_ShardCount];
+        std::string m_Error;
+    };
+
+    // One based, negative counting back from the last element so far
+    bool ParseObjIndex(const char*& text, const char* end, size_t count, UINT relativeBit, ObjCorner& corner, int& index)
+    {
+        int value = 0;
+        if (!ParseInt(text, end, value) || value == 0)
+            return false;
+
+        if (value > 0)
+            index = value - 1;
+        else
+        {
+            index = static_cast<int>(count) + value;
+            corner.m_Relative |= relativeBit;
+        }
+
+        return true;
+    }
+
+    // Corners as v, v/vt, v//vn or v/vt/vn
+    bool ParseObjFace(ObjChunk& chunk, const char* text, const char* end, std::vector<ObjCorner>& polygon)
+    {
+        polygon.clear();
+
+        for (text = SkipSpaces(text, end); text < end; text = SkipSpaces(text, end))
+        {
+            ObjCorner corner;
+            if (!ParseObjIndex(text, end, chunk.m_Positions.size(), 1, corner, corner.m_Position))
+                return false;
+
+            if (text < end && *text == '/')
+            {
+                text++;
+                if (text < end && *text != '/' && !ParseObjIndex(text, end, chunk.m_TexCoords.size(), 2, corner, corner.m_TexCoord))
+                    return false;
+
+                if (text < end && *text == '/')
+                {
+                    text++;
+                    if (!ParseObjIndex(text, end, chunk.m_Normals.size(), 4, corner, corner.m_Normal))
+                        return false;
+                }
+            }
+
+            if (text < end && !IsSpace(*text))
+                return false;
+
+            chunk.m_HasMissingNormals = chunk.m_HasMissingNormals || corner.m_Normal == s_Missing;
+            polygon.push_back(corner);
+        }
+
+        if (polygon.size() < 3)
+            return false;
+
+        for (size_t corner = 2; corner < polygon.size(); corner++)
+            chunk.m_Corners.insert(chunk.m_Corners.end(), { polygon[0], polygon[corner], polygon[corner - 1] });
+
+        return true;
+    }
+
+    // Geometry, faces and materials; groups, smoothing groups and free-form geometry are ignored
+    bool ParseObjLine(ObjChunk& chunk, const char* text, const char* end, std::vector<ObjCorner>& polygon)
+    {
+        if (text == end || *text == '#')
+            return true;
+
+        if (StartsWith(text, end, "v"))
+        {
+            // Optional w and vertex colors are ignored
+            float position[3];
+            text += 1;
+            if (!ParseFloats(text, end, position, 3))
+                return false;
+
+            chunk.m_Positions.push_back({ position[0], position[1], position[2] });
+        }
+        else if (StartsWith(text, end, "vt"))
+        {
+            float texCoord[2] = { 0.0f, 0.0f };
+            text += 2;
+            if (!ParseFloats(text, end, texCoord, 1))
+                return false;
+
+            text = SkipSpaces(text, end);
+            if (text < end && !MeshImporter::ParseFloat(text, end, texCoord[1]))
+                return false;
+
+            chunk.m_TexCoords.push_back({ texCoord[0], texCoord[1] });
+        }
+        else if (StartsWith(text, end, "vn"))
+        {
+            float normal[3];
+            text += 2;
+            if (!ParseFloats(text, end, normal, 3))
+                return false;
+
+            chunk.m_Normals.push_back({ normal[0], normal[1], normal[2] });
+        }
+        else if (StartsWith(text, end, "f"))
+            return ParseObjFace(chunk, text + 1, end, polygon);
+        else if (StartsWith(text, end, "usemtl"))
+            chunk.m_MaterialSwitches.emplace_back(chunk.m_Corners.size(), ParseName(text + 6, end));
+        else if (StartsWith(text, end, "mtllib"))
+            chunk.m_Libraries.push_back(ParseName(text + 6, end));
+
+        return true;
+    }
+
+    void ParseObjChunk(ObjChunk& chunk)
+    {
+        std::vector<ObjCorner> polygon;
+
+        for (const char* text = chunk.m_Begin; text < chunk.m_End; )
+        {
+            const char* lineEnd = static_cast<const char*>(std::memchr(text, '\n', chunk.m_End - text));
+            if (lineEnd == nullptr)
+                lineEnd = chunk.m_End;
+
+            if (!ParseObjLine(chunk, SkipSpaces(text, lineEnd), lineEnd, polygon))
+            {
+                chunk.m_Error = "Malformed OBJ line: " + std::string(text, (std::min)(lineEnd - text, static_cast<ptrdiff_t>(80)));
+                return;
+            }
+
+            text = lineEnd < chunk.m_End ? lineEnd + 1 : chunk.m_End;
+        }
+    }
+
+    // Materials the OBJ uses by name, others are skipped. Lines that do not parse are ignored like unknown ones.
+    void ParseMaterialLibrary(const std::vector<char>& text, const std::unordered_map<std::string, UINT>& names, std::vector<ImportedMaterial>& materials)
+    {
+        ImportedMaterial* material = nullptr;
+        const char* end = text.data() + text.size();
+
+        for (const char* line = text.data(); line < end; )
+        {
+            const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', end - line));
+            if (lineEnd == nullptr)
+                lineEnd = end;
+
+            const char* cursor = SkipSpaces(line, lineEnd);
+            line = lineEnd < end ? lineEnd + 1 : end;
+
+            if (StartsWith(cursor, lineEnd, "newmtl"))
+            {
+                auto name = names.find(ParseName(cursor + 6, lineEnd));
+                material = name != names.end() ? &materials[name->second] : nullptr;
+                continue;
+            }
+
+            if (material == nullptr)
+                continue;
+
+            float values[3];
+
+            if (StartsWith(cursor, lineEnd, "Kd"))
+            {
+                cursor += 2;
+                if (ParseFloats(cursor, lineEnd, values, 3))
+                    material->m_DiffuseColor = { values[0], values[1], values[2], material->m_DiffuseColor.w };
+            }
+            else if (StartsWith(cursor, lineEnd, "Ks"))
+            {
+                cursor += 2;
+                if (ParseFloats(cursor, lineEnd, values, 3))
+                    material->m_SpecularIntensity = (std::max)({ values[0], values[1], values[2] });
+            }
+            else if (StartsWith(cursor, lineEnd, "Ns"))
+            {
+                cursor += 2;
+                if (ParseFloats(cursor, lineEnd, values, 1))
+                    material->m_SpecularHardness = static_cast<int>((std::max)(1.0f, std::round(values[0])));
+            }
+            else if (StartsWith(cursor, lineEnd, "d"))
+            {
+                cursor += 1;
+                if (ParseFloats(cursor, lineEnd, values, 1))
+                    material->m_DiffuseColor.w = values[0];
+            }
+            else if (StartsWith(cursor, lineEnd, "Tr"))
+            {
+                cursor += 2;
+                if (ParseFloats(cursor, lineEnd, values, 1))
+                    material->m_DiffuseColor.w = 1.0f - values[0];
+            }
+            else if (StartsWith(cursor, lineEnd, "map_Kd"))
+            {
+                // Options such as -s precede the file name
+                std::string arguments = ParseName(cursor + 6, lineEnd);
+                size_t separator = arguments.find_last_of(" \t");
+                material->m_DiffuseTexture = separator == std::string::npos ? arguments : arguments.substr(separator + 1);
+            }
+        }
+    }
+
+    struct JsonValue final
+    {
+        enum class Type
+        {
+            Null,
+            Boolean,
+            Number,
+            String,
+            Array,
+            Object
+        };
+
+        Type m_Type{ Type::Null };
+        bool m_Boolean{ false };
+        double m_Number{ 0.0 };
+        std::string m_String;
+        std::vector<std::string> m_Names;  // Of object members
+        std::vector<JsonValue> m_Elements; // Array elements or object member values
+
+        // Null if absent
+        const JsonValue& operator[](const char* name) const
+        {
+            static const JsonValue s_Null;
+
+            if (m_Type == Type::Object)
+            {
+                for (size_t member = 0; member < m_Names.size(); member++)
+                {
+                    if (m_Names[member] == name)
+                        return m_Elements[member];
+                }
+            }
+
+            return s_Null;
+        }
+
+        const JsonValue& operator[](size_t index) const
+        {
+            static const JsonValue s_Null;
+            return m_Type == Type::Array && index < m_Elements.size() ? m_Elements[index] : s_Null;
+        }
+
+        bool IsNull() const
+        {
+            return m_Type == Type::Null;
+        }
+
+        size_t GetSize() const
+        {
+            return m_Type == Type::Array ? m_Elements.size() : 0;
+        }
+
+        double GetNumber(double fallback) const
+        {
+            return m_Type == Type::Number ? m_Number : fallback;
+        }
+    };
+
+    class JsonParser final
+    {
+    public:
+        JsonParser(const char* text, size_t size)
+            : m_Text(text)
+            , m_End(text + size)
+        { }
+
+        void Parse(JsonValue& value)
+        {
+            ParseValue(value, 0);
+            SkipWhitespace();
+
+            if (m_Text != m_End)
+                Fail();
+        }
+
+    private:
+        [[noreturn]] void Fail()
+        {
+            throw std::runtime_error("Malformed glTF JSON");
+        }
+
+        void SkipWhitespace()
+        {
+            while (m_Text < m_End && (*m_Text == ' ' || *m_Text == '\t' || *m_Text == '\n' || *m_Text == '\r'))
+                m_Text++;
+        }
+
+        bool Consume(char c)
+        {
+            SkipWhitespace();
+            if (m_Text == m_End || *m_Text != c)
+                return false;
+
+            m_Text++;
+            return true;
+        }
+
+        void Expect(const char* literal)
+        {
+            size_t length = std::strlen(literal);
+            if (static_cast<size_t>(m_End - m_Text) < length || std::memcmp(m_Text, literal, length) != 0)
+                Fail();
+
+            m_Text += length;
+        }
+
+        void ParseValue(JsonValue& value, UINT depth)
+        {
+            SkipWhitespace();
+            if (m_Text == m_End || depth > s_MaxJsonDepth)
+                Fail();
+
+            switch (*m_Text)
+            {
+            case '{':
+                m_Text++;
+                value.m_Type = JsonValue::Type::Object;
+                if (Consume('}'))
+                    return;
+
+                do
+                {
+                    SkipWhitespace();
+                    value.m_Names.emplace_back();
+                    ParseString(value.m_Names.back());
+
+                    if (!Consume(':'))
+                        Fail();
+
+                    value.m_Elements.emplace_back();
+                    ParseValue(value.m_Elements.back(), depth + 1);
+                } while (Consume(','));
+
+                if (!Consume('}'))
+                    Fail();
+                return;
+
+            case '[':
+                m_Text++;
+                value.m_Type = JsonValue::Type::Array;
+                if (Consume(']'))
+                    return;
+
+                do
+                {
+                    value.m_Elements.emplace_back();
+                    ParseValue(value.m_Elements.back(), depth + 1);
+                } while (Consume(','));
+
+                if (!Consume(']'))
+                    Fail();
+                return;
+
+            case '"':
+                value.m_Type = JsonValue::Type::String;
+                ParseString(value.m_String);
+                return;
+
+            case 't':
+                Expect("true");
+                value.m_Type = JsonValue::Type::Boolean;
+                value.m_Boolean = true;
+                return;
+
+            case 'f':
+                Expect("false");
+                value.m_Type = JsonValue::Type::Boolean;
+                return;
+
+            case 'n':
+                Expect("null");
+                return;
+
+            default:
+                value.m_Type = JsonValue::Type::Number;
+                ParseNumber(value.m_Number);
+                return;
+            }
+        }
+
+        void ParseNumber(double& number)
+        {
+            const char* start = m_Text;
+            while (m_Text < m_End && ((*m_Text >= '0' && *m_Text <= '9') || *m_Text == '-' || *m_Text == '+' || *m_Text == '.' || *m_Text == 'e' || *m_Text == 'E'))
+                m_Text++;
+
+            // Offsets and counts need more precision than ParseFloat gives
+            std::string token(start, m_Text);
+            char* tokenEnd = nullptr;
+            number = std::strtod(token.c_str(), &tokenEnd);
+
+            if (token.empty() || tokenEnd != token.c_str() + token.size())
+                Fail();
+        }
+
+        UINT ParseHex()
+        {
+            if (m_End - m_Text < 4)
+                Fail();
+
+            UINT code = 0;
+            for (UINT digit = 0; digit < 4; digit++)
+            {
+                char c = *m_Text++;
+                UINT value = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : 16;
+                if (value == 16)
+                    Fail();
+
+                code = code * 16 + value;
+            }
+
+            return code;
+        }
+
+        void ParseString(std::string& string)
+        {
+            if (m_Text == m_End || *m_Text != '"')
+                Fail();
+
+            for (m_Text++; ; )
+            {
+                if (m_Text == m_End)
+                    Fail();
+
+                char c = *m_Text++;
+                if (c == '"')
+                    return;
+
+                if (c != '\\')
+                {
+                    string.push_back(c);
+                    continue;
+                }
+
+                if (m_Text == m_End)
+                    Fail();
+
+                switch (*m_Text++)
+                {
+                case '"': string.push_back('"'); break;
+                case '\\': string.push_back('\\'); break;
+                case '/': string.push_back('/'); break;
+                case 'b': string.push_back('\b'); break;
+                case 'f': string.push_back('\f'); break;
+                case 'n': string.push_back('\n'); break;
+                case 'r': string.push_back('\r'); break;
+                case 't': string.push_back('\t'); break;
+                case 'u':
+                {
+                    UINT code = ParseHex();
+                    if (code >= 0xD800 && code < 0xDC00)
+                    {
+                        Expect("\\u");
+                        UINT low = ParseHex();
+                        if (low < 0xDC00 || low >= 0xE000)
+                            Fail();
+
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+
+                    // UTF-8
+                    if (code < 0x80)
+                        string.push_back(static_cast<char>(code));
+                    else if (code < 0x800)
+                        string.append({ static_cast<char>(0xC0 | code >> 6), static_cast<char>(0x80 | (code & 0x3F)) });
+                    else if (code < 0x10000)
+                        string.append({ static_cast<char>(0xE0 | code >> 12), static_cast<char>(0x80 | (code >> 6 & 0x3F)), static_cast<char>(0x80 | (code & 0x3F)) });
+                    else
+                        string.append({ static_cast<char>(0xF0 | code >> 18), static_cast<char>(0x80 | (code >> 12 & 0x3F)), static_cast<char>(0x80 | (code >> 6 & 0x3F)), static_cast<char>(0x80 | (code & 0x3F)) });
+                    break;
+                }
+                default:
+                    Fail();
+                }
+            }
+        }
+
+        const char* m_Text;
+        const char* m_End;
+    };
+
+    std::vector<char> DecodeBase64(const char* text, size_t size)
+    {
+        std::vector<char> bytes;
+        bytes.reserve(size / 4 * 3);
+
+        UINT bits = 0;
+        UINT bitCount = 0;
+
+        for (size_t index = 0; index < size && text[index] != '='; index++)
+        {
+            char c = text[index];
+            UINT value = c >= 'A' && c <= 'Z' ? c - 'A' : c >= 'a' && c <= 'z' ? c - 'a' + 26 : c >= '0' && c <= '9' ? c - '0' + 52 : c == '+' ? 62 : c == '/' ? 63 : 64;
+            if (value == 64)
+                throw std::runtime_error("Malformed glTF: bad base64 data");
+
+            bits = bits << 6 | value;
+            bitCount += 6;
+
+            if (bitCount >= 8)
+            {
+                bitCount -= 8;
+                bytes.push_back(static_cast<char>(bits >> bitCount));
+            }
+        }
+
+        return bytes;
+    }
+
+    // Relative URI of a local file, percent escapes decoded
+    std::string DecodeUri(const std::string& uri)
+    {
+        std::string path;
+
+        for (size_t index = 0; index < uri.size(); index++)
+        {
+            if (uri[index] == '%' && index + 2 < uri.size())
+            {
+                path.push_back(static_cast<char>(std::strtol(uri.substr(index + 1, 2).c_str(), nullptr, 16)));
+                index += 2;
+            }
+            else
+                path.push_back(uri[index]);
+        }
+
+        return path;
+    }
+
+    // Non-negative integer of a glTF property
+    size_t GetIndex(const JsonValue& value)
+    {
+        if (value.m_Type != JsonValue::Type::Number || value.m_Number < 0.0 || value.m_Number > 4294967295.0 || value.m_Number != std::floor(value.m_Number))
+            throw std::runtime_error("Malformed glTF: bad index");
+
+        return static_cast<size_t>(value.m_Number);
+    }
+
+    size_t GetIndex(const JsonValue& value, size_t fallback)
+    {
+        return value.IsNull() ? fallback : GetIndex(value);
+    }
+
+    struct GltfBuffer final
+    {
+        const BYTE* m_Data{ nullptr };
+        size_t m_Size{ 0 };
+    };
+
+    constexpr UINT s_GltfByte = 5120;
+    constexpr UINT s_GltfUnsignedByte = 5121;
+    constexpr UINT s_GltfShort = 5122;
+    constexpr UINT s_GltfUnsignedShort = 5123;
+    constexpr UINT s_GltfUnsignedInt = 5125;
+    constexpr UINT s_GltfFloat = 5126;
+
+    // Elements of an accessor in its buffer, bounds checked when created
+    struct GltfAccessor final
+    {
+        const BYTE* m_Data{ nullptr };
+        size_t m_Count{ 0 };
+        size_t m_Stride{ 0 };
+        UINT m_ComponentType{ 0 };
+        UINT m_Components{ 0 };
+        bool m_IsNormalized{ false };
+
+        float GetFloat(size_t element, UINT component) const
+        {
+            const BYTE* data = m_Data + element * m_Stride;
+
+            switch (m_ComponentType)
+            {
+            case s_GltfFloat:
+            {
+                float value;
+                std::memcpy(&value, data + component * sizeof(float), sizeof(value));
+                return value;
+            }
+            case s_GltfUnsignedByte:
+                return static_cast<float>(data[component]) / (m_IsNormalized ? 255.0f : 1.0f);
+            case s_GltfUnsignedShort:
+            {
+                USHORT value;
+                std::memcpy(&value, data + component * sizeof(USHORT), sizeof(value));
+                return static_cast<float>(value) / (m_IsNormalized ? 65535.0f : 1.0f);
+            }
+            case s_GltfByte:
+            {
+                float value = static_cast<float>(static_cast<signed char>(data[component]));
+                return m_IsNormalized ? (std::max)(value / 127.0f, -1.0f) : value;
+            }
+            case s_GltfShort:
+            {
+                SHORT value;
+                std::memcpy(&value, data + component * sizeof(SHORT), sizeof(value));
+                return m_IsNormalized ? (std::max)(static_cast<float>(value) / 32767.0f, -1.0f) : static_cast<float>(value);
+            }
+            default:
+                return 0.0f;
+            }
+        }
+
+        UINT GetIndex(size_t element) const
+        {
+            const BYTE* data = m_Data + element * m_Stride;
+
+            switch (m_ComponentType)
+            {
+            case s_GltfUnsignedByte:
+                return data[0];
+            case s_GltfUnsignedShort:
+            {
+                USHORT value;
+                std::memcpy(&value, data, sizeof(value));
+                return value;
+            }
+            default:
+            {
+                UINT value;
+                std::memcpy(&value, data, sizeof(value));
+                return value;
+            }
+            }
+        }
+    };
+
+    GltfAccessor GetAccessor(const JsonValue& root, const std::vector<GltfBuffer>& buffers, const JsonValue& index)
+    {
+        const JsonValue& accessor = root["accessors"][GetIndex(index)];
+        if (accessor.m_Type != JsonValue::Type::Object)
+            throw std::runtime_error("Malformed glTF: missing accessor");
+
+        if (!accessor["sparse"].IsNull() || accessor["bufferView"].IsNull())
+            throw std::runtime_error("Unsupported glTF: sparse accessor");
+
+        const JsonValue& bufferView = root["bufferViews"][GetIndex(accessor["bufferView"])];
+        size_t buffer = GetIndex(bufferView["buffer"]);
+        if (bufferView.m_Type != JsonValue::Type::Object || buffer >= buffers.size())
+            throw std::runtime_error("Malformed glTF: missing buffer view");
+
+        static const std::pair<const char*, UINT> s_Types[] = { { "SCALAR", 1 }, { "VEC2", 2 }, { "VEC3", 3 }, { "VEC4", 4 } };
+
+        GltfAccessor result;
+        result.m_ComponentType = static_cast<UINT>(GetIndex(accessor["componentType"]));
+        result.m_Count = GetIndex(accessor["count"]);
+        result.m_IsNormalized = accessor["normalized"].m_Boolean;
+
+        for (const auto& type : s_Types)
+        {
+            if (accessor["type"].m_String == type.first)
+                result.m_Components = type.second;
+        }
+
+        UINT componentSize = result.m_ComponentType == s_GltfFloat || result.m_ComponentType == s_GltfUnsignedInt ? 4 :
+            result.m_ComponentType == s_GltfShort || result.m_ComponentType == s_GltfUnsignedShort ? 2 :
+            result.m_ComponentType == s_GltfByte || result.m_ComponentType == s_GltfUnsignedByte ? 1 : 0;
+
+        if (componentSize == 0 || result.m_Components == 0)
+            throw std::runtime_error("Unsupported glTF: accessor type");
+
+        size_t elementSize = static_cast<size_t>(componentSize) * result.m_Components;
+        size_t viewOffset = GetIndex(bufferView["byteOffset"], 0);
+        size_t viewLength = GetIndex(bufferView["byteLength"]);
+        size_t offset = GetIndex(accessor["byteOffset"], 0);
+        result.m_Stride = GetIndex(bufferView["byteStride"], elementSize);
+
+        bool isInside = viewOffset <= buffers[buffer].m_Size && viewLength <= buffers[buffer].m_Size - viewOffset && result.m_Stride >= elementSize &&
+            (result.m_Count == 0 || (offset <= viewLength && (result.m_Count - 1) * result.m_Stride + elementSize <= viewLength - offset));
+
+        if (!isInside)
+            throw std::runtime_error("Malformed glTF: accessor outside of its buffer");
+
+        result.m_Data = buffers[buffer].m_Data + viewOffset + offset;
+        return result;
+    }
+
+    DirectX::XMMATRIX GetNodeTransform(const JsonValue& node)
+    {
+        // Column-major for column vectors reads as row-major for the row vectors of DirectXMath
+        const JsonValue& matrix = node["matrix"];
+        if (matrix.GetSize() == 16)
+        {
+            DirectX::XMFLOAT4X4 transform;
+            for (UINT element = 0; element < 16; element++)
+                transform.m[element / 4][element % 4] = static_cast<float>(matrix[element].GetNumber(0.0));
+
+            return DirectX::XMLoadFloat4x4(&transform);
+        }
+
+        auto getVector = [&node](const char* name, DirectX::XMVECTOR fallback)
+        {
+            const JsonValue& value = node[name];
+            if (value.GetSize() < 3)
+                return fallback;
+
+            DirectX::XMFLOAT4 vector(0.0f, 0.0f, 0.0f, 0.0f);
+            float* components = &vector.x;
+
+            for (size_t component = 0; component < (std::min)(value.GetSize(), static_cast<size_t>(4)); component++)
+                components[component] = static_cast<float>(value[component].GetNumber(0.0));
+
+            return DirectX::XMLoadFloat4(&vector);
+        };
+
+        DirectX::XMMATRIX scale = DirectX::XMMatrixScalingFromVector(getVector("scale", DirectX::XMVectorSplatOne()));
+        DirectX::XMMATRIX rotation = DirectX::XMMatrixRotationQuaternion(getVector("rotation", DirectX::XMQuaternionIdentity()));
+        DirectX::XMMATRIX translation = DirectX::XMMatrixTranslationFromVector(getVector("translation", DirectX::XMVectorZero()));
+
+        return DirectX::XMMatrixMultiply(DirectX::XMMatrixMultiply(scale, rotation), translation);
+    }
+
+    struct GltfInstance final
+    {
+        size_t m_Mesh{ 0 };
+        DirectX::XMFLOAT4X4 m_World;
+    };
+
+    // Depth is bounded by the node count, deeper chains can only be cycles
+    void CollectInstances(const JsonValue& nodes, const JsonValue& index, DirectX::FXMMATRIX parent, size_t depth, std::vector<GltfInstance>& instances)
+    {
+        const JsonValue& node = nodes[GetIndex(index)];
+        if (node.m_Type != JsonValue::Type::Object || depth > (std::min)(nodes.GetSize(), static_cast<size_t>(s_MaxNodeDepth)))
+            throw std::runtime_error("Malformed glTF: bad node hierarchy");
+
+        DirectX::XMMATRIX world = DirectX::XMMatrixMultiply(GetNodeTransform(node), parent);
+
+        if (!node["mesh"].IsNull())
+        {
+            GltfInstance& instance = instances.emplace_back();
+            instance.m_Mesh = GetIndex(node["mesh"]);
+            DirectX::XMStoreFloat4x4(&instance.m_World, world);
+        }
+
+        const JsonValue& children = node["children"];
+        for (size_t child = 0; child < children.GetSize(); child++)
+            CollectInstances(nodes, children[child], world, depth + 1, instances);
+    }
+
+    // Triangles of one mesh primitive placed by its node, read and deduplicated on their own
+    struct GltfPrimitive final
+    {
+        const JsonValue* m_Primitive{ nullptr };
+        DirectX::XMFLOAT4X4 m_World;
+        UINT m_Material{ 0 };
+
+        std::vector<Vertex> m_Vertices;
+        std::vector<UINT> m_Indices;
+        std::string m_Error;
+    };
+
+    void ReadPrimitive(const JsonValue& root, const std::vector<GltfBuffer>& buffers, GltfPrimitive& primitive)
+    {
+        const JsonValue& attributes = (*primitive.m_Primitive)["attributes"];
+        const JsonValue& indexAccessor = (*primitive.m_Primitive)["indices"];
+
+        GltfAccessor positions = GetAccessor(root, buffers, attributes["POSITION"]);
+        bool hasNormals = !attributes["NORMAL"].IsNull();
+        bool hasTexCoords = !attributes["TEXCOORD_0"].IsNull();
+        GltfAccessor normals = hasNormals ? GetAccessor(root, buffers, attributes["NORMAL"]) : GltfAccessor{ };
+        GltfAccessor texCoords = hasTexCoords ? GetAccessor(root, buffers, attributes["TEXCOORD_0"]) : GltfAccessor{ };
+        GltfAccessor indices = !indexAccessor.IsNull() ? GetAccessor(root, buffers, indexAccessor) : GltfAccessor{ };
+
+        size_t vertexCount = positions.m_Count;
+        size_t indexCount = indexAccessor.IsNull() ? vertexCount : indices.m_Count;
+
+        bool isValid = positions.m_ComponentType == s_GltfFloat && positions.m_Components == 3 &&
+            (!hasNormals || (normals.m_ComponentType == s_GltfFloat && normals.m_Components == 3 && normals.m_Count == vertexCount)) &&
+            (!hasTexCoords || (texCoords.m_ComponentType != s_GltfUnsignedInt && texCoords.m_Components == 2 && texCoords.m_Count == vertexCount)) &&
+            (indexAccessor.IsNull() || (indices.m_ComponentType != s_GltfFloat && indices.m_ComponentType != s_GltfByte && indices.m_ComponentType != s_GltfShort && indices.m_Components == 1)) &&
+            indexCount % 3 == 0 && vertexCount <= UINT_MAX;
+
+        if (!isValid)
+            throw std::runtime_error("Unsupported glTF: primitive attributes");
+
+        DirectX::XMMATRIX world = DirectX::XMLoadFloat4x4(&primitive.m_World);
+        DirectX::XMMATRIX normalWorld = DirectX::XMMatrixTranspose(DirectX::XMMatrixInverse(nullptr, world));
+
+        std::vector<Vertex> vertices(vertexCount);
+
+        for (size_t vertex = 0; vertex < vertexCount; vertex++)
+        {
+            DirectX::XMVECTOR position = DirectX::XMVectorSet(positions.GetFloat(vertex, 0), positions.GetFloat(vertex, 1), positions.GetFloat(vertex, 2), 1.0f);
+            DirectX::XMFLOAT3 worldPosition;
+            DirectX::XMStoreFloat3(&worldPosition, DirectX::XMVector3TransformCoord(position, world));
+            vertices[vertex].Position = Mirror(worldPosition);
+
+            if (hasNormals)
+            {
+                DirectX::XMVECTOR normal = DirectX::XMVectorSet(normals.GetFloat(vertex, 0), normals.GetFloat(vertex, 1), normals.GetFloat(vertex, 2), 0.0f);
+                DirectX::XMFLOAT3 worldNormal;
+                DirectX::XMStoreFloat3(&worldNormal, DirectX::XMVector3TransformNormal(normal, normalWorld));
+                vertices[vertex].Normal = NormalizeOrUp(Mirror(worldNormal));
+            }
+
+            // Both glTF and the renderer put the texture origin top left
+            if (hasTexCoords)
+                vertices[vertex].TexCoord = { texCoords.GetFloat(vertex, 0), texCoords.GetFloat(vertex, 1) };
+        }
+
+        std::vector<UINT> triangles(indexCount);
+        for (size_t index = 0; index < indexCount; index++)
+        {
+            triangles[index] = indexAccessor.IsNull() ? static_cast<UINT>(index) : indices.GetIndex(index);
+            if (triangles[index] >= vertexCount)
+                throw std::runtime_error("Malformed glTF: index out of range");
+        }
+
+        // Reversed into the winding of the renderer, unless a mirroring node transform did so already
+        if (DirectX::XMVectorGetX(DirectX::XMMatrixDeterminant(world)) >= 0.0f)
+        {
+            for (size_t triangle = 0; triangle < indexCount; triangle += 3)
+                std::swap(triangles[triangle + 1], triangles[triangle + 2]);
+        }
+
+        if (!hasNormals)
+        {
+            std::vector<DirectX::XMFLOAT3> positionData(vertexCount);
+            std::vector<DirectX::XMFLOAT3> smoothNormals(vertexCount, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f));
+
+            for (size_t vertex = 0; vertex < vertexCount; vertex++)
+                positionData[vertex] = vertices[vertex].Position;
+
+            for (size_t triangle = 0; triangle < indexCount; triangle += 3)
+                AddTriangleNormal(positionData.data(), &triangles[triangle], smoothNormals.data());
+
+            for (size_t vertex = 0; vertex < vertexCount; vertex++)
+                vertices[vertex].Normal = NormalizeOrUp(smoothNormals[vertex]);
+        }
+
+        // Source vertices are looked up once, in order of first use; unused ones are dropped
+        VertexTable<Vertex, HashVertex, IsEqualVertex> table(vertexCount);
+        std::vector<UINT> remap(vertexCount, UINT_MAX);
+        primitive.m_Indices.resize(indexCount);
+
+        for (size_t index = 0; index < indexCount; index++)
+        {
+            UINT& vertex = remap[triangles[index]];
+            if (vertex == UINT_MAX)
+                vertex = table.Insert(vertices[triangles[index]]);
+
+            primitive.m_Indices[index] = vertex;
+        }
+
+        primitive.m_Vertices = std::move(table.GetKeys());
+    }
+}
+
+MeshData ImportedMesh::GetData() const
+{
+    return { m_Vertices.data(), m_Indices.data(), static_cast<UINT>(m_Vertices.size() * sizeof(Vertex)), static_cast<UINT>(m_Indices.size() * sizeof(UINT)) };
+}
+
+MeshImporter::MeshImporter(ThreadPool& threadPool)
+    : m_ThreadPool(threadPool)
+{ }
+
+void MeshImporter::Import(const std::string& path, ImportedMesh& mesh)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    m_Stats = { };
+    mesh = { };
+
+    MappedFile file(path);
+    const char* contents = file.GetData();
+    size_t size = file.GetSize();
+
+    std::string extension = GetExtension(path);
+    std::string directory = GetDirectory(path);
+
+    m_Stats.m_Bytes = size;
+
+    if (extension == "obj")
+        ImportObj(contents, size, directory, mesh);
+    else if (extension == "gltf")
+        ImportGltf(contents, size, nullptr, 0, directory, mesh);
+    else if (extension == "glb")
+    {
+        // Header of magic, version and length, then chunks of length, type and data: JSON first, binary optional
+        const BYTE* bytes = reinterpret_cast<const BYTE*>(contents);
+        auto getWord = [bytes](size_t offset)
+        {
+            UINT word;
+            std::memcpy(&word, bytes + offset, sizeof(word));
+            return word;
+        };
+
+        if (size < 20 || getWord(0) != 0x46546C67 || getWord(4) != 2 || getWord(8) != size || getWord(16) != 0x4E4F534A || getWord(12) > size - 20)
+            throw std::runtime_error("Malformed glTF binary: " + path);
+
+        size_t jsonSize = getWord(12);
+        size_t binaryOffset = 20 + ((jsonSize + 3) & ~static_cast<size_t>(3));
+        const BYTE* binary = nullptr;
+        size_t binarySize = 0;
+
+        if (binaryOffset + 8 <= size && getWord(binaryOffset + 4) == 0x004E4942)
+        {
+            binarySize = getWord(binaryOffset);
+            binary = bytes + binaryOffset + 8;
+
+            if (binarySize > size - binaryOffset - 8)
+                throw std::runtime_error("Malformed glTF binary: " + path);
+        }
+
+        ImportGltf(contents + 20, jsonSize, binary, binarySize, directory, mesh);
+    }
+    else
+        throw std::runtime_error("Unknown mesh format: " + path);
+
+    m_Stats.m_Vertices = static_cast<UINT>(mesh.m_Vertices.size());
+    m_Stats.m_Triangles = static_cast<UINT>(mesh.m_Indices.size() / 3);
+    m_Stats.m_Time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+const ImportStats& MeshImporter::GetStats() const
+{
+    return m_Stats;
+}
+
+bool MeshImporter::ParseFloat(const char*& text, const char* end, float& value)
+{
+    static constexpr double s_Powers[] =
+    {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const char* cursor = text;
+    bool isNegative = cursor < end && *cursor == '-';
+    if (cursor < end && (*cursor == '-' || *cursor == '+'))
+        cursor++;
+
+    // Up to 19 significant digits fit the mantissa, the exponent accounts for the rest
+    UINT64 mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    bool hasDigits = false;
+
+    for (; cursor < end && *cursor >= '0' && *cursor <= '9'; cursor++)
+    {
+        hasDigits = true;
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + (*cursor - '0');
+            digits += mantissa > 0 ? 1 : 0;
+        }
+        else
+            exponent++;
+    }
+
+    if (cursor < end && *cursor == '.')
+    {
+        for (cursor++; cursor < end && *cursor >= '0' && *cursor <= '9'; cursor++)
+        {
+            hasDigits = true;
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (*cursor - '0');
+                digits += mantissa > 0 ? 1 : 0;
+                exponent--;
+            }
+        }
+    }
+
+    if (!hasDigits)
+        return false;
+
+    if (cursor < end && (*cursor == 'e' || *cursor == 'E'))
+    {
+        const char* exponentText = cursor + 1;
+        bool isNegativeExponent = exponentText < end && *exponentText == '-';
+        if (exponentText < end && (*exponentText == '-' || *exponentText == '+'))
+            exponentText++;
+
+        if (exponentText < end && *exponentText >= '0' && *exponentText <= '9')
+        {
+            int explicitExponent = 0;
+            for (; exponentText < end && *exponentText >= '0' && *exponentText <= '9'; exponentText++)
+                explicitExponent = (std::min)(explicitExponent * 10 + (*exponentText - '0'), 100000);
+
+            exponent += isNegativeExponent ? -explicitExponent : explicitExponent;
+            cursor = exponentText;
+        }
+    }
+
+    // Powers of ten up to 22 are exact doubles, so is a mantissa below 2^53, and a single operation rounds once
+    double result = static_cast<double>(mantissa);
+    if (mantissa != 0 && exponent != 0)
+    {
+        if (exponent < 0)
+            result = exponent >= -22 ? result / s_Powers[-exponent] : result * std::pow(10.0, exponent);
+        else
+            result = exponent <= 22 ? result * s_Powers[exponent] : result * std::pow(10.0, exponent);
+    }
+
+    value = static_cast<float>(isNegative ? -result : result);
+    text = cursor;
+    return true;
+}
+
+void MeshImporter::ImportObj(const char* text, size_t size, const std::string& directory, ImportedMesh& mesh)
+{
+    // Chunks end after a line end, so every line is parsed by exactly one of them
+    size_t chunkSize = (std::max)(s_MinChunkSize, size / (m_ThreadPool.GetThreadCount() * s_ChunksPerThread) + 1);
+    std::vector<ObjChunk> chunks;
+    chunks.reserve(size / chunkSize + 1);
+
+    for (size_t offset = 0; offset < size; )
+    {
+        size_t chunkEnd = (std::min)(offset + chunkSize, size);
+        const char* lineEnd = static_cast<const char*>(std::memchr(text + chunkEnd, '\n', size - chunkEnd));
+        chunkEnd = lineEnd != nullptr ? lineEnd - text + 1 : size;
+
+        ObjChunk& chunk = chunks.emplace_back();
+        chunk.m_Begin = text + offset;
+        chunk.m_End = text + chunkEnd;
+        offset = chunkEnd;
+    }
+
+    m_ThreadPool.ParallelFor(chunks.size(), [&chunks](size_t index)
+    {
+        ParseObjChunk(chunks[index]);
+    });
+
+    size_t positionCount = 0;
+    size_t texCoordCount = 0;
+    size_t normalCount = 0;
+    size_t cornerCount = 0;
+    bool hasMissingNormals = false;
+
+    for (ObjChunk& chunk : chunks)
+    {
+        if (!chunk.m_Error.empty())
+            throw std::runtime_error(chunk.m_Error);
+
+        chunk.m_FirstPosition = positionCount;
+        chunk.m_FirstTexCoord = texCoordCount;
+        chunk.m_FirstNormal = normalCount;
+        chunk.m_FirstCorner = cornerCount;
+
+        positionCount += chunk.m_Positions.size();
+        texCoordCount += chunk.m_TexCoords.size();
+        normalCount += chunk.m_Normals.size();
+        cornerCount += chunk.m_Corners.size();
+        hasMissingNormals = hasMissingNormals || chunk.m_HasMissingNormals;
+    }
+
+    if (cornerCount > UINT_MAX / sizeof(UINT) || positionCount > INT_MAX || texCoordCount > INT_MAX || normalCount > INT_MAX)
+        throw std::runtime_error("OBJ too large");
+
+    std::vector<DirectX::XMFLOAT3> positions(positionCount);
+    std::vector<DirectX::XMFLOAT2> texCoords(texCoordCount);
+    std::vector<DirectX::XMFLOAT3> normals(normalCount);
+
+    // Corners get file indices and are copied to the shard of their hash, which then reads them in sequence
+    m_ThreadPool.ParallelFor(chunks.size(), [&](size_t index)
+    {
+        ObjChunk& chunk = chunks[index];
+
+        std::copy(chunk.m_Positions.begin(), chunk.m_Positions.end(), positions.begin() + chunk.m_FirstPosition);
+        std::copy(chunk.m_TexCoords.begin(), chunk.m_TexCoords.end(), texCoords.begin() + chunk.m_FirstTexCoord);
+        std::copy(chunk.m_Normals.begin(), chunk.m_Normals.end(), normals.begin() + chunk.m_FirstNormal);
+
+        auto isInRange = [](int attribute, size_t count)
+        {
+            return attribute == s_Missing || (attribute >= 0 && static_cast<size_t>(attribute) < count);
+        };
+
+        chunk.m_CornerShards.resize(chunk.m_Corners.size());
+        for (std::vector<ObjCorner>& shardCorners : chunk.m_ShardCorners)
+            shardCorners.reserve(chunk.m_Corners.size() / s_ShardCount * 5 / 4);
+
+        for (size_t corner = 0; corner < chunk.m_Corners.size(); corner++)
+        {
+            ObjCorner& source = chunk.m_Corners[corner];
+
+            if (source.m_Relative & 1)
+                source.m_Position += static_cast<int>(chunk.m_FirstPosition);
+            if (source.m_Relative & 2)
+                source.m_TexCoord += static_cast<int>(chunk.m_FirstTexCoord);
+            if (source.m_Relative & 4)
+                source.m_Normal += static_cast<int>(chunk.m_FirstNormal);
+
+            if (source.m_Position == s_Missing || !isInRange(source.m_Position, positionCount) || !isInRange(source.m_TexCoord, texCoordCount) || !isInRange(source.m_Normal, normalCount))
+            {
+                chunk.m_Error = "Malformed OBJ: index out of range";
+                return;
+            }
+
+            BYTE shard = static_cast<BYTE>(HashCorner(source) >> (64 - s_ShardBits));
+            chunk.m_CornerShards[corner] = shard;
+            chunk.m_ShardCorners[shard].push_back(source);
+        }
+    });
+
+    for (const ObjChunk& chunk : chunks)
+    {
+        if (!chunk.m_Error.empty())
+            throw std::runtime_error(chunk.m_Error);
+    }
+
+    // Shards number their vertices in file order of first use, which keeps the import deterministic
+    std::vector<std::vector<ObjCorner>> shardKeys(s_ShardCount); // Distinct corners, one per vertex
+
+    m_ThreadPool.ParallelFor(s_ShardCount, [&](size_t shard)
+    {
+        size_t shardSize = 0;
+        for (const ObjChunk& chunk : chunks)
+            shardSize += chunk.m_ShardCorners[shard].size();
+
+        // Corners usually share vertices with several triangles, the table grows if they do not
+        VertexTable<ObjCorner, HashCorner, IsEqualCorner> table(shardSize / 4);
+
+        for (ObjChunk& chunk : chunks)
+        {
+            std::vector<UINT>& shardVertices = chunk.m_ShardVertices[shard];
+            shardVertices.reserve(chunk.m_ShardCorners[shard].size());
+
+            for (const ObjCorner& corner : chunk.m_ShardCorners[shard])
+                shardVertices.push_back(table.Insert(corner));
+        }
+
+        shardKeys[shard] = std::move(table.GetKeys());
+    });
+
+    std::vector<size_t> shardOffsets(s_ShardCount + 1, 0);
+    for (UINT shard = 0; shard < s_ShardCount; shard++)
+        shardOffsets[shard + 1] = shardOffsets[shard] + shardKeys[shard].size();
+
+    if (shardOffsets.back() > UINT_MAX / sizeof(Vertex))
+        throw std::runtime_error("OBJ too large");
+
+    // Positions without normals get the average of the triangles around them, like smoothing group 1
+    std::vector<DirectX::XMFLOAT3> smoothNormals;
+    if (hasMissingNormals)
+    {
+        std::vector<DirectX::XMFLOAT3> mirroredPositions(positionCount);
+        for (size_t position = 0; position < positionCount; position++)
+            mirroredPositions[position] = Mirror(positions[position]);
+
+        smoothNormals.assign(positionCount, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f));
+
+        for (const ObjChunk& chunk : chunks)
+        {
+            for (size_t corner = 0; corner < chunk.m_Corners.size(); corner += 3)
+            {
+                UINT triangle[] = { static_cast<UINT>(chunk.m_Corners[corner].m_Position), static_cast<UINT>(chunk.m_Corners[corner + 1].m_Position), static_cast<UINT>(chunk.m_Corners[corner + 2].m_Position) };
+                AddTriangleNormal(mirroredPositions.data(), triangle, smoothNormals.data());
+            }
+        }
+    }
+
+    mesh.m_Vertices.resize(shardOffsets.back());
+    mesh.m_Indices.resize(cornerCount);
+
+    m_ThreadPool.ParallelFor(s_ShardCount, [&](size_t shard)
+    {
+        const std::vector<ObjCorner>& corners = shardKeys[shard];
+        Vertex* vertices = mesh.m_Vertices.data() + shardOffsets[shard];
+
+        for (size_t vertex = 0; vertex < corners.size(); vertex++)
+        {
+            const ObjCorner& corner = corners[vertex];
+            vertices[vertex].Position = Mirror(positions[corner.m_Position]);
+            vertices[vertex].Normal = corner.m_Normal != s_Missing ? Mirror(normals[corner.m_Normal]) : NormalizeOrUp(smoothNormals[corner.m_Position]);
+
+            // OBJ puts the texture origin bottom left
+            if (corner.m_TexCoord != s_Missing)
+                vertices[vertex].TexCoord = { texCoords[corner.m_TexCoord].x, 1.0f - texCoords[corner.m_TexCoord].y };
+        }
+    });
+
+    m_ThreadPool.ParallelFor(chunks.size(), [&](size_t index)
+    {
+        const ObjChunk& chunk = chunks[index];
+        UINT* indices = mesh.m_Indices.data() + chunk.m_FirstCorner;
+        size_t shardCursors[s_ShardCount] = { };
+
+        // Shard lists of a chunk are in corner order, the next entry of a shard is that of its next corner
+        for (size_t corner = 0; corner < chunk.m_CornerShards.size(); corner++)
+        {
+            BYTE shard = chunk.m_CornerShards[corner];
+            indices[corner] = static_cast<UINT>(shardOffsets[shard]) + chunk.m_ShardVertices[shard][shardCursors[shard]++];
+        }
+    });
+
+    // Subsets between material switches, triangles ahead of the first one use a default material
+    std::unordered_map<std::string, UINT> materialNames;
+    UINT material = UINT_MAX;
+    size_t firstCorner = 0;
+
+    auto getMaterial = [&materialNames, &mesh](const std::string& name)
+    {
+        auto result = materialNames.emplace(name, static_cast<UINT>(mesh.m_Materials.size()));
+        if (result.second)
+            mesh.m_Materials.emplace_back().m_Name = name;
+
+        return result.first->second;
+    };
+
+    auto addSubset = [&](size_t endCorner)
+    {
+        if (endCorner == firstCorner)
+            return;
+
+        if (material == UINT_MAX)
+            material = getMaterial(std::string());
+
+        if (!mesh.m_Subsets.empty() && mesh.m_Subsets.back().m_Material == material)
+            mesh.m_Subsets.back().m_IndexCount += static_cast<UINT>(endCorner - firstCorner);
+        else
+            mesh.m_Subsets.push_back({ static_cast<UINT>(firstCorner), static_cast<UINT>(endCorner - firstCorner), material });
+    };
+
+    for (const ObjChunk& chunk : chunks)
+    {
+        for (const auto& materialSwitch : chunk.m_MaterialSwitches)
+        {
+            addSubset(chunk.m_FirstCorner + materialSwitch.first);
+            material = getMaterial(materialSwitch.second);
+            firstCorner = chunk.m_FirstCorner + materialSwitch.first;
+        }
+    }
+
+    addSubset(cornerCount);
+
+    // Missing libraries leave the materials at their defaults, as other viewers do
+    std::unordered_set<std::string> libraries;
+
+    for (const ObjChunk& chunk : chunks)
+    {
+        for (const std::string& library : chunk.m_Libraries)
+        {
+            if (!libraries.insert(library).second)
+                continue;
+
+            std::vector<char> libraryText;
+            try
+            {
+                libraryText = ReadFile(directory + library);
+            }
+            catch (const std::runtime_error&)
+            {
+                continue;
+            }
+
+            m_Stats.m_Bytes += libraryText.size();
+            ParseMaterialLibrary(libraryText, materialNames, mesh.m_Materials);
+        }
+    }
+
+    m_Stats.m_Chunks = static_cast<UINT>(chunks.size());
+    m_Stats.m_Corners = static_cast<UINT>(cornerCount);
+}
+
+void MeshImporter::ImportGltf(const char* json, size_t size, const BYTE* binary, size_t binarySize, const std::string& directory, ImportedMesh& mesh)
+{
+    JsonValue root;
+    JsonParser(json, size).Parse(root);
+
+    if (root["asset"]["version"].m_String.compare(0, 2, "2.") != 0)
+        throw std::runtime_error("Unsupported glTF version");
+
+    // Compressed geometry and the like cannot be read without the extension
+    if (root["extensionsRequired"].GetSize() > 0)
+        throw std::runtime_error("Unsupported glTF extension: " + root["extensionsRequired"].m_Elements[0].m_String);
+
+    std::vector<std::vector<char>> bufferData;
+    std::vector<GltfBuffer> buffers;
+    const JsonValue& jsonBuffers = root["buffers"];
+
+    for (size_t index = 0; index < jsonBuffers.GetSize(); index++)
+    {
+        const JsonValue& buffer = jsonBuffers[index];
+        const JsonValue& uri = buffer["uri"];
+        size_t byteLength = GetIndex(buffer["byteLength"]);
+        GltfBuffer view;
+
+        if (uri.IsNull())
+        {
+            // Only the first buffer of a .glb may leave out its URI, it is the binary chunk
+            if (index != 0 || binary == nullptr)
+                throw std::runtime_error("Malformed glTF: buffer without data");
+
+            view = { binary, binarySize };
+        }
+        else
+        {
+            const std::string& text = uri.m_String;
+            if (text.compare(0, 5, "data:") == 0)
+            {
+                size_t comma = text.find(',');
+                if (comma == std::string::npos || text.rfind(";base64", comma) == std::string::npos)
+                    throw std::runtime_error("Unsupported glTF: data URI without base64");
+
+                bufferData.push_back(DecodeBase64(text.data() + comma + 1, text.size() - comma - 1));
+            }
+            else
+            {
+                bufferData.push_back(ReadFile(directory + DecodeUri(text)));
+                m_Stats.m_Bytes += bufferData.back().size();
+            }
+
+            view = { reinterpret_cast<const BYTE*>(bufferData.back().data()), bufferData.back().size() };
+        }
+
+        // A .glb pads its binary chunk
+        if (view.m_Size < byteLength)
+            throw std::runtime_error("Malformed glTF: buffer too short");
+
+        view.m_Size = byteLength;
+        buffers.push_back(view);
+    }
+
+    const JsonValue& jsonMaterials = root["materials"];
+
+    for (size_t index = 0; index < jsonMaterials.GetSize(); index++)
+    {
+        const JsonValue& material = jsonMaterials[index];
+        const JsonValue& pbr = material["pbrMetallicRoughness"];
+        const JsonValue& color = pbr["baseColorFactor"];
+
+        ImportedMaterial& imported = mesh.m_Materials.emplace_back();
+        imported.m_Name = material["name"].m_String;
+
+        float* diffuseColor = &imported.m_DiffuseColor.x;
+        for (size_t component = 0; component < (std::min)(color.GetSize(), static_cast<size_t>(4)); component++)
+            diffuseColor[component] = static_cast<float>(color[component].GetNumber(1.0));
+
+        // Blinn-Phong exponent of a highlight as wide as the one of the roughness, alpha being its square
+        float roughness = static_cast<float>(pbr["roughnessFactor"].GetNumber(1.0));
+        float alpha = (std::max)(roughness * roughness, 0.03f);
+        imported.m_SpecularIntensity = 1.0f - roughness;
+        imported.m_SpecularHardness = static_cast<int>((std::min)((std::max)(2.0f / (alpha * alpha) - 2.0f, 1.0f), 1000.0f));
+
+        const JsonValue& texture = pbr["baseColorTexture"];
+        if (!texture.IsNull())
+        {
+            const JsonValue& source = root["textures"][GetIndex(texture["index"])]["source"];
+            const std::string& uri = source.IsNull() ? std::string() : root["images"][GetIndex(source)]["uri"].m_String;
+
+            if (uri.compare(0, 5, "data:") != 0)
+                imported.m_DiffuseTexture = DecodeUri(uri);
+        }
+    }
+
+    // Meshes as the default scene places them, or each once where there are no scenes
+    std::vector<GltfInstance> instances;
+    const JsonValue& scenes = root["scenes"];
+
+    if (scenes.GetSize() > 0)
+    {
+        const JsonValue& scene = scenes[GetIndex(root["scene"], 0)];
+        if (scene.m_Type != JsonValue::Type::Object)
+            throw std::runtime_error("Malformed glTF: missing scene");
+
+        const JsonValue& nodes = scene["nodes"];
+        for (size_t node = 0; node < nodes.GetSize(); node++)
+            CollectInstances(root["nodes"], nodes[node], DirectX::XMMatrixIdentity(), 0, instances);
+    }
+    else
+    {
+        for (size_t index = 0; index < root["meshes"].GetSize(); index++)
+        {
+            GltfInstance& instance = instances.emplace_back();
+            instance.m_Mesh = index;
+            DirectX::XMStoreFloat4x4(&instance.m_World, DirectX::XMMatrixIdentity());
+        }
+    }
+
+    // Triangle primitives only, points and lines are skipped
+    std::vector<GltfPrimitive> primitives;
+    UINT defaultMaterial = UINT_MAX;
+
+    for (const GltfInstance& instance : instances)
+    {
+        const JsonValue& meshPrimitives = root["meshes"][instance.m_Mesh]["primitives"];
+        if (meshPrimitives.GetSize() == 0)
+            throw std::runtime_error("Malformed glTF: missing mesh");
+
+        for (size_t index = 0; index < meshPrimitives.GetSize(); index++)
+        {
+            const JsonValue& primitive = meshPrimitives[index];
+            if (primitive["mode"].GetNumber(4.0) != 4.0)
+                continue;
+
+            if (primitive["material"].IsNull() && defaultMaterial == UINT_MAX)
+            {
+                defaultMaterial = static_cast<UINT>(mesh.m_Materials.size());
+                mesh.m_Materials.emplace_back();
+            }
+
+            size_t material = primitive["material"].IsNull() ? defaultMaterial : GetIndex(primitive["material"]);
+            if (material >= mesh.m_Materials.size())
+                throw std::runtime_error("Malformed glTF: missing material");
+
+            GltfPrimitive& job = primitives.emplace_back();
+            job.m_Primitive = &primitive;
+            job.m_World = instance.m_World;
+            job.m_Material = static_cast<UINT>(material);
+        }
+    }
+
+    m_ThreadPool.ParallelFor(primitives.size(), [&](size_t index)
+    {
+        // Tasks must not throw, errors are reported once all are done
+        try
+        {
+            ReadPrimitive(root, buffers, primitives[index]);
+        }
+        catch (const std::exception& exception)
+        {
+            primitives[index].m_Error = exception.what();
+        }
+    });
+
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+
+    for (const GltfPrimitive& primitive : primitives)
+    {
+        if (!primitive.m_Error.empty())
+            throw std::runtime_error(primitive.m_Error);
+
+        vertexCount += primitive.m_Vertices.size();
+        indexCount += primitive.m_Indices.size();
+    }
+
+    if (vertexCount > UINT_MAX / sizeof(Vertex) || indexCount > UINT_MAX / sizeof(UINT))
+        throw std::runtime_error("glTF too large");
+
+    mesh.m_Vertices.reserve(vertexCount);
+    mesh.m_Indices.reserve(indexCount);
+
+    for (const GltfPrimitive& primitive : primitives)
+    {
+        UINT firstVertex = static_cast<UINT>(mesh.m_Vertices.size());
+        UINT firstIndex = static_cast<UINT>(mesh.m_Indices.size());
+        UINT primitiveIndexCount = static_cast<UINT>(primitive.m_Indices.size());
+
+        mesh.m_Vertices.insert(mesh.m_Vertices.end(), primitive.m_Vertices.begin(), primitive.m_Vertices.end());
+        for (UINT index : primitive.m_Indices)
+            mesh.m_Indices.push_back(firstVertex + index);
+
+        if (!mesh.m_Subsets.empty() && mesh.m_Subsets.back().m_Material == primitive.m_Material)
+            mesh.m_Subsets.back().m_IndexCount += primitiveIndexCount;
+        else if (primitiveIndexCount > 0)
+            mesh.m_Subsets.push_back({ firstIndex, primitiveIndexCount, primitive.m_Material });
+    }
+
+    m_Stats.m_Chunks = static_cast<UINT>(primitives.size());
+    m_Stats.m_Corners = static_cast<UINT>(indexCount);
+}
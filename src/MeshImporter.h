@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "Mesh.h"
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// Surface of a source material in the terms of Material, plus the texture it samples
+struct ImportedMaterial final
+{
+    std::string m_Name;
+    DirectX::XMFLOAT4 m_DiffuseColor{ 1.0f, 1.0f, 1.0f, 1.0f }; // Alpha in w
+    float m_SpecularIntensity{ 1.0f };
+    int m_SpecularHardness{ 100 };
+    std::string m_DiffuseTexture; // Relative to the imported file as written there, empty if untextured
+};
+
+// Consecutive triangles of one material
+struct ImportedSubset final
+{
+    UINT m_FirstIndex{ 0 };
+    UINT m_IndexCount{ 0 };
+    UINT m_Material{ 0 }; // Into ImportedMesh::m_Materials
+};
+
+// Owns the arrays the MeshData of an import points at
+struct ImportedMesh final
+{
+    std::vector<Vertex> m_Vertices;
+    std::vector<UINT> m_Indices;
+    std::vector<ImportedSubset> m_Subsets;
+    std::vector<ImportedMaterial> m_Materials;
+
+    // All subsets as one mesh, valid while the arrays are unchanged
+    MeshData GetData() const;
+};
+
+struct ImportStats final
+{
+    UINT64 m_Bytes{ 0 };  // Read from the imported file and the files it references
+    UINT m_Chunks{ 0 };   // Parsed in parallel, text chunks of OBJ and primitives of glTF
+    UINT m_Corners{ 0 };  // Triangle corners before deduplication
+    UINT m_Vertices{ 0 }; // After
+    UINT m_Triangles{ 0 };
+    double m_Time{ 0.0 }; // Seconds, reading included
+};
+
+// Imports Wavefront OBJ with MTL materials and glTF 2.0 (.gltf with external or embedded buffers, .glb) from
+// local files. OBJ text is split into chunks at line ends that are parsed on the thread pool; corners are then
+// deduplicated into vertices by hash map, sharded by hash so that every shard fills its own map. glTF primitives
+// are read and deduplicated in parallel. Sources are right-handed with counter-clockwise front faces: positions
+// and normals are mirrored along z into the left-handed space of the renderer and triangles are reversed to its
+// clockwise front faces. Missing normals are smoothed from the triangles. Throws if a file cannot be read or is
+// malformed.
+class MeshImporter final
+{
+public:
+    MeshImporter(ThreadPool& threadPool);
+
+    // By the extension of the path: .obj, .gltf or .glb
+    void Import(const std::string& path, ImportedMesh& mesh);
+
+    const ImportStats& GetStats() const;
+
+    // Decimal with optional sign, fraction and exponent, advances text past it. Exact for up to 19 significant
+    // digits and exponents within 22 before the final rounding to float, within a unit in the last place beyond.
+    static bool ParseFloat(const char*& text, const char* end, float& value);
+
+private:
+    void ImportObj(const char* text, size_t size, const std::string& directory, ImportedMesh& mesh);
+    void ImportGltf(const char* json, size_t size, const BYTE* binary, size_t binarySize, const std::string& directory, ImportedMesh& mesh);
+
+    ThreadPool& m_ThreadPool;
+    ImportStats m_Stats;
+};
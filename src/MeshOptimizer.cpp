@@ -0,0 +1,522 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+#include <cassert>
+
+namespace
+{
+    constexpr UINT s_AnalysisCacheSize = 16; // FIFO, as common hardware behaves
+    constexpr UINT s_OverdrawResolution = 256;
+
+    // Forsyth's scoring, for an LRU cache of this size
+    constexpr UINT s_CacheSize = 32;
+    constexpr float s_CacheDecayPower = 1.5f;
+    constexpr float s_LastTriangleScore = 0.75f;
+    constexpr float s_ValenceBoostScale = 2.0f;
+    constexpr float s_ValenceBoostPower = 0.5f;
+
+    float GetVertexScore(int cachePosition, UINT valence)
+    {
+        // Vertices of no remaining triangle do not attract any
+        if (valence == 0)
+            return -1.0f;
+
+        float score = 0.0f;
+
+        if (cachePosition >= 0)
+        {
+            // The last triangle's vertices score lower, so its neighbors are not preferred over strips
+            if (cachePosition < 3)
+                score = s_LastTriangleScore;
+            else
+                score = std::pow(1.0f - static_cast<float>(cachePosition - 3) / (s_CacheSize - 3), s_CacheDecayPower);
+        }
+
+        return score + s_ValenceBoostScale * std::pow(static_cast<float>(valence), -s_ValenceBoostPower);
+    }
+
+    // FIFO cache misses of every triangle, appended to misses if given
+    UINT SimulateCache(const UINT* indices, UINT indexCount, UINT vertexCount, std::vector<UINT>* misses = nullptr)
+    {
+        std::vector<UINT> timestamps(vertexCount, 0);
+        UINT time = s_AnalysisCacheSize + 1;
+        UINT total = 0;
+
+        for (UINT index = 0; index < indexCount; index += 3)
+        {
+            UINT triangleMisses = 0;
+
+            for (UINT corner = 0; corner < 3; corner++)
+            {
+                UINT vertex = indices[index + corner];
+
+                if (time - timestamps[vertex] > s_AnalysisCacheSize)
+                {
+                    timestamps[vertex] = time++;
+                    triangleMisses++;
+                }
+            }
+
+            total += triangleMisses;
+
+            if (misses)
+                misses->push_back(triangleMisses);
+        }
+
+        return total;
+    }
+
+    // Shaded and covered pixels of the front faces seen along one axis, orthographic
+    void RasterizeOverdraw(const std::vector<Vertex>& vertices, const UINT* indices, UINT indexCount, UINT axis, bool isFlipped,
+        const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax, std::vector<float>& depths, UINT64& shaded, UINT64& covered)
+    {
+        const float* minimum = &boundsMin.x;
+        const float* maximum = &boundsMax.x;
+
+        UINT axisX = (axis + 1) % 3;
+        UINT axisY = (axis + 2) % 3;
+
+        float scaleX = s_OverdrawResolution / (std::max)(maximum[axisX] - minimum[axisX], FLT_MIN);
+        float scaleY = s_OverdrawResolution / (std::max)(maximum[axisY] - minimum[axisY], FLT_MIN);
+
+        std::fill(depths.begin(), depths.end(), FLT_MAX);
+
+        for (UINT index = 0; index < indexCount; index += 3)
+        {
+            float x[3], y[3], z[3];
+
+            for (UINT corner = 0; corner < 3; corner++)
+            {
+                const float* position = &vertices[indices[index + corner]].Position.x;
+
+                // Looking down the axis from either side, the other two axes keep a left handed basis
+                x[corner] = (position[axisX] - minimum[axisX]) * scaleX;
+                y[corner] = (position[axisY] - minimum[axisY]) * scaleY;
+                z[corner] = isFlipped ? -position[axis] : position[axis];
+
+                if (isFlipped)
+                    x[corner] = s_OverdrawResolution - x[corner];
+            }
+
+            // Back faces are culled as by the rasterizer state, clockwise with y up is front
+            float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+            if (!(area < 0.0f))
+                continue;
+
+            int minX = (std::max)(static_cast<int>(std::floor((std::min)({ x[0], x[1], x[2] }))), 0);
+            int minY = (std::max)(static_cast<int>(std::floor((std::min)({ y[0], y[1], y[2] }))), 0);
+            int maxX = (std::min)(static_cast<int>(std::ceil((std::max)({ x[0], x[1], x[2] }))), static_cast<int>(s_OverdrawResolution));
+            int maxY = (std::min)(static_cast<int>(std::ceil((std::max)({ y[0], y[1], y[2] }))), static_cast<int>(s_OverdrawResolution));
+
+            for (int pixelY = minY; pixelY < maxY; pixelY++)
+            {
+                for (int pixelX = minX; pixelX < maxX; pixelX++)
+                {
+                    float px = pixelX + 0.5f;
+                    float py = pixelY + 0.5f;
+
+                    // Barycentrics, all non-positive inside a clockwise triangle
+                    float w0 = (x[2] - x[1]) * (py - y[1]) - (y[2] - y[1]) * (px - x[1]);
+                    float w1 = (x[0] - x[2]) * (py - y[2]) - (y[0] - y[2]) * (px - x[2]);
+                    float w2 = (x[1] - x[0]) * (py - y[0]) - (y[1] - y[0]) * (px - x[0]);
+
+                    if (w0 > 0.0f || w1 > 0.0f || w2 > 0.0f)
+                        continue;
+
+                    float depth = (w0 * z[0] + w1 * z[1] + w2 * z[2]) / area;
+                    float& stored = depths[pixelY * s_OverdrawResolution + pixelX];
+
+                    if (depth < stored)
+                    {
+                        covered += stored == FLT_MAX ? 1 : 0;
+                        stored = depth;
+                        shaded++;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void MeshOptimizer::Optimize(std::vector<Vertex>& vertices, std::vector<UINT>& indices, MeshOptimizerStats* stats)
+{
+    if (stats)
+    {
+        stats->m_Vertices = static_cast<UINT>(vertices.size());
+        stats->m_Before = Analyze(vertices, indices.data(), static_cast<UINT>(indices.size()));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    UINT indexCount = static_cast<UINT>(indices.size());
+    UINT vertexCount = WeldVertices(vertices, indices);
+
+    OptimizeVertexCache(indices.data(), indexCount, vertexCount);
+    OptimizeOverdraw(vertices, indices.data(), indexCount);
+    OptimizeVertexFetch(vertices, indices);
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    if (stats)
+    {
+        stats->m_Time = elapsed.count();
+        stats->m_UniqueVertices = static_cast<UINT>(vertices.size());
+        stats->m_After = Analyze(vertices, indices.data(), indexCount);
+    }
+}
+
+UINT MeshOptimizer::WeldVertices(std::vector<Vertex>& vertices, std::vector<UINT>& indices)
+{
+    UINT vertexCount = static_cast<UINT>(vertices.size());
+
+    // Bitwise equal vertices end up next to each other
+    std::vector<UINT> order(vertexCount);
+    std::iota(order.begin(), order.end(), 0);
+
+    std::sort(order.begin(), order.end(), [&vertices](UINT a, UINT b)
+    {
+        int difference = std::memcmp(&vertices[a], &vertices[b], sizeof(Vertex));
+        return difference != 0 ? difference < 0 : a < b;
+    });
+
+    std::vector<UINT> remap(vertexCount);
+    std::vector<Vertex> welded;
+    welded.reserve(vertexCount);
+
+    for (UINT position = 0; position < vertexCount; position++)
+    {
+        UINT vertex = order[position];
+
+        if (position == 0 || std::memcmp(&vertices[order[position - 1]], &vertices[vertex], sizeof(Vertex)) != 0)
+            welded.push_back(vertices[vertex]);
+
+        remap[vertex] = static_cast<UINT>(welded.size()) - 1;
+    }
+
+    for (UINT& index : indices)
+        index = remap[index];
+
+    vertices.swap(welded);
+    return static_cast<UINT>(vertices.size());
+}
+
+void MeshOptimizer::OptimizeVertexCache(UINT* indices, UINT indexCount, UINT vertexCount)
+{
+    UINT triangleCount = indexCount / 3;
+
+    // Triangles of every vertex, the first valences of them are not emitted yet
+    std::vector<UINT> valences(vertexCount, 0);
+    for (UINT index = 0; index < indexCount; index++)
+        valences[indices[index]]++;
+
+    std::vector<UINT> offsets(vertexCount + 1, 0);
+    std::partial_sum(valences.begin(), valences.end(), offsets.begin() + 1);
+
+    std::vector<UINT> vertexTriangles(indexCount);
+    {
+        std::vector<UINT> cursors(offsets.begin(), offsets.end() - 1);
+        for (UINT index = 0; index < indexCount; index++)
+            vertexTriangles[cursors[indices[index]]++] = index / 3;
+    }
+
+    std::vector<float> vertexScores(vertexCount);
+    for (UINT vertex = 0; vertex < vertexCount; vertex++)
+        vertexScores[vertex] = GetVertexScore(-1, valences[vertex]);
+
+    std::vector<float> triangleScores(triangleCount);
+    for (UINT triangle = 0; triangle < triangleCount; triangle++)
+        triangleScores[triangle] = vertexScores[indices[triangle * 3]] + vertexScores[indices[triangle * 3 + 1]] + vertexScores[indices[triangle * 3 + 2]];
+
+    std::vector<bool> isEmitted(triangleCount, false);
+    std::vector<UINT> result;
+    result.reserve(indexCount);
+
+    // Three more entries than the cache, vertices pushed out by a triangle get their scores updated
+    UINT cache[s_CacheSize + 3];
+    UINT cacheCount = 0;
+
+    UINT nextTriangle = 0; // Input order fallback once no cached vertex has triangles left
+    UINT bestTriangle = triangleCount;
+
+    for (UINT emitted = 0; emitted < triangleCount; emitted++)
+    {
+        if (bestTriangle == triangleCount)
+        {
+            while (isEmitted[nextTriangle])
+                nextTriangle++;
+
+            bestTriangle = nextTriangle;
+        }
+
+        const UINT* triangle = &indices[bestTriangle * 3];
+        result.insert(result.end(), triangle, triangle + 3);
+        isEmitted[bestTriangle] = true;
+
+        UINT newCache[s_CacheSize + 3];
+        UINT newCacheCount = 0;
+
+        for (UINT corner = 0; corner < 3; corner++)
+        {
+            UINT vertex = triangle[corner];
+            newCache[newCacheCount++] = vertex;
+
+            // Drop the emitted triangle from the vertex list
+            UINT* first = &vertexTriangles[offsets[vertex]];
+            UINT* last = first + valences[vertex];
+            *std::find(first, last, bestTriangle) = *(last - 1);
+            valences[vertex]--;
+        }
+
+        for (UINT entry = 0; entry < cacheCount; entry++)
+        {
+            UINT vertex = cache[entry];
+            if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+                newCache[newCacheCount++] = vertex;
+        }
+
+        // Rescored vertices pass the change on to their remaining triangles, the best of them goes next
+        float bestScore = -FLT_MAX;
+        bestTriangle = triangleCount;
+
+        for (UINT entry = 0; entry < newCacheCount; entry++)
+        {
+            UINT vertex = newCache[entry];
+            int position = entry < s_CacheSize ? static_cast<int>(entry) : -1;
+
+            float score = GetVertexScore(position, valences[vertex]);
+            float difference = score - vertexScores[vertex];
+            vertexScores[vertex] = score;
+
+            for (UINT slot = offsets[vertex]; slot < offsets[vertex] + valences[vertex]; slot++)
+            {
+                UINT neighbor = vertexTriangles[slot];
+                triangleScores[neighbor] += difference;
+
+                if (triangleScores[neighbor] > bestScore)
+                {
+                    bestScore = triangleScores[neighbor];
+                    bestTriangle = neighbor;
+                }
+            }
+        }
+
+        cacheCount = (std::min)(newCacheCount, s_CacheSize);
+        std::copy(newCache, newCache + cacheCount, cache);
+    }
+
+    std::copy(result.begin(), result.end(), indices);
+}
+
+void MeshOptimizer::OptimizeOverdraw(const std::vector<Vertex>& vertices, UINT* indices, UINT indexCount, float threshold)
+{
+    UINT triangleCount = indexCount / 3;
+    UINT vertexCount = static_cast<UINT>(vertices.size());
+
+    if (triangleCount == 0)
+        return;
+
+    // Clusters start where the cache had to start over, all three vertices of a triangle missing
+    std::vector<UINT> misses;
+    SimulateCache(indices, indexCount, vertexCount, &misses);
+
+    std::vector<UINT> hardClusters;
+    for (UINT triangle = 0; triangle < triangleCount; triangle++)
+    {
+        if (triangle == 0 || misses[triangle] == 3)
+            hardClusters.push_back(triangle);
+    }
+
+    hardClusters.push_back(triangleCount);
+
+    // Further split where the cache efficiency so far is within the threshold of the whole cluster
+    std::vector<UINT> clusters;
+
+    for (size_t cluster = 0; cluster + 1 < hardClusters.size(); cluster++)
+    {
+        UINT first = hardClusters[cluster];
+        UINT last = hardClusters[cluster + 1];
+
+        float clusterAcmr = static_cast<float>(SimulateCache(indices + first * 3, (last - first) * 3, vertexCount)) / (last - first);
+
+        clusters.push_back(first);
+
+        std::vector<UINT> timestamps(vertexCount, 0);
+        UINT time = s_AnalysisCacheSize + 1;
+        UINT start = first;
+        UINT runMisses = 0;
+
+        for (UINT triangle = first; triangle < last; triangle++)
+        {
+            for (UINT corner = 0; corner < 3; corner++)
+            {
+                UINT vertex = indices[triangle * 3 + corner];
+
+                if (time - timestamps[vertex] > s_AnalysisCacheSize)
+                {
+                    timestamps[vertex] = time++;
+                    runMisses++;
+                }
+            }
+
+            float runAcmr = static_cast<float>(runMisses) / (triangle + 1 - start);
+
+            if (triangle + 1 < last && runAcmr <= clusterAcmr * threshold && triangle + 1 - start >= 3)
+            {
+                clusters.push_back(triangle + 1);
+                start = triangle + 1;
+                runMisses = 0;
+                time += s_AnalysisCacheSize + 1;
+            }
+        }
+    }
+
+    clusters.push_back(triangleCount);
+
+    // Clusters facing away from the mesh center are in front of the rest from most directions
+    DirectX::XMVECTOR meshCenter = DirectX::XMVectorZero();
+    float meshArea = 0.0f;
+
+    std::vector<DirectX::XMFLOAT4> clusterCenters(clusters.size() - 1);
+    std::vector<DirectX::XMFLOAT3> clusterNormals(clusters.size() - 1);
+
+    for (size_t cluster = 0; cluster + 1 < clusters.size(); cluster++)
+    {
+        DirectX::XMVECTOR center = DirectX::XMVectorZero();
+        DirectX::XMVECTOR normal = DirectX::XMVectorZero();
+        float area = 0.0f;
+
+        for (UINT triangle = clusters[cluster]; triangle < clusters[cluster + 1]; triangle++)
+        {
+            DirectX::XMVECTOR a = DirectX::XMLoadFloat3(&vertices[indices[triangle * 3]].Position);
+            DirectX::XMVECTOR b = DirectX::XMLoadFloat3(&vertices[indices[triangle * 3 + 1]].Position);
+            DirectX::XMVECTOR c = DirectX::XMLoadFloat3(&vertices[indices[triangle * 3 + 2]].Position);
+
+            DirectX::XMVECTOR cross = DirectX::XMVector3Cross(DirectX::XMVectorSubtract(b, a), DirectX::XMVectorSubtract(c, a));
+            float triangleArea = DirectX::XMVectorGetX(DirectX::XMVector3Length(cross));
+
+            center = DirectX::XMVectorAdd(center, DirectX::XMVectorScale(DirectX::XMVectorAdd(DirectX::XMVectorAdd(a, b), c), triangleArea / 3.0f));
+            normal = DirectX::XMVectorAdd(normal, cross);
+            area += triangleArea;
+        }
+
+        meshCenter = DirectX::XMVectorAdd(meshCenter, center);
+        meshArea += area;
+
+        DirectX::XMStoreFloat4(&clusterCenters[cluster], DirectX::XMVectorSetW(area > 0.0f ? DirectX::XMVectorScale(center, 1.0f / area) : center, area));
+        DirectX::XMStoreFloat3(&clusterNormals[cluster], DirectX::XMVector3Normalize(normal));
+    }
+
+    if (meshArea > 0.0f)
+        meshCenter = DirectX::XMVectorScale(meshCenter, 1.0f / meshArea);
+
+    std::vector<float> sortKeys(clusters.size() - 1);
+    for (size_t cluster = 0; cluster < sortKeys.size(); cluster++)
+    {
+        DirectX::XMVECTOR offset = DirectX::XMVectorSubtract(DirectX::XMVectorSetW(DirectX::XMLoadFloat4(&clusterCenters[cluster]), 0.0f), meshCenter);
+        sortKeys[cluster] = DirectX::XMVectorGetX(DirectX::XMVector3Dot(offset, DirectX::XMLoadFloat3(&clusterNormals[cluster])));
+    }
+
+    std::vector<UINT> order(sortKeys.size());
+    std::iota(order.begin(), order.end(), 0);
+
+    std::stable_sort(order.begin(), order.end(), [&sortKeys](UINT a, UINT b)
+    {
+        return sortKeys[a] > sortKeys[b];
+    });
+
+    std::vector<UINT> result;
+    result.reserve(indexCount);
+
+    for (UINT cluster : order)
+        result.insert(result.end(), indices + clusters[cluster] * 3, indices + clusters[cluster + 1] * 3);
+
+    std::copy(result.begin(), result.end(), indices);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<UINT>& indices)
+{
+    std::vector<UINT> remap(vertices.size(), ~0u);
+    std::vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+
+    for (UINT& index : indices)
+    {
+        if (remap[index] == ~0u)
+        {
+            remap[index] = static_cast<UINT>(ordered.size());
+            ordered.push_back(vertices[index]);
+        }
+
+        index = remap[index];
+    }
+
+    vertices.swap(ordered);
+}
+
+MeshAnalysis MeshOptimizer::Analyze(const std::vector<Vertex>& vertices, const UINT* indices, UINT indexCount)
+{
+    MeshAnalysis analysis;
+
+    if (indexCount == 0)
+        return analysis;
+
+    UINT vertexCount = static_cast<UINT>(vertices.size());
+    UINT misses = SimulateCache(indices, indexCount, vertexCount);
+
+    std::vector<bool> isUsed(vertexCount, false);
+    for (UINT index = 0; index < indexCount; index++)
+        isUsed[indices[index]] = true;
+
+    analysis.m_Acmr = static_cast<float>(misses) / (indexCount / 3);
+    analysis.m_Atvr = static_cast<float>(misses) / static_cast<float>(std::count(isUsed.begin(), isUsed.end(), true));
+
+    DirectX::XMFLOAT3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+    DirectX::XMFLOAT3 boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+    for (UINT index = 0; index < indexCount; index++)
+    {
+        const DirectX::XMFLOAT3& position = vertices[indices[index]].Position;
+
+        boundsMin = { (std::min)(boundsMin.x, position.x), (std::min)(boundsMin.y, position.y), (std::min)(boundsMin.z, position.z) };
+        boundsMax = { (std::max)(boundsMax.x, position.x), (std::max)(boundsMax.y, position.y), (std::max)(boundsMax.z, position.z) };
+    }
+
+    std::vector<float> depths(s_OverdrawResolution * s_OverdrawResolution);
+    UINT64 shaded = 0;
+    UINT64 covered = 0;
+
+    for (UINT axis = 0; axis < 3; axis++)
+    {
+        RasterizeOverdraw(vertices, indices, indexCount, axis, false, boundsMin, boundsMax, depths, shaded, covered);
+        RasterizeOverdraw(vertices, indices, indexCount, axis, true, boundsMin, boundsMax, depths, shaded, covered);
+    }
+
+    analysis.m_Overdraw = covered > 0 ? static_cast<float>(static_cast<double>(shaded) / static_cast<double>(covered)) : 0.0f;
+    return analysis;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "Mesh.h"
+#include <windows.h>
+#include <vector>
+
+// Vertex processing cost of an indexed triangle list as drawn
+struct MeshAnalysis final
+{
+    float m_Acmr{ 0.0f };     // Vertex shader runs per triangle with a 16 entry FIFO post-transform cache
+    float m_Atvr{ 0.0f };     // Vertex shader runs per vertex, 1 is ideal
+    float m_Overdraw{ 0.0f }; // Pixels shaded per pixel covered, averaged over six axis aligned views
+};
+
+struct MeshOptimizerStats final
+{
+    MeshAnalysis m_Before;
+    MeshAnalysis m_After;
+    UINT m_Vertices{ 0 };       // Before welding
+    UINT m_UniqueVertices{ 0 }; // After welding, unreferenced vertices dropped
+    double m_Time{ 0.0 };       // Seconds, without the analysis
+};
+
+// Reorders meshes for the GPU front end. Identical vertices are welded, triangles are ordered for the
+// post-transform vertex cache (Forsyth's linear speed algorithm), cache friendly runs of triangles are then
+// sorted so that outward facing ones are drawn first and hide the rest (Sander et al. 2007), and vertices are
+// finally renumbered in the order the triangles use them, so vertex fetches walk memory forward.
+class MeshOptimizer final
+{
+public:
+    // Every step, stats are filled if given
+    static void Optimize(std::vector<Vertex>& vertices, std::vector<UINT>& indices, MeshOptimizerStats* stats = nullptr);
+
+    static UINT WeldVertices(std::vector<Vertex>& vertices, std::vector<UINT>& indices); // Returns the vertex count
+    static void OptimizeVertexCache(UINT* indices, UINT indexCount, UINT vertexCount);
+    static void OptimizeOverdraw(const std::vector<Vertex>& vertices, UINT* indices, UINT indexCount, float threshold = 1.05f);
+    static void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<UINT>& indices);
+
+    static MeshAnalysis Analyze(const std::vector<Vertex>& vertices, const UINT* indices, UINT indexCount);
+};
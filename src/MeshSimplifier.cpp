@@ -0,0 +1,496 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cfloat>
+#include <cassert>
+
+namespace
+{
+    constexpr UINT s_Dimensions = 8; // Position, normal and texture coordinates
+    constexpr UINT s_QuadricSize = s_Dimensions * (s_Dimensions + 1) / 2;
+
+    // Attributes relative to positions scaled into the unit sphere
+    constexpr float s_NormalWeight = 0.5f;
+    constexpr float s_TexCoordWeight = 0.5f;
+
+    // Levels of detail shedding less than this part of the triangles are not kept
+    constexpr float s_MinLodReduction = 0.1f;
+
+    // Sum of squared distances to triangle planes in the attribute space, weighted by triangle area
+    struct Quadric
+    {
+        float m_A[s_QuadricSize]; // Symmetric, upper triangle by rows
+        float m_B[s_Dimensions];
+        float m_C;
+        float m_Weight;
+    };
+
+    using Point = float[s_Dimensions];
+
+    void AddQuadric(Quadric& quadric, const Quadric& other)
+    {
+        for (UINT i = 0; i < s_QuadricSize; i++)
+            quadric.m_A[i] += other.m_A[i];
+
+        for (UINT i = 0; i < s_Dimensions; i++)
+            quadric.m_B[i] += other.m_B[i];
+
+        quadric.m_C += other.m_C;
+        quadric.m_Weight += other.m_Weight;
+    }
+
+    float EvaluateQuadric(const Quadric& quadric, const Point& point)
+    {
+        float error = quadric.m_C;
+        const float* a = quadric.m_A;
+
+        for (UINT i = 0; i < s_Dimensions; i++)
+        {
+            float row = 0.5f * *a++ * point[i];
+            for (UINT j = i + 1; j < s_Dimensions; j++)
+                row += *a++ * point[j];
+
+            error += 2.0f * point[i] * (row + quadric.m_B[i]);
+        }
+
+        return error;
+    }
+
+    float Dot(const Point& a, const Point& b)
+    {
+        float dot = 0.0f;
+        for (UINT i = 0; i < s_Dimensions; i++)
+            dot += a[i] * b[i];
+
+        return dot;
+    }
+
+    // Distance to the plane through the triangle, spanned by the orthonormal e1 and e2 within the attribute space
+    bool MakeQuadric(const Point& p, const Point& q, const Point& r, float area, Quadric& quadric)
+    {
+        Point e1, e2;
+
+        for (UINT i = 0; i < s_Dimensions; i++)
+        {
+            e1[i] = q[i] - p[i];
+            e2[i] = r[i] - p[i];
+        }
+
+        float length = std::sqrt(Dot(e1, e1));
+        if (!(length > 0.0f))
+            return false;
+
+        for (float& e : e1)
+            e /= length;
+
+        float projection = Dot(e1, e2);
+        for (UINT i = 0; i < s_Dimensions; i++)
+            e2[i] -= projection * e1[i];
+
+        length = std::sqrt(Dot(e2, e2));
+        if (!(length > 0.0f))
+            return false;
+
+        for (float& e : e2)
+            e /= length;
+
+        float pe1 = Dot(p, e1);
+        float pe2 = Dot(p, e2);
+
+        float* a = quadric.m_A;
+        for (UINT i = 0; i < s_Dimensions; i++)
+            for (UINT j = i; j < s_Dimensions; j++)
+                *a++ = area * ((i == j ? 1.0f : 0.0f) - e1[i] * e1[j] - e2[i] * e2[j]);
+
+        for (UINT i = 0; i < s_Dimensions; i++)
+            quadric.m_B[i] = area * (pe1 * e1[i] + pe2 * e2[i] - p[i]);
+
+        quadric.m_C = area * (Dot(p, p) - pe1 * pe1 - pe2 * pe2);
+        quadric.m_Weight = area;
+
+        return true;
+    }
+
+    // Squared distances to triangle planes in position space alone, weighted like Quadric. Collapses are ranked
+    // by Quadric, this measures how far they move the surface.
+    struct PlaneQuadric
+    {
+        float m_A[6]; // Symmetric 3x3, upper triangle by rows
+        float m_B[3];
+        float m_C;
+    };
+
+    void AddPlaneQuadric(PlaneQuadric& quadric, const PlaneQuadric& other)
+    {
+        for (UINT i = 0; i < 6; i++)
+            quadric.m_A[i] += other.m_A[i];
+
+        for (UINT i = 0; i < 3; i++)
+            quadric.m_B[i] += other.m_B[i];
+
+        quadric.m_C += other.m_C;
+    }
+
+    float EvaluatePlaneQuadric(const PlaneQuadric& quadric, const Point& point)
+    {
+        const float* a = quadric.m_A;
+        float x = point[0];
+        float y = point[1];
+        float z = point[2];
+
+        return a[0] * x * x + a[3] * y * y + a[5] * z * z + 2.0f * (a[1] * x * y + a[2] * x * z + a[4] * y * z) +
+            2.0f * (quadric.m_B[0] * x + quadric.m_B[1] * y + quadric.m_B[2] * z) + quadric.m_C;
+    }
+
+    PlaneQuadric MakePlaneQuadric(const Point& p, const DirectX::XMVECTOR& normal, float area)
+    {
+        DirectX::XMFLOAT3 n;
+        DirectX::XMStoreFloat3(&n, DirectX::XMVector3Normalize(normal));
+
+        float d = -(n.x * p[0] + n.y * p[1] + n.z * p[2]);
+
+        return
+        {
+            { area * n.x * n.x, area * n.x * n.y, area * n.x * n.z, area * n.y * n.y, area * n.y * n.z, area * n.z * n.z },
+            { area * d * n.x, area * d * n.y, area * d * n.z },
+            area * d * d
+        };
+    }
+
+    DirectX::XMVECTOR GetTriangleNormal(const std::vector<Point>& points, UINT a, UINT b, UINT c)
+    {
+        DirectX::XMVECTOR pa = DirectX::XMVectorSet(points[a][0], points[a][1], points[a][2], 0.0f);
+        DirectX::XMVECTOR pb = DirectX::XMVectorSet(points[b][0], points[b][1], points[b][2], 0.0f);
+        DirectX::XMVECTOR pc = DirectX::XMVectorSet(points[c][0], points[c][1], points[c][2], 0.0f);
+
+        return DirectX::XMVector3Cross(DirectX::XMVectorSubtract(pb, pa), DirectX::XMVectorSubtract(pc, pa));
+    }
+
+    struct Collapse
+    {
+        UINT m_From;
+        UINT m_To;
+        float m_Cost;
+    };
+}
+
+float MeshSimplifier::Simplify(const Vertex* vertices, UINT vertexCount, const UINT* indices, UINT indexCount, UINT targetIndexCount, std::vector<UINT>& result)
+{
+    result.assign(indices, indices + indexCount);
+
+    if (indexCount <= targetIndexCount)
+        return 0.0f;
+
+    // Positions scaled into the unit sphere, so attribute weights do not depend on the mesh size
+    std::vector<Point> points(vertexCount);
+    float scale;
+    {
+        DirectX::XMVECTOR boundsMin = DirectX::XMVectorReplicate(FLT_MAX);
+        DirectX::XMVECTOR boundsMax = DirectX::XMVectorReplicate(-FLT_MAX);
+
+        for (UINT vertex = 0; vertex < vertexCount; vertex++)
+        {
+            DirectX::XMVECTOR position = DirectX::XMLoadFloat3(&vertices[vertex].Position);
+            boundsMin = DirectX::XMVectorMin(boundsMin, position);
+            boundsMax = DirectX::XMVectorMax(boundsMax, position);
+        }
+
+        DirectX::XMVECTOR center = DirectX::XMVectorScale(DirectX::XMVectorAdd(boundsMin, boundsMax), 0.5f);
+        float radius = 0.5f * DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVectorSubtract(boundsMax, boundsMin)));
+        scale = radius > 0.0f ? radius : 1.0f;
+
+        for (UINT vertex = 0; vertex < vertexCount; vertex++)
+        {
+            const Vertex& source = vertices[vertex];
+
+            DirectX::XMFLOAT3 position;
+            DirectX::XMStoreFloat3(&position, DirectX::XMVectorScale(DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&source.Position), center), 1.0f / scale));
+
+            Point& point = points[vertex];
+            point[0] = position.x;
+            point[1] = position.y;
+            point[2] = position.z;
+            point[3] = source.Normal.x * s_NormalWeight;
+            point[4] = source.Normal.y * s_NormalWeight;
+            point[5] = source.Normal.z * s_NormalWeight;
+            point[6] = source.TexCoord.x * s_TexCoordWeight;
+            point[7] = source.TexCoord.y * s_TexCoordWeight;
+        }
+    }
+
+    std::vector<bool> isLocked(vertexCount, false);
+
+    {
+        // Vertices sharing a position with others lie on a seam
+        std::vector<UINT> order(vertexCount);
+        std::iota(order.begin(), order.end(), 0);
+
+        auto positionLess = [vertices](UINT a, UINT b)
+        {
+            const DirectX::XMFLOAT3& pa = vertices[a].Position;
+            const DirectX::XMFLOAT3& pb = vertices[b].Position;
+
+            return pa.x != pb.x ? pa.x < pb.x : pa.y != pb.y ? pa.y < pb.y : pa.z < pb.z;
+        };
+
+        std::sort(order.begin(), order.end(), positionLess);
+
+        for (UINT vertex = 1; vertex < vertexCount; vertex++)
+        {
+            if (!positionLess(order[vertex - 1], order[vertex]))
+                isLocked[order[vertex - 1]] = isLocked[order[vertex]] = true;
+        }
+
+        // Edges used by one triangle lie on a border, used by more than two they are not manifold
+        std::vector<UINT64> edges;
+        edges.reserve(indexCount);
+
+        for (UINT index = 0; index < indexCount; index += 3)
+        {
+            for (UINT corner = 0; corner < 3; corner++)
+            {
+                UINT a = indices[index + corner];
+                UINT b = indices[index + (corner + 1) % 3];
+                edges.push_back(static_cast<UINT64>((std::min)(a, b)) << 32 | (std::max)(a, b));
+            }
+        }
+
+        std::sort(edges.begin(), edges.end());
+
+        for (size_t first = 0; first < edges.size();)
+        {
+            size_t last = first + 1;
+            while (last < edges.size() && edges[last] == edges[first])
+                last++;
+
+            if (last - first != 2)
+                isLocked[edges[first] >> 32] = isLocked[edges[first] & 0xFFFFFFFF] = true;
+
+            first = last;
+        }
+    }
+
+    std::vector<Quadric> quadrics(vertexCount, Quadric{ });
+    std::vector<PlaneQuadric> planes(vertexCount, PlaneQuadric{ });
+
+    for (UINT index = 0; index < indexCount; index += 3)
+    {
+        const Point& p = points[indices[index]];
+        const Point& q = points[indices[index + 1]];
+        const Point& r = points[indices[index + 2]];
+
+        DirectX::XMVECTOR normal = GetTriangleNormal(points, indices[index], indices[index + 1], indices[index + 2]);
+        float area = 0.5f * DirectX::XMVectorGetX(DirectX::XMVector3Length(normal));
+
+        Quadric quadric;
+        if (!MakeQuadric(p, q, r, area, quadric))
+            continue;
+
+        for (UINT corner = 0; corner < 3; corner++)
+            AddQuadric(quadrics[indices[index + corner]], quadric);
+
+        // Triangles without area have no plane and no weight
+        if (area > 0.0f)
+        {
+            PlaneQuadric plane = MakePlaneQuadric(p, normal, area);
+
+            for (UINT corner = 0; corner < 3; corner++)
+                AddPlaneQuadric(planes[indices[index + corner]], plane);
+        }
+    }
+
+    float maxError = 0.0f;
+
+    std::vector<Collapse> collapses;
+    std::vector<UINT> remap(vertexCount);
+    std::vector<bool> isTouched(vertexCount);
+    std::vector<UINT> triangleOffsets(vertexCount + 1);
+    std::vector<UINT> vertexTriangles;
+
+    // Passes of independent collapses, cheapest first, until the target is reached or nothing collapses
+    while (result.size() > targetIndexCount)
+    {
+        UINT triangleCount = static_cast<UINT>(result.size() / 3);
+
+        collapses.clear();
+
+        for (UINT index = 0; index < result.size(); index += 3)
+        {
+            for (UINT corner = 0; corner < 3; corner++)
+            {
+                UINT a = result[index + corner];
+                UINT b = result[index + (corner + 1) % 3];
+
+                // Interior edges show up twice, once in each direction
+                if (a > b)
+                    continue;
+
+                float costAB = isLocked[a] ? FLT_MAX : EvaluateQuadric(quadrics[a], points[b]);
+                float costBA = isLocked[b] ? FLT_MAX : EvaluateQuadric(quadrics[b], points[a]);
+
+                if (costAB <= costBA && costAB < FLT_MAX)
+                    collapses.push_back({ a, b, costAB });
+                else if (costBA < FLT_MAX)
+                    collapses.push_back({ b, a, costBA });
+            }
+        }
+
+        if (collapses.empty())
+            break;
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b)
+        {
+            return a.m_Cost < b.m_Cost;
+        });
+
+        // Triangles around every vertex
+        std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+        for (UINT vertex : result)
+            triangleOffsets[vertex + 1]++;
+
+        std::partial_sum(triangleOffsets.begin(), triangleOffsets.end(), triangleOffsets.begin());
+
+        vertexTriangles.resize(result.size());
+        {
+            std::vector<UINT> cursors(triangleOffsets.begin(), triangleOffsets.end() - 1);
+
+            for (UINT index = 0; index < result.size(); index++)
+                vertexTriangles[cursors[result[index]]++] = index / 3;
+        }
+
+        std::iota(remap.begin(), remap.end(), 0);
+        std::fill(isTouched.begin(), isTouched.end(), false);
+
+        // Every collapse removes about two triangles
+        UINT budget = (triangleCount - targetIndexCount / 3 + 1) / 2;
+        UINT applied = 0;
+
+        for (const Collapse& collapse : collapses)
+        {
+            if (applied >= budget)
+                break;
+
+            UINT from = collapse.m_From;
+            UINT to = collapse.m_To;
+
+            if (isTouched[from] || isTouched[to])
+                continue;
+
+            // Triangles keeping their corners must not turn over
+            bool isFlipped = false;
+
+            for (UINT slot = triangleOffsets[from]; slot < triangleOffsets[from + 1] && !isFlipped; slot++)
+            {
+                const UINT* triangle = &result[vertexTriangles[slot] * 3];
+
+                if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+                    continue;
+
+                UINT moved[3];
+                for (UINT corner = 0; corner < 3; corner++)
+                    moved[corner] = triangle[corner] == from ? to : triangle[corner];
+
+                DirectX::XMVECTOR before = GetTriangleNormal(points, triangle[0], triangle[1], triangle[2]);
+                DirectX::XMVECTOR after = GetTriangleNormal(points, moved[0], moved[1], moved[2]);
+
+                isFlipped = !(DirectX::XMVectorGetX(DirectX::XMVector3Dot(before, after)) > 0.0f);
+            }
+
+            if (isFlipped)
+                continue;
+
+            // Neighbors of the collapsed vertex changed triangles, they wait for the next pass
+            for (UINT slot = triangleOffsets[from]; slot < triangleOffsets[from + 1]; slot++)
+            {
+                const UINT* triangle = &result[vertexTriangles[slot] * 3];
+                isTouched[triangle[0]] = isTouched[triangle[1]] = isTouched[triangle[2]] = true;
+            }
+
+            // Root mean square distance of the moved vertex to the planes it gathered, in the unit sphere
+            float weight = quadrics[from].m_Weight;
+            float distance = EvaluatePlaneQuadric(planes[from], points[to]);
+            maxError = (std::max)(maxError, weight > 0.0f ? std::sqrt((std::max)(distance, 0.0f) / weight) : 0.0f);
+
+            remap[from] = to;
+            AddQuadric(quadrics[to], quadrics[from]);
+            AddPlaneQuadric(planes[to], planes[from]);
+
+            applied++;
+        }
+
+        if (applied == 0)
+            break;
+
+        // Triangles around collapsed edges are left with two equal corners
+        size_t kept = 0;
+
+        for (size_t index = 0; index < result.size(); index += 3)
+        {
+            UINT a = remap[result[index]];
+            UINT b = remap[result[index + 1]];
+            UINT c = remap[result[index + 2]];
+
+            if (a != b && b != c && c != a)
+            {
+                result[kept++] = a;
+                result[kept++] = b;
+                result[kept++] = c;
+            }
+        }
+
+        result.resize(kept);
+    }
+
+    return maxError * scale;
+}
+
+void MeshSimplifier::BuildLods(const Vertex* vertices, UINT vertexCount, const UINT* indices, UINT indexCount, std::vector<UINT>& lodIndices, std::vector<MeshLod>& lods)
+{
+    lodIndices.assign(indices, indices + indexCount);
+    lods.assign(1, { 0, indexCount, 0.0f });
+
+    std::vector<UINT> simplified;
+
+    // Every level is simplified from the previous one, errors add up
+    while (lods.size() < MeshGeometry::s_MaxLods)
+    {
+        const MeshLod& previous = lods.back();
+
+        UINT targetIndexCount = static_cast<UINT>(previous.m_IndexCount / 3 * s_LodRatio) * 3;
+        if (targetIndexCount < s_MinLodTriangles * 3)
+            break;
+
+        std::vector<UINT> source(lodIndices.begin() + previous.m_FirstIndex, lodIndices.begin() + previous.m_FirstIndex + previous.m_IndexCount);
+        float error = Simplify(vertices, vertexCount, source.data(), previous.m_IndexCount, targetIndexCount, simplified);
+
+        if (simplified.size() > previous.m_IndexCount * (1.0f - s_MinLodReduction))
+            break;
+
+        MeshLod lod{ static_cast<UINT>(lodIndices.size()), static_cast<UINT>(simplified.size()), previous.m_Error + error };
+        lodIndices.insert(lodIndices.end(), simplified.begin(), simplified.end());
+        lods.push_back(lod);
+    }
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "Mesh.h"
+#include <windows.h>
+#include <vector>
+
+// Quadric error simplification of indexed triangle lists. Edges are collapsed into one of their vertices, so
+// every level of detail indexes the vertex buffer of the full mesh and only needs an index range of its own.
+// Quadrics span position, normal and texture coordinates (Garland and Heckbert 1998), collapses smearing
+// normals or texture coordinates cost as much as collapses moving the surface. Vertices on open borders or
+// UV and normal seams, where several vertices share a position, are never collapsed away.
+class MeshSimplifier final
+{
+public:
+    static constexpr float s_LodRatio = 0.5f;     // Triangles of a level relative to the previous one
+    static constexpr UINT s_MinLodTriangles = 16; // Levels stop before getting smaller
+
+    // Writes at most targetIndexCount indices if the error allows. Collapses are ranked by the quadric over all
+    // attributes, the returned error is geometric alone: the largest root mean square distance in object units
+    // between a collapsed vertex and the triangle planes it was merged into.
+    static float Simplify(const Vertex* vertices, UINT vertexCount, const UINT* indices, UINT indexCount, UINT targetIndexCount, std::vector<UINT>& result);
+
+    // Level 0 is the input, levels follow each other in lodIndices. Stops once a level fails to shed a
+    // noticeable part of the triangles. Errors grow with levels.
+    static void BuildLods(const Vertex* vertices, UINT vertexCount, const UINT* indices, UINT indexCount, std::vector<UINT>& lodIndices, std::vector<MeshLod>& lods);
+};
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Meshlet.h"
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+
+namespace
+{
+    void ComputeBounds(const DirectX::XMFLOAT3* positions, const MeshletData& meshlets, Meshlet& meshlet)
+    {
+        const UINT* vertices = &meshlets.m_Vertices[meshlet.m_FirstVertex];
+        const BYTE* indices = &meshlets.m_Indices[static_cast<size_t>(meshlet.m_FirstTriangle) * 3];
+
+        // Sphere centered on the box, as for whole meshes
+        DirectX::XMVECTOR boundsMin = DirectX::XMLoadFloat3(&positions[vertices[0]]);
+        DirectX::XMVECTOR boundsMax = boundsMin;
+
+        for (UINT vertex = 1; vertex < meshlet.m_VertexCount; vertex++)
+        {
+            DirectX::XMVECTOR position = DirectX::XMLoadFloat3(&positions[vertices[vertex]]);
+            boundsMin = DirectX::XMVectorMin(boundsMin, position);
+            boundsMax = DirectX::XMVectorMax(boundsMax, position);
+        }
+
+        DirectX::XMVECTOR center = DirectX::XMVectorScale(DirectX::XMVectorAdd(boundsMin, boundsMax), 0.5f);
+        float radiusSquared = 0.0f;
+
+        for (UINT vertex = 0; vertex < meshlet.m_VertexCount; vertex++)
+        {
+            DirectX::XMVECTOR offset = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&positions[vertices[vertex]]), center);
+            radiusSquared = (std::max)(radiusSquared, DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(offset)));
+        }
+
+        DirectX::XMStoreFloat4(&meshlet.m_BoundingSphere, DirectX::XMVectorSetW(center, std::sqrt(radiusSquared)));
+
+        // Axis is the mean of the unit triangle normals, the cone opens as far as the normal farthest from it
+        std::vector<DirectX::XMVECTOR> normals;
+        normals.reserve(meshlet.m_TriangleCount);
+        DirectX::XMVECTOR axis = DirectX::XMVectorZero();
+
+        for (UINT triangle = 0; triangle < meshlet.m_TriangleCount; triangle++)
+        {
+            DirectX::XMVECTOR corner0 = DirectX::XMLoadFloat3(&positions[vertices[indices[triangle * 3 + 0]]]);
+            DirectX::XMVECTOR corner1 = DirectX::XMLoadFloat3(&positions[vertices[indices[triangle * 3 + 1]]]);
+            DirectX::XMVECTOR corner2 = DirectX::XMLoadFloat3(&positions[vertices[indices[triangle * 3 + 2]]]);
+
+            DirectX::XMVECTOR normal = DirectX::XMVector3Cross(DirectX::XMVectorSubtract(corner1, corner0), DirectX::XMVectorSubtract(corner2, corner0));
+            float length = DirectX::XMVectorGetX(DirectX::XMVector3Length(normal));
+
+            // Degenerate triangles are never drawn, whatever their orientation
+            if (length > 0.0f)
+            {
+                normal = DirectX::XMVectorScale(normal, 1.0f / length);
+                normals.push_back(normal);
+                axis = DirectX::XMVectorAdd(axis, normal);
+            }
+        }
+
+        float axisLength = DirectX::XMVectorGetX(DirectX::XMVector3Length(axis));
+        if (normals.empty() || !(axisLength > 1e-6f))
+        {
+            meshlet.m_Cone = { 0.0f, 0.0f, 0.0f, 1.0f };
+            return;
+        }
+
+        axis = DirectX::XMVectorScale(axis, 1.0f / axisLength);
+        float minDot = 1.0f;
+
+        for (const DirectX::XMVECTOR& normal : normals)
+            minDot = (std::min)(minDot, DirectX::XMVectorGetX(DirectX::XMVector3Dot(normal, axis)));
+
+        // Normals up to angle a off the axis all face away from directions within 90 - a degrees of it
+        float cutoff = minDot > 0.0f ? std::sqrt(1.0f - minDot * minDot) : 1.0f;
+
+        DirectX::XMStoreFloat4(&meshlet.m_Cone, DirectX::XMVectorSetW(axis, cutoff));
+    }
+}
+
+size_t MeshletData::GetSize() const
+{
+    return m_Meshlets.size() * sizeof(Meshlet) + m_Vertices.size() * sizeof(UINT) + m_Indices.size() * sizeof(BYTE);
+}
+
+void MeshletBuilder::Build(const DirectX::XMFLOAT3* positions, UINT vertexCount, const UINT* indices, UINT indexCount, MeshletData& meshlets)
+{
+    static_assert(s_MaxVertices <= 256, "Local indices are bytes");
+
+    meshlets.m_Meshlets.clear();
+    meshlets.m_Vertices.clear();
+    meshlets.m_Indices.clear();
+
+    // Local index of every vertex in the open meshlet, stamped with the meshlet so nothing has to be reset
+    std::vector<BYTE> localIndices(vertexCount);
+    std::vector<UINT> stamps(vertexCount, ~0u);
+
+    Meshlet meshlet;
+    UINT meshletIndex = 0;
+
+    for (UINT index = 0; index + 2 < indexCount; index += 3)
+    {
+        const UINT* triangle = indices + index;
+
+        UINT newVertices = 0;
+        for (UINT corner = 0; corner < 3; corner++)
+        {
+            // Repeated corners of degenerate triangles count once
+            bool isRepeated = (corner > 0 && triangle[corner] == triangle[0]) || (corner > 1 && triangle[corner] == triangle[1]);
+            newVertices += stamps[triangle[corner]] != meshletIndex && !isRepeated ? 1 : 0;
+        }
+
+        if (meshlet.m_VertexCount + newVertices > s_MaxVertices || meshlet.m_TriangleCount == s_MaxTriangles)
+        {
+            meshlets.m_Meshlets.push_back(meshlet);
+
+            meshlet.m_FirstVertex = static_cast<UINT>(meshlets.m_Vertices.size());
+            meshlet.m_FirstTriangle = static_cast<UINT>(meshlets.m_Indices.size() / 3);
+            meshlet.m_VertexCount = 0;
+            meshlet.m_TriangleCount = 0;
+            meshletIndex++;
+        }
+
+        for (UINT corner = 0; corner < 3; corner++)
+        {
+            UINT vertex = triangle[corner];
+            assert(vertex < vertexCount);
+
+            if (stamps[vertex] != meshletIndex)
+            {
+                stamps[vertex] = meshletIndex;
+                localIndices[vertex] = static_cast<BYTE>(meshlet.m_VertexCount++);
+                meshlets.m_Vertices.push_back(vertex);
+            }
+
+            meshlets.m_Indices.push_back(localIndices[vertex]);
+        }
+
+        meshlet.m_TriangleCount++;
+    }
+
+    if (meshlet.m_TriangleCount > 0)
+        meshlets.m_Meshlets.push_back(meshlet);
+
+    for (Meshlet& builtMeshlet : meshlets.m_Meshlets)
+        ComputeBounds(positions, meshlets, builtMeshlet);
+}
+
+void MeshletBuilder::Unpack(const MeshletData& meshlets, std::vector<UINT>& indices)
+{
+    indices.resize(meshlets.m_Indices.size());
+
+    for (const Meshlet& meshlet : meshlets.m_Meshlets)
+    {
+        const UINT* vertices = &meshlets.m_Vertices[meshlet.m_FirstVertex];
+        size_t first = static_cast<size_t>(meshlet.m_FirstTriangle) * 3;
+
+        for (size_t index = first; index < first + meshlet.m_TriangleCount * 3; index++)
+            indices[index] = vertices[meshlets.m_Indices[index]];
+    }
+}
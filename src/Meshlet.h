@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <windows.h>
+#include <DirectXMath.h>
+#include <vector>
+
+// Triangles drawn together, they index a table of at most MeshletBuilder::s_MaxVertices vertices with bytes
+struct Meshlet final
+{
+    UINT m_FirstVertex{ 0 };   // Into MeshletData::m_Vertices
+    UINT m_FirstTriangle{ 0 }; // Into MeshletData::m_Indices, three local indices per triangle
+    UINT m_VertexCount{ 0 };
+    UINT m_TriangleCount{ 0 };
+
+    // Object space, center in xyz and radius in w
+    DirectX::XMFLOAT4 m_BoundingSphere{ 0.0f, 0.0f, 0.0f, 0.0f };
+
+    // Triangle normals lie within the cone around the axis in xyz. Seen from a direction d with
+    // dot(d, axis) >= w, every triangle faces away; w of 1 or more disables the test.
+    DirectX::XMFLOAT4 m_Cone{ 0.0f, 0.0f, 0.0f, 1.0f };
+};
+
+struct MeshletData final
+{
+    std::vector<Meshlet> m_Meshlets;
+    std::vector<UINT> m_Vertices; // Vertex buffer indices, the local tables of all meshlets one after another
+    std::vector<BYTE> m_Indices;  // Local indices into the table of their meshlet
+
+    size_t GetSize() const; // Bytes of all three arrays
+};
+
+// Splits indexed triangle lists into meshlets. Triangles are taken in index order, which after vertex cache
+// optimization keeps neighbours together, and a meshlet is closed once the next triangle would exceed either
+// limit. Triangles keep their winding, clockwise seen from the front as drawn by the rasterizer state.
+class MeshletBuilder final
+{
+public:
+    static constexpr UINT s_MaxVertices = 64;
+    static constexpr UINT s_MaxTriangles = 124;
+
+    static void Build(const DirectX::XMFLOAT3* positions, UINT vertexCount, const UINT* indices, UINT indexCount, MeshletData& meshlets);
+
+    // Back to a triangle list of vertex buffer indices, in meshlet order
+    static void Unpack(const MeshletData& meshlets, std::vector<UINT>& indices);
+};
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "MeshletCulling.h"
+#include "Mesh.h"
+#include "FrustumCulling.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+void MeshletCulling::Begin(const Frustum& frustum, const DirectX::XMVECTOR& cameraPosition)
+{
+    m_Frustum = frustum;
+    DirectX::XMStoreFloat3(&m_CameraPosition, cameraPosition);
+
+    m_Stats = { };
+    m_ShortIndices.clear();
+    m_Indices.clear();
+}
+
+UINT MeshletCulling::Cull(const MeshGeometry& geometry, const DirectX::XMMATRIX& world, float scale, UINT& indexCount)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    const MeshletData& meshlets = geometry.GetMeshlets();
+
+    // Kept in the format of the index buffer they replace, so culled draws never fetch wider indices
+    bool isShort = geometry.GetIndexFormat() == DXGI_FORMAT_R16_UINT;
+    UINT firstIndex = static_cast<UINT>(isShort ? m_ShortIndices.size() : m_Indices.size());
+
+    // Camera brought into object space instead of every cone out of it
+    bool testCones = scale > 0.0f;
+    DirectX::XMVECTOR camera = DirectX::XMLoadFloat3(&m_CameraPosition);
+
+    if (testCones)
+    {
+        DirectX::XMVECTOR determinant;
+        camera = DirectX::XMVector3TransformCoord(camera, DirectX::XMMatrixInverse(&determinant, world));
+    }
+
+    // Radii grow with the longest scaled axis
+    float axisScale = std::sqrt((std::max)({
+        DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(world.r[0])),
+        DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(world.r[1])),
+        DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(world.r[2])) }));
+
+    for (const Meshlet& meshlet : meshlets.m_Meshlets)
+    {
+        m_Stats.m_Meshlets++;
+        m_Stats.m_FullTriangles += meshlet.m_TriangleCount;
+
+        DirectX::XMVECTOR sphere = DirectX::XMLoadFloat4(&meshlet.m_BoundingSphere);
+        float radius = meshlet.m_BoundingSphere.w;
+
+        // Every direction from the camera into the sphere has to lie inside the backfacing cone
+        if (testCones && meshlet.m_Cone.w < 1.0f)
+        {
+            DirectX::XMVECTOR offset = DirectX::XMVectorSubtract(sphere, camera);
+            float distance = DirectX::XMVectorGetX(DirectX::XMVector3Length(offset));
+            float facing = DirectX::XMVectorGetX(DirectX::XMVector3Dot(offset, DirectX::XMLoadFloat4(&meshlet.m_Cone)));
+
+            if (facing >= meshlet.m_Cone.w * distance + radius)
+            {
+                m_Stats.m_Backfacing++;
+                continue;
+            }
+        }
+
+        DirectX::XMFLOAT3 center;
+        DirectX::XMStoreFloat3(&center, DirectX::XMVector3TransformCoord(sphere, world));
+
+        if (!FrustumCulling::IsInside(m_Frustum, center.x, center.y, center.z, radius * axisScale))
+        {
+            m_Stats.m_Outside++;
+            continue;
+        }
+
+        m_Stats.m_Visible++;
+        m_Stats.m_Triangles += meshlet.m_TriangleCount;
+
+        const UINT* vertices = &meshlets.m_Vertices[meshlet.m_FirstVertex];
+        const BYTE* indices = &meshlets.m_Indices[static_cast<size_t>(meshlet.m_FirstTriangle) * 3];
+
+        for (UINT index = 0; index < meshlet.m_TriangleCount * 3; index++)
+        {
+            if (isShort)
+                m_ShortIndices.push_back(static_cast<USHORT>(vertices[indices[index]]));
+            else
+                m_Indices.push_back(vertices[indices[index]]);
+        }
+    }
+
+    m_Stats.m_Meshes++;
+    m_Stats.m_Time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    indexCount = static_cast<UINT>(isShort ? m_ShortIndices.size() : m_Indices.size()) - firstIndex;
+    return firstIndex;
+}
+
+const std::vector<USHORT>& MeshletCulling::GetShortIndices() const
+{
+    return m_ShortIndices;
+}
+
+const std::vector<UINT>& MeshletCulling::GetIndices() const
+{
+    return m_Indices;
+}
+
+const MeshletCullingStats& MeshletCulling::GetStats() const
+{
+    return m_Stats;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "Camera.h"
+#include <windows.h>
+#include <DirectXMath.h>
+#include <vector>
+
+class MeshGeometry;
+
+struct MeshletCullingStats final
+{
+    UINT m_Meshes{ 0 };
+    UINT m_Meshlets{ 0 };   // Tested
+    UINT m_Visible{ 0 };
+    UINT m_Backfacing{ 0 }; // Rejected by their normal cone
+    UINT m_Outside{ 0 };    // Rejected by the frustum
+    UINT m_Triangles{ 0 };  // Of visible meshlets
+    UINT m_FullTriangles{ 0 };
+    double m_Time{ 0.0 };   // Seconds
+};
+
+// Rejects meshlets of meshes in view whose triangles all face away from the camera or that lie outside the
+// frustum, and gathers the triangles of the rest into one index list drawn instead of the index buffer of
+// the geometry. Bounding spheres are tested in world space. Normal cones are tested against the camera in
+// object space, where angles only survive uniform scaling, so other meshes skip the cone test.
+class MeshletCulling final
+{
+public:
+    // Clears the index list
+    void Begin(const Frustum& frustum, const DirectX::XMVECTOR& cameraPosition);
+
+    // Appends the triangles of the visible meshlets of geometry level 0 placed by world to the index list of
+    // the index format of geometry, returns the first index of them. scale is the uniform world scale, zero if
+    // the world scales unevenly.
+    UINT Cull(const MeshGeometry& geometry, const DirectX::XMMATRIX& world, float scale, UINT& indexCount);
+
+    const std::vector<USHORT>& GetShortIndices() const; // Of geometries with DXGI_FORMAT_R16_UINT indices
+    const std::vector<UINT>& GetIndices() const;        // Of geometries with DXGI_FORMAT_R32_UINT indices
+    const MeshletCullingStats& GetStats() const; // Since the last Begin()
+
+private:
+    Frustum m_Frustum{ };
+    DirectX::XMFLOAT3 m_CameraPosition{ };
+
+    MeshletCullingStats m_Stats;
+    std::vector<USHORT> m_ShortIndices;
+    std::vector<UINT> m_Indices;
+};
@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "NullBackend.h"
+#include <cassert>
+
+NullBuffer::NullBuffer(const D3D11_BUFFER_DESC& desc, const D3D11_SUBRESOURCE_DATA* data)
+    : m_Desc(desc)
+    , m_Data(desc.ByteWidth)
+{
+    if (data != nullptr)
+        std::memcpy(m_Data.data(), data->pSysMem, desc.ByteWidth);
+}
+
+void NullBuffer::GetDesc(D3D11_BUFFER_DESC* desc)
+{
+    *desc = m_Desc;
+}
+
+BYTE* NullBuffer::GetData()
+{
+    return m_Data.data();
+}
+
+NullTexture2D::NullTexture2D(const D3D11_TEXTURE2D_DESC& desc)
+    : m_Desc(desc)
+{ }
+
+void NullTexture2D::GetDesc(D3D11_TEXTURE2D_DESC* desc)
+{
+    *desc = m_Desc;
+}
+
+void NullTexture2D::Allocate(UINT texelSize)
+{
+    m_RowPitch = m_Desc.Width * texelSize;
+    m_Data.assign(static_cast<size_t>(m_RowPitch) * m_Desc.Height, 0);
+}
+
+BYTE* NullTexture2D::GetData()
+{
+    return m_Data.empty() ? nullptr : m_Data.data();
+}
+
+UINT NullTexture2D::GetRowPitch() const
+{
+    return m_RowPitch;
+}
+
+NullBackend::NullBackend(UINT width, UINT height)
+{
+    D3D11_TEXTURE2D_DESC backBufferDesc{ };
+    backBufferDesc.Width = width;
+    backBufferDesc.Height = height;
+    backBufferDesc.MipLevels = 1;
+    backBufferDesc.ArraySize = 1;
+    backBufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    backBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+    backBufferDesc.BindFlags = D3D11_BIND_RENDER_TARGET;
+    backBufferDesc.SampleDesc.Count = 1;
+    backBufferDesc.SampleDesc.Quality = 0;
+
+    HRESULT hr = CreateTexture2D(&backBufferDesc, nullptr, &m_BackBuffer);
+    assert(SUCCEEDED(hr));
+}
+
+HRESULT NullBackend::CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* data, ID3D11Buffer** buffer)
+{
+    *buffer = new NullBuffer(*desc, data);
+    return S_OK;
+}
+
+HRESULT NullBackend::CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* data, ID3D11Texture2D** texture)
+{
+    *texture = new NullTexture2D(*desc);
+    return S_OK;
+}
+
+HRESULT NullBackend::CreateTextureFromFile(const wchar_t* source, ID3D11ShaderResourceView** view)
+{
+    // Image contents are never sampled, a single texel placeholder stands for any file
+    D3D11_TEXTURE2D_DESC textureDesc{ };
+    textureDesc.Width = 1;
+    textureDesc.Height = 1;
+    textureDesc.MipLevels = 1;
+    textureDesc.ArraySize = 1;
+    textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    textureDesc.Usage = D3D11_USAGE_DEFAULT;
+    textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    textureDesc.SampleDesc.Count = 1;
+    textureDesc.SampleDesc.Quality = 0;
+
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+
+    HRESULT hr = CreateTexture2D(&textureDesc, nullptr, &texture);
+    if (FAILED(hr))
+        return hr;
+
+    return CreateShaderResourceView(texture.Get(), nullptr, view);
+}
+
+HRESULT NullBackend::CreateShaderResourceView(ID3D11Resource* resource, const D3D11_SHADER_RESOURCE_VIEW_DESC* desc, ID3D11ShaderResourceView** view)
+{
+    *view = new NullShaderResourceView(resource, desc);
+    return S_OK;
+}
+
+HRESULT NullBackend::CreateRenderTargetView(ID3D11Resource* resource, const D3D11_RENDER_TARGET_VIEW_DESC* desc, ID3D11RenderTargetView** view)
+{
+    *view = new NullRenderTargetView(resource, desc);
+    return S_OK;
+}
+
+HRESULT NullBackend::CreateDepthStencilView(ID3D11Resource* resource, const D3D11_DEPTH_STENCIL_VIEW_DESC* desc, ID3D11DepthStencilView** view)
+{
+    *view = new NullDepthStencilView(resource, desc);
+    return S_OK;
+}
+
+HRESULT NullBackend::CreateVertexShader(const void* bytecode, SIZE_T length, ID3D11VertexShader** shader)
+{
+    *shader = new NullVertexShader();
+    return S_OK;
+}
+
+HRESULT NullBackend::CreatePixelShader(const void* bytecode, SIZE_T length, ID3D11PixelShader** shader)
+{
+    *shader = new NullPixelShader();
+    return S_OK;
+}
+
+HRESULT NullBackend::CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT count, const void* bytecode, SIZE_T length, ID3D11InputLayout** layout)
+{
+    *layout = new NullInputLayout(elements, count);
+    return S_OK;
+}
+
+HRESULT NullBackend::CreateSamplerState(const D3D11_SAMPLER_DESC* desc, ID3D11SamplerState** sampler)
+{
+    *sampler = new NullSamplerState(*desc);
+    return S_OK;
+}
+
+HRESULT NullBackend::CreateBlendState(const D3D11_BLEND_DESC* desc, ID3D11BlendState** state)
+{
+    *state = new NullBlendState(*desc);
+    return S_OK;
+}
+
+HRESULT NullBackend::CreateRasterizerState(const D3D11_RASTERIZER_DESC* desc, ID3D11RasterizerState** state)
+{
+    *state = new NullRasterizerState(*desc);
+    return S_OK;
+}
+
+HRESULT NullBackend::GetBackBuffer(ID3D11Texture2D** texture)
+{
+    *texture = m_BackBuffer.Get();
+    (*texture)->AddRef();
+    return S_OK;
+}
+
+void NullBackend::IASetInputLayout(ID3D11InputLayout* layout)
+{
+    m_Stats.m_StateCalls++;
+}
+
+void NullBackend::IASetVertexBuffers(UINT slot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets)
+{
+    m_Stats.m_StateCalls++;
+}
+
+void NullBackend::IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+{
+    m_Stats.m_StateCalls++;
+}
+
+void NullBackend::IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+    m_Stats.m_StateCalls++;
+}
+
+void NullBackend::VSSetShader(ID3D11VertexShader* shader)
+{
+    m_Stats.m_StateCalls++;
+}
+
+void NullBackend::VSSetConstantBuffers(UINT slot, UINT count, ID3D11Buffer* const* buffers)
+{
+    m_Stats.m_StateCalls++;
+}
+
+void NullBackend::VSSetConstantBuffers1(UINT slot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts)
+{
+    m_Stats.m_StateCalls++;
+}
+
+void NullBackend::PSSetShader(ID3D11PixelShader* shader)
+{
+    m_Stats.m_StateCalls++;
+}
+
+void NullBackend::PSSetConstantBuffers(UINT slot, UINT count, ID3D11Buffer* const* buffers)
+{
+    m_Stats.m_StateCalls++;
+}
+
+void NullBackend::PSSetConstantBuffers1(UINT slot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts)
+{
+    m_Stats.m_StateCalls++;
+}
+
+void NullBackend::PSSetShaderResources(UINT slot, UINT count, ID3D11ShaderResourceView* const* views)
+{
+    m_Stats.m_StateCalls++;
+}
+
+void NullBackend::PSSetSamplers(UINT slot, UINT count, ID3D11SamplerState* const* samplers)
+{
+    m_Stats.m_StateCalls++;
+}
+
+void NullBackend::RSSetState(ID3D11RasterizerState* state)
+{
+    m_Stats.m_StateCalls++;
+}
+
+void NullBackend::RSSetViewports(UINT count, const D3D11_VIEWPORT* viewports)
+{
+    m_Stats.m_StateCalls++;
+}
+
+void NullBackend::RSSetScissorRects(UINT count, const D3D11_RECT* rects)
+{
+    m_Stats.m_StateCalls++;
+}
+
+void NullBackend::OMSetRenderTargets(UINT count, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthStencilView)
+{
+    m_Stats.m_StateCalls++;
+}
+
+void NullBackend::OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask)
+{
+    m_Stats.m_StateCalls++;
+}
+
+void NullBackend::ClearRenderTargetView(ID3D11RenderTargetView* view, const FLOAT color[4])
+{
+    m_Stats.m_ClearCalls++;
+}
+
+void NullBackend::ClearDepthStencilView(ID3D11DepthStencilView* view, UINT flags, FLOAT depth, UINT8 stencil)
+{
+    m_Stats.m_ClearCalls++;
+}
+
+HRESULT NullBackend::Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP type, UINT flags, D3D11_MAPPED_SUBRESOURCE* mappedResource)
+{
+    D3D11_RESOURCE_DIMENSION dimension = D3D11_RESOURCE_DIMENSION_UNKNOWN;
+    resource->GetType(&dimension);
+
+    if (dimension != D3D11_RESOURCE_DIMENSION_BUFFER)
+        return E_INVALIDARG;
+
+    NullBuffer* buffer = static_cast<NullBuffer*>(resource);
+
+    D3D11_BUFFER_DESC bufferDesc{ };
+    buffer->GetDesc(&bufferDesc);
+
+    mappedResource->pData = buffer->GetData();
+    mappedResource->RowPitch = bufferDesc.ByteWidth;
+    mappedResource->DepthPitch = bufferDesc.ByteWidth;
+
+    m_Stats.m_MapCalls++;
+    m_Stats.m_MappedBytes += bufferDesc.ByteWidth;
+
+    return S_OK;
+}
+
+void NullBackend::Unmap(ID3D11Resource* resource, UINT subresource)
+{ }
+
+void NullBackend::DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex)
+{
+    m_Stats.m_DrawCalls++;
+    m_Stats.m_DrawIndices += indexCount;
+    m_Stats.m_DrawInstances++;
+}
+
+void NullBackend::DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)
+{
+    m_Stats.m_DrawCalls++;
+    m_Stats.m_DrawIndices += indexCount * instanceCount;
+    m_Stats.m_DrawInstances += instanceCount;
+}
+
+void NullBackend::Present()
+{ }
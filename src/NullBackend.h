@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "Backend.h"
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <vector>
+#include <cstring>
+
+// Reference counted stand-ins for D3D11 objects, created by NullBackend instead of a driver
+template <typename T>
+class NullDeviceChild : public T
+{
+public:
+    virtual ~NullDeviceChild() = default;
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override
+    {
+        if (riid != __uuidof(T) && riid != __uuidof(ID3D11DeviceChild) && riid != __uuidof(IUnknown))
+        {
+            *object = nullptr;
+            return E_NOINTERFACE;
+        }
+
+        AddRef();
+        *object = static_cast<T*>(this);
+        return S_OK;
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() override
+    {
+        return ++m_References;
+    }
+
+    ULONG STDMETHODCALLTYPE Release() override
+    {
+        ULONG references = --m_References;
+        if (references == 0)
+            delete this;
+
+        return references;
+    }
+
+    void STDMETHODCALLTYPE GetDevice(ID3D11Device** device) override
+    {
+        *device = nullptr;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID guid, UINT* size, void* data) override
+    {
+        for (const PrivateData& privateData : m_PrivateData)
+        {
+            if (privateData.m_Guid != guid)
+                continue;
+
+            UINT dataSize = static_cast<UINT>(privateData.m_Data.size());
+            if (data != nullptr && *size < dataSize)
+                return E_INVALIDARG;
+
+            if (data != nullptr)
+                std::memcpy(data, privateData.m_Data.data(), dataSize);
+
+            *size = dataSize;
+            return S_OK;
+        }
+
+        *size = 0;
+        return E_FAIL;
+    }
+
+    HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID guid, UINT size, const void* data) override
+    {
+        const BYTE* bytes = static_cast<const BYTE*>(data);
+
+        for (PrivateData& privateData : m_PrivateData)
+        {
+            if (privateData.m_Guid == guid)
+            {
+                privateData.m_Data.assign(bytes, bytes + size);
+                return S_OK;
+            }
+        }
+
+        m_PrivateData.push_back({ guid, std::vector<BYTE>(bytes, bytes + size) });
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID guid, const IUnknown* data) override
+    {
+        return E_NOTIMPL;
+    }
+
+private:
+    struct PrivateData
+    {
+        GUID m_Guid;
+        std::vector<BYTE> m_Data;
+    };
+
+    ULONG m_References{ 1 };
+    std::vector<PrivateData> m_PrivateData;
+};
+
+template <typename T, D3D11_RESOURCE_DIMENSION Dimension>
+class NullResource : public NullDeviceChild<T>
+{
+public:
+    void STDMETHODCALLTYPE GetType(D3D11_RESOURCE_DIMENSION* dimension) override
+    {
+        *dimension = Dimension;
+    }
+
+    void STDMETHODCALLTYPE SetEvictionPriority(UINT priority) override
+    { }
+
+    UINT STDMETHODCALLTYPE GetEvictionPriority() override
+    {
+        return 0;
+    }
+};
+
+class NullBuffer final : public NullResource<ID3D11Buffer, D3D11_RESOURCE_DIMENSION_BUFFER>
+{
+public:
+    NullBuffer(const D3D11_BUFFER_DESC& desc, const D3D11_SUBRESOURCE_DATA* data);
+
+    void STDMETHODCALLTYPE GetDesc(D3D11_BUFFER_DESC* desc) override;
+
+    BYTE* GetData();
+
+private:
+    D3D11_BUFFER_DESC m_Desc{ };
+    std::vector<BYTE> m_Data;
+};
+
+class NullTexture2D final : public NullResource<ID3D11Texture2D, D3D11_RESOURCE_DIMENSION_TEXTURE2D>
+{
+public:
+    NullTexture2D(const D3D11_TEXTURE2D_DESC& desc);
+
+    void STDMETHODCALLTYPE GetDesc(D3D11_TEXTURE2D_DESC* desc) override;
+
+    // Texels of the top mip level, only stored once a backend executing shaders on CPU allocates them
+    void Allocate(UINT texelSize);
+
+    BYTE* GetData();
+    UINT GetRowPitch() const;
+
+private:
+    D3D11_TEXTURE2D_DESC m_Desc{ };
+    UINT m_RowPitch{ 0 };
+    std::vector<BYTE> m_Data;
+};
+
+template <typename T, typename Desc>
+class NullView final : public NullDeviceChild<T>
+{
+public:
+    NullView(ID3D11Resource* resource, const Desc* desc)
+        : m_Resource(resource)
+    {
+        if (desc != nullptr)
+            m_Desc = *desc;
+    }
+
+    void STDMETHODCALLTYPE GetResource(ID3D11Resource** resource) override
+    {
+        *resource = m_Resource.Get();
+        (*resource)->AddRef();
+    }
+
+    void STDMETHODCALLTYPE GetDesc(Desc* desc) override
+    {
+        *desc = m_Desc;
+    }
+
+private:
+    Microsoft::WRL::ComPtr<ID3D11Resource> m_Resource;
+    Desc m_Desc{ };
+};
+
+template <typename T, typename Desc>
+class NullState final : public NullDeviceChild<T>
+{
+public:
+    NullState(const Desc& desc)
+        : m_Desc(desc)
+    { }
+
+    void STDMETHODCALLTYPE GetDesc(Desc* desc) override
+    {
+        *desc = m_Desc;
+    }
+
+private:
+    Desc m_Desc{ };
+};
+
+using NullShaderResourceView = NullView<ID3D11ShaderResourceView, D3D11_SHADER_RESOURCE_VIEW_DESC>;
+using NullRenderTargetView = NullView<ID3D11RenderTargetView, D3D11_RENDER_TARGET_VIEW_DESC>;
+using NullDepthStencilView = NullView<ID3D11DepthStencilView, D3D11_DEPTH_STENCIL_VIEW_DESC>;
+
+using NullSamplerState = NullState<ID3D11SamplerState, D3D11_SAMPLER_DESC>;
+using NullBlendState = NullState<ID3D11BlendState, D3D11_BLEND_DESC>;
+using NullRasterizerState = NullState<ID3D11RasterizerState, D3D11_RASTERIZER_DESC>;
+
+using NullVertexShader = NullDeviceChild<ID3D11VertexShader>;
+using NullPixelShader = NullDeviceChild<ID3D11PixelShader>;
+
+// Keeps the POSITION element format, CPU backends tell vertex formats apart by it
+class NullInputLayout final : public NullDeviceChild<ID3D11InputLayout>
+{
+public:
+    NullInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT count)
+    {
+        for (UINT element = 0; element < count; element++)
+        {
+            if (std::strcmp(elements[element].SemanticName, "POSITION") == 0)
+                m_PositionFormat = elements[element].Format;
+        }
+    }
+
+    DXGI_FORMAT GetPositionFormat() const
+    {
+        return m_PositionFormat;
+    }
+
+private:
+    DXGI_FORMAT m_PositionFormat{ DXGI_FORMAT_UNKNOWN };
+};
+
+// Headless backend: accepts every call without a window or GPU and only records BackendStats
+class NullBackend : public Backend
+{
+public:
+    NullBackend(UINT width, UINT height);
+
+    HRESULT CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* data, ID3D11Buffer** buffer) override;
+    HRESULT CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* data, ID3D11Texture2D** texture) override;
+    HRESULT CreateTextureFromFile(const wchar_t* source, ID3D11ShaderResourceView** view) override;
+    HRESULT CreateShaderResourceView(ID3D11Resource* resource, const D3D11_SHADER_RESOURCE_VIEW_DESC* desc, ID3D11ShaderResourceView** view) override;
+    HRESULT CreateRenderTargetView(ID3D11Resource* resource, const D3D11_RENDER_TARGET_VIEW_DESC* desc, ID3D11RenderTargetView** view) override;
+    HRESULT CreateDepthStencilView(ID3D11Resource* resource, const D3D11_DEPTH_STENCIL_VIEW_DESC* desc, ID3D11DepthStencilView** view) override;
+    HRESULT CreateVertexShader(const void* bytecode, SIZE_T length, ID3D11VertexShader** shader) override;
+    HRESULT CreatePixelShader(const void* bytecode, SIZE_T length, ID3D11PixelShader** shader) override;
+    HRESULT CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT count, const void* bytecode, SIZE_T length, ID3D11InputLayout** layout) override;
+    HRESULT CreateSamplerState(const D3D11_SAMPLER_DESC* desc, ID3D11SamplerState** sampler) override;
+    HRESULT CreateBlendState(const D3D11_BLEND_DESC* desc, ID3D11BlendState** state) override;
+    HRESULT CreateRasterizerState(const D3D11_RASTERIZER_DESC* desc, ID3D11RasterizerState** state) override;
+    HRESULT GetBackBuffer(ID3D11Texture2D** texture) override;
+
+    void IASetInputLayout(ID3D11InputLayout* layout) override;
+    void IASetVertexBuffers(UINT slot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets) override;
+    void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset) override;
+    void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) override;
+    void VSSetShader(ID3D11VertexShader* shader) override;
+    void VSSetConstantBuffers(UINT slot, UINT count, ID3D11Buffer* const* buffers) override;
+    void VSSetConstantBuffers1(UINT slot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts) override;
+    void PSSetShader(ID3D11PixelShader* shader) override;
+    void PSSetConstantBuffers(UINT slot, UINT count, ID3D11Buffer* const* buffers) override;
+    void PSSetConstantBuffers1(UINT slot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts) override;
+    void PSSetShaderResources(UINT slot, UINT count, ID3D11ShaderResourceView* const* views) override;
+    void PSSetSamplers(UINT slot, UINT count, ID3D11SamplerState* const* samplers) override;
+    void RSSetState(ID3D11RasterizerState* state) override;
+    void RSSetViewports(UINT count, const D3D11_VIEWPORT* viewports) override;
+    void RSSetScissorRects(UINT count, const D3D11_RECT* rects) override;
+    void OMSetRenderTargets(UINT count, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthStencilView) override;
+    void OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask) override;
+    void ClearRenderTargetView(ID3D11RenderTargetView* view, const FLOAT color[4]) override;
+    void ClearDepthStencilView(ID3D11DepthStencilView* view, UINT flags, FLOAT depth, UINT8 stencil) override;
+    HRESULT Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP type, UINT flags, D3D11_MAPPED_SUBRESOURCE* mappedResource) override;
+    void Unmap(ID3D11Resource* resource, UINT subresource) override;
+    void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex) override;
+    void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance) override;
+
+    void Present() override;
+
+private:
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> m_BackBuffer;
+};
@@ -0,0 +1,478 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "OcclusionCulling.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cassert>
+#include <emmintrin.h>
+
+namespace
+{
+    constexpr UINT s_FullMask = 0xFFFFFFFF;
+    constexpr size_t s_QueryBatchSize = 256; // Queries per thread pool task
+
+    // Bits of the pixels [x0, x1] x [y0, y1] of a tile, bit y * 8 + x
+    UINT GetRectMask(UINT x0, UINT x1, UINT y0, UINT y1)
+    {
+        UINT rowMask = (2u << x1) - (1u << x0);
+        UINT mask = 0;
+
+        for (UINT y = y0; y <= y1; y++)
+            mask |= rowMask << (y * OcclusionCulling::s_TileWidth);
+
+        return mask;
+    }
+}
+
+OcclusionCulling::OcclusionCulling(ThreadPool& threadPool, UINT width, UINT height)
+    : m_ThreadPool(threadPool)
+{
+    m_TilesX = (width + s_TileWidth - 1) / s_TileWidth;
+    m_TilesY = (height + s_TileHeight - 1) / s_TileHeight;
+    m_BlocksX = (m_TilesX + s_BlockSize - 1) / s_BlockSize;
+    m_BlocksY = (m_TilesY + s_BlockSize - 1) / s_BlockSize;
+
+    m_TileMasks.resize(m_TilesX * m_TilesY);
+    m_TileDepths.resize(m_TilesX * m_TilesY);
+    m_LayerDepths.resize(m_TilesX * m_TilesY);
+    m_BlockDepths.resize(m_BlocksX * m_BlocksY);
+    m_RowTriangles.resize(m_TilesY);
+
+    Begin(DirectX::XMMatrixIdentity());
+}
+
+UINT OcclusionCulling::GetWidth() const
+{
+    return m_TilesX * s_TileWidth;
+}
+
+UINT OcclusionCulling::GetHeight() const
+{
+    return m_TilesY * s_TileHeight;
+}
+
+void OcclusionCulling::Begin(const DirectX::XMMATRIX& viewProjection)
+{
+    DirectX::XMStoreFloat4x4(&m_ViewProjection, viewProjection);
+
+    std::fill(m_TileMasks.begin(), m_TileMasks.end(), 0);
+    std::fill(m_TileDepths.begin(), m_TileDepths.end(), 1.0f);
+    std::fill(m_LayerDepths.begin(), m_LayerDepths.end(), 0.0f);
+    std::fill(m_BlockDepths.begin(), m_BlockDepths.end(), 1.0f);
+
+    m_Triangles.clear();
+    for (auto& triangles : m_RowTriangles)
+        triangles.clear();
+
+    m_Stats = { };
+}
+
+void OcclusionCulling::AddOccluder(const std::vector<DirectX::XMFLOAT3>& positions, const std::vector<UINT>& indices, const DirectX::XMMATRIX& world)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    DirectX::XMMATRIX worldViewProjection = DirectX::XMMatrixMultiply(world, DirectX::XMLoadFloat4x4(&m_ViewProjection));
+
+    m_Vertices.resize(positions.size());
+    for (size_t vertex = 0; vertex < positions.size(); vertex++)
+        DirectX::XMStoreFloat4(&m_Vertices[vertex], DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&positions[vertex]), worldViewProjection));
+
+    for (size_t index = 0; index + 2 < indices.size(); index += 3)
+    {
+        DirectX::XMVECTOR vertices[4];
+        DirectX::XMVECTOR triangle[3];
+        UINT count = 0;
+
+        for (UINT corner = 0; corner < 3; corner++)
+            triangle[corner] = DirectX::XMLoadFloat4(&m_Vertices[indices[index + corner]]);
+
+        // Clipped against the near plane z >= 0, the rest of the frustum is handled by the pixel bounds
+        for (UINT corner = 0; corner < 3; corner++)
+        {
+            const DirectX::XMVECTOR& current = triangle[corner];
+            const DirectX::XMVECTOR& next = triangle[(corner + 1) % 3];
+
+            float currentZ = DirectX::XMVectorGetZ(current);
+            float nextZ = DirectX::XMVectorGetZ(next);
+
+            if (currentZ >= 0.0f)
+                vertices[count++] = current;
+
+            if ((currentZ >= 0.0f) != (nextZ >= 0.0f))
+                vertices[count++] = DirectX::XMVectorLerp(current, next, currentZ / (currentZ - nextZ));
+        }
+
+        for (UINT corner = 2; corner < count; corner++)
+            AddTriangle(vertices[0], vertices[corner - 1], vertices[corner]);
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    m_Stats.m_Time += elapsed.count();
+}
+
+void OcclusionCulling::AddTriangle(const DirectX::XMVECTOR& v0, const DirectX::XMVECTOR& v1, const DirectX::XMVECTOR& v2)
+{
+    float width = static_cast<float>(GetWidth());
+    float height = static_cast<float>(GetHeight());
+
+    float x[3], y[3], z[3];
+
+    {
+        const DirectX::XMVECTOR* vertices[] = { &v0, &v1, &v2 };
+
+        for (UINT corner = 0; corner < 3; corner++)
+        {
+            DirectX::XMFLOAT4 clip;
+            DirectX::XMStoreFloat4(&clip, *vertices[corner]);
+
+            float inverseW = 1.0f / clip.w;
+            x[corner] = (clip.x * inverseW * 0.5f + 0.5f) * width;
+            y[corner] = (0.5f - clip.y * inverseW * 0.5f) * height;
+            z[corner] = clip.z * inverseW;
+        }
+    }
+
+    Triangle triangle;
+
+    triangle.m_MinX = (std::max)((std::min)({ x[0], x[1], x[2] }), 0.0f);
+    triangle.m_MinY = (std::max)((std::min)({ y[0], y[1], y[2] }), 0.0f);
+    triangle.m_MaxX = (std::min)((std::max)({ x[0], x[1], x[2] }), width);
+    triangle.m_MaxY = (std::min)((std::max)({ y[0], y[1], y[2] }), height);
+
+    if (triangle.m_MinX >= triangle.m_MaxX || triangle.m_MinY >= triangle.m_MaxY)
+        return;
+
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (!(std::abs(area) > 0.0f))
+        return;
+
+    {
+        // Both windings are occluders, edges are oriented so that the inside is positive
+        float orientation = area > 0.0f ? 1.0f : -1.0f;
+
+        for (UINT edge = 0; edge < 3; edge++)
+        {
+            UINT next = (edge + 1) % 3;
+
+            triangle.m_EdgeA[edge] = orientation * (y[edge] - y[next]);
+            triangle.m_EdgeB[edge] = orientation * (x[next] - x[edge]);
+            triangle.m_EdgeC[edge] = orientation * (x[edge] * y[next] - y[edge] * x[next]);
+        }
+    }
+
+    {
+        float depthX = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+        float depthY = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+
+        triangle.m_Depth[0] = z[0] - depthX * x[0] - depthY * y[0];
+        triangle.m_Depth[1] = depthX;
+        triangle.m_Depth[2] = depthY;
+        triangle.m_MaxDepth = (std::max)({ z[0], z[1], z[2] });
+    }
+
+    UINT index = static_cast<UINT>(m_Triangles.size());
+    m_Triangles.push_back(triangle);
+    m_Stats.m_OccluderTriangles++;
+
+    UINT firstRow = static_cast<UINT>(triangle.m_MinY) / s_TileHeight;
+    UINT lastRow = (std::min)(static_cast<UINT>(std::ceil(triangle.m_MaxY)) - 1, GetHeight() - 1) / s_TileHeight;
+
+    for (UINT row = firstRow; row <= lastRow; row++)
+        m_RowTriangles[row].push_back(index);
+}
+
+void OcclusionCulling::Rasterize()
+{
+    auto start = std::chrono::steady_clock::now();
+
+    m_ThreadPool.ParallelFor(m_TilesY, [this](size_t row)
+    {
+        RasterizeRow(static_cast<UINT>(row));
+    });
+
+    // Hierarchical depth, farthest tile depth of every block
+    for (UINT blockY = 0; blockY < m_BlocksY; blockY++)
+    {
+        for (UINT blockX = 0; blockX < m_BlocksX; blockX++)
+        {
+            float depth = 0.0f;
+
+            for (UINT tileY = blockY * s_BlockSize; tileY < (std::min)((blockY + 1) * s_BlockSize, m_TilesY); tileY++)
+                for (UINT tileX = blockX * s_BlockSize; tileX < (std::min)((blockX + 1) * s_BlockSize, m_TilesX); tileX++)
+                    depth = (std::max)(depth, m_TileDepths[tileY * m_TilesX + tileX]);
+
+            m_BlockDepths[blockY * m_BlocksX + blockX] = depth;
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    m_Stats.m_Time += elapsed.count();
+}
+
+void OcclusionCulling::RasterizeRow(UINT row)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 laneOffsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+
+    float top = static_cast<float>(row * s_TileHeight);
+
+    for (UINT index : m_RowTriangles[row])
+    {
+        const Triangle& triangle = m_Triangles[index];
+
+        __m128 edgeSteps[3];      // Along a row, for the left four pixels of a tile
+        __m128 edgeHalfSteps[3];  // From the left to the right four pixels
+        __m128 edgeRowSteps[3];   // From one pixel row to the next
+        __m128 edgeTopLeft[3];    // Pixel centers exactly on a top or left edge are inside
+
+        for (UINT edge = 0; edge < 3; edge++)
+        {
+            float a = triangle.m_EdgeA[edge];
+            float b = triangle.m_EdgeB[edge];
+
+            edgeSteps[edge] = _mm_mul_ps(_mm_set1_ps(a), laneOffsets);
+            edgeHalfSteps[edge] = _mm_set1_ps(a * 4.0f);
+            edgeRowSteps[edge] = _mm_set1_ps(b);
+            edgeTopLeft[edge] = _mm_castsi128_ps(_mm_set1_epi32(a > 0.0f || (a == 0.0f && b > 0.0f) ? -1 : 0));
+        }
+
+        float minY = (std::max)(triangle.m_MinY, top);
+        float maxY = (std::min)(triangle.m_MaxY, top + s_TileHeight);
+
+        UINT firstTile = static_cast<UINT>(triangle.m_MinX) / s_TileWidth;
+        UINT lastTile = (std::min)(static_cast<UINT>(std::ceil(triangle.m_MaxX)) - 1, GetWidth() - 1) / s_TileWidth;
+
+        for (UINT tileX = firstTile; tileX <= lastTile; tileX++)
+        {
+            UINT tile = row * m_TilesX + tileX;
+            float left = static_cast<float>(tileX * s_TileWidth);
+
+            // Farthest depth of the triangle in the tile, at a corner of the tile clipped to the triangle bounds
+            float depth;
+            {
+                float minX = (std::max)(triangle.m_MinX, left);
+                float maxX = (std::min)(triangle.m_MaxX, left + s_TileWidth);
+
+                depth = triangle.m_Depth[0] +
+                    triangle.m_Depth[1] * (triangle.m_Depth[1] > 0.0f ? maxX : minX) +
+                    triangle.m_Depth[2] * (triangle.m_Depth[2] > 0.0f ? maxY : minY);
+                depth = (std::min)(depth, triangle.m_MaxDepth);
+            }
+
+            // Behind everything already covering the tile
+            if (!(depth < m_TileDepths[tile]))
+                continue;
+
+            UINT mask = 0;
+            {
+                __m128 rowEdges[3];
+                for (UINT edge = 0; edge < 3; edge++)
+                {
+                    float center = triangle.m_EdgeA[edge] * (left + 0.5f) + triangle.m_EdgeB[edge] * (top + 0.5f) + triangle.m_EdgeC[edge];
+                    rowEdges[edge] = _mm_add_ps(_mm_set1_ps(center), edgeSteps[edge]);
+                }
+
+                for (UINT y = 0; y < s_TileHeight; y++)
+                {
+                    __m128 insideLeft = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                    __m128 insideRight = insideLeft;
+
+                    for (UINT edge = 0; edge < 3; edge++)
+                    {
+                        __m128 leftEdges = rowEdges[edge];
+                        __m128 rightEdges = _mm_add_ps(leftEdges, edgeHalfSteps[edge]);
+
+                        insideLeft = _mm_and_ps(insideLeft, _mm_or_ps(_mm_cmpgt_ps(leftEdges, zero), _mm_and_ps(_mm_cmpeq_ps(leftEdges, zero), edgeTopLeft[edge])));
+                        insideRight = _mm_and_ps(insideRight, _mm_or_ps(_mm_cmpgt_ps(rightEdges, zero), _mm_and_ps(_mm_cmpeq_ps(rightEdges, zero), edgeTopLeft[edge])));
+
+                        rowEdges[edge] = _mm_add_ps(leftEdges, edgeRowSteps[edge]);
+                    }
+
+                    UINT rowMask = static_cast<UINT>(_mm_movemask_ps(insideLeft) | (_mm_movemask_ps(insideRight) << 4));
+                    mask |= rowMask << (y * s_TileWidth);
+                }
+            }
+
+            if (mask == 0)
+                continue;
+
+            float& tileDepth = m_TileDepths[tile];
+            float& layerDepth = m_LayerDepths[tile];
+            UINT& tileMask = m_TileMasks[tile];
+
+            // The working layer is dropped when the triangle is closer to it than the layer is to the tile depth,
+            // merging would push the layer back towards the tile depth and gain little
+            if (layerDepth - depth > tileDepth - layerDepth)
+            {
+                layerDepth = 0.0f;
+                tileMask = 0;
+            }
+
+            layerDepth = (std::max)(layerDepth, depth);
+            tileMask |= mask;
+
+            if (tileMask == s_FullMask)
+            {
+                tileDepth = (std::min)(tileDepth, layerDepth);
+                layerDepth = 0.0f;
+                tileMask = 0;
+            }
+        }
+    }
+}
+
+void OcclusionCulling::Test(std::vector<OcclusionQuery>& queries)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    size_t batches = (queries.size() + s_QueryBatchSize - 1) / s_QueryBatchSize;
+
+    m_ThreadPool.ParallelFor(batches, [&](size_t batch)
+    {
+        size_t last = (std::min)((batch + 1) * s_QueryBatchSize, queries.size());
+
+        for (size_t query = batch * s_QueryBatchSize; query < last; query++)
+            queries[query].m_IsOccluded = IsOccluded(queries[query]);
+    });
+
+    for (const OcclusionQuery& query : queries)
+    {
+        m_Stats.m_Tested++;
+
+        if (query.m_IsOccluded)
+        {
+            m_Stats.m_Occluded++;
+            m_Stats.m_OccludedTriangles += query.m_Triangles;
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    m_Stats.m_Time += elapsed.count();
+}
+
+bool OcclusionCulling::IsOccluded(const OcclusionQuery& query) const
+{
+    float width = static_cast<float>(GetWidth());
+    float height = static_cast<float>(GetHeight());
+
+    float minX = width, minY = height, maxX = 0.0f, maxY = 0.0f;
+    float minDepth = 1.0f;
+
+    {
+        // Screen rectangle and nearest depth of the eight corners
+        DirectX::XMMATRIX viewProjection = DirectX::XMLoadFloat4x4(&m_ViewProjection);
+
+        for (UINT corner = 0; corner < 8; corner++)
+        {
+            DirectX::XMVECTOR position = DirectX::XMVectorSet(
+                corner & 1 ? query.m_BoundsMax.x : query.m_BoundsMin.x,
+                corner & 2 ? query.m_BoundsMax.y : query.m_BoundsMin.y,
+                corner & 4 ? query.m_BoundsMax.z : query.m_BoundsMin.z, 1.0f);
+
+            DirectX::XMFLOAT4 clip;
+            DirectX::XMStoreFloat4(&clip, DirectX::XMVector4Transform(position, viewProjection));
+
+            if (clip.z < 0.0f)
+                return false;
+
+            float inverseW = 1.0f / clip.w;
+            float x = (clip.x * inverseW * 0.5f + 0.5f) * width;
+            float y = (0.5f - clip.y * inverseW * 0.5f) * height;
+
+            minX = (std::min)(minX, x);
+            minY = (std::min)(minY, y);
+            maxX = (std::max)(maxX, x);
+            maxY = (std::max)(maxY, y);
+            minDepth = (std::min)(minDepth, clip.z * inverseW);
+        }
+    }
+
+    // Every pixel touched by the rectangle, not only those with covered centers
+    minX = (std::max)(std::floor(minX), 0.0f);
+    minY = (std::max)(std::floor(minY), 0.0f);
+    maxX = (std::min)(std::ceil(maxX), width);
+    maxY = (std::min)(std::ceil(maxY), height);
+
+    if (minX >= maxX || minY >= maxY)
+        return false;
+
+    UINT pixelX0 = static_cast<UINT>(minX);
+    UINT pixelY0 = static_cast<UINT>(minY);
+    UINT pixelX1 = static_cast<UINT>(maxX) - 1;
+    UINT pixelY1 = static_cast<UINT>(maxY) - 1;
+
+    UINT tileX0 = pixelX0 / s_TileWidth, tileX1 = pixelX1 / s_TileWidth;
+    UINT tileY0 = pixelY0 / s_TileHeight, tileY1 = pixelY1 / s_TileHeight;
+
+    for (UINT blockY = tileY0 / s_BlockSize; blockY <= tileY1 / s_BlockSize; blockY++)
+    {
+        for (UINT blockX = tileX0 / s_BlockSize; blockX <= tileX1 / s_BlockSize; blockX++)
+        {
+            // Behind the farthest occluder of the whole block
+            if (minDepth > m_BlockDepths[blockY * m_BlocksX + blockX])
+                continue;
+
+            UINT firstY = (std::max)(tileY0, blockY * s_BlockSize), lastY = (std::min)(tileY1, blockY * s_BlockSize + s_BlockSize - 1);
+            UINT firstX = (std::max)(tileX0, blockX * s_BlockSize), lastX = (std::min)(tileX1, blockX * s_BlockSize + s_BlockSize - 1);
+
+            for (UINT tileY = firstY; tileY <= lastY; tileY++)
+            {
+                for (UINT tileX = firstX; tileX <= lastX; tileX++)
+                {
+                    UINT tile = tileY * m_TilesX + tileX;
+
+                    if (minDepth > m_TileDepths[tile])
+                        continue;
+
+                    // Pixels of the working layer are also behind its depth
+                    UINT rectMask = GetRectMask(
+                        tileX == tileX0 ? pixelX0 % s_TileWidth : 0, tileX == tileX1 ? pixelX1 % s_TileWidth : s_TileWidth - 1,
+                        tileY == tileY0 ? pixelY0 % s_TileHeight : 0, tileY == tileY1 ? pixelY1 % s_TileHeight : s_TileHeight - 1);
+
+                    if ((rectMask & ~m_TileMasks[tile]) != 0 || !(minDepth > m_LayerDepths[tile]))
+                        return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+float OcclusionCulling::GetDepth(UINT x, UINT y) const
+{
+    UINT tile = (y / s_TileHeight) * m_TilesX + x / s_TileWidth;
+    UINT bit = (y % s_TileHeight) * s_TileWidth + x % s_TileWidth;
+
+    if (m_TileMasks[tile] & (1u << bit))
+        return (std::min)(m_TileDepths[tile], m_LayerDepths[tile]);
+
+    return m_TileDepths[tile];
+}
+
+const OcclusionStats& OcclusionCulling::GetStats() const
+{
+    return m_Stats;
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <windows.h>
+#include <DirectXMath.h>
+#include <vector>
+
+class ThreadPool;
+
+struct OcclusionQuery final
+{
+    DirectX::XMFLOAT3 m_BoundsMin{ }; // World space box
+    DirectX::XMFLOAT3 m_BoundsMax{ };
+    UINT m_Triangles{ 0 };            // Counted as rejected if the box is occluded
+    bool m_IsOccluded{ false };
+};
+
+struct OcclusionStats final
+{
+    UINT m_OccluderTriangles{ 0 }; // Rasterized after near plane clipping
+    UINT m_Tested{ 0 };
+    UINT m_Occluded{ 0 };
+    UINT m_OccludedTriangles{ 0 };
+    double m_Time{ 0.0 };          // Seconds, occluder setup, rasterization and tests
+};
+
+// Occluder triangles rasterized into a low resolution depth buffer split into 8x4 pixel tiles. A tile does not
+// keep per pixel depths, only a 32-bit coverage mask and two conservative depths as in masked occlusion culling:
+// the farthest depth over the whole tile and the farthest depth of the pixels in the mask. Triangles are merged
+// into them as they arrive, so coverage is computed with SSE edge functions for eight pixels per instruction
+// pair and the buffer never needs resolving. Tile rows are independent and rasterized in parallel.
+//
+// Depths are post-projection z, larger is farther. A box is occluded if its nearest depth lies behind the
+// occluders at every pixel of its screen rectangle. Blocks of 4x4 tiles keep the farthest tile depth, so most
+// boxes are rejected or accepted before looking at single tiles. Occluders are sampled at pixel centers like
+// the GPU samples them, so gaps between occluders thinner than a low resolution pixel can hide boxes behind.
+class OcclusionCulling final
+{
+public:
+    static constexpr UINT s_TileWidth = 8;
+    static constexpr UINT s_TileHeight = 4;
+    static constexpr UINT s_BlockSize = 4; // Tiles per hierarchical depth block side
+
+    // Resolution is rounded up to whole tiles, the aspect ratio should match the camera
+    OcclusionCulling(ThreadPool& threadPool, UINT width = 256, UINT height = 192);
+
+    UINT GetWidth() const;
+    UINT GetHeight() const;
+
+    // Clears the buffer, occluders added until Rasterize() are projected with this matrix
+    void Begin(const DirectX::XMMATRIX& viewProjection);
+    void AddOccluder(const std::vector<DirectX::XMFLOAT3>& positions, const std::vector<UINT>& indices, const DirectX::XMMATRIX& world);
+    void Rasterize();
+
+    // Sets m_IsOccluded of every query, boxes crossing the near plane are never occluded
+    void Test(std::vector<OcclusionQuery>& queries);
+
+    // Farthest occluder depth of a pixel, 1 where nothing was rasterized
+    float GetDepth(UINT x, UINT y) const;
+
+    const OcclusionStats& GetStats() const; // Since the last Begin()
+
+private:
+    struct Triangle
+    {
+        float m_EdgeA[3]; // Edge functions a * x + b * y + c at pixel centers, positive inside
+        float m_EdgeB[3];
+        float m_EdgeC[3];
+
+        float m_Depth[3]; // Plane z = depth[0] + depth[1] * x + depth[2] * y
+        float m_MaxDepth;
+
+        float m_MinX, m_MinY, m_MaxX, m_MaxY; // Pixel bounds
+    };
+
+    void AddTriangle(const DirectX::XMVECTOR& v0, const DirectX::XMVECTOR& v1, const DirectX::XMVECTOR& v2);
+    void RasterizeRow(UINT row);
+    bool IsOccluded(const OcclusionQuery& query) const;
+
+    ThreadPool& m_ThreadPool;
+    OcclusionStats m_Stats;
+
+    UINT m_TilesX{ 0 };
+    UINT m_TilesY{ 0 };
+    UINT m_BlocksX{ 0 };
+    UINT m_BlocksY{ 0 };
+
+    DirectX::XMFLOAT4X4 m_ViewProjection{ };
+
+    std::vector<UINT> m_TileMasks;    // Pixels covered by the working layer
+    std::vector<float> m_TileDepths;  // Farthest depth of the whole tile
+    std::vector<float> m_LayerDepths; // Farthest depth of the working layer
+    std::vector<float> m_BlockDepths; // Farthest tile depth of every block
+
+    std::vector<DirectX::XMFLOAT4> m_Vertices; // Clip space positions of the occluder being added
+    std::vector<Triangle> m_Triangles;
+    std::vector<std::vector<UINT>> m_RowTriangles; // Indices into m_Triangles in submission order
+};
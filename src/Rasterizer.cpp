@@ -0,0 +1,677 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Rasterizer.h"
+#include "ThreadPool.h"
+#include "Mesh.h"
+#include "GeometryPacking.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cassert>
+
+namespace
+{
+    float EvaluatePlane(const float plane[3], float x, float y)
+    {
+        return plane[0] * x + plane[1] * y + plane[2];
+    }
+
+    // Draw owning an item (vertex or triangle) given prefix sums of per draw item counts
+    UINT FindDraw(const std::vector<UINT64>& prefix, UINT64 item)
+    {
+        return static_cast<UINT>(std::upper_bound(prefix.begin(), prefix.end(), item) - prefix.begin()) - 1;
+    }
+
+    // Bilinear filtering of the top mip level, addresses outside of [0, 1] read green border like diffuseSampler
+    DirectX::XMVECTOR SampleTexture(const RasterTexture& texture, float u, float v)
+    {
+        // Unbound shader resources read as zero
+        if (texture.m_Texels == nullptr)
+            return DirectX::XMVectorZero();
+
+        const DirectX::XMVECTOR border = DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 1.0f);
+
+        int width = static_cast<int>(texture.m_Width);
+        int height = static_cast<int>(texture.m_Height);
+
+        // Keep coordinates in integer range, anything past a texel outside of the texture is border anyway
+        float x = std::fmin(std::fmax(u, -1.0f), 2.0f) * width - 0.5f;
+        float y = std::fmin(std::fmax(v, -1.0f), 2.0f) * height - 0.5f;
+
+        float left = std::floor(x);
+        float top = std::floor(y);
+
+        auto fetch = [&texture, &border, width, height](int texelX, int texelY)
+        {
+            if (texelX < 0 || texelY < 0 || texelX >= width || texelY >= height)
+                return border;
+
+            const BYTE* texel = texture.m_Texels + (static_cast<size_t>(texelY) * width + texelX) * 4;
+
+            DirectX::XMVECTOR color = DirectX::XMVectorSet(texel[0], texel[1], texel[2], texel[3]);
+            return DirectX::XMVectorScale(color, 1.0f / 255.0f);
+        };
+
+        int texelX = static_cast<int>(left);
+        int texelY = static_cast<int>(top);
+
+        DirectX::XMVECTOR upper = DirectX::XMVectorLerp(fetch(texelX, texelY), fetch(texelX + 1, texelY), x - left);
+        DirectX::XMVECTOR lower = DirectX::XMVectorLerp(fetch(texelX, texelY + 1), fetch(texelX + 1, texelY + 1), x - left);
+
+        return DirectX::XMVectorLerp(upper, lower, y - top);
+    }
+}
+
+Rasterizer::Rasterizer(ThreadPool& threadPool)
+    : m_ThreadPool(threadPool)
+{ }
+
+const RasterizerStats& Rasterizer::GetStats() const
+{
+    return m_Stats;
+}
+
+void Rasterizer::Draw(const RasterTargets& targets, const std::vector<RasterDraw>& draws)
+{
+    if (draws.empty())
+        return;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    m_TilesX = (targets.m_Width + s_TileSize - 1) / s_TileSize;
+    m_TilesY = (targets.m_Height + s_TileSize - 1) / s_TileSize;
+
+    m_DrawVertices.assign(1, 0);
+    m_DrawTriangles.assign(1, 0);
+
+    for (const RasterDraw& draw : draws)
+    {
+        m_DrawVertices.push_back(m_DrawVertices.back() + draw.m_VertexCount);
+        m_DrawTriangles.push_back(m_DrawTriangles.back() + draw.m_IndexCount / 3);
+    }
+
+    UINT64 vertices = m_DrawVertices.back();
+    UINT64 triangles = m_DrawTriangles.back();
+
+    // Vertex stage
+    {
+        m_Vertices.resize(static_cast<size_t>(vertices));
+
+        size_t chunks = static_cast<size_t>((vertices + s_ChunkVertices - 1) / s_ChunkVertices);
+        m_ThreadPool.ParallelFor(chunks, [this, &draws, vertices](size_t chunk)
+        {
+            UINT64 last = (std::min)(static_cast<UINT64>(chunk + 1) * s_ChunkVertices, vertices);
+
+            // Chunks may span several draws
+            for (UINT64 vertex = static_cast<UINT64>(chunk) * s_ChunkVertices; vertex < last; )
+            {
+                UINT draw = FindDraw(m_DrawVertices, vertex);
+                UINT64 drawLast = (std::min)(m_DrawVertices[draw + 1], last);
+
+                UINT first = static_cast<UINT>(vertex - m_DrawVertices[draw]);
+                TransformVertices(draws[draw], first, static_cast<UINT>(drawLast - vertex), &m_Vertices[static_cast<size_t>(vertex)]);
+
+                vertex = drawLast;
+            }
+        });
+    }
+
+    // Triangle setup and binning
+    {
+        m_Chunks.resize(static_cast<size_t>((triangles + s_ChunkTriangles - 1) / s_ChunkTriangles));
+
+        m_ThreadPool.ParallelFor(m_Chunks.size(), [this, &targets, &draws, triangles](size_t chunk)
+        {
+            UINT64 first = static_cast<UINT64>(chunk) * s_ChunkTriangles;
+            UINT64 count = (std::min)(first + s_ChunkTriangles, triangles) - first;
+
+            SetupTriangles(targets, draws, first, count, m_Chunks[chunk]);
+        });
+    }
+
+    // Pixel stage
+    {
+        UINT blocksX = (targets.m_Width + s_BlockSize - 1) / s_BlockSize;
+        UINT blocksY = (targets.m_Height + s_BlockSize - 1) / s_BlockSize;
+        m_BlockDepth.resize(static_cast<size_t>(blocksX) * blocksY);
+
+        std::atomic<UINT64> rejectedBlocks{ 0 };
+        std::atomic<UINT64> shadedPixels{ 0 };
+
+        m_ThreadPool.ParallelFor(static_cast<size_t>(m_TilesX) * m_TilesY, [&](size_t tile)
+        {
+            UINT64 tileRejectedBlocks = 0;
+            UINT64 tileShadedPixels = 0;
+
+            RasterizeTile(targets, draws, static_cast<UINT>(tile), tileRejectedBlocks, tileShadedPixels);
+
+            rejectedBlocks += tileRejectedBlocks;
+            shadedPixels += tileShadedPixels;
+        });
+
+        m_Stats.m_RejectedBlocks += rejectedBlocks;
+        m_Stats.m_ShadedPixels += shadedPixels;
+    }
+
+    m_Stats.m_Triangles += triangles;
+
+    for (const Chunk& chunk : m_Chunks)
+    {
+        m_Stats.m_CulledTriangles += chunk.m_Culled;
+        m_Stats.m_BinnedTriangles += chunk.m_Binned;
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    m_Stats.m_Time += elapsed.count();
+}
+
+void Rasterizer::TransformVertices(const RasterDraw& draw, UINT first, UINT count, ShadedVertex* output) const
+{
+    const GeometryTransform& transform = draw.m_Transform;
+    DirectX::XMMATRIX worldViewProjection = DirectX::XMMatrixMultiply(transform.m_WorldVertices, transform.m_ViewProjection);
+
+    for (UINT index = 0; index < count; index++)
+    {
+        // Compact formats arrive as the input assembler would pass them, the instance world dequantizes positions
+        const BYTE* vertexData = draw.m_Vertices + static_cast<size_t>(first + index) * draw.m_VertexStride;
+        Vertex vertex = draw.m_VertexFormat == VertexFormat::Full ? *reinterpret_cast<const Vertex*>(vertexData) : VertexEncoding::Decode(draw.m_VertexFormat, vertexData);
+        ShadedVertex& shadedVertex = output[index];
+
+        // Normal W is 1 like in Geometry.fx
+        DirectX::XMVECTOR vertexPosition = DirectX::XMVectorSet(vertex.Position.x, vertex.Position.y, vertex.Position.z, 1.0f);
+        DirectX::XMVECTOR vertexNormal = DirectX::XMVectorSet(vertex.Normal.x, vertex.Normal.y, vertex.Normal.z, 1.0f);
+
+        DirectX::XMFLOAT3 pixelNormal;
+
+        DirectX::XMStoreFloat4(&shadedVertex.m_Position, DirectX::XMVector4Transform(vertexPosition, worldViewProjection));
+        DirectX::XMStoreFloat3(&pixelNormal, DirectX::XMVector4Transform(vertexNormal, transform.m_WorldNormals));
+
+        float* attributes = shadedVertex.m_Attributes;
+        attributes[0] = pixelNormal.x;
+        attributes[1] = pixelNormal.y;
+        attributes[2] = pixelNormal.z;
+        attributes[3] = vertex.TexCoord.x;
+        attributes[4] = vertex.TexCoord.y;
+    }
+}
+
+void Rasterizer::SetupTriangles(const RasterTargets& targets, const std::vector<RasterDraw>& draws, UINT64 first, UINT64 count, Chunk& chunk) const
+{
+    chunk.m_Triangles.clear();
+    chunk.m_Bins.resize(static_cast<size_t>(m_TilesX) * m_TilesY);
+    chunk.m_Culled = 0;
+    chunk.m_Binned = 0;
+
+    for (std::vector<UINT>& bin : chunk.m_Bins)
+        bin.clear();
+
+    auto emit = [this, &targets, &draws, &chunk](UINT draw, const ShadedVertex* vertices[3])
+    {
+        Triangle triangle;
+        if (!SetupTriangle(targets, draws[draw], vertices, triangle))
+            return false;
+
+        triangle.m_Draw = draw;
+
+        UINT index = static_cast<UINT>(chunk.m_Triangles.size());
+        chunk.m_Triangles.push_back(triangle);
+
+        for (UINT tileY = triangle.m_MinY / s_TileSize; tileY <= triangle.m_MaxY / s_TileSize; tileY++)
+        {
+            for (UINT tileX = triangle.m_MinX / s_TileSize; tileX <= triangle.m_MaxX / s_TileSize; tileX++)
+            {
+                chunk.m_Bins[tileY * m_TilesX + tileX].push_back(index);
+                chunk.m_Binned++;
+            }
+        }
+
+        return true;
+    };
+
+    // Sutherland-Hodgman against a single clip plane, vertices with non-negative distance are kept
+    auto clip = [](const ShadedVertex* input, UINT inputCount, ShadedVertex* output, auto distance)
+    {
+        UINT outputCount = 0;
+
+        for (UINT index = 0; index < inputCount; index++)
+        {
+            const ShadedVertex& current = input[index];
+            const ShadedVertex& next = input[(index + 1) % inputCount];
+
+            float currentDistance = distance(current);
+            float nextDistance = distance(next);
+
+            if (currentDistance >= 0.0f)
+                output[outputCount++] = current;
+
+            if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+            {
+                float t = currentDistance / (currentDistance - nextDistance);
+                ShadedVertex& vertex = output[outputCount++];
+
+                DirectX::XMVECTOR currentPosition = DirectX::XMLoadFloat4(&current.m_Position);
+                DirectX::XMVECTOR nextPosition = DirectX::XMLoadFloat4(&next.m_Position);
+                DirectX::XMStoreFloat4(&vertex.m_Position, DirectX::XMVectorLerp(currentPosition, nextPosition, t));
+
+                for (UINT attribute = 0; attribute < s_Attributes; attribute++)
+                    vertex.m_Attributes[attribute] = current.m_Attributes[attribute] + (next.m_Attributes[attribute] - current.m_Attributes[attribute]) * t;
+            }
+        }
+
+        return outputCount;
+    };
+
+    auto nearDistance = [](const ShadedVertex& vertex) { return vertex.m_Position.z; };
+    auto farDistance = [](const ShadedVertex& vertex) { return vertex.m_Position.w - vertex.m_Position.z; };
+
+    UINT draw = FindDraw(m_DrawTriangles, first);
+
+    for (UINT64 triangle = first; triangle < first + count; triangle++)
+    {
+        while (triangle >= m_DrawTriangles[draw + 1])
+            draw++;
+
+        const RasterDraw& rasterDraw = draws[draw];
+        const ShadedVertex* drawVertices = m_Vertices.data() + m_DrawVertices[draw];
+        const BYTE* indices = rasterDraw.m_Indices + (triangle - m_DrawTriangles[draw]) * 3 * rasterDraw.m_IndexStride;
+
+        const ShadedVertex* vertices[3];
+        bool inside = true;
+
+        for (UINT corner = 0; corner < 3; corner++)
+        {
+            UINT vertex = rasterDraw.m_IndexStride == sizeof(USHORT) ? reinterpret_cast<const USHORT*>(indices)[corner] : reinterpret_cast<const UINT*>(indices)[corner];
+            INT index = static_cast<INT>(vertex) + rasterDraw.m_BaseVertex;
+            assert(index >= 0 && static_cast<UINT>(index) < rasterDraw.m_VertexCount);
+
+            vertices[corner] = drawVertices + index;
+            inside = inside && nearDistance(*vertices[corner]) >= 0.0f && farDistance(*vertices[corner]) >= 0.0f;
+        }
+
+        if (inside)
+        {
+            if (!emit(draw, vertices))
+                chunk.m_Culled++;
+
+            continue;
+        }
+
+        // Depth clipping (0 <= z <= w), every plane adds at most one vertex
+        ShadedVertex polygon[5];
+        ShadedVertex clipped[5];
+
+        for (UINT corner = 0; corner < 3; corner++)
+            polygon[corner] = *vertices[corner];
+
+        UINT polygonCount = clip(polygon, 3, clipped, nearDistance);
+        polygonCount = clip(clipped, polygonCount, polygon, farDistance);
+
+        bool emitted = false;
+
+        for (UINT corner = 1; corner + 1 < polygonCount; corner++)
+        {
+            const ShadedVertex* fan[3] = { &polygon[0], &polygon[corner], &polygon[corner + 1] };
+            emitted = emit(draw, fan) || emitted;
+        }
+
+        if (!emitted)
+            chunk.m_Culled++;
+    }
+}
+
+bool Rasterizer::SetupTriangle(const RasterTargets& targets, const RasterDraw& draw, const ShadedVertex* vertices[3], Triangle& triangle) const
+{
+    const D3D11_VIEWPORT& viewport = targets.m_Viewport;
+
+    float x[3];
+    float y[3];
+    float z[3];
+    float inverseW[3];
+
+    for (UINT corner = 0; corner < 3; corner++)
+    {
+        const DirectX::XMFLOAT4& position = vertices[corner]->m_Position;
+        inverseW[corner] = 1.0f / position.w;
+
+        float screenX = (position.x * inverseW[corner] * 0.5f + 0.5f) * viewport.Width + viewport.TopLeftX;
+        float screenY = (0.5f - position.y * inverseW[corner] * 0.5f) * viewport.Height + viewport.TopLeftY;
+
+        // Snap to 8 bits of subpixel precision like GPU rasterizers do
+        x[corner] = std::floor(screenX * 256.0f + 0.5f) / 256.0f;
+        y[corner] = std::floor(screenY * 256.0f + 0.5f) / 256.0f;
+        z[corner] = viewport.MinDepth + position.z * inverseW[corner] * (viewport.MaxDepth - viewport.MinDepth);
+    }
+
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (area == 0.0f)
+        return false;
+
+    // Clockwise triangles are front facing (FrontCounterClockwise is FALSE), their area is positive with Y pointing down
+    if ((draw.m_CullMode == D3D11_CULL_BACK && area < 0.0f) || (draw.m_CullMode == D3D11_CULL_FRONT && area > 0.0f))
+        return false;
+
+    // Edge functions below expect clockwise winding
+    if (area < 0.0f)
+    {
+        std::swap(vertices[1], vertices[2]);
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        std::swap(z[1], z[2]);
+        std::swap(inverseW[1], inverseW[2]);
+        area = -area;
+    }
+
+    // Pixel centers within bounds of both the triangle and viewport
+    {
+        float viewLeft = (std::max)(viewport.TopLeftX, 0.0f);
+        float viewTop = (std::max)(viewport.TopLeftY, 0.0f);
+        float viewRight = (std::min)(viewport.TopLeftX + viewport.Width, static_cast<float>(targets.m_Width)) - 1.0f;
+        float viewBottom = (std::min)(viewport.TopLeftY + viewport.Height, static_cast<float>(targets.m_Height)) - 1.0f;
+
+        float left = std::ceil((std::min)({ x[0], x[1], x[2] }) - 0.5f);
+        float top = std::ceil((std::min)({ y[0], y[1], y[2] }) - 0.5f);
+        float right = std::floor((std::max)({ x[0], x[1], x[2] }) - 0.5f);
+        float bottom = std::floor((std::max)({ y[0], y[1], y[2] }) - 0.5f);
+
+        left = (std::max)(left, viewLeft);
+        top = (std::max)(top, viewTop);
+        right = (std::min)(right, viewRight);
+        bottom = (std::min)(bottom, viewBottom);
+
+        if (left > right || top > bottom)
+            return false;
+
+        triangle.m_MinX = static_cast<int>(left);
+        triangle.m_MinY = static_cast<int>(top);
+        triangle.m_MaxX = static_cast<int>(right);
+        triangle.m_MaxY = static_cast<int>(bottom);
+    }
+
+    // Edge k is opposite to vertex k, its function divided by area is the barycentric weight of that vertex
+    for (UINT edge = 0; edge < 3; edge++)
+    {
+        UINT from = (edge + 1) % 3;
+        UINT to = (edge + 2) % 3;
+
+        float a = y[from] - y[to];
+        float b = x[to] - x[from];
+
+        triangle.m_EdgeA[edge] = a;
+        triangle.m_EdgeB[edge] = b;
+        triangle.m_EdgeC[edge] = -(a * x[from] + b * y[from]) + 0.5f * (a + b); // Evaluated at pixel centers
+        triangle.m_TopLeft[edge] = a > 0.0f || (a == 0.0f && b > 0.0f);
+    }
+
+    float inverseArea = 1.0f / area;
+
+    auto setupPlane = [&triangle, inverseArea](float plane[3], float value0, float value1, float value2)
+    {
+        plane[0] = (triangle.m_EdgeA[0] * value0 + triangle.m_EdgeA[1] * value1 + triangle.m_EdgeA[2] * value2) * inverseArea;
+        plane[1] = (triangle.m_EdgeB[0] * value0 + triangle.m_EdgeB[1] * value1 + triangle.m_EdgeB[2] * value2) * inverseArea;
+        plane[2] = (triangle.m_EdgeC[0] * value0 + triangle.m_EdgeC[1] * value1 + triangle.m_EdgeC[2] * value2) * inverseArea;
+    };
+
+    setupPlane(triangle.m_Depth, z[0], z[1], z[2]);
+    setupPlane(triangle.m_InverseW, inverseW[0], inverseW[1], inverseW[2]);
+
+    for (UINT attribute = 0; attribute < s_Attributes; attribute++)
+    {
+        setupPlane(triangle.m_Attributes[attribute],
+            vertices[0]->m_Attributes[attribute] * inverseW[0],
+            vertices[1]->m_Attributes[attribute] * inverseW[1],
+            vertices[2]->m_Attributes[attribute] * inverseW[2]);
+    }
+
+    triangle.m_MinDepth = (std::min)({ z[0], z[1], z[2] });
+
+    return true;
+}
+
+void Rasterizer::RasterizeTile(const RasterTargets& targets, const std::vector<RasterDraw>& draws, UINT tile, UINT64& rejectedBlocks, UINT64& shadedPixels)
+{
+    int width = static_cast<int>(targets.m_Width);
+    int height = static_cast<int>(targets.m_Height);
+    int blocksX = (width + s_BlockSize - 1) / s_BlockSize;
+
+    int tileLeft = static_cast<int>(tile % m_TilesX * s_TileSize);
+    int tileTop = static_cast<int>(tile / m_TilesX * s_TileSize);
+    int tileRight = (std::min)(tileLeft + static_cast<int>(s_TileSize), width) - 1;
+    int tileBottom = (std::min)(tileTop + static_cast<int>(s_TileSize), height) - 1;
+
+    // Farthest depth per block, depth buffer might have been cleared since the last draw
+    auto updateBlockDepth = [&targets, width, blocksX, tileRight, tileBottom, this](int blockX, int blockY)
+    {
+        float farthest = 0.0f;
+
+        for (int y = blockY * s_BlockSize; y <= (std::min)(blockY * static_cast<int>(s_BlockSize) + 7, tileBottom); y++)
+        {
+            const float* depth = targets.m_Depth + static_cast<size_t>(y) * width;
+
+            for (int x = blockX * s_BlockSize; x <= (std::min)(blockX * static_cast<int>(s_BlockSize) + 7, tileRight); x++)
+                farthest = (std::max)(farthest, depth[x]);
+        }
+
+        m_BlockDepth[static_cast<size_t>(blockY) * blocksX + blockX] = farthest;
+    };
+
+    for (int blockY = tileTop / s_BlockSize; blockY <= tileBottom / static_cast<int>(s_BlockSize); blockY++)
+    {
+        for (int blockX = tileLeft / s_BlockSize; blockX <= tileRight / static_cast<int>(s_BlockSize); blockX++)
+            updateBlockDepth(blockX, blockY);
+    }
+
+    const DirectX::XMVECTOR laneOffsets = DirectX::XMVectorSet(0.0f, 1.0f, 2.0f, 3.0f);
+    const DirectX::XMVECTOR zero = DirectX::XMVectorZero();
+
+    for (const Chunk& chunk : m_Chunks)
+    {
+        for (UINT index : chunk.m_Bins[tile])
+        {
+            const Triangle& triangle = chunk.m_Triangles[index];
+            const RasterDraw& draw = draws[triangle.m_Draw];
+
+            int left = (std::max)(triangle.m_MinX, tileLeft);
+            int top = (std::max)(triangle.m_MinY, tileTop);
+            int right = (std::min)(triangle.m_MaxX, tileRight);
+            int bottom = (std::min)(triangle.m_MaxY, tileBottom);
+
+            DirectX::XMVECTOR edgeA[3];
+            DirectX::XMVECTOR edgeB[3];
+            DirectX::XMVECTOR edgeC[3];
+
+            for (UINT edge = 0; edge < 3; edge++)
+            {
+                edgeA[edge] = DirectX::XMVectorReplicate(triangle.m_EdgeA[edge]);
+                edgeB[edge] = DirectX::XMVectorReplicate(triangle.m_EdgeB[edge]);
+                edgeC[edge] = DirectX::XMVectorReplicate(triangle.m_EdgeC[edge]);
+            }
+
+            DirectX::XMVECTOR depthA = DirectX::XMVectorReplicate(triangle.m_Depth[0]);
+            DirectX::XMVECTOR depthB = DirectX::XMVectorReplicate(triangle.m_Depth[1]);
+            DirectX::XMVECTOR depthC = DirectX::XMVectorReplicate(triangle.m_Depth[2]);
+
+            for (int blockY = top / s_BlockSize; blockY <= bottom / static_cast<int>(s_BlockSize); blockY++)
+            {
+                for (int blockX = left / s_BlockSize; blockX <= right / static_cast<int>(s_BlockSize); blockX++)
+                {
+                    float blockLeft = static_cast<float>(blockX * s_BlockSize);
+                    float blockTop = static_cast<float>(blockY * s_BlockSize);
+                    float blockRight = blockLeft + static_cast<float>(s_BlockSize - 1);
+                    float blockBottom = blockTop + static_cast<float>(s_BlockSize - 1);
+
+                    // Coarse test: edge functions are linear, so block corners bound them
+                    bool outside = false;
+                    bool covered = true;
+
+                    for (UINT edge = 0; edge < 3; edge++)
+                    {
+                        float a = triangle.m_EdgeA[edge];
+                        float b = triangle.m_EdgeB[edge];
+                        float c = triangle.m_EdgeC[edge];
+
+                        float largest = a * (a > 0.0f ? blockRight : blockLeft) + b * (b > 0.0f ? blockBottom : blockTop) + c;
+                        float smallest = a * (a > 0.0f ? blockLeft : blockRight) + b * (b > 0.0f ? blockTop : blockBottom) + c;
+
+                        outside = outside || largest < 0.0f;
+                        covered = covered && smallest > 0.0f;
+                    }
+
+                    if (outside)
+                        continue;
+
+                    // Hierarchical depth test: nothing passes LESS if the nearest point is behind the farthest stored depth
+                    float& blockDepth = m_BlockDepth[static_cast<size_t>(blockY) * blocksX + blockX];
+                    {
+                        float a = triangle.m_Depth[0];
+                        float b = triangle.m_Depth[1];
+                        float c = triangle.m_Depth[2];
+
+                        float nearest = a * (a > 0.0f ? blockLeft : blockRight) + b * (b > 0.0f ? blockTop : blockBottom) + c;
+                        if ((std::max)(nearest, triangle.m_MinDepth) >= blockDepth)
+                        {
+                            rejectedBlocks++;
+                            continue;
+                        }
+                    }
+
+                    int columnLeft = (std::max)(static_cast<int>(blockLeft), left);
+                    int columnRight = (std::min)(static_cast<int>(blockRight), right);
+                    int rowTop = (std::max)(static_cast<int>(blockTop), top);
+                    int rowBottom = (std::min)(static_cast<int>(blockBottom), bottom);
+
+                    DirectX::XMVECTOR laneLeft = DirectX::XMVectorReplicate(static_cast<float>(columnLeft));
+                    DirectX::XMVECTOR laneRight = DirectX::XMVectorReplicate(static_cast<float>(columnRight));
+
+                    bool written = false;
+
+                    for (int y = rowTop; y <= rowBottom; y++)
+                    {
+                        DirectX::XMVECTOR rowY = DirectX::XMVectorReplicate(static_cast<float>(y));
+                        float* depthRow = targets.m_Depth + static_cast<size_t>(y) * width;
+
+                        // Four pixels at a time
+                        for (int x = static_cast<int>(blockLeft); x <= columnRight; x += 4)
+                        {
+                            if (x + 3 < columnLeft)
+                                continue;
+
+                            DirectX::XMVECTOR laneX = DirectX::XMVectorAdd(DirectX::XMVectorReplicate(static_cast<float>(x)), laneOffsets);
+                            DirectX::XMVECTOR mask = DirectX::XMVectorAndInt(DirectX::XMVectorGreaterOrEqual(laneX, laneLeft), DirectX::XMVectorLessOrEqual(laneX, laneRight));
+
+                            if (!covered)
+                            {
+                                for (UINT edge = 0; edge < 3; edge++)
+                                {
+                                    DirectX::XMVECTOR value = DirectX::XMVectorMultiplyAdd(edgeA[edge], laneX, DirectX::XMVectorMultiplyAdd(edgeB[edge], rowY, edgeC[edge]));
+
+                                    // Top-left fill rule: pixel centers exactly on an edge belong to top and left edges only
+                                    DirectX::XMVECTOR inside = triangle.m_TopLeft[edge] ? DirectX::XMVectorGreaterOrEqual(value, zero) : DirectX::XMVectorGreater(value, zero);
+                                    mask = DirectX::XMVectorAndInt(mask, inside);
+                                }
+                            }
+
+                            if (DirectX::XMVector4EqualInt(mask, DirectX::XMVectorFalseInt()))
+                                continue;
+
+                            // Depth test (LESS), lanes past the row end are masked out and never touched
+                            float storedDepth[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+                            int lanes = (std::min)(4, width - x);
+
+                            std::copy(depthRow + x, depthRow + x + lanes, storedDepth);
+
+                            DirectX::XMVECTOR stored = DirectX::XMLoadFloat4(reinterpret_cast<const DirectX::XMFLOAT4*>(storedDepth));
+                            DirectX::XMVECTOR depth = DirectX::XMVectorMultiplyAdd(depthA, laneX, DirectX::XMVectorMultiplyAdd(depthB, rowY, depthC));
+
+                            mask = DirectX::XMVectorAndInt(mask, DirectX::XMVectorLess(depth, stored));
+                            if (DirectX::XMVector4EqualInt(mask, DirectX::XMVectorFalseInt()))
+                                continue;
+
+                            DirectX::XMStoreFloat4(reinterpret_cast<DirectX::XMFLOAT4*>(storedDepth), DirectX::XMVectorSelect(stored, depth, mask));
+                            std::copy(storedDepth, storedDepth + lanes, depthRow + x);
+
+                            uint32_t laneMask[4];
+                            DirectX::XMStoreInt4(laneMask, mask);
+
+                            for (int lane = 0; lane < lanes; lane++)
+                            {
+                                if (laneMask[lane] == 0)
+                                    continue;
+
+                                ShadePixel(targets, draw, triangle, x + lane, y);
+                                shadedPixels++;
+                            }
+
+                            written = true;
+                        }
+                    }
+
+                    if (written)
+                        updateBlockDepth(blockX, blockY);
+                }
+            }
+        }
+    }
+}
+
+void Rasterizer::ShadePixel(const RasterTargets& targets, const RasterDraw& draw, const Triangle& triangle, int x, int y) const
+{
+    float pixelX = static_cast<float>(x);
+    float pixelY = static_cast<float>(y);
+
+    // Perspective correct interpolation
+    float w = 1.0f / EvaluatePlane(triangle.m_InverseW, pixelX, pixelY);
+
+    float attributes[s_Attributes];
+    for (UINT attribute = 0; attribute < s_Attributes; attribute++)
+        attributes[attribute] = EvaluatePlane(triangle.m_Attributes[attribute], pixelX, pixelY) * w;
+
+    DirectX::XMFLOAT4 diffuseColor;
+    DirectX::XMStoreFloat4(&diffuseColor, SampleTexture(draw.m_Texture, attributes[3], attributes[4]));
+
+    const GeometryMaterial& material = draw.m_Material;
+    size_t texel = static_cast<size_t>(y) * targets.m_Width + x;
+
+    DirectX::XMFLOAT4 outputs[] =
+    {
+        { diffuseColor.x, diffuseColor.y, diffuseColor.z, material.m_AmbientIntensity },
+        { diffuseColor.x * material.m_SpecularIntensity, diffuseColor.y * material.m_SpecularIntensity, diffuseColor.z * material.m_SpecularIntensity, material.m_DiffuseIntensity },
+        { attributes[0], attributes[1], attributes[2], static_cast<float>(material.m_SpecularHardness) }
+    };
+
+    for (UINT target = 0; target < 3; target++)
+    {
+        if (targets.m_Colors[target] != nullptr)
+            targets.m_Colors[target][texel] = outputs[target];
+    }
+
+    if (targets.m_PackedColors[0] != nullptr)
+        targets.m_PackedColors[0][texel] = GeometryPacking::EncodeAlbedo({ diffuseColor.x, diffuseColor.y, diffuseColor.z });
+
+    if (targets.m_PackedColors[1] != nullptr)
+        targets.m_PackedColors[1][texel] = GeometryPacking::EncodeNormal({ attributes[0], attributes[1], attributes[2] });
+
+    if (targets.m_PackedColors[2] != nullptr)
+        targets.m_PackedColors[2][texel] = GeometryPacking::EncodeMaterial(material.m_AmbientIntensity, material.m_DiffuseIntensity, material.m_SpecularIntensity, material.m_SpecularHardness);
+}
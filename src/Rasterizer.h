@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "VertexFormat.h"
+#include <d3d11.h>
+#include <DirectXMath.h>
+#include <vector>
+
+class ThreadPool;
+
+// Geometry.fx transforms of one instance: InstanceData rows and VertexTransform buffer (b0)
+struct GeometryTransform final
+{
+    DirectX::XMMATRIX m_WorldVertices;
+    DirectX::XMMATRIX m_WorldNormals;
+    DirectX::XMMATRIX m_ViewProjection;
+};
+
+// CPU mirror of Geometry.fx Material buffer (b0)
+struct GeometryMaterial final
+{
+    float m_AmbientIntensity;
+    float m_DiffuseIntensity;
+    float m_SpecularIntensity;
+    int m_SpecularHardness;
+};
+
+// Top mip level of a diffuse texture, 8 bits per RGBA channel
+struct RasterTexture final
+{
+    const BYTE* m_Texels{ nullptr };
+    UINT m_Width{ 0 };
+    UINT m_Height{ 0 };
+};
+
+struct RasterDraw final
+{
+    GeometryTransform m_Transform;
+    GeometryMaterial m_Material;
+    RasterTexture m_Texture;
+
+    const BYTE* m_Vertices{ nullptr }; // Encoded as m_VertexFormat, m_VertexStride bytes apart
+    UINT m_VertexStride{ 0 };
+    VertexFormat m_VertexFormat{ VertexFormat::Full };
+    UINT m_VertexCount{ 0 };
+
+    const BYTE* m_Indices{ nullptr }; // 16 or 32-bit, m_IndexStride bytes apart
+    UINT m_IndexStride{ sizeof(UINT) };
+    UINT m_IndexCount{ 0 };
+    INT m_BaseVertex{ 0 };
+
+    D3D11_CULL_MODE m_CullMode{ D3D11_CULL_BACK };
+};
+
+// Geometry.fx outputs: diffuse, specular and normal targets plus depth, all tightly packed.
+// Packed layout writes albedo, normal and material texels instead, see GeometryPacking
+struct RasterTargets final
+{
+    DirectX::XMFLOAT4* m_Colors[3]{ };
+    UINT* m_PackedColors[3]{ };
+    float* m_Depth{ nullptr };
+
+    UINT m_Width{ 0 };
+    UINT m_Height{ 0 };
+
+    D3D11_VIEWPORT m_Viewport{ };
+};
+
+struct RasterizerStats final
+{
+    UINT64 m_Triangles{ 0 };       // Submitted by draws
+    UINT64 m_CulledTriangles{ 0 }; // Back facing, degenerate, clipped away or outside of viewport
+    UINT64 m_BinnedTriangles{ 0 }; // Triangle to tile assignments
+    UINT64 m_RejectedBlocks{ 0 };  // Blocks skipped by hierarchical depth test
+    UINT64 m_ShadedPixels{ 0 };    // Pixels passed depth test
+    double m_Time{ 0.0 };          // Seconds spent in Draw()
+};
+
+// Tile binning rasterizer executing Geometry.fx on CPU.
+// Vertices are transformed and triangles set up in parallel chunks, every chunk bins its triangles
+// into screen tiles. Tiles are then rasterized in parallel, each one walking chunk bins in submission
+// order so that the depth test resolves exactly like on GPU.
+class Rasterizer final
+{
+public:
+    Rasterizer(ThreadPool& threadPool);
+
+    const RasterizerStats& GetStats() const;
+
+    void Draw(const RasterTargets& targets, const std::vector<RasterDraw>& draws);
+
+private:
+    static constexpr UINT s_Attributes = 5; // pixelNormal.xyz, texcoord.xy
+
+    static constexpr UINT s_TileSize = 64;
+    static constexpr UINT s_BlockSize = 8;
+    static constexpr UINT s_TileBlocks = s_TileSize / s_BlockSize;
+
+    static constexpr UINT s_ChunkVertices = 1024;
+    static constexpr UINT s_ChunkTriangles = 512;
+
+    struct ShadedVertex final
+    {
+        DirectX::XMFLOAT4 m_Position; // Clip space
+        float m_Attributes[s_Attributes];
+    };
+
+    // Screen space plane equations: value(x, y) = a * x + b * y + c at pixel centers
+    struct Triangle final
+    {
+        float m_EdgeA[3];
+        float m_EdgeB[3];
+        float m_EdgeC[3];
+        bool m_TopLeft[3];
+
+        float m_Depth[3];
+        float m_InverseW[3];
+        float m_Attributes[s_Attributes][3]; // Divided by W, perspective corrected per pixel
+
+        float m_MinDepth;
+        int m_MinX;
+        int m_MinY;
+        int m_MaxX;
+        int m_MaxY;
+
+        UINT m_Draw;
+    };
+
+    struct Chunk final
+    {
+        std::vector<Triangle> m_Triangles;
+        std::vector<std::vector<UINT>> m_Bins;
+        UINT64 m_Culled{ 0 };
+        UINT64 m_Binned{ 0 };
+    };
+
+    void TransformVertices(const RasterDraw& draw, UINT first, UINT count, ShadedVertex* output) const;
+    void SetupTriangles(const RasterTargets& targets, const std::vector<RasterDraw>& draws, UINT64 first, UINT64 count, Chunk& chunk) const;
+    bool SetupTriangle(const RasterTargets& targets, const RasterDraw& draw, const ShadedVertex* vertices[3], Triangle& triangle) const;
+    void RasterizeTile(const RasterTargets& targets, const std::vector<RasterDraw>& draws, UINT tile, UINT64& rejectedBlocks, UINT64& shadedPixels);
+    void ShadePixel(const RasterTargets& targets, const RasterDraw& draw, const Triangle& triangle, int x, int y) const;
+
+    ThreadPool& m_ThreadPool;
+    RasterizerStats m_Stats;
+
+    UINT m_TilesX{ 0 };
+    UINT m_TilesY{ 0 };
+
+    std::vector<UINT64> m_DrawVertices;  // Prefix sums of vertex counts
+    std::vector<UINT64> m_DrawTriangles; // Prefix sums of triangle counts
+    std::vector<ShadedVertex> m_Vertices;
+    std::vector<Chunk> m_Chunks;
+    std::vector<float> m_BlockDepth;     // Farthest depth of every block, rebuilt per Draw()
+};
@@ -29,11 +29,11 @@ RenderTarget::RenderTarget(DX11Device& device)
     : DX11Resource(device)
 { }
 
-GeometryBuffer::GeometryBuffer(DX11Device& device)
+GeometryBuffer::GeometryBuffer(DX11Device& device, GeometryLayout layout)
     : RenderTarget(device)
+    , m_Layout(layout)
 {
-    ID3D11Device& deviceHandle = m_Device.GetHandle();
-    IDXGISwapChain1& swapChain = m_Device.GetSwapChain();
+    Backend& backend = m_Device.GetBackend();
 
     {
         D3D11_RENDER_TARGET_BLEND_DESC targetBlendDesc{ };
@@ -46,7 +46,7 @@ GeometryBuffer::GeometryBuffer(DX11Device& device)
         blendDesc.RenderTarget[2] = targetBlendDesc;
         blendDesc.RenderTarget[3] = targetBlendDesc;
 
-        HRESULT hr = deviceHandle.CreateBlendState(&blendDesc, &m_BlendState);
+        HRESULT hr = backend.CreateBlendState(&blendDesc, &m_BlendState);
         assert(SUCCEEDED(hr));
     }
 
@@ -56,86 +56,95 @@ GeometryBuffer::GeometryBuffer(DX11Device& device)
         rasterizerDesc.CullMode = D3D11_CULL_BACK;
         rasterizerDesc.DepthClipEnable = TRUE;
 
-        HRESULT hr = deviceHandle.CreateRasterizerState(&rasterizerDesc, &m_RasterizerState);
+        HRESULT hr = backend.CreateRasterizerState(&rasterizerDesc, &m_RasterizerState);
         assert(SUCCEEDED(hr));
     }
 
     Microsoft::WRL::ComPtr<ID3D11Texture2D> pFrameTexture;
 
-    HRESULT hr = swapChain.GetBuffer(0, IID_PPV_ARGS(&pFrameTexture));
+    HRESULT hr = backend.GetBackBuffer(&pFrameTexture);
     assert(SUCCEEDED(hr));
 
     D3D11_TEXTURE2D_DESC outputDesc{ };
     pFrameTexture->GetDesc(&outputDesc);
 
-    m_DiffuseTexture.reset(new GeometryTexture(m_Device, 0, outputDesc.Width, outputDesc.Height));
-    m_SpecularTexture.reset(new GeometryTexture(m_Device, 1, outputDesc.Width, outputDesc.Height));
-    m_PositionTexture.reset(new GeometryTexture(m_Device, 2, outputDesc.Width, outputDesc.Height));
-    m_NormalTexture.reset(new GeometryTexture(m_Device, 3, outputDesc.Width, outputDesc.Height));
+    if (m_Layout == GeometryLayout::Packed)
+    {
+        m_Textures.emplace_back(new GeometryTexture(m_Device, 0, outputDesc.Width, outputDesc.Height, GeometryPacking::s_AlbedoFormat));
+        m_Textures.emplace_back(new GeometryTexture(m_Device, 1, outputDesc.Width, outputDesc.Height, GeometryPacking::s_NormalFormat));
+        m_Textures.emplace_back(new GeometryTexture(m_Device, 2, outputDesc.Width, outputDesc.Height, GeometryPacking::s_MaterialFormat));
+    }
+    else
+    {
+        for (UINT slot = 0; slot < 3; slot++)
+            m_Textures.emplace_back(new GeometryTexture(m_Device, slot, outputDesc.Width, outputDesc.Height));
+    }
 
     m_DepthStencilTexture.reset(new DepthStencilTexture(m_Device, 4, outputDesc.Width, outputDesc.Height));
 }
 
 void GeometryBuffer::Enable()
 {
-    ID3D11DeviceContext& deviceContext = m_Device.GetContext();
+    CommandBuffer& commandBuffer = m_Device.GetCommandBuffer();
 
     {
-        ID3D11RenderTargetView* renderViews[] =
-        {
-            &m_DiffuseTexture->GetRenderView(),
-            &m_SpecularTexture->GetRenderView(),
-            &m_PositionTexture->GetRenderView(),
-            &m_NormalTexture->GetRenderView()
-        };
-
-        deviceContext.OMSetRenderTargets(4, renderViews, &m_DepthStencilTexture->GetDepthStencilView()); // Output Merger
-        deviceContext.OMSetBlendState(m_BlendState.Get(), nullptr, 0xffffffff); // Output Merger
-        deviceContext.RSSetState(m_RasterizerState.Get()); // Rasterizer State
+        ID3D11RenderTargetView* renderViews[4]{ };
+        UINT renderViewCount = static_cast<UINT>(m_Textures.size());
+
+        for (UINT view = 0; view < renderViewCount; view++)
+            renderViews[view] = &m_Textures[view]->GetRenderView();
+
+        commandBuffer.SetRenderTargets(renderViewCount, renderViews, &m_DepthStencilTexture->GetDepthStencilView()); // Output Merger
+        commandBuffer.SetBlendState(m_BlendState.Get()); // Output Merger
+        commandBuffer.SetRasterizerState(m_RasterizerState.Get()); // Rasterizer State
 
         FLOAT zero[] = { 0.0f, 0.0f, 0.0f, 0.0f };
-        deviceContext.ClearRenderTargetView(&m_DiffuseTexture->GetRenderView(), zero);
-        deviceContext.ClearRenderTargetView(&m_SpecularTexture->GetRenderView(), zero);
-        deviceContext.ClearRenderTargetView(&m_PositionTexture->GetRenderView(), zero);
-        deviceContext.ClearRenderTargetView(&m_NormalTexture->GetRenderView(), zero);
+        for (UINT view = 0; view < renderViewCount; view++)
+            commandBuffer.ClearRenderTarget(renderViews[view], zero);
 
-        deviceContext.ClearDepthStencilView(&m_DepthStencilTexture->GetDepthStencilView(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+        commandBuffer.ClearDepthStencil(&m_DepthStencilTexture->GetDepthStencilView(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
     }
 }
 
 void GeometryBuffer::Disable()
 {
-    ID3D11DeviceContext& deviceContext = m_Device.GetContext();
+    CommandBuffer& commandBuffer = m_Device.GetCommandBuffer();
 
     {
         // Unbound render targets in case target textures to be used in shaders later
         ID3D11RenderTargetView* renderViews[] = { nullptr, nullptr, nullptr, nullptr };
-        deviceContext.OMSetRenderTargets(4, renderViews, nullptr); // Output Merger
-        deviceContext.OMSetBlendState(nullptr, nullptr, 0xffffffff); // Output Merger
+        commandBuffer.SetRenderTargets(4, renderViews, nullptr); // Output Merger
+        commandBuffer.SetBlendState(nullptr); // Output Merger
 
         // Reset rasterizer state to default just in case
-        deviceContext.RSSetState(nullptr); // Rasterizer State
+        commandBuffer.SetRasterizerState(nullptr); // Rasterizer State
     }
 }
 
-GeometryTexture& GeometryBuffer::GetDiffuseTexture() const
+void GeometryBuffer::EnableTextures()
 {
-    return *m_DiffuseTexture.get();
+    for (auto& texture : m_Textures)
+        texture->Enable();
+
+    m_DepthStencilTexture->Enable();
 }
 
-GeometryTexture& GeometryBuffer::GetSpecularTexture() const
+void GeometryBuffer::DisableTextures()
 {
-    return *m_SpecularTexture.get();
+    for (auto& texture : m_Textures)
+        texture->Disable();
+
+    m_DepthStencilTexture->Disable();
 }
 
-GeometryTexture& GeometryBuffer::GetPositionTexture() const
+GeometryLayout GeometryBuffer::GetLayout() const
 {
-    return *m_PositionTexture.get();
+    return m_Layout;
 }
 
-GeometryTexture& GeometryBuffer::GetNormalTexture() const
+const std::vector<std::unique_ptr<GeometryTexture>>& GeometryBuffer::GetTextures() const
 {
-    return *m_NormalTexture.get();
+    return m_Textures;
 }
 
 DepthStencilTexture& GeometryBuffer::GetDepthStencilTexture() const
@@ -146,8 +155,7 @@ DepthStencilTexture& GeometryBuffer::GetDepthStencilTexture() const
 FrameBuffer::FrameBuffer(DX11Device& device)
     : RenderTarget(device)
 {
-    ID3D11Device& deviceHandle = m_Device.GetHandle();
-    IDXGISwapChain1& swapChain = m_Device.GetSwapChain();
+    Backend& backend = m_Device.GetBackend();
 
     {
         D3D11_RENDER_TARGET_BLEND_DESC targetBlendDesc{ };
@@ -163,7 +171,7 @@ FrameBuffer::FrameBuffer(DX11Device& device)
         D3D11_BLEND_DESC blendDesc{ };
         blendDesc.RenderTarget[0] = targetBlendDesc;
 
-        HRESULT hr = deviceHandle.CreateBlendState(&blendDesc, &m_BlendState);
+        HRESULT hr = backend.CreateBlendState(&blendDesc, &m_BlendState);
         assert(SUCCEEDED(hr));
     }
 
@@ -172,48 +180,67 @@ FrameBuffer::FrameBuffer(DX11Device& device)
         rasterizerDesc.FillMode = D3D11_FILL_SOLID;
         rasterizerDesc.CullMode = D3D11_CULL_BACK;
         rasterizerDesc.DepthClipEnable = FALSE;
+        rasterizerDesc.ScissorEnable = TRUE;
 
-        HRESULT hr = deviceHandle.CreateRasterizerState(&rasterizerDesc, &m_RasterizerState);
+        HRESULT hr = backend.CreateRasterizerState(&rasterizerDesc, &m_RasterizerState);
         assert(SUCCEEDED(hr));
     }
 
     {
         Microsoft::WRL::ComPtr<ID3D11Texture2D> pFrameTexture;
 
-        HRESULT hr = swapChain.GetBuffer(0, IID_PPV_ARGS(&pFrameTexture));
+        HRESULT hr = backend.GetBackBuffer(&pFrameTexture);
         assert(SUCCEEDED(hr));
 
-        hr = deviceHandle.CreateRenderTargetView(pFrameTexture.Get(), nullptr, &m_FrameRenderView);
+        D3D11_TEXTURE2D_DESC outputDesc{ };
+        pFrameTexture->GetDesc(&outputDesc);
+
+        m_Width = outputDesc.Width;
+        m_Height = outputDesc.Height;
+
+        hr = backend.CreateRenderTargetView(pFrameTexture.Get(), nullptr, &m_FrameRenderView);
         assert(SUCCEEDED(hr));
     }
 }
 
 void FrameBuffer::Enable()
 {
-    ID3D11DeviceContext& deviceContext = m_Device.GetContext();
+    CommandBuffer& commandBuffer = m_Device.GetCommandBuffer();
 
     {
         ID3D11RenderTargetView* renderViews[] = { m_FrameRenderView.Get() };
-        deviceContext.OMSetRenderTargets(1, renderViews, nullptr); // Output Merger
-        deviceContext.OMSetBlendState(m_BlendState.Get(), nullptr, 0xffffffff); // Output Merger
-        deviceContext.RSSetState(m_RasterizerState.Get()); // Rasterizer State
+        commandBuffer.SetRenderTargets(1, renderViews, nullptr); // Output Merger
+        commandBuffer.SetBlendState(m_BlendState.Get()); // Output Merger
+        commandBuffer.SetRasterizerState(m_RasterizerState.Get()); // Rasterizer State
 
         FLOAT black[] = { 0.0f, 0.0f, 0.0f, 1.0f };
-        deviceContext.ClearRenderTargetView(m_FrameRenderView.Get(), black);
+        commandBuffer.ClearRenderTarget(m_FrameRenderView.Get(), black);
     }
+
+    SetScissorRect(nullptr);
 }
 
 void FrameBuffer::Disable()
 {
-    ID3D11DeviceContext& deviceContext = m_Device.GetContext();
+    CommandBuffer& commandBuffer = m_Device.GetCommandBuffer();
 
     {
         // Unbound render targets in case target textures to be used in shaders later
         ID3D11RenderTargetView* renderViews[] = { nullptr };
-        deviceContext.OMSetRenderTargets(1, renderViews, nullptr); // Output Merger
-        deviceContext.OMSetBlendState(nullptr, nullptr, 0xffffffff); // Output Merger
+        commandBuffer.SetRenderTargets(1, renderViews, nullptr); // Output Merger
+        commandBuffer.SetBlendState(nullptr); // Output Merger
 
         // Reset rasterizer state to default just in case
-        deviceContext.RSSetState(nullptr); // Rasterizer State
+        commandBuffer.SetRasterizerState(nullptr); // Rasterizer State
+    }
+}
+
+void FrameBuffer::SetScissorRect(const D3D11_RECT* rect)
+{
+    CommandBuffer& commandBuffer = m_Device.GetCommandBuffer();
+
+    {
+        D3D11_RECT frameRect{ 0, 0, static_cast<LONG>(m_Width), static_cast<LONG>(m_Height) };
+        commandBuffer.SetScissorRect(rect != nullptr ? *rect : frameRect); // Rasterizer State
     }
 }
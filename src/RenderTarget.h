@@ -24,9 +24,11 @@
 
 #include "Resource.h"
 #include "Texture.h"
+#include "GeometryPacking.h"
 #include <d3d11.h>
 #include <wrl/client.h>
 #include <memory>
+#include <vector>
 
 class DX11Device;
 
@@ -41,27 +43,30 @@ protected:
     Microsoft::WRL::ComPtr<ID3D11RasterizerState> m_RasterizerState;
 };
 
+// Full layout takes 48 bytes per pixel plus depth, packed layout 12 bytes plus depth
 class GeometryBuffer final : public RenderTarget
 {
 public:
-    GeometryBuffer(DX11Device& device);
+    GeometryBuffer(DX11Device& device, GeometryLayout layout = GeometryLayout::Full);
 
     void Enable() override;
     void Disable() override;
 
-    GeometryTexture& GetDiffuseTexture() const;
-    GeometryTexture& GetSpecularTexture() const;
-    GeometryTexture& GetPositionTexture() const;
-    GeometryTexture& GetNormalTexture() const;
+    // Binds what the light shaders sample: all targets and depth, positions are rebuilt from it
+    void EnableTextures();
+    void DisableTextures();
+
+    GeometryLayout GetLayout() const;
+
+    // Full layout: diffuse, specular and normal. Packed layout: albedo, normal and material
+    const std::vector<std::unique_ptr<GeometryTexture>>& GetTextures() const;
 
     DepthStencilTexture& GetDepthStencilTexture() const;
 
 private:
-    std::unique_ptr<GeometryTexture> m_DiffuseTexture;
-    std::unique_ptr<GeometryTexture> m_SpecularTexture;
-    std::unique_ptr<GeometryTexture> m_PositionTexture;
-    std::unique_ptr<GeometryTexture> m_NormalTexture;
+    GeometryLayout m_Layout{ GeometryLayout::Full };
 
+    std::vector<std::unique_ptr<GeometryTexture>> m_Textures;
     std::unique_ptr<DepthStencilTexture> m_DepthStencilTexture;
 };
 
@@ -73,7 +78,13 @@ public:
     void Enable() override;
     void Disable() override;
 
+    // Limits following draws to the pixel rectangle, nullptr restores the whole frame
+    void SetScissorRect(const D3D11_RECT* rect);
+
 private:
+    UINT m_Width{ 0 };
+    UINT m_Height{ 0 };
+
     // Frame texture is a part of swap chain output buffer
     Microsoft::WRL::ComPtr<ID3D11RenderTargetView> m_FrameRenderView;
 };
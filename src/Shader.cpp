@@ -24,14 +24,16 @@
 #include "Device.h"
 #include <windows.h>
 #include <d3dcompiler.h>
+#include <algorithm>
+#include <iterator>
 #include <fstream>
 #include <stdexcept>
 #include <cassert>
 
-Shader::Shader(DX11Device& device, const std::string& source)
+Shader::Shader(DX11Device& device, const std::string& source, const std::vector<std::string>& defines, ShaderInput input, VertexFormat format)
     : DX11Resource(device)
 {
-    ID3D11Device& deviceHandle = m_Device.GetHandle();
+    Backend& backend = m_Device.GetBackend();
 
     std::ifstream sourceFile(source, std::ios::in | std::ios::binary);
     if (!sourceFile)
@@ -52,62 +54,84 @@ Shader::Shader(DX11Device& device, const std::string& source)
     UINT uFlags = 0;
 #endif // NDEBUG
 
+    // Stage macro goes first, the list is terminated by an empty macro
+    std::vector<D3D_SHADER_MACRO> shaderMacros(1);
+    for (const std::string& define : defines)
+        shaderMacros.push_back({ define.c_str(), "" });
+    if (format != VertexFormat::Full)
+        shaderMacros.push_back({ "VERTEX_OCTAHEDRAL_NORMALS", "" });
+    shaderMacros.push_back({ nullptr, nullptr });
+
+    // Relative includes are resolved against the working directory, next to the shader sources
+    ID3DInclude* shaderInclude = D3D_COMPILE_STANDARD_FILE_INCLUDE;
+
     {
-        D3D_SHADER_MACRO shaderMacro[] = { "VERTEX_SHADER", "", nullptr, nullptr };
+        shaderMacros[0] = { "VERTEX_SHADER", "" };
 
         Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob;
         Microsoft::WRL::ComPtr<ID3DBlob> errorsBlob;
 
-        HRESULT hr = D3DCompile(shaderSource.get(), sourceSize, "Vertex Shader", shaderMacro, nullptr, "Main", "vs_5_0", uFlags, 0, &shaderBlob, &errorsBlob);
+        HRESULT hr = D3DCompile(shaderSource.get(), sourceSize, "Vertex Shader", shaderMacros.data(), shaderInclude, "Main", "vs_5_0", uFlags, 0, &shaderBlob, &errorsBlob);
         if (FAILED(hr))
         {
             std::string error(reinterpret_cast<char*>(errorsBlob->GetBufferPointer()), errorsBlob->GetBufferSize());
             throw std::runtime_error("Failed to compile shader: " + error);
         }
 
-        hr = deviceHandle.CreateVertexShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), nullptr, &m_VertexShader);
+        hr = backend.CreateVertexShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), &m_VertexShader);
         assert(SUCCEEDED(hr));
 
+        // Source name shows up in graphics debuggers and lets CPU backends recognize the shader
+        hr = m_VertexShader->SetPrivateData(WKPDID_D3DDebugObjectName, static_cast<UINT>(source.size()), source.c_str());
+        assert(SUCCEEDED(hr));
+
+        // Vertex elements of the format go first
         D3D11_INPUT_ELEMENT_DESC inputDesc[] =
         {
-            { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,  D3D11_INPUT_PER_VERTEX_DATA, 0 },
-            { "NORMAL",   0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 }, // Offset for R32G32B32 (POSITION)
-            { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,    0, 24, D3D11_INPUT_PER_VERTEX_DATA, 0 }  // Offset for R32G32B32 + R32G32B32 (POSITION + NORMAL)
+            { }, { }, { },
+
+            // InstanceData rows, advanced once per instance
+            { "INSTANCE_WORLD",   0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0,   D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+            { "INSTANCE_WORLD",   1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16,  D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+            { "INSTANCE_WORLD",   2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32,  D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+            { "INSTANCE_WORLD",   3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48,  D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+            { "INSTANCE_NORMALS", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 64,  D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+            { "INSTANCE_NORMALS", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 80,  D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+            { "INSTANCE_NORMALS", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 96,  D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+            { "INSTANCE_NORMALS", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 112, D3D11_INPUT_PER_INSTANCE_DATA, 1 }
         };
 
-        hr = deviceHandle.CreateInputLayout(inputDesc, 3, shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), &m_InputLayout);
+        static_assert(VertexEncoding::s_InputElementCount == 3, "One placeholder per vertex element");
+
+        std::copy_n(VertexEncoding::GetInputElements(format), VertexEncoding::s_InputElementCount, inputDesc);
+        UINT inputCount = input == ShaderInput::Instances ? static_cast<UINT>(std::size(inputDesc)) : VertexEncoding::s_InputElementCount;
+
+        hr = backend.CreateInputLayout(inputDesc, inputCount, shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), &m_InputLayout);
         assert(SUCCEEDED(hr));
     }
 
     {
-        D3D_SHADER_MACRO shaderMacro[] = { "PIXEL_SHADER", "", nullptr, nullptr };
+        shaderMacros[0] = { "PIXEL_SHADER", "" };
 
         Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob;
         Microsoft::WRL::ComPtr<ID3DBlob> errorsBlob;
 
-        HRESULT hr = D3DCompile(shaderSource.get(), sourceSize, "Pixel Shader", shaderMacro, nullptr, "Main", "ps_5_0", uFlags, 0, &shaderBlob, &errorsBlob);
+        HRESULT hr = D3DCompile(shaderSource.get(), sourceSize, "Pixel Shader", shaderMacros.data(), shaderInclude, "Main", "ps_5_0", uFlags, 0, &shaderBlob, &errorsBlob);
         if (FAILED(hr))
         {
             std::string error(reinterpret_cast<char*>(errorsBlob->GetBufferPointer()), errorsBlob->GetBufferSize());
             throw std::runtime_error("Failed to compile shader: " + error);
         }
 
-        hr = deviceHandle.CreatePixelShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), nullptr, &m_PixelShader);
+        hr = backend.CreatePixelShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), &m_PixelShader);
         assert(SUCCEEDED(hr));
-    }
-
-    m_TransformBuffer.reset(new ConstantBuffer<TransformData>(device, 0, ResourceInput::INPUT_VERTEX_SHADER));
-    m_VectorsBuffer.reset(new ConstantBuffer<VectorsData>(device, 1, ResourceInput::INPUT_PIXEL_SHADER));
-}
 
-void Shader::SetWorld(const DirectX::XMMATRIX& world)
-{
-    DirectX::XMVECTOR determinant(DirectX::XMMatrixDeterminant(world));
-    DirectX::XMMATRIX worldInverse(DirectX::XMMatrixInverse(&determinant, world));
-    DirectX::XMMATRIX worldInverseTranspose(DirectX::XMMatrixTranspose(worldInverse));
+        hr = m_PixelShader->SetPrivateData(WKPDID_D3DDebugObjectName, static_cast<UINT>(source.size()), source.c_str());
+        assert(SUCCEEDED(hr));
+    }
 
-    m_TransformData.m_WorldVertices = world;
-    m_TransformData.m_WorldNormals = worldInverseTranspose;
+    m_TransformBuffer.reset(new ConstantBuffer<TransformData>(device, 0, ResourceInput::INPUT_VERTEX_SHADER, ConstantUsage::Frame));
+    m_VectorsBuffer.reset(new ConstantBuffer<VectorsData>(device, 1, ResourceInput::INPUT_PIXEL_SHADER, ConstantUsage::Frame));
 }
 
 void Shader::SetViewProjection(const DirectX::XMMATRIX& viewProjection)
@@ -130,9 +154,19 @@ void Shader::SetLightDirection(const DirectX::XMVECTOR& direction)
     m_VectorsData.m_LightDirection = direction;
 }
 
+void Shader::SetLightBounds(const DirectX::XMVECTOR& bounds)
+{
+    m_VectorsData.m_LightBounds = bounds;
+}
+
+void Shader::SetInverseViewProjection(const DirectX::XMMATRIX& inverseViewProjection)
+{
+    m_VectorsData.m_InverseViewProjection = inverseViewProjection;
+}
+
 void Shader::SetSampler(UINT slot, D3D11_FILTER filter)
 {
-    ID3D11Device& deviceHandle = m_Device.GetHandle();
+    Backend& backend = m_Device.GetBackend();
 
     {
         D3D11_SAMPLER_DESC samplerDesc{ };
@@ -145,7 +179,7 @@ void Shader::SetSampler(UINT slot, D3D11_FILTER filter)
         samplerDesc.BorderColor[3] = 1.0f; // Alpha
 
         Microsoft::WRL::ComPtr<ID3D11SamplerState>& sampler = m_TextureSamplers[slot];
-        HRESULT hr = deviceHandle.CreateSamplerState(&samplerDesc, sampler.ReleaseAndGetAddressOf());
+        HRESULT hr = backend.CreateSamplerState(&samplerDesc, sampler.ReleaseAndGetAddressOf());
         assert(SUCCEEDED(hr));
     }
 }
@@ -162,12 +196,10 @@ void Shader::UpdateVectors()
 
 void Shader::Enable()
 {
-    ID3D11DeviceContext& deviceContext = m_Device.GetContext();
+    CommandBuffer& commandBuffer = m_Device.GetCommandBuffer();
 
     {
-        deviceContext.VSSetShader(m_VertexShader.Get(), nullptr, 0);
-        deviceContext.PSSetShader(m_PixelShader.Get(), nullptr, 0);
-        deviceContext.IASetInputLayout(m_InputLayout.Get()); // Input Assembly
+        commandBuffer.SetPipeline(m_VertexShader.Get(), m_PixelShader.Get(), m_InputLayout.Get());
     }
 
     m_TransformBuffer->Enable();
@@ -178,8 +210,7 @@ void Shader::Enable()
         UINT slot = textureSampler.first;
         Microsoft::WRL::ComPtr<ID3D11SamplerState>& sampler = textureSampler.second;
 
-        ID3D11SamplerState* samplers[] = { sampler.Get() };
-        deviceContext.PSSetSamplers(slot, 1, samplers);
+        commandBuffer.SetPixelSampler(slot, sampler.Get());
     }
 }
 void Shader::Disable()
@@ -24,28 +24,46 @@
 
 #include "Resource.h"
 #include "Buffer.h"
+#include "VertexFormat.h"
 #include <d3d11.h>
 #include <wrl/client.h>
 #include <DirectXMath.h>
 #include <string>
+#include <vector>
 #include <map>
+#include <limits>
 
 class DX11Device;
 
+enum class ShaderInput
+{
+    Vertices, // Vertex stream at slot 0
+    Instances // Vertex stream plus InstanceData stream at slot 1
+};
+
 class Shader final : public DX11Resource
 {
 public:
-    Shader(DX11Device& device, const std::string& source);
+    // Defines are passed to both stages as empty macros. The vertex stream at slot 0 is laid out as format,
+    // compact formats add VERTEX_OCTAHEDRAL_NORMALS.
+    Shader(DX11Device& device, const std::string& source, const std::vector<std::string>& defines = { }, ShaderInput input = ShaderInput::Vertices, VertexFormat format = VertexFormat::Full);
 
-    void SetWorld(const DirectX::XMMATRIX& world);
+    // World transforms come with instances
     void SetViewProjection(const DirectX::XMMATRIX& viewProjection);
 
     void SetCameraPosition(const DirectX::XMVECTOR& position);
     void SetLightPosition(const DirectX::XMVECTOR& position);
     void SetLightDirection(const DirectX::XMVECTOR& direction);
 
+    // Light volume with center in xyz and radius in w, pixels outside are discarded
+    void SetLightBounds(const DirectX::XMVECTOR& bounds);
+
+    // Rebuilds world positions from depth for the packed G-buffer
+    void SetInverseViewProjection(const DirectX::XMMATRIX& inverseViewProjection);
+
     void SetSampler(UINT slot, D3D11_FILTER filter);
 
+    // Constants live in the frame's constant ring, update them every frame the shader is used
     void UpdateTransform();
     void UpdateVectors();
 
@@ -59,8 +77,6 @@ private:
     {
         // Describes a 4*4 matrix aligned on a 16-byte boundary that maps to four hardware vector registers
         // https://docs.microsoft.com/en-us/windows/win32/api/directxmath/ns-directxmath-xmmatrix
-        DirectX::XMMATRIX m_WorldVertices{ DirectX::XMMatrixIdentity() };
-        DirectX::XMMATRIX m_WorldNormals{ DirectX::XMMatrixIdentity() };
         DirectX::XMMATRIX m_ViewProjection{ DirectX::XMMatrixIdentity() };
     };
 
@@ -69,6 +85,8 @@ private:
         DirectX::XMVECTOR m_CameraPosition{ DirectX::XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f) };
         DirectX::XMVECTOR m_LightPosition{ DirectX::XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f) };
         DirectX::XMVECTOR m_LightDirection{ DirectX::XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f) };
+        DirectX::XMVECTOR m_LightBounds{ DirectX::XMVectorSet(0.0f, 0.0f, 0.0f, std::numeric_limits<float>::infinity()) };
+        DirectX::XMMATRIX m_InverseViewProjection{ DirectX::XMMatrixIdentity() };
     };
 
     Microsoft::WRL::ComPtr<ID3D11VertexShader> m_VertexShader;
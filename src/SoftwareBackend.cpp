@@ -0,0 +1,823 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "SoftwareBackend.h"
+#include "LightTiles.h"
+#include <d3dcommon.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <cassert>
+
+namespace
+{
+    UINT GetTexelSize(DXGI_FORMAT format)
+    {
+        // 8-bit RGBA colors, depth is stored as float
+        return format == DXGI_FORMAT_R32G32B32A32_FLOAT ? 16 : 4;
+    }
+
+    NullTexture2D* GetTexture(ID3D11View* view)
+    {
+        if (view == nullptr)
+            return nullptr;
+
+        // Views hold a reference to their resource
+        Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+        view->GetResource(&resource);
+
+        D3D11_RESOURCE_DIMENSION dimension = D3D11_RESOURCE_DIMENSION_UNKNOWN;
+        resource->GetType(&dimension);
+
+        if (dimension != D3D11_RESOURCE_DIMENSION_TEXTURE2D)
+            return nullptr;
+
+        return static_cast<NullTexture2D*>(resource.Get());
+    }
+
+    template <typename T>
+    bool ReadConstants(ID3D11Buffer* buffer, UINT offset, T& constants)
+    {
+        if (buffer == nullptr)
+            return false;
+
+        D3D11_BUFFER_DESC bufferDesc{ };
+        buffer->GetDesc(&bufferDesc);
+
+        if (bufferDesc.ByteWidth < offset + sizeof(T))
+            return false;
+
+        std::memcpy(&constants, static_cast<NullBuffer*>(buffer)->GetData() + offset, sizeof(T));
+        return true;
+    }
+
+    template <typename T>
+    const T* GetStructuredData(ID3D11ShaderResourceView* view, UINT& count)
+    {
+        if (view == nullptr)
+            return nullptr;
+
+        Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+        view->GetResource(&resource);
+
+        D3D11_RESOURCE_DIMENSION dimension = D3D11_RESOURCE_DIMENSION_UNKNOWN;
+        resource->GetType(&dimension);
+
+        if (dimension != D3D11_RESOURCE_DIMENSION_BUFFER)
+            return nullptr;
+
+        NullBuffer* buffer = static_cast<NullBuffer*>(resource.Get());
+
+        D3D11_BUFFER_DESC bufferDesc{ };
+        buffer->GetDesc(&bufferDesc);
+
+        D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc{ };
+        view->GetDesc(&viewDesc);
+
+        if (bufferDesc.StructureByteStride != sizeof(T))
+            return nullptr;
+
+        count = viewDesc.Buffer.NumElements;
+        return reinterpret_cast<const T*>(buffer->GetData()) + viewDesc.Buffer.FirstElement;
+    }
+
+    UINT GetMaskShift(UINT mask)
+    {
+        UINT shift = 0;
+        while (mask != 0 && (mask & 1) == 0)
+        {
+            mask >>= 1;
+            shift++;
+        }
+
+        return shift;
+    }
+}
+
+SoftwareBackend::SoftwareBackend(UINT width, UINT height)
+    : NullBackend(width, height)
+    , m_Rasterizer(m_ThreadPool)
+    , m_Lighting(m_ThreadPool)
+{
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> backBuffer;
+
+    HRESULT hr = GetBackBuffer(&backBuffer);
+    assert(SUCCEEDED(hr));
+
+    static_cast<NullTexture2D*>(backBuffer.Get())->Allocate(4);
+}
+
+const RasterizerStats& SoftwareBackend::GetRasterizerStats() const
+{
+    return m_Rasterizer.GetStats();
+}
+
+const LightingStats& SoftwareBackend::GetLightingStats() const
+{
+    return m_Lighting.GetStats();
+}
+
+HRESULT SoftwareBackend::CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* data, ID3D11Texture2D** texture)
+{
+    HRESULT hr = NullBackend::CreateTexture2D(desc, data, texture);
+    if (FAILED(hr))
+        return hr;
+
+    NullTexture2D* nullTexture = static_cast<NullTexture2D*>(*texture);
+    nullTexture->Allocate(GetTexelSize(desc->Format));
+
+    if (data != nullptr)
+    {
+        UINT rowPitch = nullTexture->GetRowPitch();
+        const BYTE* source = static_cast<const BYTE*>(data->pSysMem);
+
+        for (UINT row = 0; row < desc->Height; row++)
+            std::memcpy(nullTexture->GetData() + row * rowPitch, source + row * data->SysMemPitch, rowPitch);
+    }
+
+    return S_OK;
+}
+
+HRESULT SoftwareBackend::CreateTextureFromFile(const wchar_t* source, ID3D11ShaderResourceView** view)
+{
+    // Uncompressed 32-bit DDS images only, top mip level is converted to RGBA
+    std::ifstream imageFile(std::filesystem::path(source), std::ios::in | std::ios::binary);
+    if (!imageFile)
+        return E_FAIL;
+
+    const UINT headerSize = 128;
+    const UINT pixelFormatRGB = 0x40;
+    const UINT pixelFormatAlpha = 0x1;
+
+    BYTE header[headerSize];
+    imageFile.read(reinterpret_cast<char*>(header), headerSize);
+
+    auto readHeader = [&header](UINT offset)
+    {
+        UINT value = 0;
+        std::memcpy(&value, header + offset, sizeof(value));
+        return value;
+    };
+
+    UINT height = readHeader(12);
+    UINT width = readHeader(16);
+    UINT pixelFlags = readHeader(80);
+    UINT bitCount = readHeader(88);
+    UINT masks[] = { readHeader(92), readHeader(96), readHeader(100), readHeader(104) };
+
+    if (!imageFile || readHeader(0) != 0x20534444 || (pixelFlags & pixelFormatRGB) == 0 || bitCount != 32)
+        return E_FAIL;
+
+    if ((pixelFlags & pixelFormatAlpha) == 0)
+        masks[3] = 0;
+
+    std::vector<UINT> pixels(static_cast<size_t>(width) * height);
+    imageFile.read(reinterpret_cast<char*>(pixels.data()), pixels.size() * sizeof(UINT));
+
+    if (!imageFile)
+        return E_FAIL;
+
+    std::vector<BYTE> texels(pixels.size() * 4);
+
+    for (size_t pixel = 0; pixel < pixels.size(); pixel++)
+    {
+        for (UINT channel = 0; channel < 4; channel++)
+        {
+            UINT mask = masks[channel];
+            texels[pixel * 4 + channel] = mask != 0 ? static_cast<BYTE>((pixels[pixel] & mask) >> GetMaskShift(mask)) : 0xff;
+        }
+    }
+
+    D3D11_TEXTURE2D_DESC textureDesc{ };
+    textureDesc.Width = width;
+    textureDesc.Height = height;
+    textureDesc.MipLevels = 1;
+    textureDesc.ArraySize = 1;
+    textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    textureDesc.Usage = D3D11_USAGE_IMMUTABLE;
+    textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    textureDesc.SampleDesc.Count = 1;
+    textureDesc.SampleDesc.Quality = 0;
+
+    D3D11_SUBRESOURCE_DATA textureData{ };
+    textureData.pSysMem = texels.data();
+    textureData.SysMemPitch = width * 4;
+
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+
+    HRESULT hr = CreateTexture2D(&textureDesc, &textureData, &texture);
+    if (FAILED(hr))
+        return hr;
+
+    return CreateShaderResourceView(texture.Get(), nullptr, view);
+}
+
+void SoftwareBackend::IASetInputLayout(ID3D11InputLayout* layout)
+{
+    NullBackend::IASetInputLayout(layout);
+
+    if (layout != nullptr)
+        m_VertexFormat = VertexEncoding::GetFormat(static_cast<NullInputLayout*>(layout)->GetPositionFormat());
+}
+
+void SoftwareBackend::IASetVertexBuffers(UINT slot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets)
+{
+    NullBackend::IASetVertexBuffers(slot, count, buffers, strides, offsets);
+
+    // Geometry.fx reads vertices at slot 0 and instances at slot 1
+    for (UINT buffer = 0; buffer < count; buffer++)
+    {
+        if (slot + buffer == 0)
+        {
+            m_VertexBuffer = buffers[buffer];
+            m_VertexStride = strides[buffer];
+            m_VertexOffset = offsets[buffer];
+        }
+        else if (slot + buffer == 1)
+        {
+            m_InstanceBuffer = buffers[buffer];
+            m_InstanceStride = strides[buffer];
+            m_InstanceOffset = offsets[buffer];
+        }
+    }
+}
+
+void SoftwareBackend::IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+{
+    NullBackend::IASetIndexBuffer(buffer, format, offset);
+
+    m_IndexBuffer = buffer;
+    m_IndexFormat = format;
+    m_IndexOffset = offset;
+}
+
+void SoftwareBackend::VSSetShader(ID3D11VertexShader* shader)
+{
+    NullBackend::VSSetShader(shader);
+
+    // Shaders are recognized by debug names set from their source file names
+    char name[32]{ };
+    UINT nameSize = sizeof(name);
+
+    m_Program = ShaderProgram::Unknown;
+
+    if (shader == nullptr || FAILED(shader->GetPrivateData(WKPDID_D3DDebugObjectName, &nameSize, name)))
+        return;
+
+    std::string program(name, nameSize);
+
+    if (program == "Geometry.fx")
+        m_Program = ShaderProgram::Geometry;
+    else if (program == "AmbientLight.fx")
+        m_Program = ShaderProgram::AmbientLight;
+    else if (program == "DynamicLight.fx")
+        m_Program = ShaderProgram::DynamicLight;
+    else if (program == "TiledLight.fx")
+        m_Program = ShaderProgram::TiledLight;
+}
+
+void SoftwareBackend::VSSetConstantBuffers(UINT slot, UINT count, ID3D11Buffer* const* buffers)
+{
+    NullBackend::VSSetConstantBuffers(slot, count, buffers);
+
+    assert(slot + count <= s_ConstantSlots);
+    std::copy(buffers, buffers + count, m_VertexConstants + slot);
+    std::fill(m_VertexConstantOffsets + slot, m_VertexConstantOffsets + slot + count, 0);
+}
+
+void SoftwareBackend::VSSetConstantBuffers1(UINT slot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts)
+{
+    NullBackend::VSSetConstantBuffers1(slot, count, buffers, firstConstants, constantCounts);
+
+    assert(slot + count <= s_ConstantSlots);
+    std::copy(buffers, buffers + count, m_VertexConstants + slot);
+
+    for (UINT i = 0; i < count; i++)
+        m_VertexConstantOffsets[slot + i] = firstConstants[i] * 16;
+}
+
+void SoftwareBackend::PSSetConstantBuffers(UINT slot, UINT count, ID3D11Buffer* const* buffers)
+{
+    NullBackend::PSSetConstantBuffers(slot, count, buffers);
+
+    assert(slot + count <= s_ConstantSlots);
+    std::copy(buffers, buffers + count, m_PixelConstants + slot);
+    std::fill(m_PixelConstantOffsets + slot, m_PixelConstantOffsets + slot + count, 0);
+}
+
+void SoftwareBackend::PSSetConstantBuffers1(UINT slot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts)
+{
+    NullBackend::PSSetConstantBuffers1(slot, count, buffers, firstConstants, constantCounts);
+
+    assert(slot + count <= s_ConstantSlots);
+    std::copy(buffers, buffers + count, m_PixelConstants + slot);
+
+    for (UINT i = 0; i < count; i++)
+        m_PixelConstantOffsets[slot + i] = firstConstants[i] * 16;
+}
+
+void SoftwareBackend::PSSetShaderResources(UINT slot, UINT count, ID3D11ShaderResourceView* const* views)
+{
+    NullBackend::PSSetShaderResources(slot, count, views);
+
+    assert(slot + count <= s_ResourceSlots);
+    std::copy(views, views + count, m_PixelResources + slot);
+}
+
+void SoftwareBackend::RSSetState(ID3D11RasterizerState* state)
+{
+    NullBackend::RSSetState(state);
+
+    D3D11_RASTERIZER_DESC rasterizerDesc{ };
+    rasterizerDesc.CullMode = D3D11_CULL_BACK; // Default state
+
+    if (state != nullptr)
+        state->GetDesc(&rasterizerDesc);
+
+    m_CullMode = rasterizerDesc.CullMode;
+    m_ScissorEnabled = rasterizerDesc.ScissorEnable != FALSE;
+}
+
+void SoftwareBackend::RSSetViewports(UINT count, const D3D11_VIEWPORT* viewports)
+{
+    Flush();
+    NullBackend::RSSetViewports(count, viewports);
+
+    if (count > 0)
+        m_Viewport = viewports[0];
+}
+
+void SoftwareBackend::RSSetScissorRects(UINT count, const D3D11_RECT* rects)
+{
+    NullBackend::RSSetScissorRects(count, rects);
+
+    // Without rectangles the scissor test rejects everything
+    m_ScissorRect = count > 0 ? rects[0] : D3D11_RECT{ };
+}
+
+void SoftwareBackend::OMSetRenderTargets(UINT count, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthStencilView)
+{
+    Flush();
+    NullBackend::OMSetRenderTargets(count, views, depthStencilView);
+
+    assert(count <= s_RenderTargets);
+    std::fill(std::begin(m_RenderViews), std::end(m_RenderViews), nullptr);
+    std::copy(views, views + count, m_RenderViews);
+
+    m_DepthStencilView = depthStencilView;
+}
+
+void SoftwareBackend::OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask)
+{
+    NullBackend::OMSetBlendState(state, blendFactor, sampleMask);
+
+    // Lighting passes support FrameBuffer blending (SRC_ALPHA, INV_SRC_ALPHA) only
+    D3D11_BLEND_DESC blendDesc{ };
+
+    if (state != nullptr)
+        state->GetDesc(&blendDesc);
+
+    m_BlendEnabled = blendDesc.RenderTarget[0].BlendEnable == TRUE;
+}
+
+void SoftwareBackend::ClearRenderTargetView(ID3D11RenderTargetView* view, const FLOAT color[4])
+{
+    Flush();
+    NullBackend::ClearRenderTargetView(view, color);
+
+    NullTexture2D* texture = GetTexture(view);
+    if (texture == nullptr || texture->GetData() == nullptr)
+        return;
+
+    D3D11_TEXTURE2D_DESC textureDesc{ };
+    texture->GetDesc(&textureDesc);
+
+    size_t texels = static_cast<size_t>(textureDesc.Width) * textureDesc.Height;
+
+    if (textureDesc.Format == DXGI_FORMAT_R32G32B32A32_FLOAT)
+    {
+        DirectX::XMFLOAT4* colors = reinterpret_cast<DirectX::XMFLOAT4*>(texture->GetData());
+        std::fill(colors, colors + texels, DirectX::XMFLOAT4(color[0], color[1], color[2], color[3]));
+    }
+    else if (textureDesc.Format == DXGI_FORMAT_R16G16_UNORM)
+    {
+        UINT16 clearColor[2];
+        for (UINT channel = 0; channel < 2; channel++)
+            clearColor[channel] = static_cast<UINT16>(std::clamp(color[channel], 0.0f, 1.0f) * 65535.0f + 0.5f);
+
+        for (size_t texel = 0; texel < texels; texel++)
+            std::memcpy(texture->GetData() + texel * 4, clearColor, 4);
+    }
+    else
+    {
+        BYTE clearColor[4];
+        for (UINT channel = 0; channel < 4; channel++)
+            clearColor[channel] = static_cast<BYTE>(std::clamp(color[channel], 0.0f, 1.0f) * 255.0f + 0.5f);
+
+        for (size_t texel = 0; texel < texels; texel++)
+            std::memcpy(texture->GetData() + texel * 4, clearColor, 4);
+    }
+}
+
+void SoftwareBackend::ClearDepthStencilView(ID3D11DepthStencilView* view, UINT flags, FLOAT depth, UINT8 stencil)
+{
+    Flush();
+    NullBackend::ClearDepthStencilView(view, flags, depth, stencil);
+
+    NullTexture2D* texture = GetTexture(view);
+    if (texture == nullptr || texture->GetData() == nullptr || (flags & D3D11_CLEAR_DEPTH) == 0)
+        return;
+
+    D3D11_TEXTURE2D_DESC textureDesc{ };
+    texture->GetDesc(&textureDesc);
+
+    // Stencil is not stored
+    float* depths = reinterpret_cast<float*>(texture->GetData());
+    std::fill(depths, depths + static_cast<size_t>(textureDesc.Width) * textureDesc.Height, depth);
+}
+
+void SoftwareBackend::DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex)
+{
+    NullBackend::DrawIndexed(indexCount, startIndex, baseVertex);
+
+    switch (m_Program)
+    {
+    case ShaderProgram::Geometry:
+        QueueGeometry(indexCount, 1, startIndex, baseVertex, 0);
+        break;
+
+    case ShaderProgram::AmbientLight:
+    case ShaderProgram::DynamicLight:
+        QueueLighting();
+        break;
+
+    case ShaderProgram::TiledLight:
+        ShadeTiledLighting();
+        break;
+
+    default:
+        break;
+    }
+}
+
+void SoftwareBackend::DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)
+{
+    NullBackend::DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+
+    // Light passes are never instanced
+    if (m_Program == ShaderProgram::Geometry)
+        QueueGeometry(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+void SoftwareBackend::Present()
+{
+    Flush();
+    NullBackend::Present();
+}
+
+void SoftwareBackend::QueueGeometry(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)
+{
+    if (m_DepthStencilView == nullptr || m_VertexBuffer == nullptr || m_IndexBuffer == nullptr || m_InstanceBuffer == nullptr)
+        return;
+
+    assert(m_IndexFormat == DXGI_FORMAT_R32_UINT || m_IndexFormat == DXGI_FORMAT_R16_UINT);
+    assert(m_InstanceStride >= sizeof(DirectX::XMFLOAT4X4) * 2);
+
+    RasterDraw draw;
+
+    // Constant buffers are captured now, they get updated between draws
+    if (!ReadConstants(m_VertexConstants[0], m_VertexConstantOffsets[0], draw.m_Transform.m_ViewProjection) || !ReadConstants(m_PixelConstants[0], m_PixelConstantOffsets[0], draw.m_Material))
+        return;
+
+    {
+        D3D11_BUFFER_DESC bufferDesc{ };
+        m_VertexBuffer->GetDesc(&bufferDesc);
+
+        draw.m_Vertices = static_cast<NullBuffer*>(m_VertexBuffer)->GetData() + m_VertexOffset;
+        draw.m_VertexStride = m_VertexStride;
+        draw.m_VertexFormat = m_VertexFormat;
+        draw.m_VertexCount = (bufferDesc.ByteWidth - m_VertexOffset) / m_VertexStride;
+    }
+
+    {
+        const BYTE* indexData = static_cast<NullBuffer*>(m_IndexBuffer)->GetData() + m_IndexOffset;
+
+        draw.m_IndexStride = m_IndexFormat == DXGI_FORMAT_R16_UINT ? sizeof(USHORT) : sizeof(UINT);
+        draw.m_Indices = indexData + static_cast<size_t>(startIndex) * draw.m_IndexStride;
+        draw.m_IndexCount = indexCount;
+        draw.m_BaseVertex = baseVertex;
+    }
+
+    NullTexture2D* texture = GetTexture(m_PixelResources[0]);
+    if (texture != nullptr)
+    {
+        D3D11_TEXTURE2D_DESC textureDesc{ };
+        texture->GetDesc(&textureDesc);
+
+        if (textureDesc.Format == DXGI_FORMAT_R8G8B8A8_UNORM)
+        {
+            draw.m_Texture.m_Texels = texture->GetData();
+            draw.m_Texture.m_Width = textureDesc.Width;
+            draw.m_Texture.m_Height = textureDesc.Height;
+        }
+    }
+
+    draw.m_CullMode = m_CullMode;
+
+    // Every instance is queued as a draw of its own, InstanceData starts with world and normal matrices
+    D3D11_BUFFER_DESC instanceDesc{ };
+    m_InstanceBuffer->GetDesc(&instanceDesc);
+
+    const BYTE* instanceData = static_cast<NullBuffer*>(m_InstanceBuffer)->GetData() + m_InstanceOffset;
+
+    for (UINT instance = startInstance; instance < startInstance + instanceCount; instance++)
+    {
+        if (m_InstanceOffset + (instance + 1) * m_InstanceStride > instanceDesc.ByteWidth)
+            break;
+
+        const DirectX::XMFLOAT4X4* matrices = reinterpret_cast<const DirectX::XMFLOAT4X4*>(instanceData + instance * m_InstanceStride);
+
+        draw.m_Transform.m_WorldVertices = DirectX::XMLoadFloat4x4(&matrices[0]);
+        draw.m_Transform.m_WorldNormals = DirectX::XMLoadFloat4x4(&matrices[1]);
+        m_Draws.push_back(draw);
+    }
+}
+
+NullTexture2D* SoftwareBackend::GetLightingTarget(GeometryLayout& layout) const
+{
+    // Full screen passes: the quad is not rasterized, every pixel of the 8-bit RGBA target is shaded
+    NullTexture2D* target = GetTexture(m_RenderViews[0]);
+    if (target == nullptr)
+        return nullptr;
+
+    D3D11_TEXTURE2D_DESC targetDesc{ };
+    target->GetDesc(&targetDesc);
+
+    if (targetDesc.Format != DXGI_FORMAT_R8G8B8A8_UNORM)
+        return nullptr;
+
+    // G-buffer views as bound by GeometryBuffer::EnableTextures(), unused slots are left unknown
+    const DXGI_FORMAT fullFormats[] = { DXGI_FORMAT_R32G32B32A32_FLOAT, DXGI_FORMAT_R32G32B32A32_FLOAT, DXGI_FORMAT_R32G32B32A32_FLOAT, DXGI_FORMAT_R24G8_TYPELESS };
+    const DXGI_FORMAT packedFormats[] = { GeometryPacking::s_AlbedoFormat, GeometryPacking::s_NormalFormat, GeometryPacking::s_MaterialFormat, DXGI_FORMAT_R24G8_TYPELESS };
+
+    // Three targets at t0 - t2 and depth at t4
+    auto matches = [this, &targetDesc](const DXGI_FORMAT* formats)
+    {
+        for (UINT source = 0; source < 4; source++)
+        {
+            NullTexture2D* texture = GetTexture(m_PixelResources[source < 3 ? source : 4]);
+            if (texture == nullptr)
+                return false;
+
+            D3D11_TEXTURE2D_DESC textureDesc{ };
+            texture->GetDesc(&textureDesc);
+
+            if (textureDesc.Format != formats[source] || textureDesc.Width != targetDesc.Width || textureDesc.Height != targetDesc.Height)
+                return false;
+        }
+
+        return true;
+    };
+
+    if (matches(fullFormats))
+        layout = GeometryLayout::Full;
+    else if (matches(packedFormats))
+        layout = GeometryLayout::Packed;
+    else
+        return nullptr;
+
+    return target;
+}
+
+void SoftwareBackend::LoadLightingGeometry(NullTexture2D* target, ID3D11ShaderResourceView* const* sources, GeometryLayout layout, const DirectX::XMFLOAT4X4& inverseViewProjection)
+{
+    D3D11_TEXTURE2D_DESC targetDesc{ };
+    target->GetDesc(&targetDesc);
+
+    const float* depth = reinterpret_cast<const float*>(GetTexture(sources[4])->GetData());
+
+    if (layout == GeometryLayout::Packed)
+    {
+        const UINT* targets[3];
+        for (UINT source = 0; source < 3; source++)
+            targets[source] = reinterpret_cast<const UINT*>(GetTexture(sources[source])->GetData());
+
+        m_Lighting.LoadGeometry(targetDesc.Width, targetDesc.Height, targets, depth, inverseViewProjection);
+    }
+    else
+    {
+        const DirectX::XMFLOAT4* targets[3];
+        for (UINT source = 0; source < 3; source++)
+            targets[source] = reinterpret_cast<const DirectX::XMFLOAT4*>(GetTexture(sources[source])->GetData());
+
+        m_Lighting.LoadGeometry(targetDesc.Width, targetDesc.Height, targets, depth, inverseViewProjection);
+    }
+}
+
+void SoftwareBackend::QueueLighting()
+{
+    GeometryLayout layout = GeometryLayout::Full;
+    if (GetLightingTarget(layout) == nullptr)
+        return;
+
+    if (!std::equal(std::begin(m_LightSources), std::end(m_LightSources), m_PixelResources))
+    {
+        Flush();
+        std::copy(m_PixelResources, m_PixelResources + 5, m_LightSources);
+        m_LightLayout = layout;
+    }
+
+    LightPass pass;
+    pass.m_Blend = m_BlendEnabled;
+
+    if (m_ScissorEnabled)
+        pass.m_Scissor = m_ScissorRect;
+
+    // Constant buffers are captured now, they get updated between draws
+    if (!ReadConstants(m_PixelConstants[0], m_PixelConstantOffsets[0], pass.m_Light))
+        return;
+
+    if (m_Program == ShaderProgram::DynamicLight)
+    {
+        if (!ReadConstants(m_PixelConstants[1], m_PixelConstantOffsets[1], pass.m_Vectors))
+            return;
+
+        // Passes of a frame share the camera
+        m_LightUnprojection = pass.m_Vectors.m_InverseViewProjection;
+    }
+
+    m_LightPasses.push_back(pass);
+}
+
+void SoftwareBackend::ShadeTiledLighting()
+{
+    GeometryLayout layout = GeometryLayout::Full;
+    NullTexture2D* target = GetLightingTarget(layout);
+    if (target == nullptr)
+        return;
+
+    D3D11_TEXTURE2D_DESC targetDesc{ };
+    target->GetDesc(&targetDesc);
+
+    // TiledLight.fx buffers t5 - t7 and b2
+    UINT lightCount = 0;
+    UINT indexCount = 0;
+    UINT rangeCount = 0;
+
+    const TiledLightData* lights = GetStructuredData<TiledLightData>(m_PixelResources[5], lightCount);
+    const UINT* indices = GetStructuredData<UINT>(m_PixelResources[6], indexCount);
+    const DirectX::XMUINT2* ranges = GetStructuredData<DirectX::XMUINT2>(m_PixelResources[7], rangeCount);
+
+    LightGrid grid;
+    if (lights == nullptr || indices == nullptr || ranges == nullptr || !ReadConstants(m_PixelConstants[2], m_PixelConstantOffsets[2], grid))
+        return;
+
+    // Lighting shades whole 8 pixel vectors
+    if (grid.m_TileSize == 0 || grid.m_TileSize % 8 != 0 || grid.m_Slices == 0)
+        return;
+
+    UINT tilesX = (targetDesc.Width + grid.m_TileSize - 1) / grid.m_TileSize;
+    UINT tilesY = (targetDesc.Height + grid.m_TileSize - 1) / grid.m_TileSize;
+
+    if (grid.m_TilesX != tilesX || grid.m_TilesY != tilesY || rangeCount < tilesX * tilesY * grid.m_Slices)
+        return;
+
+    // Rows of a tile share one pass list, so depth slices of a tile are merged keeping light order.
+    // Lights missing from the cluster of a pixel are below their cut-off there and barely change it
+    if (grid.m_Slices > 1)
+    {
+        UINT tileCount = tilesX * tilesY;
+
+        m_TileIndices.clear();
+        m_TileRanges.resize(tileCount);
+
+        for (UINT tile = 0; tile < tileCount; tile++)
+        {
+            size_t start = m_TileIndices.size();
+
+            for (UINT slice = 0; slice < grid.m_Slices; slice++)
+            {
+                const DirectX::XMUINT2& range = ranges[slice * tileCount + tile];
+                m_TileIndices.insert(m_TileIndices.end(), indices + range.x, indices + range.x + range.y);
+            }
+
+            std::sort(m_TileIndices.begin() + start, m_TileIndices.end());
+            m_TileIndices.erase(std::unique(m_TileIndices.begin() + start, m_TileIndices.end()), m_TileIndices.end());
+
+            m_TileRanges[tile] = DirectX::XMUINT2(static_cast<UINT>(start), static_cast<UINT>(m_TileIndices.size() - start));
+        }
+
+        indices = m_TileIndices.data();
+        ranges = m_TileRanges.data();
+    }
+
+    LightVectors vectors;
+    if (!ReadConstants(m_PixelConstants[1], m_PixelConstantOffsets[1], vectors))
+        return;
+
+    // Tile lists pick passes, blending happens in the shader and the output is opaque.
+    // Lights are not bounded by volumes there, tiles already cull them
+    std::vector<LightPass> passes(lightCount);
+    const float infinity = std::numeric_limits<float>::infinity();
+
+    for (UINT light = 0; light < lightCount; light++)
+    {
+        const TiledLightData& data = lights[light];
+
+        LightPass& pass = passes[light];
+        pass.m_Light = { static_cast<int>(data.m_Type), data.m_Color, data.m_Intensity, data.m_Falloff, data.m_SpotAngle, data.m_SpotBorder };
+        pass.m_Vectors = { vectors.m_CameraPosition, data.m_Position, data.m_Direction, DirectX::XMFLOAT4(0.0f, 0.0f, 0.0f, infinity) };
+        pass.m_Blend = true;
+    }
+
+    LightTileLists tiles;
+    tiles.m_TileSize = grid.m_TileSize;
+    tiles.m_Indices = indices;
+    tiles.m_Ranges = ranges;
+
+    // Earlier geometry and light passes write the sources and the target
+    Flush();
+
+    LoadLightingGeometry(target, m_PixelResources, layout, vectors.m_InverseViewProjection);
+    m_Lighting.LoadFrame(target->GetData());
+    m_Lighting.Shade(passes, tiles);
+    m_Lighting.StoreFrame(target->GetData());
+}
+
+void SoftwareBackend::Flush()
+{
+    if (!m_Draws.empty())
+    {
+        RasterTargets targets;
+
+        NullTexture2D* depthTexture = GetTexture(m_DepthStencilView);
+        assert(depthTexture != nullptr);
+
+        D3D11_TEXTURE2D_DESC depthDesc{ };
+        depthTexture->GetDesc(&depthDesc);
+
+        targets.m_Depth = reinterpret_cast<float*>(depthTexture->GetData());
+        targets.m_Width = depthDesc.Width;
+        targets.m_Height = depthDesc.Height;
+        targets.m_Viewport = m_Viewport;
+
+        // Packed targets are told apart from the full ones by their formats
+        const DXGI_FORMAT packedFormats[] = { GeometryPacking::s_AlbedoFormat, GeometryPacking::s_NormalFormat, GeometryPacking::s_MaterialFormat };
+
+        for (UINT target = 0; target < 3; target++)
+        {
+            NullTexture2D* texture = GetTexture(m_RenderViews[target]);
+            if (texture == nullptr)
+                continue;
+
+            D3D11_TEXTURE2D_DESC textureDesc{ };
+            texture->GetDesc(&textureDesc);
+
+            if (textureDesc.Width != depthDesc.Width || textureDesc.Height != depthDesc.Height)
+                continue;
+
+            if (textureDesc.Format == DXGI_FORMAT_R32G32B32A32_FLOAT)
+                targets.m_Colors[target] = reinterpret_cast<DirectX::XMFLOAT4*>(texture->GetData());
+            else if (textureDesc.Format == packedFormats[target])
+                targets.m_PackedColors[target] = reinterpret_cast<UINT*>(texture->GetData());
+        }
+
+        m_Rasterizer.Draw(targets, m_Draws);
+        m_Draws.clear();
+    }
+
+    if (!m_LightPasses.empty())
+    {
+        NullTexture2D* target = GetTexture(m_RenderViews[0]);
+
+        LoadLightingGeometry(target, m_LightSources, m_LightLayout, m_LightUnprojection);
+        m_Lighting.LoadFrame(target->GetData());
+        m_Lighting.Shade(m_LightPasses);
+        m_Lighting.StoreFrame(target->GetData());
+
+        m_LightPasses.clear();
+    }
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "NullBackend.h"
+#include "Rasterizer.h"
+#include "Lighting.h"
+#include "ThreadPool.h"
+#include "GeometryPacking.h"
+#include <vector>
+
+// Headless backend running Geometry.fx, AmbientLight.fx, DynamicLight.fx and TiledLight.fx on CPU. Render targets,
+// depth buffers and image textures keep their texels; draws are queued and executed together once
+// output is about to change. Other shaders are only recorded in BackendStats.
+class SoftwareBackend final : public NullBackend
+{
+public:
+    SoftwareBackend(UINT width, UINT height);
+
+    const RasterizerStats& GetRasterizerStats() const;
+    const LightingStats& GetLightingStats() const;
+
+    HRESULT CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* data, ID3D11Texture2D** texture) override;
+    HRESULT CreateTextureFromFile(const wchar_t* source, ID3D11ShaderResourceView** view) override;
+
+    void IASetInputLayout(ID3D11InputLayout* layout) override;
+    void IASetVertexBuffers(UINT slot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets) override;
+    void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset) override;
+    void VSSetShader(ID3D11VertexShader* shader) override;
+    void VSSetConstantBuffers(UINT slot, UINT count, ID3D11Buffer* const* buffers) override;
+    void VSSetConstantBuffers1(UINT slot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts) override;
+    void PSSetConstantBuffers(UINT slot, UINT count, ID3D11Buffer* const* buffers) override;
+    void PSSetConstantBuffers1(UINT slot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts) override;
+    void PSSetShaderResources(UINT slot, UINT count, ID3D11ShaderResourceView* const* views) override;
+    void RSSetState(ID3D11RasterizerState* state) override;
+    void RSSetViewports(UINT count, const D3D11_VIEWPORT* viewports) override;
+    void RSSetScissorRects(UINT count, const D3D11_RECT* rects) override;
+    void OMSetRenderTargets(UINT count, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthStencilView) override;
+    void OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask) override;
+    void ClearRenderTargetView(ID3D11RenderTargetView* view, const FLOAT color[4]) override;
+    void ClearDepthStencilView(ID3D11DepthStencilView* view, UINT flags, FLOAT depth, UINT8 stencil) override;
+    void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex) override;
+    void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance) override;
+
+    void Present() override;
+
+private:
+    static constexpr UINT s_ConstantSlots = D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT;
+    static constexpr UINT s_ResourceSlots = 16;
+    static constexpr UINT s_RenderTargets = D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT;
+
+    enum class ShaderProgram
+    {
+        Unknown,
+        Geometry,
+        AmbientLight,
+        DynamicLight,
+        TiledLight
+    };
+
+    void QueueGeometry(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance);
+    NullTexture2D* GetLightingTarget(GeometryLayout& layout) const;
+    void LoadLightingGeometry(NullTexture2D* target, ID3D11ShaderResourceView* const* sources, GeometryLayout layout, const DirectX::XMFLOAT4X4& inverseViewProjection);
+    void QueueLighting();
+    void ShadeTiledLighting();
+    void Flush();
+
+    ThreadPool m_ThreadPool;
+    Rasterizer m_Rasterizer;
+    Lighting m_Lighting;
+
+    // Bound pipeline objects, the engine keeps them alive while bound
+    VertexFormat m_VertexFormat{ VertexFormat::Full };
+    ID3D11Buffer* m_VertexBuffer{ nullptr };
+    UINT m_VertexStride{ 0 };
+    UINT m_VertexOffset{ 0 };
+
+    ID3D11Buffer* m_InstanceBuffer{ nullptr };
+    UINT m_InstanceStride{ 0 };
+    UINT m_InstanceOffset{ 0 };
+
+    ID3D11Buffer* m_IndexBuffer{ nullptr };
+    DXGI_FORMAT m_IndexFormat{ DXGI_FORMAT_UNKNOWN };
+    UINT m_IndexOffset{ 0 };
+
+    ShaderProgram m_Program{ ShaderProgram::Unknown };
+    ID3D11Buffer* m_VertexConstants[s_ConstantSlots]{ };
+    ID3D11Buffer* m_PixelConstants[s_ConstantSlots]{ };
+    UINT m_VertexConstantOffsets[s_ConstantSlots]{ }; // In bytes, set by *SetConstantBuffers1()
+    UINT m_PixelConstantOffsets[s_ConstantSlots]{ };
+    ID3D11ShaderResourceView* m_PixelResources[s_ResourceSlots]{ };
+
+    D3D11_CULL_MODE m_CullMode{ D3D11_CULL_BACK };
+    bool m_ScissorEnabled{ false }; // Honored by light passes only, geometry is never scissored
+    D3D11_RECT m_ScissorRect{ };
+    bool m_BlendEnabled{ false };
+    D3D11_VIEWPORT m_Viewport{ };
+
+    ID3D11RenderTargetView* m_RenderViews[s_RenderTargets]{ };
+    ID3D11DepthStencilView* m_DepthStencilView{ nullptr };
+
+    // Queued until Flush(), vertex and index data is referenced rather than copied
+    std::vector<RasterDraw> m_Draws;
+
+    // Queued until Flush(), all passes read the same G-buffer views at t0 - t4
+    std::vector<LightPass> m_LightPasses;
+    ID3D11ShaderResourceView* m_LightSources[5]{ };
+    GeometryLayout m_LightLayout{ GeometryLayout::Full };
+    DirectX::XMFLOAT4X4 m_LightUnprojection{ LightVectors{ }.m_InverseViewProjection }; // Of the last DynamicLight.fx pass
+
+    // TiledLight.fx cluster lists merged per screen tile
+    std::vector<UINT> m_TileIndices;
+    std::vector<DirectX::XMUINT2> m_TileRanges;
+};
@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "StateCache.h"
+#include "Backend.h"
+#include <algorithm>
+#include <iterator>
+#include <cassert>
+
+namespace
+{
+    template <typename T>
+    bool IsEqual(const T& left, const T& right)
+    {
+        return left == right;
+    }
+
+    bool IsEqual(const D3D11_VIEWPORT& left, const D3D11_VIEWPORT& right)
+    {
+        return left.TopLeftX == right.TopLeftX && left.TopLeftY == right.TopLeftY && left.Width == right.Width &&
+            left.Height == right.Height && left.MinDepth == right.MinDepth && left.MaxDepth == right.MaxDepth;
+    }
+
+    bool IsEqual(const D3D11_RECT& left, const D3D11_RECT& right)
+    {
+        return left.left == right.left && left.top == right.top && left.right == right.right && left.bottom == right.bottom;
+    }
+
+    template <typename T, size_t N>
+    void Forget(T (&shadows)[N])
+    {
+        for (T& shadow : shadows)
+            shadow.m_IsKnown = false;
+    }
+}
+
+StateCache::StateCache(Backend& backend)
+    : m_Backend(backend)
+{ }
+
+void StateCache::Invalidate()
+{
+    m_VertexShader.m_IsKnown = false;
+    m_PixelShader.m_IsKnown = false;
+    m_InputLayout.m_IsKnown = false;
+    Forget(m_VertexBuffers);
+    m_IndexBuffer.m_IsKnown = false;
+    m_Topology.m_IsKnown = false;
+
+    Forget(m_VertexConstantBuffers);
+    Forget(m_PixelConstantBuffers);
+    Forget(m_PixelShaderResources);
+    Forget(m_PixelSamplers);
+
+    m_RasterizerState.m_IsKnown = false;
+    m_Viewport.m_IsKnown = false;
+    m_ScissorRect.m_IsKnown = false;
+
+    m_RenderTargets.m_IsKnown = false;
+    m_BlendState.m_IsKnown = false;
+}
+
+void StateCache::InvalidateRenderTargets()
+{
+    m_RenderTargets.m_IsKnown = false;
+}
+
+void StateCache::SetPipeline(ID3D11VertexShader* vertexShader, ID3D11PixelShader* pixelShader, ID3D11InputLayout* inputLayout)
+{
+    if (Update(m_VertexShader, vertexShader))
+        m_Backend.VSSetShader(vertexShader);
+
+    if (Update(m_PixelShader, pixelShader))
+        m_Backend.PSSetShader(pixelShader);
+
+    if (Update(m_InputLayout, inputLayout))
+        m_Backend.IASetInputLayout(inputLayout); // Input Assembly
+}
+
+void StateCache::SetVertexBuffer(UINT slot, ID3D11Buffer* buffer, UINT stride, UINT offset)
+{
+    assert(slot < std::size(m_VertexBuffers));
+
+    if (Update(m_VertexBuffers[slot], { buffer, stride, offset }))
+        m_Backend.IASetVertexBuffers(slot, 1, &buffer, &stride, &offset); // Input Assembly
+}
+
+void StateCache::SetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+{
+    if (Update(m_IndexBuffer, { buffer, format, offset }))
+        m_Backend.IASetIndexBuffer(buffer, format, offset); // Input Assembly
+}
+
+void StateCache::SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+    if (Update(m_Topology, topology))
+        m_Backend.IASetPrimitiveTopology(topology); // Input Assembly
+}
+
+void StateCache::SetVertexConstantBuffer(UINT slot, ID3D11Buffer* buffer, UINT firstConstant, UINT constantCount)
+{
+    assert(slot < std::size(m_VertexConstantBuffers));
+
+    if (!Update(m_VertexConstantBuffers[slot], { buffer, firstConstant, constantCount }))
+        return;
+
+    if (constantCount > 0)
+        m_Backend.VSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &constantCount);
+    else
+        m_Backend.VSSetConstantBuffers(slot, 1, &buffer);
+}
+
+void StateCache::SetPixelConstantBuffer(UINT slot, ID3D11Buffer* buffer, UINT firstConstant, UINT constantCount)
+{
+    assert(slot < std::size(m_PixelConstantBuffers));
+
+    if (!Update(m_PixelConstantBuffers[slot], { buffer, firstConstant, constantCount }))
+        return;
+
+    if (constantCount > 0)
+        m_Backend.PSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &constantCount);
+    else
+        m_Backend.PSSetConstantBuffers(slot, 1, &buffer);
+}
+
+void StateCache::SetPixelShaderResource(UINT slot, ID3D11ShaderResourceView* view)
+{
+    assert(slot < std::size(m_PixelShaderResources));
+
+    if (Update(m_PixelShaderResources[slot], view))
+        m_Backend.PSSetShaderResources(slot, 1, &view);
+}
+
+void StateCache::SetPixelSampler(UINT slot, ID3D11SamplerState* sampler)
+{
+    assert(slot < std::size(m_PixelSamplers));
+
+    if (Update(m_PixelSamplers[slot], sampler))
+        m_Backend.PSSetSamplers(slot, 1, &sampler);
+}
+
+void StateCache::SetRasterizerState(ID3D11RasterizerState* state)
+{
+    if (Update(m_RasterizerState, state))
+        m_Backend.RSSetState(state); // Rasterizer State
+}
+
+void StateCache::SetViewport(const D3D11_VIEWPORT& viewport)
+{
+    if (Update(m_Viewport, viewport))
+        m_Backend.RSSetViewports(1, &viewport); // Rasterizer State
+}
+
+void StateCache::SetScissorRect(const D3D11_RECT& rect)
+{
+    if (Update(m_ScissorRect, rect))
+        m_Backend.RSSetScissorRects(1, &rect); // Rasterizer State
+}
+
+void StateCache::SetRenderTargets(UINT count, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthStencilView)
+{
+    RenderTargetsBinding binding{ };
+
+    assert(count <= std::size(binding.m_Views));
+    binding.m_Count = count;
+    std::copy(views, views + count, binding.m_Views);
+    binding.m_DepthStencilView = depthStencilView;
+
+    if (Update(m_RenderTargets, binding))
+    {
+        m_Backend.OMSetRenderTargets(count, views, depthStencilView); // Output Merger
+        Forget(m_PixelShaderResources);
+    }
+}
+
+void StateCache::SetBlendState(ID3D11BlendState* state)
+{
+    if (Update(m_BlendState, state))
+        m_Backend.OMSetBlendState(state, nullptr, 0xffffffff); // Output Merger
+}
+
+const StateCacheStats& StateCache::GetStats() const
+{
+    return m_Stats;
+}
+
+void StateCache::ResetStats()
+{
+    m_Stats = { };
+}
+
+bool StateCache::VertexBufferBinding::operator==(const VertexBufferBinding& other) const
+{
+    return m_Buffer == other.m_Buffer && m_Stride == other.m_Stride && m_Offset == other.m_Offset;
+}
+
+bool StateCache::IndexBufferBinding::operator==(const IndexBufferBinding& other) const
+{
+    return m_Buffer == other.m_Buffer && m_Format == other.m_Format && m_Offset == other.m_Offset;
+}
+
+bool StateCache::ConstantBufferBinding::operator==(const ConstantBufferBinding& other) const
+{
+    return m_Buffer == other.m_Buffer && m_FirstConstant == other.m_FirstConstant && m_ConstantCount == other.m_ConstantCount;
+}
+
+bool StateCache::RenderTargetsBinding::operator==(const RenderTargetsBinding& other) const
+{
+    // Views past the count are null in both
+    return m_Count == other.m_Count && std::equal(m_Views, m_Views + std::size(m_Views), other.m_Views) && m_DepthStencilView == other.m_DepthStencilView;
+}
+
+template <typename T>
+bool StateCache::Update(Shadow<T>& shadow, const T& value)
+{
+    if (shadow.m_IsKnown && IsEqual(shadow.m_Value, value))
+    {
+        m_Stats.m_ElidedCalls++;
+        return false;
+    }
+
+    shadow.m_Value = value;
+    shadow.m_IsKnown = true;
+
+    m_Stats.m_IssuedCalls++;
+    return true;
+}
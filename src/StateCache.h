@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <d3d11.h>
+
+class Backend;
+
+struct StateCacheStats final
+{
+    UINT m_IssuedCalls{ 0 };
+    UINT m_ElidedCalls{ 0 }; // Would have bound what is already bound
+};
+
+// Shadow copy of the pipeline state bound through it. Calls that would bind the state already in place
+// are dropped before they reach the backend. Shader resources are forgotten whenever render targets change,
+// the runtime unbinds inputs aliasing new outputs without telling us.
+class StateCache final
+{
+public:
+    StateCache(Backend& backend);
+
+    // The next call of every kind is issued
+    void Invalidate();
+
+    // Flip model swap chains unbind the back buffer on Present
+    void InvalidateRenderTargets();
+
+    void SetPipeline(ID3D11VertexShader* vertexShader, ID3D11PixelShader* pixelShader, ID3D11InputLayout* inputLayout);
+    void SetVertexBuffer(UINT slot, ID3D11Buffer* buffer, UINT stride, UINT offset);
+    void SetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset);
+    void SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology);
+
+    // A non-zero constant count binds a window of the buffer, in 16-byte constants
+    void SetVertexConstantBuffer(UINT slot, ID3D11Buffer* buffer, UINT firstConstant = 0, UINT constantCount = 0);
+    void SetPixelConstantBuffer(UINT slot, ID3D11Buffer* buffer, UINT firstConstant = 0, UINT constantCount = 0);
+    void SetPixelShaderResource(UINT slot, ID3D11ShaderResourceView* view);
+    void SetPixelSampler(UINT slot, ID3D11SamplerState* sampler);
+
+    void SetRasterizerState(ID3D11RasterizerState* state);
+    void SetViewport(const D3D11_VIEWPORT& viewport);
+    void SetScissorRect(const D3D11_RECT& rect);
+
+    void SetRenderTargets(UINT count, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthStencilView);
+    void SetBlendState(ID3D11BlendState* state);
+
+    const StateCacheStats& GetStats() const;
+    void ResetStats();
+
+private:
+    template <typename T>
+    struct Shadow
+    {
+        T m_Value{ };
+        bool m_IsKnown{ false };
+    };
+
+    struct VertexBufferBinding
+    {
+        ID3D11Buffer* m_Buffer;
+        UINT m_Stride;
+        UINT m_Offset;
+
+        bool operator==(const VertexBufferBinding& other) const;
+    };
+
+    struct IndexBufferBinding
+    {
+        ID3D11Buffer* m_Buffer;
+        DXGI_FORMAT m_Format;
+        UINT m_Offset;
+
+        bool operator==(const IndexBufferBinding& other) const;
+    };
+
+    struct ConstantBufferBinding
+    {
+        ID3D11Buffer* m_Buffer;
+        UINT m_FirstConstant;
+        UINT m_ConstantCount; // Whole buffer if zero
+
+        bool operator==(const ConstantBufferBinding& other) const;
+    };
+
+    struct RenderTargetsBinding
+    {
+        UINT m_Count;
+        ID3D11RenderTargetView* m_Views[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT];
+        ID3D11DepthStencilView* m_DepthStencilView;
+
+        bool operator==(const RenderTargetsBinding& other) const;
+    };
+
+    // Returns true and records the value if the call has to be issued
+    template <typename T>
+    bool Update(Shadow<T>& shadow, const T& value);
+
+    Backend& m_Backend;
+
+    Shadow<ID3D11VertexShader*> m_VertexShader;
+    Shadow<ID3D11PixelShader*> m_PixelShader;
+    Shadow<ID3D11InputLayout*> m_InputLayout;
+    Shadow<VertexBufferBinding> m_VertexBuffers[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+    Shadow<IndexBufferBinding> m_IndexBuffer;
+    Shadow<D3D11_PRIMITIVE_TOPOLOGY> m_Topology;
+
+    Shadow<ConstantBufferBinding> m_VertexConstantBuffers[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+    Shadow<ConstantBufferBinding> m_PixelConstantBuffers[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+    Shadow<ID3D11ShaderResourceView*> m_PixelShaderResources[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT];
+    Shadow<ID3D11SamplerState*> m_PixelSamplers[D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT];
+
+    Shadow<ID3D11RasterizerState*> m_RasterizerState;
+    Shadow<D3D11_VIEWPORT> m_Viewport;
+    Shadow<D3D11_RECT> m_ScissorRect;
+
+    Shadow<RenderTargetsBinding> m_RenderTargets;
+    Shadow<ID3D11BlendState*> m_BlendState;
+
+    StateCacheStats m_Stats{ };
+};
@@ -23,7 +23,6 @@
 #include "Texture.h"
 #include "Device.h"
 #include <windows.h>
-#include <DDSTextureLoader.h>
 #include <cassert>
 
 Texture::Texture(DX11Device& device, UINT slot)
@@ -33,21 +32,19 @@ Texture::Texture(DX11Device& device, UINT slot)
 
 void Texture::Enable()
 {
-    ID3D11DeviceContext& deviceContext = m_Device.GetContext();
+    CommandBuffer& commandBuffer = m_Device.GetCommandBuffer();
 
     {
-        ID3D11ShaderResourceView* resourceViews[] = { m_ShaderView.Get() };
-        deviceContext.PSSetShaderResources(m_ResourceSlot, 1, resourceViews);
+        commandBuffer.SetPixelShaderResource(m_ResourceSlot, m_ShaderView.Get());
     }
 }
 
 void Texture::Disable()
 {
-    ID3D11DeviceContext& deviceContext = m_Device.GetContext();
+    CommandBuffer& commandBuffer = m_Device.GetCommandBuffer();
 
     {
-        ID3D11ShaderResourceView* resourceViews[] = { nullptr };
-        deviceContext.PSSetShaderResources(m_ResourceSlot, 1, resourceViews);
+        commandBuffer.SetPixelShaderResource(m_ResourceSlot, nullptr);
     }
 }
 
@@ -56,10 +53,10 @@ ID3D11ShaderResourceView& Texture::GetShaderView() const
     return *m_ShaderView.Get();
 }
 
-GeometryTexture::GeometryTexture(DX11Device& device, UINT slot, UINT width, UINT height)
+GeometryTexture::GeometryTexture(DX11Device& device, UINT slot, UINT width, UINT height, DXGI_FORMAT format)
     : Texture(device, slot)
 {
-    ID3D11Device& deviceHandle = m_Device.GetHandle();
+    Backend& backend = m_Device.GetBackend();
 
     {
         D3D11_TEXTURE2D_DESC textureDesc{ };
@@ -67,19 +64,19 @@ GeometryTexture::GeometryTexture(DX11Device& device, UINT slot, UINT width, UINT
         textureDesc.Height = height;
         textureDesc.MipLevels = 1;
         textureDesc.ArraySize = 1;
-        textureDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+        textureDesc.Format = format;
         textureDesc.Usage = D3D11_USAGE_DEFAULT;
         textureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
         textureDesc.SampleDesc.Count = 1;
         textureDesc.SampleDesc.Quality = 0;
 
-        HRESULT hr = deviceHandle.CreateTexture2D(&textureDesc, 0, &m_Texture);
+        HRESULT hr = backend.CreateTexture2D(&textureDesc, 0, &m_Texture);
         assert(SUCCEEDED(hr));
 
-        hr = deviceHandle.CreateShaderResourceView(m_Texture.Get(), nullptr, &m_ShaderView);
+        hr = backend.CreateShaderResourceView(m_Texture.Get(), nullptr, &m_ShaderView);
         assert(SUCCEEDED(hr));
 
-        hr = deviceHandle.CreateRenderTargetView(m_Texture.Get(), nullptr, &m_RenderView);
+        hr = backend.CreateRenderTargetView(m_Texture.Get(), nullptr, &m_RenderView);
         assert(SUCCEEDED(hr));
     }
 }
@@ -92,7 +89,7 @@ ID3D11RenderTargetView& GeometryTexture::GetRenderView() const
 DepthStencilTexture::DepthStencilTexture(DX11Device& device, UINT slot, UINT width, UINT height)
     : Texture(device, slot)
 {
-    ID3D11Device& deviceHandle = m_Device.GetHandle();
+    Backend& backend = m_Device.GetBackend();
 
     {
         D3D11_TEXTURE2D_DESC depthStencilDesc{ };
@@ -100,16 +97,28 @@ DepthStencilTexture::DepthStencilTexture(DX11Device& device, UINT slot, UINT wid
         depthStencilDesc.Height = height;
         depthStencilDesc.MipLevels = 1;
         depthStencilDesc.ArraySize = 1;
-        depthStencilDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+        depthStencilDesc.Format = DXGI_FORMAT_R24G8_TYPELESS; // Depth and shader views differ in format
         depthStencilDesc.Usage = D3D11_USAGE_DEFAULT;
-        depthStencilDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+        depthStencilDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
         depthStencilDesc.SampleDesc.Count = 1;
         depthStencilDesc.SampleDesc.Quality = 0;
 
-        HRESULT hr = deviceHandle.CreateTexture2D(&depthStencilDesc, 0, &m_Texture);
+        HRESULT hr = backend.CreateTexture2D(&depthStencilDesc, 0, &m_Texture);
         assert(SUCCEEDED(hr));
 
-        hr = deviceHandle.CreateDepthStencilView(m_Texture.Get(), nullptr, &m_DepthStencilView);
+        D3D11_DEPTH_STENCIL_VIEW_DESC depthStencilViewDesc{ };
+        depthStencilViewDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+        depthStencilViewDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+
+        hr = backend.CreateDepthStencilView(m_Texture.Get(), &depthStencilViewDesc, &m_DepthStencilView);
+        assert(SUCCEEDED(hr));
+
+        D3D11_SHADER_RESOURCE_VIEW_DESC shaderViewDesc{ };
+        shaderViewDesc.Format = DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
+        shaderViewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+        shaderViewDesc.Texture2D.MipLevels = 1;
+
+        hr = backend.CreateShaderResourceView(m_Texture.Get(), &shaderViewDesc, &m_ShaderView);
         assert(SUCCEEDED(hr));
     }
 }
@@ -122,10 +131,10 @@ ID3D11DepthStencilView& DepthStencilTexture::GetDepthStencilView() const
 ImageTexture::ImageTexture(DX11Device& device, UINT slot, const std::wstring& source)
     : Texture(device, slot)
 {
-    ID3D11Device& deviceHandle = m_Device.GetHandle();
+    Backend& backend = m_Device.GetBackend();
 
     {
-        HRESULT hr = DirectX::CreateDDSTextureFromFile(&deviceHandle, source.c_str(), nullptr, m_ShaderView.GetAddressOf());
+        HRESULT hr = backend.CreateTextureFromFile(source.c_str(), m_ShaderView.GetAddressOf());
         assert(SUCCEEDED(hr));
     }
 }
@@ -48,7 +48,7 @@ protected:
 class GeometryTexture final : public Texture
 {
 public:
-    GeometryTexture(DX11Device& device, UINT slot, UINT width, UINT height);
+    GeometryTexture(DX11Device& device, UINT slot, UINT width, UINT height, DXGI_FORMAT format = DXGI_FORMAT_R32G32B32A32_FLOAT);
 
     ID3D11RenderTargetView& GetRenderView() const;
 
@@ -57,6 +57,7 @@ private:
     Microsoft::WRL::ComPtr<ID3D11RenderTargetView> m_RenderView;
 };
 
+// Depth is readable by shaders as DXGI_FORMAT_R24_UNORM_X8_TYPELESS
 class DepthStencilTexture final : public Texture
 {
 public:
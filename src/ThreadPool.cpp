@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threads)
+{
+    // Calling thread is the first one, workers make up the rest
+    size_t workers = std::max<size_t>(threads, 1) - 1;
+
+    for (size_t worker = 0; worker < workers; worker++)
+        m_Workers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Terminate = true;
+    }
+
+    m_WakeCondition.notify_all();
+
+    for (std::thread& worker : m_Workers)
+        worker.join();
+}
+
+size_t ThreadPool::GetThreadCount() const
+{
+    return m_Workers.size() + 1;
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& task)
+{
+    if (count == 0)
+        return;
+
+    if (count == 1 || m_Workers.empty())
+    {
+        for (size_t index = 0; index < count; index++)
+            task(index);
+
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        m_Task = &task;
+        m_TaskCount = count;
+        m_NextTask = 0;
+        m_BusyWorkers = m_Workers.size();
+        m_Generation++;
+    }
+
+    m_WakeCondition.notify_all();
+    RunTasks();
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_DoneCondition.wait(lock, [this] { return m_BusyWorkers == 0; });
+    m_Task = nullptr;
+}
+
+void ThreadPool::WorkerLoop()
+{
+    size_t generation = 0;
+    std::unique_lock<std::mutex> lock(m_Mutex);
+
+    while (!m_Terminate)
+    {
+        if (m_Generation == generation)
+        {
+            m_WakeCondition.wait(lock);
+            continue;
+        }
+
+        generation = m_Generation;
+
+        lock.unlock();
+        RunTasks();
+        lock.lock();
+
+        if (--m_BusyWorkers == 0)
+            m_DoneCondition.notify_one();
+    }
+}
+
+void ThreadPool::RunTasks()
+{
+    const std::function<void(size_t)>& task = *m_Task;
+
+    for (size_t index = m_NextTask++; index < m_TaskCount; index = m_NextTask++)
+        task(index);
+}
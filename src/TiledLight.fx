@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma pack_matrix(row_major) // DirectXMath uses row-major matrices
+
+#ifdef VERTEX_SHADER
+
+struct VertexInput
+{
+    float3 position : POSITION;
+    float3 normal : NORMAL;
+    float2 texcoord : TEXCOORD;
+};
+
+struct VertexOutput
+{
+    float4 position : SV_POSITION; // System Value
+    float2 texcoord : TEXCOORD;
+};
+
+VertexOutput Main(VertexInput input)
+{
+    VertexOutput output;
+
+    output.position = float4(input.position, 1.0f);
+    output.texcoord = input.texcoord;
+
+    return output;
+}
+
+#endif // VERTEX_SHADER
+
+#ifdef PIXEL_SHADER
+
+#define LIGHT_AMBIENT   0
+#define LIGHT_DIRECTION 1
+#define LIGHT_POINT     2
+#define LIGHT_SPOT      3
+
+struct TiledLight
+{
+    int type;
+    float3 color;
+    float intensity;
+    float falloff;
+    float spotAngle;
+    float spotBorder;
+    float4 position;
+    float4 direction;
+};
+
+#include "GeometryBuffer.fxh"
+
+StructuredBuffer<TiledLight> tiledLights : register(t5);
+StructuredBuffer<uint> tileLightIndices : register(t6);
+StructuredBuffer<uint2> tileLightRanges : register(t7); // Offset into tileLightIndices and count per cluster
+
+cbuffer LightGrid : register(b2)
+{
+    uint gridTileSize;
+    uint gridTilesX;
+    uint gridTilesY;
+    uint gridSlices;
+    float4 gridViewForward;
+    float gridSliceScale;
+    float gridSliceBias;
+};
+
+struct PixelInput
+{
+    float4 position : SV_POSITION; // System Value
+    float2 texcoord : TEXCOORD;
+};
+
+struct PixelOutput
+{
+    float4 color : SV_Target0; // System Value
+};
+
+// AmbientLight.fx for ambient lights and DynamicLight.fx for the rest
+float4 ShadeLight(TiledLight light, float4 diffuseSample, float4 specularSample, float4 positionSample, float4 normalSample)
+{
+    float3 lightColor = mul(light.color, light.intensity);
+
+    if (light.type == LIGHT_AMBIENT)
+        return float4(diffuseSample.rgb * diffuseSample.a * lightColor, 1.0f);
+
+    float3 pixelDiffuseColor = mul(diffuseSample.rgb, specularSample.a);
+    float3 pixelSpecularColor = mul(specularSample.rgb, positionSample.a);
+
+    float3 pixelPosition = positionSample.xyz;
+    float3 pixelNormal = normalize(normalSample.xyz);
+
+    float3 directionFromLight = normalize(light.type == LIGHT_POINT ? pixelPosition - light.position.xyz : light.direction.xyz);
+
+    float diffuseLightIntensity = max(dot(-directionFromLight, pixelNormal), 0.0f);
+
+    float3 lightReflection = reflect(directionFromLight, pixelNormal);
+    float3 directionToCamera = normalize(cameraPosition.xyz - pixelPosition);
+
+    int specularHardness = normalSample.a;
+    float specularLightIntensity = max(dot(directionToCamera, lightReflection), 0.0f);
+    specularLightIntensity = pow(specularLightIntensity, specularHardness);
+
+    if (light.type == LIGHT_SPOT)
+    {
+        float3 directionFromLightToPixel = normalize(pixelPosition - light.position.xyz);
+        float lightAngleCos = max(dot(directionFromLight, directionFromLightToPixel), 0.0f);
+
+        float lightHardAngleCos = cos(light.spotAngle * (1.0f - light.spotBorder));
+        float lightSoftAngleCos = cos(light.spotAngle);
+        float spotIntensity = saturate((lightSoftAngleCos - lightAngleCos) / (lightSoftAngleCos - lightHardAngleCos));
+
+        diffuseLightIntensity *= spotIntensity;
+        specularLightIntensity *= spotIntensity;
+    }
+
+    if (light.type != LIGHT_DIRECTION)
+    {
+        float lightFalloffSquare = pow(light.falloff, 2);
+        float lightDistanceSquare = pow(distance(pixelPosition, light.position.xyz), 2);
+        float lightFalloff = lightFalloffSquare / (lightFalloffSquare + lightDistanceSquare);
+
+        diffuseLightIntensity *= lightFalloff;
+        specularLightIntensity *= lightFalloff;
+    }
+
+    float3 color = (pixelDiffuseColor * diffuseLightIntensity + pixelSpecularColor * specularLightIntensity) * lightColor;
+    return float4(color, diffuseLightIntensity + specularLightIntensity);
+}
+
+PixelOutput Main(PixelInput input)
+{
+    float4 diffuseSample, specularSample, positionSample, normalSample;
+    SampleGeometry(input.texcoord, diffuseSample, specularSample, positionSample, normalSample);
+
+    // Exponential depth slices, background and pixels closer than the near plane go to the first one
+    float viewDepth = dot(positionSample.xyz - cameraPosition.xyz, gridViewForward.xyz);
+    float slice = log(max(viewDepth, 1e-4f)) * gridSliceScale + gridSliceBias;
+
+    uint2 tile = uint2(input.position.xy) / gridTileSize;
+    uint cluster = (min(uint(max(slice, 0.0f)), gridSlices - 1) * gridTilesY + tile.y) * gridTilesX + tile.x;
+    uint2 range = tileLightRanges[cluster];
+
+    // Same result as one blended pass per light: FrameBuffer is cleared to opaque black,
+    // every light is blended with SRC_ALPHA / INV_SRC_ALPHA after unorm clamping
+    float3 frameColor = float3(0.0f, 0.0f, 0.0f);
+
+    for (uint index = 0; index < range.y; index++)
+    {
+        TiledLight light = tiledLights[tileLightIndices[range.x + index]];
+
+        float4 lightColor = saturate(ShadeLight(light, diffuseSample, specularSample, positionSample, normalSample));
+        frameColor = lerp(frameColor, lightColor.rgb, lightColor.a);
+    }
+
+    PixelOutput output;
+    output.color = float4(frameColor, 1.0f);
+    return output;
+}
+
+#endif // PIXEL_SHADER
@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "TransformHierarchy.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+
+namespace
+{
+    // values[index] = values[order[index]]
+    template <typename T>
+    void Reorder(std::vector<T>& values, const std::vector<UINT>& order)
+    {
+        std::vector<T> reordered;
+        reordered.reserve(values.size());
+
+        for (UINT index : order)
+            reordered.push_back(values[index]);
+
+        values.swap(reordered);
+    }
+}
+
+TransformHierarchy::TransformHierarchy(ThreadPool& threadPool)
+    : m_ThreadPool(threadPool)
+{ }
+
+TransformId TransformHierarchy::Create(TransformId parent)
+{
+    UINT index = GetCount();
+    UINT parentIndex = s_None;
+    UINT depth = 0;
+
+    if (parent != s_None)
+    {
+        assert(parent < m_Indices.size());
+        parentIndex = m_Indices[parent];
+        depth = m_Depths[parentIndex] + 1;
+    }
+
+    TransformId id = static_cast<TransformId>(m_Indices.size());
+    m_Indices.push_back(index);
+
+    m_Ids.push_back(id);
+    m_Parents.push_back(parentIndex);
+    m_Depths.push_back(depth);
+
+    m_Rotations.push_back({ 0.0f, 0.0f, 0.0f, 1.0f });
+    m_Scalings.push_back({ 1.0f, 1.0f, 1.0f });
+    m_Positions.push_back({ 0.0f, 0.0f, 0.0f });
+
+    DirectX::XMFLOAT4X4& world = m_Worlds.emplace_back();
+    DirectX::XMStoreFloat4x4(&world, DirectX::XMMatrixIdentity());
+
+    m_WorldScales.push_back(1.0f);
+    m_Versions.push_back(0);
+    m_Dirty.push_back(1);
+
+    m_IsLayoutDirty = true;
+    return id;
+}
+
+TransformId TransformHierarchy::GetParent(TransformId id) const
+{
+    UINT parent = m_Parents[m_Indices[id]];
+    return parent != s_None ? m_Ids[parent] : s_None;
+}
+
+UINT TransformHierarchy::GetCount() const
+{
+    return static_cast<UINT>(m_Ids.size());
+}
+
+DirectX::XMVECTOR TransformHierarchy::GetRotation(TransformId id) const
+{
+    return DirectX::XMLoadFloat4(&m_Rotations[m_Indices[id]]);
+}
+
+void TransformHierarchy::Rotate(TransformId id, const DirectX::XMVECTOR& axis, float angle)
+{
+    DirectX::XMFLOAT4& rotation = m_Rotations[m_Indices[id]];
+
+    // The new rotation is applied after the current one
+    DirectX::XMVECTOR quaternion = DirectX::XMQuaternionMultiply(DirectX::XMLoadFloat4(&rotation), DirectX::XMQuaternionRotationAxis(axis, DirectX::XMConvertToRadians(angle)));
+    DirectX::XMStoreFloat4(&rotation, DirectX::XMQuaternionNormalize(quaternion));
+
+    Invalidate(id);
+}
+
+DirectX::XMVECTOR TransformHierarchy::GetScaling(TransformId id) const
+{
+    return DirectX::XMLoadFloat3(&m_Scalings[m_Indices[id]]);
+}
+
+void TransformHierarchy::Scale(TransformId id, const DirectX::XMVECTOR& scaling)
+{
+    DirectX::XMFLOAT3& current = m_Scalings[m_Indices[id]];
+    DirectX::XMStoreFloat3(&current, DirectX::XMVectorMultiply(DirectX::XMLoadFloat3(&current), scaling));
+
+    Invalidate(id);
+}
+
+DirectX::XMVECTOR TransformHierarchy::GetPosition(TransformId id) const
+{
+    return DirectX::XMLoadFloat3(&m_Positions[m_Indices[id]]);
+}
+
+void TransformHierarchy::Move(TransformId id, const DirectX::XMVECTOR& position)
+{
+    DirectX::XMFLOAT3& current = m_Positions[m_Indices[id]];
+    DirectX::XMStoreFloat3(&current, DirectX::XMVectorAdd(DirectX::XMLoadFloat3(&current), position));
+
+    Invalidate(id);
+}
+
+DirectX::XMMATRIX TransformHierarchy::GetWorld(TransformId id) const
+{
+    return DirectX::XMLoadFloat4x4(&m_Worlds[m_Indices[id]]);
+}
+
+DirectX::XMVECTOR TransformHierarchy::GetWorldPosition(TransformId id) const
+{
+    const DirectX::XMFLOAT4X4& world = m_Worlds[m_Indices[id]];
+    return DirectX::XMVectorSet(world.m[3][0], world.m[3][1], world.m[3][2], 1.0f);
+}
+
+float TransformHierarchy::GetWorldScale(TransformId id) const
+{
+    return m_WorldScales[m_Indices[id]];
+}
+
+UINT TransformHierarchy::GetVersion(TransformId id) const
+{
+    return m_Versions[m_Indices[id]];
+}
+
+UINT TransformHierarchy::Update()
+{
+    if (m_IsLayoutDirty)
+        Sort();
+
+    std::atomic<UINT> updates{ 0 };
+
+    // A level only reads worlds and dirty flags of the level above, complete once ParallelFor returns
+    for (size_t level = 0; level + 1 < m_LevelStarts.size(); level++)
+    {
+        UINT first = m_LevelStarts[level];
+        UINT last = m_LevelStarts[level + 1];
+        UINT batches = (last - first + s_BatchSize - 1) / s_BatchSize;
+
+        // Small levels run on the calling thread
+        m_ThreadPool.ParallelFor(batches, [&](size_t batch)
+        {
+            UINT batchFirst = first + static_cast<UINT>(batch) * s_BatchSize;
+            updates += UpdateRange(batchFirst, (std::min)(batchFirst + s_BatchSize, last));
+        });
+    }
+
+    // Nothing is dirty if nothing was rebuilt
+    if (updates > 0)
+        std::fill(m_Dirty.begin(), m_Dirty.end(), static_cast<BYTE>(0));
+
+    return updates;
+}
+
+void TransformHierarchy::Invalidate(TransformId id)
+{
+    m_Dirty[m_Indices[id]] = 1;
+}
+
+void TransformHierarchy::Sort()
+{
+    UINT count = GetCount();
+    UINT levels = count > 0 ? *std::max_element(m_Depths.begin(), m_Depths.end()) + 1 : 0;
+
+    // Counting sort by depth, nodes of a level keep their creation order
+    std::vector<UINT> levelStarts(levels + 1, 0);
+    for (UINT depth : m_Depths)
+        levelStarts[depth + 1]++;
+
+    for (UINT level = 0; level < levels; level++)
+        levelStarts[level + 1] += levelStarts[level];
+
+    std::vector<UINT> order(count);
+    std::vector<UINT> next(levelStarts.begin(), levelStarts.end() - 1);
+
+    for (UINT index = 0; index < count; index++)
+        order[next[m_Depths[index]]++] = index;
+
+    // Parents refer to node indices, which change along with the order
+    std::vector<UINT> newIndices(count);
+    for (UINT index = 0; index < count; index++)
+        newIndices[order[index]] = index;
+
+    for (UINT& parent : m_Parents)
+    {
+        if (parent != s_None)
+            parent = newIndices[parent];
+    }
+
+    Reorder(m_Ids, order);
+    Reorder(m_Parents, order);
+    Reorder(m_Depths, order);
+    Reorder(m_Rotations, order);
+    Reorder(m_Scalings, order);
+    Reorder(m_Positions, order);
+    Reorder(m_Worlds, order);
+    Reorder(m_WorldScales, order);
+    Reorder(m_Versions, order);
+    Reorder(m_Dirty, order);
+
+    for (UINT index = 0; index < count; index++)
+        m_Indices[m_Ids[index]] = index;
+
+    m_LevelStarts.swap(levelStarts);
+    m_IsLayoutDirty = false;
+}
+
+UINT TransformHierarchy::UpdateRange(UINT first, UINT last)
+{
+    UINT updates = 0;
+
+    for (UINT index = first; index < last; index++)
+    {
+        UINT parent = m_Parents[index];
+
+        // Parents were visited a level earlier, their flags are still set
+        if (parent != s_None && m_Dirty[parent])
+            m_Dirty[index] = 1;
+
+        if (!m_Dirty[index])
+            continue;
+
+        const DirectX::XMFLOAT3& scaling = m_Scalings[index];
+
+        DirectX::XMMATRIX world = DirectX::XMMatrixScaling(scaling.x, scaling.y, scaling.z) *
+            DirectX::XMMatrixRotationQuaternion(DirectX::XMLoadFloat4(&m_Rotations[index])) *
+            DirectX::XMMatrixTranslationFromVector(DirectX::XMLoadFloat3(&m_Positions[index]));
+
+        // Uniform scale survives only if the whole chain scales uniformly
+        float worldScale = scaling.x == scaling.y && scaling.x == scaling.z ? scaling.x : 0.0f;
+
+        if (parent != s_None)
+        {
+            world = world * DirectX::XMLoadFloat4x4(&m_Worlds[parent]);
+            worldScale *= m_WorldScales[parent];
+        }
+
+        DirectX::XMStoreFloat4x4(&m_Worlds[index], world);
+        m_WorldScales[index] = worldScale;
+        m_Versions[index]++;
+        updates++;
+    }
+
+    return updates;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <windows.h>
+#include <DirectXMath.h>
+#include <vector>
+
+class ThreadPool;
+
+// Stable handle of a node, indices into the node arrays change when they are reordered
+using TransformId = UINT;
+
+// Scene graph of local scale, rotation and translation. Nodes are kept as parallel arrays sorted by depth,
+// so parents always precede their children and every depth level is a contiguous range. Update() walks the
+// levels top down, a node is rebuilt if it or any of its ancestors changed, nodes of a level in parallel.
+class TransformHierarchy final
+{
+public:
+    static constexpr TransformId s_None = ~0u;
+    static constexpr UINT s_BatchSize = 1024; // Nodes per thread pool task
+
+    TransformHierarchy(ThreadPool& threadPool);
+
+    // Nodes are placed relative to their parent, which has to exist already
+    TransformId Create(TransformId parent = s_None);
+
+    TransformId GetParent(TransformId id) const;
+    UINT GetCount() const;
+
+    // Local transform, scale is applied first and translation last
+    DirectX::XMVECTOR GetRotation(TransformId id) const; // Quaternion
+    void Rotate(TransformId id, const DirectX::XMVECTOR& axis, float angle);
+
+    DirectX::XMVECTOR GetScaling(TransformId id) const;
+    void Scale(TransformId id, const DirectX::XMVECTOR& scaling);
+
+    DirectX::XMVECTOR GetPosition(TransformId id) const;
+    void Move(TransformId id, const DirectX::XMVECTOR& position);
+
+    // As of the last Update()
+    DirectX::XMMATRIX GetWorld(TransformId id) const;
+    DirectX::XMVECTOR GetWorldPosition(TransformId id) const;
+    float GetWorldScale(TransformId id) const; // Zero unless the node and all its ancestors scale uniformly
+    UINT GetVersion(TransformId id) const;     // Bumped whenever the world matrix is rebuilt
+
+    // Rebuilds world matrices of changed nodes and their descendants, returns how many were rebuilt
+    UINT Update();
+
+private:
+    void Invalidate(TransformId id);
+    void Sort();
+    UINT UpdateRange(UINT first, UINT last);
+
+    ThreadPool& m_ThreadPool;
+
+    // Node arrays in depth order
+    std::vector<TransformId> m_Ids;
+    std::vector<UINT> m_Parents; // Index of the parent node, s_None for roots
+    std::vector<UINT> m_Depths;
+
+    std::vector<DirectX::XMFLOAT4> m_Rotations;
+    std::vector<DirectX::XMFLOAT3> m_Scalings;
+    std::vector<DirectX::XMFLOAT3> m_Positions;
+
+    std::vector<DirectX::XMFLOAT4X4> m_Worlds;
+    std::vector<float> m_WorldScales;
+    std::vector<UINT> m_Versions;
+    std::vector<BYTE> m_Dirty; // Bytes, neighbours are written by different threads
+
+    std::vector<UINT> m_Indices;     // Node index of every id
+    std::vector<UINT> m_LevelStarts; // First node of every depth and the node count
+    bool m_IsLayoutDirty{ false };   // Nodes were created since the last Update()
+};
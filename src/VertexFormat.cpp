@@ -0,0 +1,415 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "VertexFormat.h"
+#include "GeometryPacking.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cassert>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif // __AVX2__
+
+namespace
+{
+    const D3D11_INPUT_ELEMENT_DESC s_FullElements[] =
+    {
+        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,  D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "NORMAL",   0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 }, // Offset for R32G32B32 (POSITION)
+        { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,    0, 24, D3D11_INPUT_PER_VERTEX_DATA, 0 }  // Offset for R32G32B32 + R32G32B32 (POSITION + NORMAL)
+    };
+
+    const D3D11_INPUT_ELEMENT_DESC s_QuantizedElements[] =
+    {
+        { "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0,  D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "NORMAL",   0, DXGI_FORMAT_R16G16_SNORM,       0, 8,  D3D11_INPUT_PER_VERTEX_DATA, 0 }, // Offset for R16G16B16A16 (POSITION)
+        { "TEXCOORD", 0, DXGI_FORMAT_R16G16_UNORM,       0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 }  // Offset for R16G16B16A16 + R16G16 (POSITION + NORMAL)
+    };
+
+    const D3D11_INPUT_ELEMENT_DESC s_HalfElements[] =
+    {
+        { "POSITION", 0, DXGI_FORMAT_R16G16B16A16_FLOAT, 0, 0,  D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "NORMAL",   0, DXGI_FORMAT_R16G16_SNORM,       0, 8,  D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT,       0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+    };
+
+    constexpr float s_UnormScale = 65535.0f;
+    constexpr float s_SnormScale = 32767.0f;
+
+    // Round to nearest even, as the F16C conversion does
+    USHORT FloatToHalf(float value)
+    {
+        UINT bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+
+        UINT sign = (bits >> 16) & 0x8000;
+        UINT magnitude = bits & 0x7FFFFFFF;
+
+        // Infinity stays, NaN is quieted and keeps the top of its payload
+        if (magnitude >= 0x7F800000)
+            return static_cast<USHORT>(sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x0200 | ((magnitude >> 13) & 0x03FF) : 0));
+
+        // 65520 and above round to infinity
+        if (magnitude >= 0x477FF000)
+            return static_cast<USHORT>(sign | 0x7C00);
+
+        // Below 2^-14 the half is denormal, counted in units of 2^-24
+        if (magnitude < 0x38800000)
+        {
+            UINT exponent = magnitude >> 23;
+            UINT shift = 126 - exponent;
+
+            if (shift > 24)
+                return static_cast<USHORT>(sign);
+
+            UINT mantissa = (magnitude & 0x007FFFFF) | 0x00800000;
+            UINT half = mantissa >> shift;
+            UINT remainder = mantissa & ((1u << shift) - 1);
+            UINT halfway = 1u << (shift - 1);
+
+            if (remainder > halfway || (remainder == halfway && (half & 1)))
+                half++;
+
+            return static_cast<USHORT>(sign | half);
+        }
+
+        // Rebias the exponent, a mantissa carry moves into the exponent as it should
+        UINT half = (magnitude >> 13) - ((127 - 15) << 10);
+        UINT remainder = magnitude & 0x1FFF;
+
+        if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+            half++;
+
+        return static_cast<USHORT>(sign | half);
+    }
+
+    float HalfToFloat(USHORT value)
+    {
+        UINT sign = static_cast<UINT>(value & 0x8000) << 16;
+        UINT exponent = (value >> 10) & 0x1F;
+        UINT mantissa = value & 0x03FF;
+        UINT bits;
+
+        if (exponent == 0x1F)
+            bits = sign | 0x7F800000 | (mantissa << 13);
+        else if (exponent != 0)
+            bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+        else
+        {
+            // Denormals are exact in float
+            float magnitude = static_cast<float>(mantissa) * (1.0f / 16777216.0f);
+            return sign ? -magnitude : magnitude;
+        }
+
+        float result;
+        std::memcpy(&result, &bits, sizeof(result));
+        return result;
+    }
+
+    // Both paths convert with the current rounding mode, nearest even unless changed
+    SHORT QuantizeSnorm(float value)
+    {
+        value = (std::min)((std::max)(value * s_SnormScale, -s_SnormScale), s_SnormScale);
+        return static_cast<SHORT>(std::lrint(value));
+    }
+
+    USHORT QuantizeUnorm(float value)
+    {
+        value = (std::min)((std::max)(value, 0.0f), s_UnormScale);
+        return static_cast<USHORT>(std::lrint(value));
+    }
+
+    void EncodeScalar(VertexFormat format, const Vertex* vertices, UINT count, const float* offset, const float* scale, CompactVertex* output)
+    {
+        for (UINT index = 0; index < count; index++)
+        {
+            const Vertex& vertex = vertices[index];
+            CompactVertex& compact = output[index];
+
+            const float position[3] = { vertex.Position.x, vertex.Position.y, vertex.Position.z };
+
+            if (format == VertexFormat::Quantized)
+            {
+                for (UINT axis = 0; axis < 3; axis++)
+                    compact.Position[axis] = QuantizeUnorm((position[axis] - offset[axis]) * scale[axis]);
+
+                compact.TexCoord[0] = QuantizeUnorm(vertex.TexCoord.x * s_UnormScale);
+                compact.TexCoord[1] = QuantizeUnorm(vertex.TexCoord.y * s_UnormScale);
+            }
+            else
+            {
+                for (UINT axis = 0; axis < 3; axis++)
+                    compact.Position[axis] = FloatToHalf(position[axis]);
+
+                compact.TexCoord[0] = FloatToHalf(vertex.TexCoord.x);
+                compact.TexCoord[1] = FloatToHalf(vertex.TexCoord.y);
+            }
+
+            compact.Position[3] = 0;
+
+            DirectX::XMFLOAT2 octahedron = GeometryPacking::FoldOctahedral(vertex.Normal);
+            compact.Normal[0] = QuantizeSnorm(octahedron.x);
+            compact.Normal[1] = QuantizeSnorm(octahedron.y);
+        }
+    }
+
+#if defined(__AVX2__)
+    // Rows of eight floats become columns, turns eight vertices into eight attribute streams and back
+    void Transpose8x8(__m256 rows[8])
+    {
+        __m256 low0 = _mm256_unpacklo_ps(rows[0], rows[1]);
+        __m256 high0 = _mm256_unpackhi_ps(rows[0], rows[1]);
+        __m256 low1 = _mm256_unpacklo_ps(rows[2], rows[3]);
+        __m256 high1 = _mm256_unpackhi_ps(rows[2], rows[3]);
+        __m256 low2 = _mm256_unpacklo_ps(rows[4], rows[5]);
+        __m256 high2 = _mm256_unpackhi_ps(rows[4], rows[5]);
+        __m256 low3 = _mm256_unpacklo_ps(rows[6], rows[7]);
+        __m256 high3 = _mm256_unpackhi_ps(rows[6], rows[7]);
+
+        __m256 quad0 = _mm256_shuffle_ps(low0, low1, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 quad1 = _mm256_shuffle_ps(low0, low1, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 quad2 = _mm256_shuffle_ps(high0, high1, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 quad3 = _mm256_shuffle_ps(high0, high1, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 quad4 = _mm256_shuffle_ps(low2, low3, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 quad5 = _mm256_shuffle_ps(low2, low3, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 quad6 = _mm256_shuffle_ps(high2, high3, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 quad7 = _mm256_shuffle_ps(high2, high3, _MM_SHUFFLE(3, 2, 3, 2));
+
+        rows[0] = _mm256_permute2f128_ps(quad0, quad4, 0x20);
+        rows[1] = _mm256_permute2f128_ps(quad1, quad5, 0x20);
+        rows[2] = _mm256_permute2f128_ps(quad2, quad6, 0x20);
+        rows[3] = _mm256_permute2f128_ps(quad3, quad7, 0x20);
+        rows[4] = _mm256_permute2f128_ps(quad0, quad4, 0x31);
+        rows[5] = _mm256_permute2f128_ps(quad1, quad5, 0x31);
+        rows[6] = _mm256_permute2f128_ps(quad2, quad6, 0x31);
+        rows[7] = _mm256_permute2f128_ps(quad3, quad7, 0x31);
+    }
+
+    __m256i QuantizeUnorm8(__m256 value)
+    {
+        value = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(s_UnormScale));
+        return _mm256_cvtps_epi32(value);
+    }
+
+    __m256i QuantizeSnorm8(__m256 value)
+    {
+        value = _mm256_mul_ps(value, _mm256_set1_ps(s_SnormScale));
+        value = _mm256_min_ps(_mm256_max_ps(value, _mm256_set1_ps(-s_SnormScale)), _mm256_set1_ps(s_SnormScale));
+        return _mm256_cvtps_epi32(value);
+    }
+
+    __m256i FloatToHalf8(__m256 value)
+    {
+        return _mm256_cvtepu16_epi32(_mm256_cvtps_ph(value, _MM_FROUND_TO_NEAREST_INT));
+    }
+
+    // Eight vertices a step, the rest is left to the scalar path
+    UINT EncodeSimd(VertexFormat format, const Vertex* vertices, UINT count, const float* offset, const float* scale, CompactVertex* output)
+    {
+        static_assert(sizeof(Vertex) == sizeof(__m256), "Vertex is loaded as one row");
+        static_assert(sizeof(CompactVertex) == sizeof(__m128i), "CompactVertex is stored as half a row");
+
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256i lowMask = _mm256_set1_epi32(0xFFFF);
+
+        UINT simdCount = count & ~7u;
+
+        for (UINT first = 0; first < simdCount; first += 8)
+        {
+            __m256 rows[8];
+            for (UINT row = 0; row < 8; row++)
+                rows[row] = _mm256_loadu_ps(&vertices[first + row].Position.x);
+
+            // Position xyz, normal xyz, texture coordinate uv
+            Transpose8x8(rows);
+
+            __m256i columns[8];
+
+            if (format == VertexFormat::Quantized)
+            {
+                for (UINT axis = 0; axis < 3; axis++)
+                    columns[axis] = QuantizeUnorm8(_mm256_mul_ps(_mm256_sub_ps(rows[axis], _mm256_set1_ps(offset[axis])), _mm256_set1_ps(scale[axis])));
+
+                columns[6] = QuantizeUnorm8(_mm256_mul_ps(rows[6], _mm256_set1_ps(s_UnormScale)));
+                columns[7] = QuantizeUnorm8(_mm256_mul_ps(rows[7], _mm256_set1_ps(s_UnormScale)));
+            }
+            else
+            {
+                for (UINT axis = 0; axis < 3; axis++)
+                    columns[axis] = FloatToHalf8(rows[axis]);
+
+                columns[6] = FloatToHalf8(rows[6]);
+                columns[7] = FloatToHalf8(rows[7]);
+            }
+
+            columns[3] = _mm256_setzero_si256();
+
+            // GeometryPacking::FoldOctahedral for eight normals
+            {
+                __m256 x = rows[3];
+                __m256 y = rows[4];
+                __m256 z = rows[5];
+
+                __m256 length = _mm256_add_ps(_mm256_add_ps(_mm256_andnot_ps(signMask, x), _mm256_andnot_ps(signMask, y)), _mm256_andnot_ps(signMask, z));
+                __m256 inverseLength = _mm256_div_ps(one, _mm256_max_ps(length, _mm256_set1_ps(1e-20f)));
+
+                x = _mm256_mul_ps(x, inverseLength);
+                y = _mm256_mul_ps(y, inverseLength);
+                z = _mm256_mul_ps(z, inverseLength);
+
+                __m256 foldedX = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_andnot_ps(signMask, y)), _mm256_or_ps(_mm256_and_ps(x, signMask), one));
+                __m256 foldedY = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_andnot_ps(signMask, x)), _mm256_or_ps(_mm256_and_ps(y, signMask), one));
+                __m256 lower = _mm256_cmp_ps(z, _mm256_setzero_ps(), _CMP_LT_OQ);
+
+                columns[4] = _mm256_and_si256(QuantizeSnorm8(_mm256_blendv_ps(x, foldedX, lower)), lowMask);
+                columns[5] = _mm256_and_si256(QuantizeSnorm8(_mm256_blendv_ps(y, foldedY, lower)), lowMask);
+            }
+
+            // Back to one row of eight 16-bit values per vertex
+            for (UINT column = 0; column < 8; column++)
+                rows[column] = _mm256_castsi256_ps(columns[column]);
+
+            Transpose8x8(rows);
+
+            for (UINT row = 0; row < 8; row += 2)
+            {
+                // Packs within 128-bit lanes, the permute puts each vertex in one lane
+                __m256i packed = _mm256_packus_epi32(_mm256_castps_si256(rows[row]), _mm256_castps_si256(rows[row + 1]));
+                packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(&output[first + row]), packed);
+            }
+        }
+
+        return simdCount;
+    }
+#endif // __AVX2__
+}
+
+bool VertexEncoding::IsSimdAvailable()
+{
+#if defined(__AVX2__)
+    return true;
+#else  // __AVX2__
+    return false;
+#endif // __AVX2__
+}
+
+UINT VertexEncoding::GetStride(VertexFormat format)
+{
+    return format == VertexFormat::Full ? sizeof(Vertex) : sizeof(CompactVertex);
+}
+
+const D3D11_INPUT_ELEMENT_DESC* VertexEncoding::GetInputElements(VertexFormat format)
+{
+    switch (format)
+    {
+    case VertexFormat::Quantized:
+        return s_QuantizedElements;
+    case VertexFormat::Half:
+        return s_HalfElements;
+    default:
+        return s_FullElements;
+    }
+}
+
+VertexFormat VertexEncoding::GetFormat(DXGI_FORMAT positionFormat)
+{
+    switch (positionFormat)
+    {
+    case DXGI_FORMAT_R16G16B16A16_UNORM:
+        return VertexFormat::Quantized;
+    case DXGI_FORMAT_R16G16B16A16_FLOAT:
+        return VertexFormat::Half;
+    default:
+        return VertexFormat::Full;
+    }
+}
+
+DirectX::XMMATRIX VertexEncoding::GetPositionTransform(VertexFormat format, const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax)
+{
+    if (format != VertexFormat::Quantized)
+        return DirectX::XMMatrixIdentity();
+
+    DirectX::XMVECTOR offset = DirectX::XMLoadFloat3(&boundsMin);
+    DirectX::XMVECTOR extent = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&boundsMax), offset);
+
+    return DirectX::XMMatrixMultiply(DirectX::XMMatrixScalingFromVector(extent), DirectX::XMMatrixTranslationFromVector(offset));
+}
+
+void VertexEncoding::Encode(VertexFormat format, const Vertex* vertices, UINT count, const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax, BYTE* output, bool simd)
+{
+    if (format == VertexFormat::Full)
+    {
+        std::memcpy(output, vertices, count * sizeof(Vertex));
+        return;
+    }
+
+    // Flat axes quantize to the minimum
+    const float offset[3] = { boundsMin.x, boundsMin.y, boundsMin.z };
+    const float extent[3] = { boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y, boundsMax.z - boundsMin.z };
+    float scale[3];
+
+    for (UINT axis = 0; axis < 3; axis++)
+        scale[axis] = extent[axis] > 0.0f ? s_UnormScale / extent[axis] : 0.0f;
+
+    CompactVertex* compact = reinterpret_cast<CompactVertex*>(output);
+    UINT first = 0;
+
+#if defined(__AVX2__)
+    if (simd)
+        first = EncodeSimd(format, vertices, count, offset, scale, compact);
+#endif // __AVX2__
+
+    EncodeScalar(format, vertices + first, count - first, offset, scale, compact + first);
+}
+
+Vertex VertexEncoding::Decode(VertexFormat format, const BYTE* vertex)
+{
+    if (format == VertexFormat::Full)
+        return *reinterpret_cast<const Vertex*>(vertex);
+
+    const CompactVertex& compact = *reinterpret_cast<const CompactVertex*>(vertex);
+    Vertex result;
+
+    if (format == VertexFormat::Quantized)
+    {
+        result.Position = {
+            static_cast<float>(compact.Position[0]) / s_UnormScale,
+            static_cast<float>(compact.Position[1]) / s_UnormScale,
+            static_cast<float>(compact.Position[2]) / s_UnormScale };
+
+        result.TexCoord = { static_cast<float>(compact.TexCoord[0]) / s_UnormScale, static_cast<float>(compact.TexCoord[1]) / s_UnormScale };
+    }
+    else
+    {
+        result.Position = { HalfToFloat(compact.Position[0]), HalfToFloat(compact.Position[1]), HalfToFloat(compact.Position[2]) };
+        result.TexCoord = { HalfToFloat(compact.TexCoord[0]), HalfToFloat(compact.TexCoord[1]) };
+    }
+
+    float x = (std::max)(static_cast<float>(compact.Normal[0]) / s_SnormScale, -1.0f);
+    float y = (std::max)(static_cast<float>(compact.Normal[1]) / s_SnormScale, -1.0f);
+    result.Normal = GeometryPacking::UnfoldOctahedral(DirectX::XMFLOAT2(x, y));
+    return result;
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2020 Pavlo Lavrenenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <windows.h>
+#include <d3d11.h>
+#include <DirectXMath.h>
+
+struct Vertex final
+{
+    DirectX::XMFLOAT3 Position{ 0.0f, 0.0f, 0.0f };
+    DirectX::XMFLOAT3 Normal{ 0.0f, 0.0f, 0.0f };
+    DirectX::XMFLOAT2 TexCoord{ 0.0f, 0.0f };
+};
+
+// Vertex buffer layouts, every one has an input layout of its own
+enum class VertexFormat
+{
+    Full,      // Vertex, 32 bytes
+    Quantized, // CompactVertex: unorm16 positions within the mesh bounds, unorm16 texture coordinates clamped to [0, 1]
+    Half       // CompactVertex: half float positions and texture coordinates
+};
+
+// Normals of both compact formats are snorm16 octahedral projections, Geometry.fx unfolds them
+struct CompactVertex final
+{
+    USHORT Position[4]; // w is unused
+    SHORT Normal[2];
+    USHORT TexCoord[2];
+};
+
+// Converts Vertex arrays into the compact formats and back. Encoding transposes eight vertices at a time
+// into attribute rows with AVX2, converts every row with one instruction sequence and transposes the
+// 16-bit results back. The scalar path evaluates the same expressions and produces the same bytes.
+class VertexEncoding final
+{
+public:
+    static constexpr UINT s_FormatCount = 3;
+
+    // True when built with AVX2, see DX11_AVX2 in CMakeLists.txt
+    static bool IsSimdAvailable();
+
+    static UINT GetStride(VertexFormat format);
+
+    // Slot 0 elements: POSITION, NORMAL and TEXCOORD
+    static const D3D11_INPUT_ELEMENT_DESC* GetInputElements(VertexFormat format);
+    static constexpr UINT s_InputElementCount = 3;
+
+    // Format whose POSITION element has the given format, CPU backends tell vertex buffers apart by it
+    static VertexFormat GetFormat(DXGI_FORMAT positionFormat);
+
+    // Object space positions of Quantized vertices are boundsMin + position * (boundsMax - boundsMin), this
+    // matrix maps them and goes in front of the world matrix. Identity for other formats.
+    static DirectX::XMMATRIX GetPositionTransform(VertexFormat format, const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax);
+
+    // Writes count vertices of GetStride(format) bytes, bounds are only used by Quantized
+    static void Encode(VertexFormat format, const Vertex* vertices, UINT count, const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax, BYTE* output, bool simd = true);
+
+    // Position as the input assembler passes it to Geometry.fx, before GetPositionTransform(); normal unfolded
+    static Vertex Decode(VertexFormat format, const BYTE* vertex);
+};
@@ -33,6 +33,10 @@ Window::Window(Context& context)
     m_Height = static_cast<LONG>(params.m_WindowHeight);
     m_Instance = GetModuleHandle(nullptr);
 
+    // Headless run: no window is created, keyboard and mouse stay idle
+    if (params.m_DeviceType != DeviceType::Hardware)
+        return;
+
     {
         WNDCLASSEX wcex{ };
         wcex.cbSize = sizeof(wcex);
@@ -99,6 +103,9 @@ FLOAT Window::GetAspectRatio() const
 POINT Window::GetCursorPosition() const
 {
     POINT cursorPosition{ };
+    if (!m_Handle)
+        return cursorPosition;
+
     GetCursorPos(&cursorPosition);
     ScreenToClient(m_Handle, &cursorPosition);
     return cursorPosition;
@@ -111,11 +118,15 @@ const BYTE* Window::GetKeyboardState() const
 
 void Window::DrawCursor(bool draw)
 {
-    ShowCursor(draw);
+    if (m_Handle)
+        ShowCursor(draw);
 }
 
 void Window::LockCursor(bool lock)
 {
+    if (!m_Handle)
+        return;
+
     if (lock && lock != m_IsCursorLocked)
     {
         POINT windowCenter = { m_Width / 2, m_Height / 2 };